@@ -11,23 +11,256 @@
 #include "ippserver.h"
 #include "printer-png.h"
 #include "printer3d-png.h"
+#include <cups/json.h>
+#ifndef _WIN32
+#  include <signal.h>
+#  include <spawn.h>
+#  include <fcntl.h>
+#  include <sys/un.h>
+#endif /* !_WIN32 */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct server_webpage_s		/**** Cached web status page ****/
+{
+  int		printer_id,		/* Printer ID or 0 for the system page */
+		page,			/* Page of jobs */
+		version;		/* Status version of page */
+  bool		apple_client;		/* Rendered for an Apple client? */
+  time_t	used;			/* Time of last use */
+  char		*data;			/* Page content */
+  size_t	length;			/* Length of page content */
+} server_webpage_t;
+
+typedef struct server_webevent_s	/**** Web interface event ****/
+{
+  int		sequence,		/* Sequence number */
+		printer_id;		/* Printer ID */
+  char		*data;			/* JSON event data */
+} server_webevent_t;
+
+#define WEB_JSON_DEPTH	16		/* Maximum nesting of JSON values */
+
+typedef struct server_json_s		/**** Streaming JSON writer ****/
+{
+  server_client_t *client;		/* Client */
+  int		depth;			/* Current nesting depth */
+  bool		values[WEB_JSON_DEPTH];	/* Values written at each depth? */
+} server_json_t;
+
+#define REQUEST_DISCARD_MAX 1048576	/* Maximum unread request data to discard */
+#define WEB_CACHE_MAX	32		/* Maximum number of cached pages */
+#define WEB_EVENTS_MAX	256		/* Maximum number of buffered events */
+#define WEB_JOBS_MAX	50		/* Maximum number of jobs per page */
+
+
+/*
+ * Local globals...
+ */
+
+static cups_mutex_t	web_mutex = CUPS_MUTEX_INITIALIZER;
+					/* Mutex for cached pages */
+static server_webpage_t	web_pages[WEB_CACHE_MAX];
+					/* Cached pages */
+
+static cups_mutex_t	web_events_mutex = CUPS_MUTEX_INITIALIZER;
+					/* Mutex for web events */
+static cups_cond_t	web_events_cond = CUPS_COND_INITIALIZER;
+					/* Condition for new web events */
+static int		web_events_clients = 0,
+					/* Number of event stream clients */
+			web_events_sequence = 0;
+					/* Last event sequence number */
+static server_webevent_t web_events[WEB_EVENTS_MAX];
+					/* Recent events */
+
+static cups_mutex_t	clients_mutex = CUPS_MUTEX_INITIALIZER;
+					/* Mutex for active clients */
+static cups_cond_t	clients_cond = CUPS_COND_INITIALIZER;
+					/* Condition for closed clients */
+static int		clients_active = 0;
+					/* Number of active clients */
+static bool		clients_draining = false;
+					/* Close clients after the current request? (clients_mutex) */
+
+#ifndef _WIN32
+static int		handoff_fd = -1;
+					/* Hand-off socket from previous server */
+static volatile sig_atomic_t restart_requested = 0;
+					/* Graceful restart requested? */
+#endif /* !_WIN32 */
+
+static const char * const printer_reasons[] =
+{					/* printer-state-reasons strings */
+  "Other",
+  "Cover Open",
+  "Input Tray Missing",
+  "Marker Supply Empty",
+  "Marker Supply Low",
+  "Marker Waste Almost Full",
+  "Marker Waste Full",
+  "Media Empty",
+  "Media Jam",
+  "Media Low",
+  "Media Needed",
+  "Moving to Paused",
+  "Paused",
+  "Spool Area Full",
+  "Toner Empty",
+  "Toner Low"
+};
 
 
 /*
  * Local functions...
  */
 
+static bool		get_cached_page(server_client_t *client, int printer_id, int page, bool apple_client, int version);
+static bool		html_buffer(server_client_t *client);
 static void		html_escape(server_client_t *client, const char *s, size_t slen);
 static void		html_footer(server_client_t *client);
 static void		html_header(server_client_t *client, const char *title, int refresh);
 static void		html_printf(server_client_t *client, const char *format, ...) _CUPS_FORMAT(2, 3);
+static void		html_script(server_client_t *client, const char *resource, int page);
+static int		html_send(server_client_t *client, const char *encoding, const char *type);
+static void		html_write(server_client_t *client, const char *data, size_t length);
+#ifndef _WIN32
+static bool		inherit_listener(int fd);
+#endif /* !_WIN32 */
+static bool		is_draining(void);
+static char		*job_when(server_job_t *job, char *buffer, size_t bufsize);
+static void		json_boolean(server_json_t *json, const char *key, bool value);
+static void		json_end(server_json_t *json, char close);
+static void		json_key(server_json_t *json, const char *key);
+static void		json_number(server_json_t *json, const char *key, long value);
+static void		json_pairs(server_json_t *json, const char *data, size_t datalen);
+static void		json_printer(server_json_t *json, server_printer_t *printer);
+static void		json_quote(server_json_t *json, const char *s);
+static void		json_start(server_json_t *json, const char *key, char open);
+static void		json_string(server_json_t *json, const char *key, const char *value);
+#ifdef AF_LOCAL
+static int		listen_local(const char *path);
+#endif /* AF_LOCAL */
 static size_t		parse_options(server_client_t *client, cups_option_t **options);
+static void		put_cached_page(server_client_t *client, int printer_id, int page, bool apple_client, int version);
+#ifndef _WIN32
+static bool		restart_server(void);
+static void		restart_signal(int sig);
+static bool		send_listener(int sock, int fd);
+#endif /* !_WIN32 */
 static int		send_mobile_config(server_client_t *client, server_printer_t *printer);
 static void		send_printer_payload(server_client_t *client, server_printer_t *printer);
+static int		show_events(server_client_t *client, server_printer_t *printer);
+static int		show_json(server_client_t *client, server_printer_t *printer, const char *name, const char *encoding);
 static int		show_materials(server_client_t *client, server_printer_t *printer, const char *encoding);
 static int		show_media(server_client_t *client, server_printer_t *printer, const char *encoding);
 static int		show_status(server_client_t *client, server_printer_t *printer, const char *encoding);
 static int		show_supplies(server_client_t *client, server_printer_t *printer, const char *encoding);
+static bool		wait_request(server_client_t *client);
+
+
+/*
+ * 'serverAddWebEventNoLock()' - Add an event for the web interface event
+ *                               streams.
+ *
+ * Events are only generated while a web browser is connected to one of the
+ * "/events" resources.
+ */
+
+void
+serverAddWebEventNoLock(
+    server_printer_t *printer,		/* I - Printer */
+    server_job_t     *job,		/* I - Job, if any */
+    server_event_t   event)		/* I - Event */
+{
+  int			i;		/* Looping var */
+  server_preason_t	reason;		/* Current reason */
+  cups_json_t		*json,		/* JSON event data */
+			*current,	/* Current value */
+			*reasons,	/* Reasons array */
+			*rcurrent;	/* Current reason */
+  char			*data,		/* JSON string */
+			when[256];	/* When job queued/started/finished */
+  server_webevent_t	*wev;		/* New event */
+
+
+  cupsMutexLock(&web_events_mutex);
+  i = web_events_clients;
+  cupsMutexUnlock(&web_events_mutex);
+
+  if (!i)
+    return;
+
+ /*
+  * Build the event data:
+  *
+  * {
+  *   "event": "...", "printer-id": N, "printer-state": "...",
+  *   "printer-state-reasons": [...], "printer-jobs": N,
+  *   "job-id": N, "job-name": "...", "job-originating-user-name": "...",
+  *   "job-when": "..."
+  * }
+  */
+
+  json    = cupsJSONNew(NULL, NULL, CUPS_JTYPE_OBJECT);
+  current = cupsJSONNewKey(json, NULL, "event");
+  current = cupsJSONNewString(json, current, serverGetNotifySubscribedEvent(event));
+  current = cupsJSONNewKey(json, current, "printer-id");
+  current = cupsJSONNewNumber(json, current, printer->id);
+  current = cupsJSONNewKey(json, current, "printer-state");
+  current = cupsJSONNewString(json, current, printer->state == IPP_PSTATE_IDLE ? "idle" : printer->state == IPP_PSTATE_PROCESSING ? "processing" : "stopped");
+  current = cupsJSONNewKey(json, current, "printer-state-reasons");
+  reasons = cupsJSONNew(json, current, CUPS_JTYPE_ARRAY);
+
+  for (i = 0, reason = 1, rcurrent = NULL; i < (int)(sizeof(printer_reasons) / sizeof(printer_reasons[0])); i ++, reason <<= 1)
+  {
+    if (printer->state_reasons & reason)
+      rcurrent = cupsJSONNewString(reasons, rcurrent, printer_reasons[i]);
+  }
+
+  current = cupsJSONNewKey(json, reasons, "printer-jobs");
+  current = cupsJSONNewNumber(json, current, (double)cupsArrayGetCount(printer->jobs));
+
+  if (job)
+  {
+    current = cupsJSONNewKey(json, current, "job-id");
+    current = cupsJSONNewNumber(json, current, job->id);
+    current = cupsJSONNewKey(json, current, "job-name");
+    current = cupsJSONNewString(json, current, job->name ? job->name : "");
+    current = cupsJSONNewKey(json, current, "job-originating-user-name");
+    current = cupsJSONNewString(json, current, job->username ? job->username : "");
+    current = cupsJSONNewKey(json, current, "job-when");
+    cupsJSONNewString(json, current, job_when(job, when, sizeof(when)));
+  }
+
+  data = cupsJSONExportString(json);
+  cupsJSONDelete(json);
+
+  if (!data)
+    return;
+
+ /*
+  * Add it to the ring of recent events and wake up the event streams...
+  */
+
+  cupsMutexLock(&web_events_mutex);
+
+  web_events_sequence ++;
+
+  wev = web_events + (web_events_sequence % WEB_EVENTS_MAX);
+
+  free(wev->data);
+
+  wev->sequence   = web_events_sequence;
+  wev->printer_id = printer->id;
+  wev->data       = data;
+
+  cupsCondBroadcast(&web_events_cond);
+  cupsMutexUnlock(&web_events_mutex);
+}
 
 
 /*
@@ -66,6 +299,14 @@ serverCreateClient(int sock)		/* I - Listen socket */
 
   httpGetHostname(client->http, client->hostname, sizeof(client->hostname));
 
+  cupsMutexLock(&clients_mutex);
+  clients_active ++;
+  cupsMutexUnlock(&clients_mutex);
+
+#ifdef AF_LOCAL
+  client->is_local = httpAddrGetFamily(httpGetAddress(client->http)) == AF_LOCAL;
+#endif /* AF_LOCAL */
+
   serverLogClient(SERVER_LOGLEVEL_INFO, client, "Accepted connection from \"%s\".", client->hostname);
 
   return (client);
@@ -74,11 +315,14 @@ serverCreateClient(int sock)		/* I - Listen socket */
 
 /*
  * 'serverCreateListener()' - Create a listener socket.
+ *
+ * A host starting with "/" is the path of a UNIX domain socket, which only the
+ * server's user and group can connect to.
  */
 
 int					/* O - 1 on success, 0 on error */
-serverCreateListeners(const char *host,	/* I - Hostname, IP address, or NULL for any address */
-                      int        port)	/* I - Port number */
+serverCreateListeners(const char *host,	/* I - Hostname, IP address, socket path, or NULL for any address */
+                      int        port)	/* I - Port number (ignored for socket paths) */
 {
   int			count = 0;	/* Number of sockets */
   int			sock;		/* Listener socket */
@@ -92,6 +336,22 @@ serverCreateListeners(const char *host,	/* I - Hostname, IP address, or NULL for
   if (host && !strcmp(host, "*"))
     host = NULL;
 
+#ifndef _WIN32
+  if (host && *host == '/')
+  {
+    struct stat	fileinfo;		/* Socket file information */
+
+   /*
+    * Remove any socket file left behind by a previous server...
+    */
+
+    port = 0;
+
+    if (!lstat(host, &fileinfo) && S_ISSOCK(fileinfo.st_mode))
+      unlink(host);
+  }
+#endif /* !_WIN32 */
+
   snprintf(service, sizeof(service), "%d", port);
   if ((addrlist = httpAddrGetList(host, AF_UNSPEC, service)) == NULL)
   {
@@ -107,7 +367,14 @@ serverCreateListeners(const char *host,	/* I - Hostname, IP address, or NULL for
 
   for (addr = addrlist; addr; addr = addr->next)
   {
-    if ((sock = httpAddrListen(&(addr->addr), port)) < 0)
+#ifdef AF_LOCAL
+    if (httpAddrGetFamily(&(addr->addr)) == AF_LOCAL)
+      sock = listen_local(host);
+    else
+#endif /* AF_LOCAL */
+    sock = httpAddrListen(&(addr->addr), port);
+
+    if (sock < 0)
       continue;
 
     if ((lis = calloc(1, sizeof(server_listener_t))) == NULL)
@@ -157,7 +424,145 @@ serverDeleteClient(server_client_t *client)	/* I - Client */
   ippDelete(client->request);
   ippDelete(client->response);
 
+  free(client->html);
   free(client);
+
+  cupsMutexLock(&clients_mutex);
+  clients_active --;
+  cupsCondBroadcast(&clients_cond);
+  cupsMutexUnlock(&clients_mutex);
+}
+
+
+/*
+ * 'serverFlushRequest()' - Discard the unread message body of the current
+ *                          request.
+ *
+ * Only the rest of the current request is read, so any pipelined requests that
+ * follow it stay in the read buffer.  Large bodies are not worth reading, so
+ * after REQUEST_DISCARD_MAX bytes the connection is flushed and closed instead.
+ */
+
+void
+serverFlushRequest(
+    server_client_t *client)		/* I - Client */
+{
+  char		buffer[8192];		/* Discard buffer */
+  ssize_t	bytes;			/* Bytes read */
+  size_t	total = 0;		/* Total bytes discarded */
+
+
+  while (httpGetState(client->http) == HTTP_STATE_POST_RECV && total < REQUEST_DISCARD_MAX)
+  {
+    if ((bytes = httpRead(client->http, buffer, sizeof(buffer))) <= 0)
+      break;
+
+    total += (size_t)bytes;
+  }
+
+  if (httpGetState(client->http) == HTTP_STATE_POST_RECV)
+  {
+    serverLogClient(SERVER_LOGLEVEL_DEBUG, client, "Discarded %u bytes of request data, flushing connection.", (unsigned)total);
+    httpFlush(client->http);
+  }
+}
+
+
+/*
+ * 'serverInheritListeners()' - Adopt listener sockets from a previous server
+ *                              or the service manager.
+ *
+ * During a graceful restart the previous server passes its listeners over the
+ * socket named by the "IPPSERVER_HANDOFF_FD" environment variable.  Otherwise
+ * the systemd "LISTEN_PID" and "LISTEN_FDS" environment variables are used,
+ * with the first listener on file descriptor 3.
+ */
+
+size_t					/* O - Number of inherited listeners */
+serverInheritListeners(void)
+{
+#ifdef _WIN32
+  return (0);
+
+#else
+  size_t	count = 0;		/* Number of listeners */
+  const char	*value;			/* Environment variable value */
+  int		fd,			/* Current file descriptor */
+		num_fds;		/* Number of file descriptors */
+
+
+  if ((value = getenv("IPPSERVER_HANDOFF_FD")) != NULL)
+  {
+   /*
+    * Receive the listeners from the previous server...
+    */
+
+    char		type;		/* Message type */
+    struct iovec	iov;		/* Message data */
+    struct msghdr	msg;		/* Message */
+    struct cmsghdr	*cmsg;		/* Control message */
+    union
+    {
+      struct cmsghdr	hdr;		/* Control message header */
+      char		buf[CMSG_SPACE(sizeof(int))];
+					/* Control message buffer */
+    }			control;	/* Control data */
+
+    handoff_fd = atoi(value);
+    unsetenv("IPPSERVER_HANDOFF_FD");
+
+    fcntl(handoff_fd, F_SETFD, fcntl(handoff_fd, F_GETFD) | FD_CLOEXEC);
+
+    for (;;)
+    {
+      iov.iov_base = &type;
+      iov.iov_len  = 1;
+
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov        = &iov;
+      msg.msg_iovlen     = 1;
+      msg.msg_control    = control.buf;
+      msg.msg_controllen = sizeof(control.buf);
+
+      if (recvmsg(handoff_fd, &msg, 0) != 1)
+      {
+        serverLog(SERVER_LOGLEVEL_ERROR, "Unable to receive listeners from previous server: %s", strerror(errno));
+        close(handoff_fd);
+        handoff_fd = -1;
+        break;
+      }
+
+      if (type == 'E')
+        break;
+
+      if (type == 'L' && (cmsg = CMSG_FIRSTHDR(&msg)) != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      {
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+
+        if (inherit_listener(fd))
+          count ++;
+      }
+    }
+  }
+  else if ((value = getenv("LISTEN_PID")) != NULL && atoi(value) == (int)getpid() && (value = getenv("LISTEN_FDS")) != NULL)
+  {
+   /*
+    * Use the sockets passed by systemd or another service manager...
+    */
+
+    for (fd = 3, num_fds = atoi(value); num_fds > 0; fd ++, num_fds --)
+    {
+      if (inherit_listener(fd))
+        count ++;
+    }
+
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+  }
+
+  return (count);
+#endif /* _WIN32 */
 }
 
 
@@ -175,9 +580,15 @@ serverProcessClient(
 
   int first_time = 1;			/* First time request? */
 
-  while (httpWait(client->http, 30000))
+ /*
+  * Queued responses are sent before waiting for or reading the next request,
+  * since the read buffer might only hold part of it (or a stray CR LF) and the
+  * read would then block with the responses still unsent...
+  */
+
+  while (httpFlushWrite(client->http) >= 0 && wait_request(client))
   {
-    if (first_time && Encryption != HTTP_ENCRYPTION_NEVER)
+    if (first_time && Encryption != HTTP_ENCRYPTION_NEVER && !client->is_local)
     {
      /*
       * See if we need to negotiate a TLS connection...
@@ -202,14 +613,17 @@ serverProcessClient(
       first_time = 0;
     }
 
-    if (!serverProcessHTTP(client))
+    if (!serverProcessHTTP(client) || is_draining())
       break;
   }
 
  /*
-  * Close the conection to the client and return...
+  * Send any remaining responses, then close the conection to the client and
+  * return...
   */
 
+  httpFlushWrite(client->http);
+
   serverDeleteClient(client);
 
   return (NULL);
@@ -247,9 +661,10 @@ serverProcessHTTP(
   ippDelete(client->request);
   ippDelete(client->response);
 
-  client->request   = NULL;
-  client->response  = NULL;
-  client->operation = HTTP_STATE_WAITING;
+  client->request       = NULL;
+  client->response      = NULL;
+  client->operation     = HTTP_STATE_WAITING;
+  client->last_modified = 0;
 
  /*
   * Read a request from the connection...
@@ -375,7 +790,7 @@ serverProcessHTTP(
       return (0);
   }
 
-  if (Encryption == HTTP_ENCRYPTION_REQUIRED && !httpIsEncrypted(client->http))
+  if (Encryption == HTTP_ENCRYPTION_REQUIRED && !httpIsEncrypted(client->http) && !client->is_local)
   {
     serverLogClient(SERVER_LOGLEVEL_ERROR, client, "Forcing encryption of connection.");
     serverRespondHTTP(client, HTTP_STATUS_UPGRADE_REQUIRED, NULL, NULL, 0);
@@ -470,6 +885,10 @@ serverProcessHTTP(
               return (serverRespondHTTP(client, HTTP_STATUS_OK, NULL, "image/png", 0));
             else if (!*uriptr || !strcmp(uriptr, "materials") || !strcmp(uriptr, "media") || !strcmp(uriptr, "supplies"))
               return (serverRespondHTTP(client, HTTP_STATUS_OK, NULL, "text/html", 0));
+            else if (!strcmp(uriptr, "events"))
+              return (serverRespondHTTP(client, HTTP_STATUS_OK, NULL, "text/event-stream", 0));
+            else if (!strcmp(uriptr, "jobs.json") || !strcmp(uriptr, "media.json") || !strcmp(uriptr, "status.json") || !strcmp(uriptr, "supplies.json"))
+              return (serverRespondHTTP(client, HTTP_STATUS_OK, NULL, "application/json", 0));
           }
         }
         else if (!strcmp(client->uri, "/ipp/system/apple.mobileconfig"))
@@ -478,6 +897,10 @@ serverProcessHTTP(
           return (serverRespondHTTP(client, HTTP_STATUS_OK, NULL, res->format, 0));
 	else if (!strcmp(client->uri, "/"))
 	  return (serverRespondHTTP(client, HTTP_STATUS_OK, NULL, "text/html", 0));
+	else if (!strcmp(client->uri, "/events"))
+	  return (serverRespondHTTP(client, HTTP_STATUS_OK, NULL, "text/event-stream", 0));
+	else if (!strcmp(client->uri, "/status.json"))
+	  return (serverRespondHTTP(client, HTTP_STATUS_OK, NULL, "application/json", 0));
 
         return (serverRespondHTTP(client, HTTP_STATUS_NOT_FOUND, NULL, NULL, 0));
 
@@ -585,6 +1008,14 @@ serverProcessHTTP(
             {
               return (show_supplies(client, printer, encoding));
             }
+            else if (!strcmp(uriptr, "events"))
+            {
+              return (show_events(client, printer));
+            }
+            else if (!strcmp(uriptr, "jobs.json") || !strcmp(uriptr, "media.json") || !strcmp(uriptr, "status.json") || !strcmp(uriptr, "supplies.json"))
+            {
+              return (show_json(client, printer, uriptr, encoding));
+            }
           }
 	}
 	else if (!strcmp(client->uri, "/ipp/system/apple.mobileconfig"))
@@ -627,6 +1058,14 @@ serverProcessHTTP(
 	{
           return (show_status(client, NULL, encoding));
 	}
+	else if (!strcmp(client->uri, "/events"))
+	{
+          return (show_events(client, NULL));
+	}
+	else if (!strcmp(client->uri, "/status.json"))
+	{
+          return (show_json(client, NULL, "status.json", encoding));
+	}
 
         return (serverRespondHTTP(client, HTTP_STATUS_NOT_FOUND, NULL, NULL, 0));
 
@@ -701,7 +1140,7 @@ serverRespondHTTP(
   * Format an error message...
   */
 
-  if (!type && !length && code != HTTP_STATUS_OK && code != HTTP_STATUS_SWITCHING_PROTOCOLS)
+  if (!type && !length && code != HTTP_STATUS_OK && code != HTTP_STATUS_SWITCHING_PROTOCOLS && code != HTTP_STATUS_NOT_MODIFIED)
   {
     snprintf(message, sizeof(message), "%d - %s\n", code, httpStatusString(code));
 
@@ -740,7 +1179,17 @@ serverRespondHTTP(
       httpSetField(client->http, HTTP_FIELD_CONTENT_ENCODING, content_encoding);
   }
 
-  httpSetLength(client->http, length);
+  if (client->last_modified)
+  {
+    char date[256];			/* Last-Modified date */
+
+    httpSetField(client->http, HTTP_FIELD_LAST_MODIFIED, httpGetDateString(client->last_modified, date, sizeof(date)));
+  }
+
+  if (code == HTTP_STATUS_NOT_MODIFIED)
+    httpSetField(client->http, HTTP_FIELD_CONTENT_LENGTH, "0");
+  else
+    httpSetLength(client->http, length);
 
   if (!httpWriteResponse(client->http, code))
     return (0);
@@ -802,8 +1251,21 @@ serverRespondHTTP(
     }
   }
 
-  serverLogClient(SERVER_LOGLEVEL_DEBUG, client, "serverRespondHTTP: Flushing write buffer.");
-  httpFlushWrite(client->http);
+  if (code != HTTP_STATUS_SWITCHING_PROTOCOLS && httpGetReady(client->http))
+  {
+   /*
+    * The client has pipelined another request, so leave this response in the
+    * write buffer - serverProcessClient() sends it before reading the next
+    * request...
+    */
+
+    serverLogClient(SERVER_LOGLEVEL_DEBUG, client, "serverRespondHTTP: Queued response for pipelined requests.");
+  }
+  else
+  {
+    serverLogClient(SERVER_LOGLEVEL_DEBUG, client, "serverRespondHTTP: Flushing write buffer.");
+    httpFlushWrite(client->http);
+  }
 
   return (1);
 }
@@ -818,15 +1280,66 @@ serverRun(void)
 {
   int			max_fd;		/* Number of file descriptors */
   fd_set		input;		/* select() input set */
-  struct timeval	timeout;	/* Timeout for poll() */
+#ifdef _WIN32
+  struct timeval	timeout;	/* Timeout for select() */
+#endif /* _WIN32 */
   server_listener_t	*lis;		/* Listener */
   server_client_t	*client;	/* New client */
   time_t                next_clean = 0; /* Next time to clean old jobs */
+#ifndef _WIN32
+  struct sigaction	action;		/* Signal action */
+  sigset_t		usr2_mask,	/* Mask with SIGUSR2 */
+			wait_mask;	/* Mask while waiting in pselect() */
+  struct timespec	wait_timeout;	/* Timeout for pselect() */
+#endif /* !_WIN32 */
 
 
   serverLog(SERVER_LOGLEVEL_DEBUG, "serverRun: %u printers configured.", (unsigned)cupsArrayGetCount(Printers));
   serverLog(SERVER_LOGLEVEL_DEBUG, "serverRun: %u listeners configured.", (unsigned)cupsArrayGetCount(Listeners));
 
+#ifndef _WIN32
+  if (handoff_fd >= 0)
+  {
+   /*
+    * Tell the previous server that we are ready to accept connections...
+    */
+
+    if (write(handoff_fd, "R", 1) != 1)
+      serverLog(SERVER_LOGLEVEL_ERROR, "Unable to notify previous server: %s", strerror(errno));
+
+    close(handoff_fd);
+    handoff_fd = -1;
+  }
+
+ /*
+  * SIGUSR2 starts a graceful restart...
+  */
+
+  memset(&action, 0, sizeof(action));
+  sigemptyset(&action.sa_mask);
+  action.sa_handler = restart_signal;
+  sigaction(SIGUSR2, &action, NULL);
+
+ /*
+  * Block SIGUSR2 in this thread and so in every client and job thread created
+  * from it, and only accept it while the main loop waits in pselect() so the
+  * restart starts right away...
+  */
+
+  sigemptyset(&usr2_mask);
+  sigaddset(&usr2_mask, SIGUSR2);
+  pthread_sigmask(SIG_BLOCK, &usr2_mask, &wait_mask);
+  sigdelset(&wait_mask, SIGUSR2);
+
+ /*
+  * Ignore SIGPIPE so that a document check that stops reading early can't
+  * kill the server...
+  */
+
+  action.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &action, NULL);
+#endif /* !_WIN32 */
+
  /*
   * Loop until we are killed or have a hard error...
   */
@@ -847,15 +1360,34 @@ serverRun(void)
         max_fd = lis->fd;
     }
 
+#ifdef _WIN32
     timeout.tv_sec  = DNSSDUpdate ? 1 : 10;
     timeout.tv_usec = 0;
 
     if (select(max_fd + 1, &input, NULL, NULL, &timeout) < 0 && errno != EINTR)
+#else
+    wait_timeout.tv_sec  = DNSSDUpdate ? 1 : 10;
+    wait_timeout.tv_nsec = 0;
+
+    if (pselect(max_fd + 1, &input, NULL, NULL, &wait_timeout, &wait_mask) < 0 && errno != EINTR)
+#endif /* _WIN32 */
     {
       serverLog(SERVER_LOGLEVEL_ERROR, "Main loop failed (%s)", strerror(errno));
       break;
     }
 
+#ifndef _WIN32
+    if (restart_requested)
+    {
+      restart_requested = 0;
+
+      if (restart_server())
+        return;
+
+      continue;
+    }
+#endif /* !_WIN32 */
+
     for (lis = (server_listener_t *)cupsArrayGetFirst(Listeners); lis; lis = (server_listener_t *)cupsArrayGetNext(Listeners))
     {
       if (FD_ISSET(lis->fd, &input))
@@ -910,6 +1442,67 @@ serverRun(void)
 }
 
 
+/*
+ * 'get_cached_page()' - Copy a cached status page to the client's page buffer.
+ */
+
+static bool				/* O - `true` if found, `false` otherwise */
+get_cached_page(
+    server_client_t *client,		/* I - Client */
+    int             printer_id,		/* I - Printer ID or 0 for the system page */
+    int             page,		/* I - Page of jobs */
+    bool            apple_client,	/* I - Rendered for an Apple client? */
+    int             version)		/* I - Current status version */
+{
+  int			i;		/* Looping var */
+  server_webpage_t	*wp;		/* Current page */
+  bool			found = false;	/* Found the page? */
+
+
+  cupsMutexLock(&web_mutex);
+
+  for (i = WEB_CACHE_MAX, wp = web_pages; i > 0; i --, wp ++)
+  {
+    if (wp->data && wp->printer_id == printer_id && wp->page == page && wp->apple_client == apple_client && wp->version == version)
+    {
+      if ((client->html = malloc(wp->length)) != NULL)
+      {
+        memcpy(client->html, wp->data, wp->length);
+
+        client->html_length = client->html_size = wp->length;
+        wp->used            = time(NULL);
+        found               = true;
+      }
+      break;
+    }
+  }
+
+  cupsMutexUnlock(&web_mutex);
+
+  return (found);
+}
+
+
+/*
+ * 'html_buffer()' - Start a page buffer for a generated response.
+ *
+ * All generated pages are written to the client's page buffer and then sent
+ * using html_send().
+ */
+
+static bool				/* O - `true` on success, `false` on error */
+html_buffer(server_client_t *client)	/* I - Client */
+{
+  if ((client->html = malloc(65536)) == NULL)
+    return (false);
+
+  client->html_length = 0;
+  client->html_size   = 65536;
+
+  return (true);
+}
+
+
 /*
  * 'html_escape()' - Write a HTML-safe string.
  */
@@ -931,12 +1524,12 @@ html_escape(server_client_t *client,	/* I - Client */
     if (*s == '&' || *s == '<')
     {
       if (s > start)
-        httpWrite(client->http, start, (size_t)(s - start));
+        html_write(client, start, (size_t)(s - start));
 
       if (*s == '&')
-        httpWrite(client->http, "&amp;", 5);
+        html_write(client, "&amp;", 5);
       else
-        httpWrite(client->http, "&lt;", 4);
+        html_write(client, "&lt;", 4);
 
       start = s + 1;
     }
@@ -945,14 +1538,15 @@ html_escape(server_client_t *client,	/* I - Client */
   }
 
   if (s > start)
-    httpWrite(client->http, start, (size_t)(s - start));
+    html_write(client, start, (size_t)(s - start));
 }
 
 
 /*
  * 'html_footer()' - Show the web interface footer.
  *
- * This function also writes the trailing 0-length chunk.
+ * The footer is added to the page buffer like the rest of the page, which is
+ * then sent by 'html_send()'.
  */
 
 static void
@@ -964,7 +1558,6 @@ html_footer(server_client_t *client)	/* I - Client */
 	      "ippserver is part of the <a href=\"https://github.com/istopwg/ippsample\" target=\"_blank\">ippsample</a> project and is provided on an \"AS IS\" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. It is <em>not</em> intended for production use.</div>\n"
 	      "</body>\n"
 	      "</html>\n");
-  httpWrite(client->http, "", 0);
 }
 
 
@@ -986,7 +1579,7 @@ html_header(server_client_t *client,	/* I - Client */
 	      "<link rel=\"apple-touch-icon\" href=\"/icon.png\" type=\"image/png\">\n"
 	      "<meta http-equiv=\"X-UA-Compatible\" content=\"IE=9\">\n", title);
   if (refresh > 0)
-    html_printf(client, "<meta http-equiv=\"refresh\" content=\"%d\">\n", refresh);
+    html_printf(client, "<noscript><meta http-equiv=\"refresh\" content=\"%d\"></noscript>\n", refresh);
   html_printf(client,
 	      "<meta name=\"viewport\" content=\"width=device-width\">\n"
 	      "<style>\n"
@@ -1052,14 +1645,14 @@ html_printf(server_client_t *client,	/* I - Client */
     if (*format == '%')
     {
       if (format > start)
-        httpWrite(client->http, start, (size_t)(format - start));
+        html_write(client, start, (size_t)(format - start));
 
       tptr    = tformat;
       *tptr++ = *format++;
 
       if (*format == '%')
       {
-        httpWrite(client->http, "%", 1);
+        html_write(client, "%", 1);
         format ++;
 	start = format;
 	continue;
@@ -1173,7 +1766,7 @@ html_printf(server_client_t *client,	/* I - Client */
 
 	    snprintf(temp, sizeof(temp), tformat, va_arg(ap, double));
 
-            httpWrite(client->http, temp, strlen(temp));
+            html_write(client, temp, strlen(temp));
 	    break;
 
         case 'B' : /* Integer formats */
@@ -1197,7 +1790,7 @@ html_printf(server_client_t *client,	/* I - Client */
 	    else
 	      snprintf(temp, sizeof(temp), tformat, va_arg(ap, int));
 
-            httpWrite(client->http, temp, strlen(temp));
+            html_write(client, temp, strlen(temp));
 	    break;
 
 	case 'p' : /* Pointer value */
@@ -1206,7 +1799,7 @@ html_printf(server_client_t *client,	/* I - Client */
 
 	    snprintf(temp, sizeof(temp), tformat, va_arg(ap, void *));
 
-            httpWrite(client->http, temp, strlen(temp));
+            html_write(client, temp, strlen(temp));
 	    break;
 
         case 'c' : /* Character or character array */
@@ -1233,192 +1826,1478 @@ html_printf(server_client_t *client,	/* I - Client */
   }
 
   if (format > start)
-    httpWrite(client->http, start, (size_t)(format - start));
+    html_write(client, start, (size_t)(format - start));
 
   va_end(ap);
 }
 
 
 /*
- * 'parse_options()' - Parse URL options into CUPS options.
+ * 'html_script()' - Show the script that updates a status page from the event
+ *                   stream.
  *
- * The client->options string is destroyed by this function.
+ * Printer state paragraphs use the id "printer-N" and job rows use the id
+ * "job-N".  New jobs are only added to the first page of jobs.
  */
 
-static size_t				/* O - Number of options */
-parse_options(server_client_t *client,	/* I - Client */
-              cups_option_t   **options)/* O - Options */
+static void
+html_script(server_client_t *client,	/* I - Client */
+            const char      *resource,	/* I - Printer resource or "" for system */
+            int             page)	/* I - Page of jobs or 0 for system */
 {
-  char		*post_data = NULL,	/* POST form data */
-		*name,			/* Name */
-      		*value,			/* Value */
-		*next;			/* Next name=value pair */
-  size_t	num_options = 0;	/* Number of options */
+  html_printf(client,
+	      "<script>\n"
+	      "var page = %d, opened = false, events = new EventSource(\"%s/events\");\n"
+	      "var states = { \"idle\": \"Idle\", \"processing\": \"Printing\", \"stopped\": \"Stopped\" };\n"
+	      "events.onopen = function() {\n"
+	      "  if (opened)\n"
+	      "    location.reload();\n"
+	      "  opened = true;\n"
+	      "};\n"
+	      "events.onmessage = function(e) {\n"
+	      "  var ev = JSON.parse(e.data), el, row, i;\n"
+	      "  if (ev[\"event\"] == \"reload\" || (el = document.getElementById(\"printer-\" + ev[\"printer-id\"])) == null) {\n"
+	      "    location.reload();\n"
+	      "    return;\n"
+	      "  }\n"
+	      "  el.textContent = states[ev[\"printer-state\"]] + \", \" + ev[\"printer-jobs\"] + \" job(s).\";\n"
+	      "  ev[\"printer-state-reasons\"].forEach(function(reason) {\n"
+	      "    el.appendChild(document.createElement(\"br\"));\n"
+	      "    el.appendChild(document.createTextNode(\"\\u00a0\\u00a0\\u00a0\\u00a0\" + reason));\n"
+	      "  });\n"
+	      "  if (page == 0 || ev[\"job-id\"] == null)\n"
+	      "    return;\n"
+	      "  if ((row = document.getElementById(\"job-\" + ev[\"job-id\"])) == null) {\n"
+	      "    if (page != 1)\n"
+	      "      return;\n"
+	      "    if ((el = document.getElementById(\"jobs\")) == null) {\n"
+	      "      location.reload();\n"
+	      "      return;\n"
+	      "    }\n"
+	      "    row    = el.insertRow(0);\n"
+	      "    row.id = \"job-\" + ev[\"job-id\"];\n"
+	      "    for (i = 0; i != 4; i ++)\n"
+	      "      row.insertCell(i);\n"
+	      "  }\n"
+	      "  row.cells[0].textContent = ev[\"job-id\"];\n"
+	      "  row.cells[1].textContent = ev[\"job-name\"];\n"
+	      "  row.cells[2].textContent = ev[\"job-originating-user-name\"];\n"
+	      "  row.cells[3].textContent = ev[\"job-when\"];\n"
+	      "};\n"
+	      "</script>\n", page, resource);
+}
 
 
-  *options = NULL;
+/*
+ * 'html_send()' - Send the page buffer to the client and free it.
+ *
+ * Uncompressed pages are sent with an exact Content-Length using a single
+ * httpWrite() call.  Compressed pages are passed to the compressor in one call
+ * and end with a 0-length chunk.
+ */
 
-  if (httpGetState(client->http) == HTTP_STATE_POST_RECV)
+static int				/* O - 1 on success, 0 on failure */
+html_send(server_client_t *client,	/* I - Client */
+          const char      *encoding,	/* I - Content-Encoding to use */
+          const char      *type)	/* I - MIME media type */
+{
+  int	status = 0;			/* Return status */
+
+
+  if (!client->html)
   {
-    off_t	post_len = httpGetLength(client->http);
-					/* Length of POST form data */
+    serverRespondHTTP(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0);
+  }
+  else if (serverRespondHTTP(client, HTTP_STATUS_OK, encoding, type, encoding ? 0 : client->html_length))
+  {
+    httpWrite(client->http, client->html, client->html_length);
 
-    if (post_len == 0 || post_len > 65535)
-      post_len = 65535;
+    if (encoding)
+      httpWrite(client->http, "", 0);
 
-    if ((post_data = calloc(1, (size_t)post_len + 1)) != NULL)
-    {
-      char	*post_ptr = post_data,	/* Pointer into POST form data */
-		*post_end = post_data + post_len;
-					/* Pointer to end of POST form data */
-      ssize_t	post_bytes;		/* Number of bytes read... */
+    status = httpFlushWrite(client->http) >= 0;
+  }
 
+  free(client->html);
+  client->html        = NULL;
+  client->html_length = 0;
+  client->html_size   = 0;
 
-      while ((post_bytes = httpRead(client->http, post_ptr, (size_t)(post_end - post_ptr))) > 0)
-      {
-        post_ptr += post_bytes;
-      }
+  return (status);
+}
 
-      *post_ptr = '\0';
-    }
 
-    name = post_data;
-  }
-  else
+/*
+ * 'html_write()' - Write data to the client's page buffer.
+ */
+
+static void
+html_write(server_client_t *client,	/* I - Client */
+           const char      *data,	/* I - Data to write */
+           size_t          length)	/* I - Length of data */
+{
+  if (!client->html)
+    return;
+
+ /*
+  * Append to the page buffer, expanding as needed...
+  */
+
+  if ((client->html_length + length) > client->html_size)
+  {
+    size_t	newsize = 2 * client->html_size + length;
+					/* New buffer size */
+    char	*newhtml;		/* New buffer */
+
+    if ((newhtml = realloc(client->html, newsize)) == NULL)
+    {
+      free(client->html);
+      client->html = NULL;
+      return;
+    }
+
+    client->html      = newhtml;
+    client->html_size = newsize;
+  }
+
+  memcpy(client->html + client->html_length, data, length);
+  client->html_length += length;
+}
+
+
+#ifndef _WIN32
+/*
+ * 'inherit_listener()' - Add an inherited listener socket.
+ */
+
+static bool				/* O - `true` on success, `false` on error */
+inherit_listener(int fd)		/* I - Listener socket */
+{
+  http_addr_t		addr;		/* Listener address */
+  socklen_t		addrlen;	/* Length of address */
+  server_listener_t	*lis;		/* New listener */
+
+
+  memset(&addr, 0, sizeof(addr));
+  addrlen = sizeof(addr);
+
+  if (getsockname(fd, (struct sockaddr *)&addr, &addrlen))
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "Ignoring inherited file descriptor %d: %s", fd, strerror(errno));
+    return (false);
+  }
+
+  if ((lis = calloc(1, sizeof(server_listener_t))) == NULL)
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "Unable to allocate memory for listener: %s", strerror(errno));
+    close(fd);
+    return (false);
+  }
+
+  fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+
+  lis->fd   = fd;
+  lis->port = httpAddrGetPort(&addr);
+
+  if (httpAddrIsAny(&addr))
+    httpGetHostname(NULL, lis->host, sizeof(lis->host));
+  else
+    httpAddrGetString(&addr, lis->host, sizeof(lis->host));
+
+  if (lis->port > 0 && !DefaultPort)
+    DefaultPort = lis->port;
+
+  if (!Listeners)
+    Listeners = cupsArrayNew(NULL, NULL, NULL, 0, NULL, NULL);
+
+  cupsArrayAdd(Listeners, lis);
+
+  serverLog(SERVER_LOGLEVEL_INFO, "Using inherited listener %s:%d.", lis->host, lis->port);
+
+  return (true);
+}
+#endif /* !_WIN32 */
+
+
+/*
+ * 'is_draining()' - Determine whether clients are being closed for a restart.
+ */
+
+static bool				/* O - `true` if draining, `false` otherwise */
+is_draining(void)
+{
+  bool	draining;			/* Draining clients? */
+
+
+  cupsMutexLock(&clients_mutex);
+  draining = clients_draining;
+  cupsMutexUnlock(&clients_mutex);
+
+  return (draining);
+}
+
+
+/*
+ * 'job_when()' - Describe when a job was queued, started, or finished.
+ */
+
+static char *				/* O - Description */
+job_when(server_job_t *job,		/* I - Job */
+         char         *buffer,		/* I - String buffer */
+         size_t       bufsize)		/* I - Size of string buffer */
+{
+  char	hhmmss[64];			/* Time HH:MM:SS */
+
+
+  switch (job->state)
+  {
+    case IPP_JSTATE_PENDING :
+    case IPP_JSTATE_HELD :
+        snprintf(buffer, bufsize, "Queued at %s", serverTimeString(job->created, hhmmss, sizeof(hhmmss)));
+        break;
+    case IPP_JSTATE_PROCESSING :
+    case IPP_JSTATE_STOPPED :
+        snprintf(buffer, bufsize, "Started at %s", serverTimeString(job->processing, hhmmss, sizeof(hhmmss)));
+        break;
+    case IPP_JSTATE_ABORTED :
+        snprintf(buffer, bufsize, "Aborted at %s", serverTimeString(job->completed, hhmmss, sizeof(hhmmss)));
+        break;
+    case IPP_JSTATE_CANCELED :
+        snprintf(buffer, bufsize, "Canceled at %s", serverTimeString(job->completed, hhmmss, sizeof(hhmmss)));
+        break;
+    case IPP_JSTATE_COMPLETED :
+        snprintf(buffer, bufsize, "Completed at %s", serverTimeString(job->completed, hhmmss, sizeof(hhmmss)));
+        break;
+  }
+
+  return (buffer);
+}
+
+
+/*
+ * 'json_boolean()' - Write a boolean JSON value.
+ */
+
+static void
+json_boolean(server_json_t *json,	/* I - JSON writer */
+             const char    *key,	/* I - Key or `NULL` for an array value */
+             bool          value)	/* I - Value */
+{
+  json_key(json, key);
+
+  if (value)
+    html_write(json->client, "true", 4);
+  else
+    html_write(json->client, "false", 5);
+}
+
+
+/*
+ * 'json_end()' - End a JSON object or array.
+ */
+
+static void
+json_end(server_json_t *json,		/* I - JSON writer */
+         char          close)		/* I - '}' or ']' */
+{
+  if (json->depth > 0)
+    json->depth --;
+
+  html_write(json->client, &close, 1);
+}
+
+
+/*
+ * 'json_key()' - Write the separator and key for a JSON value.
+ */
+
+static void
+json_key(server_json_t *json,		/* I - JSON writer */
+         const char    *key)		/* I - Key or `NULL` for an array value */
+{
+  if (json->values[json->depth])
+    html_write(json->client, ",", 1);
+  else
+    json->values[json->depth] = true;
+
+  if (key)
+  {
+    json_quote(json, key);
+    html_write(json->client, ":", 1);
+  }
+}
+
+
+/*
+ * 'json_number()' - Write a numeric JSON value.
+ */
+
+static void
+json_number(server_json_t *json,	/* I - JSON writer */
+            const char    *key,		/* I - Key or `NULL` for an array value */
+            long          value)	/* I - Value */
+{
+  char	temp[32];			/* Number string */
+
+
+  json_key(json, key);
+
+  snprintf(temp, sizeof(temp), "%ld", value);
+  html_write(json->client, temp, strlen(temp));
+}
+
+
+/*
+ * 'json_pairs()' - Write the "key=value;" pairs from a printer-supply or
+ *                  printer-input-tray value as members of the current object.
+ */
+
+static void
+json_pairs(server_json_t *json,		/* I - JSON writer */
+           const char    *data,		/* I - "key=value;" string */
+           size_t        datalen)	/* I - Length of string */
+{
+  char	temp[1024],			/* Copy of string */
+	*name,				/* Current key */
+	*value,				/* Current value */
+	*next,				/* Next pair */
+	*end;				/* End of number */
+  long	number;				/* Numeric value */
+
+
+  if (datalen > (sizeof(temp) - 1))
+    datalen = sizeof(temp) - 1;
+
+  memcpy(temp, data, datalen);
+  temp[datalen] = '\0';
+
+  for (name = temp; *name; name = next)
+  {
+    if ((next = strchr(name, ';')) != NULL)
+      *next++ = '\0';
+    else
+      next = name + strlen(name);
+
+    if ((value = strchr(name, '=')) == NULL)
+      continue;
+
+    *value++ = '\0';
+
+    number = strtol(value, &end, 10);
+
+    if ((isdigit(*value & 255) || (*value == '-' && isdigit(value[1] & 255))) && !*end)
+      json_number(json, name, number);
+    else
+      json_string(json, name, value);
+  }
+}
+
+
+/*
+ * 'json_printer()' - Write the state of a printer as a JSON object.
+ */
+
+static void
+json_printer(server_json_t    *json,	/* I - JSON writer */
+             server_printer_t *printer)	/* I - Printer */
+{
+  size_t		i;		/* Looping var */
+  server_preason_t	creasons,	/* Combined reasons */
+			reason;		/* Current reason */
+
+
+  creasons = printer->state_reasons | printer->dev_reasons;
+
+  if (printer->state == IPP_PSTATE_STOPPED)
+    creasons |= SERVER_PREASON_PAUSED;
+  else
+    creasons &= (server_preason_t)~SERVER_PREASON_PAUSED;
+
+  json_start(json, NULL, '{');
+  json_number(json, "printer-id", printer->id);
+  json_string(json, "printer-name", printer->name);
+  json_string(json, "printer-dns-sd-name", printer->dns_sd_name);
+  json_string(json, "printer-uri-path", printer->resource);
+  json_string(json, "printer-state", ippEnumString("printer-state", (int)printer->state));
+
+  json_start(json, "printer-state-reasons", '[');
+  for (i = 0, reason = 1; i < (sizeof(server_preasons) / sizeof(server_preasons[0])); i ++, reason <<= 1)
+  {
+    if (creasons & reason)
+      json_string(json, NULL, server_preasons[i]);
+  }
+  json_end(json, ']');
+
+  json_number(json, "printer-state-change-time", (long)printer->state_time);
+  json_number(json, "printer-config-change-time", (long)printer->config_time);
+  json_boolean(json, "printer-is-accepting-jobs", printer->is_accepting);
+  json_number(json, "queued-job-count", (long)cupsArrayGetCount(printer->active_jobs));
+  json_number(json, "printer-jobs", (long)cupsArrayGetCount(printer->jobs));
+  json_end(json, '}');
+}
+
+
+/*
+ * 'json_quote()' - Write a quoted JSON string.
+ */
+
+static void
+json_quote(server_json_t *json,		/* I - JSON writer */
+           const char    *s)		/* I - String */
+{
+  const char	*start;			/* Start of unquoted text */
+  char		temp[8];		/* Escape sequence */
+
+
+  html_write(json->client, "\"", 1);
+
+  for (start = s; *s; s ++)
+  {
+    if (*s == '\"' || *s == '\\' || (*s & 255) < ' ')
+    {
+      if (s > start)
+        html_write(json->client, start, (size_t)(s - start));
+
+      if (*s == '\"' || *s == '\\')
+        snprintf(temp, sizeof(temp), "\\%c", *s);
+      else
+        snprintf(temp, sizeof(temp), "\\u%04x", *s & 255);
+
+      html_write(json->client, temp, strlen(temp));
+
+      start = s + 1;
+    }
+  }
+
+  if (s > start)
+    html_write(json->client, start, (size_t)(s - start));
+
+  html_write(json->client, "\"", 1);
+}
+
+
+/*
+ * 'json_start()' - Start a JSON object or array.
+ */
+
+static void
+json_start(server_json_t *json,		/* I - JSON writer */
+           const char    *key,		/* I - Key or `NULL` for an array value */
+           char          open)		/* I - '{' or '[' */
+{
+  json_key(json, key);
+
+  html_write(json->client, &open, 1);
+
+  if (json->depth < (WEB_JSON_DEPTH - 1))
+    json->depth ++;
+
+  json->values[json->depth] = false;
+}
+
+
+/*
+ * 'json_string()' - Write a string JSON value.
+ */
+
+static void
+json_string(server_json_t *json,	/* I - JSON writer */
+            const char    *key,		/* I - Key or `NULL` for an array value */
+            const char    *value)	/* I - Value or `NULL` for null */
+{
+  json_key(json, key);
+
+  if (value)
+    json_quote(json, value);
+  else
+    html_write(json->client, "null", 4);
+}
+
+
+#ifdef AF_LOCAL
+/*
+ * 'listen_local()' - Create a listener for a UNIX domain socket.
+ *
+ * The socket is created with mode 0660 (using the umask) before it starts
+ * listening, so other users can never connect to it.
+ */
+
+static int				/* O - Listener socket or -1 on error */
+listen_local(const char *path)		/* I - Socket path */
+{
+  int			sock;		/* Listener socket */
+  struct sockaddr_un	addr;		/* Socket address */
+  mode_t		mask;		/* Saved umask */
+  int			status;		/* Result of bind() */
+
+
+  if (strlen(path) >= sizeof(addr.sun_path))
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "Socket path \"%s\" is too long.", path);
+    return (-1);
+  }
+
+  if ((sock = socket(AF_LOCAL, SOCK_STREAM, 0)) < 0)
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "Unable to create socket \"%s\": %s", path, strerror(errno));
+    return (-1);
+  }
+
+  fcntl(sock, F_SETFD, FD_CLOEXEC);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_LOCAL;
+  cupsCopyString(addr.sun_path, path, sizeof(addr.sun_path));
+
+  mask   = umask(0117);
+  status = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+  umask(mask);
+
+  if (status)
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "Unable to bind socket \"%s\": %s", path, strerror(errno));
+    close(sock);
+    return (-1);
+  }
+
+ /*
+  * Set the mode explicitly as well, in case the umask was not applied...
+  */
+
+  if (chmod(path, 0660))
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "Unable to set permissions of socket \"%s\": %s", path, strerror(errno));
+    close(sock);
+    unlink(path);
+    return (-1);
+  }
+
+  if (listen(sock, 128))
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "Unable to listen on socket \"%s\": %s", path, strerror(errno));
+    close(sock);
+    unlink(path);
+    return (-1);
+  }
+
+  return (sock);
+}
+#endif /* AF_LOCAL */
+
+
+/*
+ * 'parse_options()' - Parse URL options into CUPS options.
+ *
+ * The client->options string is destroyed by this function.
+ */
+
+static size_t				/* O - Number of options */
+parse_options(server_client_t *client,	/* I - Client */
+              cups_option_t   **options)/* O - Options */
+{
+  char		*post_data = NULL,	/* POST form data */
+		*name,			/* Name */
+      		*value,			/* Value */
+		*next;			/* Next name=value pair */
+  size_t	num_options = 0;	/* Number of options */
+
+
+  *options = NULL;
+
+  if (httpGetState(client->http) == HTTP_STATE_POST_RECV)
+  {
+    off_t	post_len = httpGetLength(client->http);
+					/* Length of POST form data */
+
+    if (post_len == 0 || post_len > 65535)
+      post_len = 65535;
+
+    if ((post_data = calloc(1, (size_t)post_len + 1)) != NULL)
+    {
+      char	*post_ptr = post_data,	/* Pointer into POST form data */
+		*post_end = post_data + post_len;
+					/* Pointer to end of POST form data */
+      ssize_t	post_bytes;		/* Number of bytes read... */
+
+
+      while ((post_bytes = httpRead(client->http, post_ptr, (size_t)(post_end - post_ptr))) > 0)
+      {
+        post_ptr += post_bytes;
+      }
+
+      *post_ptr = '\0';
+    }
+
+    name = post_data;
+  }
+  else
     name = client->options;
 
-  while (name && *name)
+  while (name && *name)
+  {
+    if ((value = strchr(name, '=')) == NULL)
+      break;
+
+    *value++ = '\0';
+    if ((next = strchr(value, '&')) != NULL)
+      *next++ = '\0';
+
+    num_options = cupsAddOption(name, value, num_options, options);
+    name        = next;
+  }
+
+  if (post_data)
+    free(post_data);
+
+  return (num_options);
+}
+
+
+/*
+ * 'put_cached_page()' - Save the client's page buffer in the page cache.
+ */
+
+static void
+put_cached_page(
+    server_client_t *client,		/* I - Client */
+    int             printer_id,		/* I - Printer ID or 0 for the system page */
+    int             page,		/* I - Page of jobs */
+    bool            apple_client,	/* I - Rendered for an Apple client? */
+    int             version)		/* I - Status version of page */
+{
+  int			i;		/* Looping var */
+  server_webpage_t	*wp,		/* Current page */
+			*oldest;	/* Page to replace */
+  char			*data;		/* Copy of page */
+
+
+  if ((data = malloc(client->html_length)) == NULL)
+    return;
+
+  memcpy(data, client->html, client->html_length);
+
+  cupsMutexLock(&web_mutex);
+
+ /*
+  * Replace the previous version of this page or the least recently used
+  * page...
+  */
+
+  for (i = WEB_CACHE_MAX, wp = web_pages, oldest = NULL; i > 0; i --, wp ++)
+  {
+    if (wp->data && wp->printer_id == printer_id && wp->page == page && wp->apple_client == apple_client)
+    {
+      oldest = wp;
+      break;
+    }
+    else if (!oldest || (oldest->data && (!wp->data || wp->used < oldest->used)))
+      oldest = wp;
+  }
+
+  free(oldest->data);
+
+  oldest->printer_id   = printer_id;
+  oldest->page         = page;
+  oldest->version      = version;
+  oldest->apple_client = apple_client;
+  oldest->used         = time(NULL);
+  oldest->data         = data;
+  oldest->length       = client->html_length;
+
+  cupsMutexUnlock(&web_mutex);
+}
+
+
+#ifndef _WIN32
+/*
+ * 'restart_server()' - Start a new server and hand our listeners to it.
+ *
+ * The new server is started with the same arguments and gets the listeners
+ * over a socket pair.  Once it reports that it is ready, we stop accepting
+ * connections and wait up to 60 seconds for the active clients to finish.
+ */
+
+static bool				/* O - `true` if the new server took over, `false` otherwise */
+restart_server(void)
+{
+  int			fds[2];		/* Hand-off socket pair */
+  pid_t			pid = 0;	/* New server process ID */
+  char			**envp,		/* New server environment */
+			fdenv[64],	/* IPPSERVER_HANDOFF_FD variable */
+			type;		/* Reply from new server */
+  int			envc,		/* Number of environment variables */
+			status;		/* Exit status */
+  size_t		i,		/* Looping var */
+			count;		/* Number of printers */
+  server_printer_t	*printer;	/* Current printer */
+  server_listener_t	*lis;		/* Current listener */
+  struct pollfd		pfd;		/* Hand-off socket poll data */
+  time_t		drain_end;	/* End of drain period */
+
+
+  serverLog(SERVER_LOGLEVEL_INFO, "Starting graceful restart.");
+
+  if (!ServerArgv)
+    return (false);
+
+  if (socketpair(AF_LOCAL, SOCK_STREAM, 0, fds))
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "Unable to create hand-off socket: %s", strerror(errno));
+    return (false);
+  }
+
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+ /*
+  * Copy the current environment and add the hand-off socket...
+  */
+
+  for (envc = 0; environ[envc]; envc ++);
+
+  if ((envp = calloc((size_t)envc + 2, sizeof(char *))) == NULL)
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "Unable to allocate memory for environment: %s", strerror(errno));
+    close(fds[0]);
+    close(fds[1]);
+    return (false);
+  }
+
+  for (envc = 0; environ[envc]; envc ++)
+    envp[envc] = environ[envc];
+
+  snprintf(fdenv, sizeof(fdenv), "IPPSERVER_HANDOFF_FD=%d", fds[1]);
+  envp[envc] = fdenv;
+
+ /*
+  * Remove our DNS-SD registrations so the new server can use the same names...
+  */
+
+  cupsRWLockRead(&PrintersRWLock);
+
+  for (i = 0, count = cupsArrayGetCount(Printers); i < count; i ++)
+  {
+    printer = (server_printer_t *)cupsArrayGetElement(Printers, i);
+
+    serverUnregisterPrinter(printer);
+  }
+
+  cupsRWUnlock(&PrintersRWLock);
+
+ /*
+  * Start the new server...
+  */
+
+  status = posix_spawnp(&pid, ServerArgv[0], NULL, NULL, ServerArgv, envp);
+
+  free(envp);
+  close(fds[1]);
+
+  if (status)
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "Unable to start new server: %s", strerror(status));
+    pid = 0;
+    goto error;
+  }
+
+  serverLog(SERVER_LOGLEVEL_INFO, "Started new server (PID %d).", (int)pid);
+
+ /*
+  * Send the listeners and wait for the new server to become ready...
+  */
+
+  for (lis = (server_listener_t *)cupsArrayGetFirst(Listeners); lis; lis = (server_listener_t *)cupsArrayGetNext(Listeners))
+  {
+    if (!send_listener(fds[0], lis->fd))
+      goto error;
+  }
+
+  if (write(fds[0], "E", 1) != 1)
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "Unable to send listeners to new server: %s", strerror(errno));
+    goto error;
+  }
+
+  pfd.fd     = fds[0];
+  pfd.events = POLLIN;
+
+  if (poll(&pfd, 1, 60000) <= 0 || read(fds[0], &type, 1) != 1 || type != 'R')
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "New server did not start.");
+    goto error;
+  }
+
+  close(fds[0]);
+
+ /*
+  * Stop accepting connections and drain the active clients.  The sockets are
+  * closed without removing any socket files, which the new server still uses.
+  */
+
+  for (lis = (server_listener_t *)cupsArrayGetFirst(Listeners); lis; lis = (server_listener_t *)cupsArrayGetNext(Listeners))
+  {
+    close(lis->fd);
+    free(lis);
+  }
+
+  cupsArrayDelete(Listeners);
+  Listeners = NULL;
+
+  cupsMutexLock(&clients_mutex);
+
+  serverLog(SERVER_LOGLEVEL_INFO, "New server has taken over, waiting for %d active clients.", clients_active);
+
+  clients_draining = true;
+  drain_end        = time(NULL) + 60;
+
+  while (clients_active > 0 && time(NULL) < drain_end)
+    cupsCondWait(&clients_cond, &clients_mutex, 1.0);
+
+  if (clients_active > 0)
+    serverLog(SERVER_LOGLEVEL_ERROR, "Closing %d active clients.", clients_active);
+
+  cupsMutexUnlock(&clients_mutex);
+
+  return (true);
+
+ /*
+  * If we get here the new server did not take over, so keep running...
+  */
+
+  error:
+
+  close(fds[0]);
+
+  if (pid > 0)
+  {
+    kill(pid, SIGKILL);
+
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+  }
+
+  cupsRWLockRead(&PrintersRWLock);
+
+  for (i = 0, count = cupsArrayGetCount(Printers); i < count; i ++)
+  {
+    printer = (server_printer_t *)cupsArrayGetElement(Printers, i);
+
+    serverRegisterPrinter(printer);
+  }
+
+  cupsRWUnlock(&PrintersRWLock);
+
+  return (false);
+}
+
+
+/*
+ * 'restart_signal()' - Request a graceful restart.
+ */
+
+static void
+restart_signal(int sig)			/* I - Signal number (unused) */
+{
+  (void)sig;
+
+  restart_requested = 1;
+}
+
+
+/*
+ * 'send_listener()' - Send a listener socket to the new server.
+ */
+
+static bool				/* O - `true` on success, `false` on error */
+send_listener(int sock,			/* I - Hand-off socket */
+              int fd)			/* I - Listener socket */
+{
+  char			type = 'L';	/* Message type */
+  struct iovec		iov;		/* Message data */
+  struct msghdr		msg;		/* Message */
+  struct cmsghdr	*cmsg;		/* Control message */
+  union
+  {
+    struct cmsghdr	hdr;		/* Control message header */
+    char		buf[CMSG_SPACE(sizeof(int))];
+					/* Control message buffer */
+  }			control;	/* Control data */
+
+
+  iov.iov_base = &type;
+  iov.iov_len  = 1;
+
+  memset(&msg, 0, sizeof(msg));
+  memset(&control, 0, sizeof(control));
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  cmsg             = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type  = SCM_RIGHTS;
+  cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+  if (sendmsg(sock, &msg, 0) != 1)
+  {
+    serverLog(SERVER_LOGLEVEL_ERROR, "Unable to send listener to new server: %s", strerror(errno));
+    return (false);
+  }
+
+  return (true);
+}
+#endif /* !_WIN32 */
+
+
+/*
+ * 'send_mobile_config()' - Send an Apple mobile configuration file for one or
+ *                          more printers.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+send_mobile_config(
+    server_client_t  *client,		/* I - Client connection */
+    server_printer_t *printer)		/* I - Printer to send (NULL for all) */
+{
+  if (!html_buffer(client))
+    return (serverRespondHTTP(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0));
+
+  html_printf(client,
+              "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+              "<!DOCTYPE plist PUBLIC \"-//Apple Computer//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
+              "<plist version=\"1.0\">\n"
+              "\t<dict>\n"
+              "\t\t<key>PayloadIdentifier</key>\n"
+              "\t\t<string>org.pwg.ippserver.%s</string>\n"
+              "\t\t<key>PayloadUUID</key>\n"
+              "\t\t<string>Unused</string>\n"
+              "\t\t<key>PayloadType</key>\n"
+              "\t\t<string>Configuration</string>\n"
+              "\t\t<key>PayloadVersion</key>\n"
+              "\t\t<integer>1</integer>\n"
+              "\t\t<key>PayloadDescription</key>\n"
+              "\t\t<string>Printers on %s.</string>\n"
+              "\t\t<key>PayloadDisplayName</key>\n"
+              "\t\t<string>%s Printers</string>\n"
+              "\t\t<key>PayloadContent</key>\n"
+              "\t\t<array>\n", ServerName, ServerName, ServerName);
+
+  if (printer)
+  {
+    send_printer_payload(client, printer);
+  }
+  else
+  {
+    cupsRWLockRead(&PrintersRWLock);
+    for (printer = (server_printer_t *)cupsArrayGetFirst(Printers); printer; printer = (server_printer_t *)cupsArrayGetNext(Printers))
+    {
+      if (printer->type == SERVER_TYPE_PRINT)
+        send_printer_payload(client, printer);
+    }
+    cupsRWUnlock(&PrintersRWLock);
+  }
+
+  html_printf(client,
+              "\t\t</array>\n"
+              "\t</dict>\n"
+              "</plist>\n");
+
+  return (html_send(client, NULL, "application/x-apple-aspen-config"));
+}
+
+
+/*
+ * 'send_printer_payload()' - Send the mobile configuration payload for a
+ *                            printer.
+ */
+
+static void
+send_printer_payload(
+    server_client_t  *client,		/* I - Client connection */
+    server_printer_t *printer)		/* I - Printer to send */
+{
+
+  const char	*make_and_model,	/* printer-make-and-model value */
+		*uuid;			/* printer-uuid value */
+
+  cupsRWLockRead(&printer->rwlock);
+
+  make_and_model = ippGetString(ippFindAttribute(printer->pinfo.attrs, "printer-make-and-model", IPP_TAG_TEXT), 0, NULL);
+  uuid           = ippGetString(ippFindAttribute(printer->pinfo.attrs, "printer-uuid", IPP_TAG_URI), 0, NULL);
+
+  if (uuid)
+    uuid += 9;				/* Skip "urn:uuid:" URI prefix */
+  else
+    uuid = "unknown";
+
+  html_printf(client,
+              "\t\t\t<dict>\n"
+              "\t\t\t\t<key>PayloadIdentifier</key>\n"
+              "\t\t\t\t<string>org.pwg.ippserver.%s.%s</string>\n"
+              "\t\t\t\t<key>PayloadUUID</key>\n"
+              "\t\t\t\t<string>%s</string>\n"
+              "\t\t\t\t<key>PayloadType</key>\n"
+              "\t\t\t\t<string>com.apple.airprint</string>\n"
+              "\t\t\t\t<key>PayloadVersion</key>\n"
+              "\t\t\t\t<integer>1</integer>\n"
+              "\t\t\t\t<key>PayloadDescription</key>\n"
+              "\t\t\t\t<string>%s</string>\n"
+              "\t\t\t\t<key>PayloadDisplayName</key>\n"
+              "\t\t\t\t<string>%s</string>\n"
+              "\t\t\t\t<key>AirPrint</key>\n"
+              "\t\t\t\t<array>\n"
+              "\t\t\t\t\t<dict>\n"
+              "\t\t\t\t\t\t<key>IPAddress</key>\n"
+              "\t\t\t\t\t\t<string>%s</string>\n"
+              "\t\t\t\t\t\t<key>ResourcePath</key>\n"
+              "\t\t\t\t\t\t<string>%s</string>\n"
+              "\t\t\t\t\t\t<key>Port</key>\n"
+              "\t\t\t\t\t\t<integer>%d</integer>\n"
+              "\t\t\t\t\t\t<key>ForceTLS</key>\n"
+              "\t\t\t\t\t\t<true />\n"
+              "\t\t\t\t\t</dict>\n"
+              "\t\t\t\t</array>\n"
+              "\t\t\t</dict>\n", ServerName, uuid, uuid, make_and_model ? make_and_model : "unknown", printer->dns_sd_name, ServerName, printer->resource, DefaultPort);
+
+  cupsRWUnlock(&printer->rwlock);
+}
+
+
+/*
+ * 'show_events()' - Send a Server-Sent Events stream of printer/system events.
+ *
+ * The stream stays open until the client disconnects.  A comment is sent
+ * every 15 seconds without events so that closed connections are detected.
+ */
+
+static int				/* O - 0 to close the connection */
+show_events(server_client_t  *client,	/* I - Client connection */
+            server_printer_t *printer)	/* I - Printer or NULL for system */
+{
+  int			printer_id = printer ? printer->id : 0;
+					/* Printer ID */
+  int			sequence,	/* Last event sent */
+			count;		/* Number of events to send */
+  server_webevent_t	*wev;		/* Current event */
+  int			ids[WEB_EVENTS_MAX];
+					/* Event IDs to send */
+  char			*data[WEB_EVENTS_MAX],
+					/* Event data to send */
+			*start,		/* Start of line */
+			*end,		/* End of line */
+			line[256];	/* Line buffer */
+  bool			reload;		/* Missed events? */
+
+
+  if (!serverRespondHTTP(client, HTTP_STATUS_OK, NULL, "text/event-stream", 0))
+    return (0);
+
+  cupsMutexLock(&web_events_mutex);
+  web_events_clients ++;
+  sequence = web_events_sequence;
+  cupsMutexUnlock(&web_events_mutex);
+
+  serverLogClient(SERVER_LOGLEVEL_INFO, client, "Sending events for %s.", printer ? printer->name : "system");
+
+  httpWrite(client->http, "retry: 5000\n\n", 13);
+
+  do
+  {
+   /*
+    * Wait for new events...
+    */
+
+    cupsMutexLock(&web_events_mutex);
+
+    if (sequence == web_events_sequence)
+      cupsCondWait(&web_events_cond, &web_events_mutex, 15.0);
+
+    if ((reload = (web_events_sequence - sequence) > WEB_EVENTS_MAX) == true)
+      sequence = web_events_sequence;
+
+    for (count = 0; sequence < web_events_sequence;)
+    {
+      wev = web_events + (++ sequence % WEB_EVENTS_MAX);
+
+      if (!printer_id || wev->printer_id == printer_id)
+      {
+        ids[count]    = wev->sequence;
+        data[count ++] = strdup(wev->data);
+      }
+    }
+
+    cupsMutexUnlock(&web_events_mutex);
+
+   /*
+    * Send them...
+    */
+
+    if (reload)
+    {
+      httpWrite(client->http, "data: {\"event\":\"reload\"}\n\n", 26);
+    }
+    else if (count == 0)
+    {
+      httpWrite(client->http, ":\n\n", 3);
+    }
+    else
+    {
+      int i;				/* Looping var */
+
+      for (i = 0; i < count; i ++)
+      {
+        if (!data[i])
+          continue;
+
+        snprintf(line, sizeof(line), "id: %d\n", ids[i]);
+        httpWrite(client->http, line, strlen(line));
+
+        for (start = data[i]; *start; start = end)
+        {
+          if ((end = strchr(start, '\n')) != NULL)
+            end ++;
+          else
+            end = start + strlen(start);
+
+          httpWrite(client->http, "data: ", 6);
+          httpWrite(client->http, start, (size_t)(end - start));
+          if (end[-1] != '\n')
+            httpWrite(client->http, "\n", 1);
+        }
+
+        httpWrite(client->http, "\n", 1);
+        free(data[i]);
+      }
+    }
+  }
+  while (httpFlushWrite(client->http) >= 0 && !is_draining());
+
+  serverLogClient(SERVER_LOGLEVEL_INFO, client, "Event stream closed.");
+
+  cupsMutexLock(&web_events_mutex);
+  web_events_clients --;
+  cupsMutexUnlock(&web_events_mutex);
+
+  return (0);
+}
+
+
+/*
+ * 'show_json()' - Send printer/system status as JSON.
+ *
+ * The following resources are supported:
+ *
+ *   /status.json            - The state of all printers
+ *   printer/status.json     - The state of a printer
+ *   printer/jobs.json       - A page of jobs ("which-jobs", "page", and
+ *                             "limit" URL options)
+ *   printer/media.json      - Ready media
+ *   printer/supplies.json   - Supply levels
+ *
+ * The JSON is written directly from the printer and job data into the
+ * client's page buffer and then sent with an exact Content-Length.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+show_json(server_client_t  *client,	/* I - Client connection */
+          server_printer_t *printer,	/* I - Printer or NULL for system */
+          const char       *name,	/* I - Resource name */
+          const char       *encoding)	/* I - Content-Encoding to use */
+{
+  server_json_t		json;		/* JSON writer */
+  size_t		i, j,		/* Looping vars */
+			which = 0,	/* which-jobs filter */
+			num_values;	/* Number of values */
+  server_job_t		*job;		/* Current job */
+  server_jreason_t	reason;		/* Current job reason */
+  int			page = 1,	/* Page of jobs */
+			limit = WEB_JOBS_MAX,
+					/* Jobs per page */
+			count;		/* Number of matching jobs */
+  ipp_attribute_t	*attr,		/* Current attribute */
+			*desc,		/* Description attribute */
+			*media_col_ready;/* media-col-ready attribute */
+  ipp_t			*media_col;	/* media-col value */
+  const char		*source,	/* media-source value */
+			*ready_source,	/* media-col-ready media-source value */
+			*data;		/* Octet string value */
+  size_t		datalen;	/* Length of octet string */
+  time_t		modified,	/* Time of last status change */
+			since;		/* If-Modified-Since time */
+  static const struct
+  {
+    const char		*name;		/* which-jobs value */
+    int			comparison;	/* Job state comparison */
+    ipp_jstate_t	state;		/* Job state */
+  }			which_jobs[] =	/* Supported which-jobs values */
+  {
+    { "not-completed",      -1, IPP_JSTATE_STOPPED },
+    { "aborted",            0,  IPP_JSTATE_ABORTED },
+    { "all",                1,  IPP_JSTATE_PENDING },
+    { "canceled",           0,  IPP_JSTATE_CANCELED },
+    { "completed",          1,  IPP_JSTATE_CANCELED },
+    { "pending",            0,  IPP_JSTATE_PENDING },
+    { "pending-held",       0,  IPP_JSTATE_HELD },
+    { "processing",         0,  IPP_JSTATE_PROCESSING },
+    { "processing-stopped", 0,  IPP_JSTATE_STOPPED }
+  };
+
+
+  if (!printer && strcmp(name, "status.json"))
+    return (serverRespondHTTP(client, HTTP_STATUS_NOT_FOUND, NULL, NULL, 0));
+
+  if (!strcmp(name, "jobs.json") && client->options)
+  {
+   /*
+    * Get the job filter and page from the URL options...
+    */
+
+    cups_option_t	*options;	/* URL options */
+    size_t		num_options;	/* Number of URL options */
+    const char		*val;		/* Option value */
+
+    num_options = parse_options(client, &options);
+
+    if ((val = cupsGetOption("page", num_options, options)) != NULL && (page = atoi(val)) < 1)
+      page = 1;
+
+    if ((val = cupsGetOption("limit", num_options, options)) != NULL && ((limit = atoi(val)) < 1 || limit > 1000))
+      limit = WEB_JOBS_MAX;
+
+    if ((val = cupsGetOption("which-jobs", num_options, options)) != NULL)
+    {
+      for (which = 0; which < (sizeof(which_jobs) / sizeof(which_jobs[0])); which ++)
+      {
+        if (!strcmp(val, which_jobs[which].name))
+          break;
+      }
+
+      if (which >= (sizeof(which_jobs) / sizeof(which_jobs[0])))
+      {
+        serverLogClient(SERVER_LOGLEVEL_ERROR, client, "Bad which-jobs value \"%s\".", val);
+        cupsFreeOptions(num_options, options);
+        return (serverRespondHTTP(client, HTTP_STATUS_BAD_REQUEST, NULL, NULL, 0));
+      }
+    }
+
+    cupsFreeOptions(num_options, options);
+  }
+
+  if (!strcmp(name, "status.json") || !strcmp(name, "jobs.json"))
   {
-    if ((value = strchr(name, '=')) == NULL)
-      break;
+   /*
+    * See whether the client already has the current state...
+    */
 
-    *value++ = '\0';
-    if ((next = strchr(value, '&')) != NULL)
-      *next++ = '\0';
+    cupsMutexLock(&SystemStatusMutex);
+    modified = printer ? printer->status_time : SystemStatusTime;
+    cupsMutexUnlock(&SystemStatusMutex);
 
-    num_options = cupsAddOption(name, value, num_options, options);
-    name        = next;
+    if (modified < time(NULL))
+    {
+      client->last_modified = modified;
+
+      if ((since = httpGetDateTime(httpGetField(client->http, HTTP_FIELD_IF_MODIFIED_SINCE))) > 0 && modified <= since)
+        return (serverRespondHTTP(client, HTTP_STATUS_NOT_MODIFIED, NULL, NULL, 0));
+    }
   }
 
-  if (post_data)
-    free(post_data);
+ /*
+  * Write the JSON into the client's page buffer...
+  */
 
-  return (num_options);
-}
+  if (!html_buffer(client))
+    return (serverRespondHTTP(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0));
 
+  memset(&json, 0, sizeof(json));
+  json.client = client;
 
-/*
- * 'send_mobile_config()' - Send an Apple mobile configuration file for one or
- *                          more printers.
- */
+  if (!printer)
+  {
+   /*
+    * {"printers":[{...},...]}
+    */
 
-static int				/* O - 1 on success, 0 on failure */
-send_mobile_config(
-    server_client_t  *client,		/* I - Client connection */
-    server_printer_t *printer)		/* I - Printer to send (NULL for all) */
-{
-  if (!serverRespondHTTP(client, HTTP_STATUS_OK, NULL, "application/x-apple-aspen-config", 0))
-    return (0);
+    json_start(&json, NULL, '{');
+    json_start(&json, "printers", '[');
 
-  html_printf(client,
-              "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
-              "<!DOCTYPE plist PUBLIC \"-//Apple Computer//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
-              "<plist version=\"1.0\">\n"
-              "\t<dict>\n"
-              "\t\t<key>PayloadIdentifier</key>\n"
-              "\t\t<string>org.pwg.ippserver.%s</string>\n"
-              "\t\t<key>PayloadUUID</key>\n"
-              "\t\t<string>Unused</string>\n"
-              "\t\t<key>PayloadType</key>\n"
-              "\t\t<string>Configuration</string>\n"
-              "\t\t<key>PayloadVersion</key>\n"
-              "\t\t<integer>1</integer>\n"
-              "\t\t<key>PayloadDescription</key>\n"
-              "\t\t<string>Printers on %s.</string>\n"
-              "\t\t<key>PayloadDisplayName</key>\n"
-              "\t\t<string>%s Printers</string>\n"
-              "\t\t<key>PayloadContent</key>\n"
-              "\t\t<array>\n", ServerName, ServerName, ServerName);
+    cupsRWLockRead(&PrintersRWLock);
 
-  if (printer)
+    for (printer = (server_printer_t *)cupsArrayGetFirst(Printers); printer; printer = (server_printer_t *)cupsArrayGetNext(Printers))
+    {
+      cupsRWLockRead(&printer->rwlock);
+      json_printer(&json, printer);
+      cupsRWUnlock(&printer->rwlock);
+    }
+
+    cupsRWUnlock(&PrintersRWLock);
+
+    json_end(&json, ']');
+    json_end(&json, '}');
+  }
+  else if (!strcmp(name, "status.json"))
   {
-    send_printer_payload(client, printer);
+   /*
+    * {"printer-id":N,...}
+    */
+
+    cupsRWLockRead(&printer->rwlock);
+    json_printer(&json, printer);
+    cupsRWUnlock(&printer->rwlock);
   }
-  else
+  else if (!strcmp(name, "jobs.json"))
   {
-    cupsRWLockRead(&PrintersRWLock);
-    for (printer = (server_printer_t *)cupsArrayGetFirst(Printers); printer; printer = (server_printer_t *)cupsArrayGetNext(Printers))
+   /*
+    * {"printer-id":N,"which-jobs":"...","page":N,"limit":N,"jobs":[{...},...],"count":N}
+    */
+
+    json_start(&json, NULL, '{');
+    json_number(&json, "printer-id", printer->id);
+    json_string(&json, "which-jobs", which_jobs[which].name);
+    json_number(&json, "page", page);
+    json_number(&json, "limit", limit);
+    json_start(&json, "jobs", '[');
+
+    cupsRWLockRead(&printer->rwlock);
+
+    for (job = (server_job_t *)cupsArrayGetFirst(printer->jobs), count = 0; job; job = (server_job_t *)cupsArrayGetNext(printer->jobs))
     {
-      if (printer->type == SERVER_TYPE_PRINT)
-        send_printer_payload(client, printer);
+      if ((which_jobs[which].comparison < 0 && job->state > which_jobs[which].state) ||
+          (which_jobs[which].comparison == 0 && job->state != which_jobs[which].state) ||
+          (which_jobs[which].comparison > 0 && job->state < which_jobs[which].state))
+        continue;
+
+      count ++;
+
+      if (count <= ((page - 1) * limit) || count > (page * limit))
+        continue;
+
+      json_start(&json, NULL, '{');
+      json_number(&json, "job-id", job->id);
+      json_string(&json, "job-name", job->name);
+      json_string(&json, "job-originating-user-name", job->username);
+      json_string(&json, "document-format", job->format);
+      json_string(&json, "job-state", ippEnumString("job-state", (int)job->state));
+
+      json_start(&json, "job-state-reasons", '[');
+      for (i = 0, reason = 1; i < (sizeof(server_jreasons) / sizeof(server_jreasons[0])); i ++, reason <<= 1)
+      {
+        if ((job->state_reasons | job->dev_state_reasons) & reason)
+          json_string(&json, NULL, server_jreasons[i]);
+      }
+      json_end(&json, ']');
+
+      json_number(&json, "job-impressions", job->impressions);
+      json_number(&json, "job-impressions-completed", job->impcompleted);
+      json_number(&json, "time-at-creation", (long)job->created);
+      json_number(&json, "time-at-processing", (long)job->processing);
+      json_number(&json, "time-at-completed", (long)job->completed);
+      json_end(&json, '}');
     }
-    cupsRWUnlock(&PrintersRWLock);
+
+    cupsRWUnlock(&printer->rwlock);
+
+    json_end(&json, ']');
+    json_number(&json, "count", count);
+    json_end(&json, '}');
   }
+  else if (!strcmp(name, "media.json"))
+  {
+   /*
+    * {"printer-id":N,"media-ready":[...],"media-sources":[{...},...]}
+    */
 
-  html_printf(client,
-              "\t\t</array>\n"
-              "\t</dict>\n"
-              "</plist>\n");
-  httpWrite(client->http, "", 0);
+    json_start(&json, NULL, '{');
+    json_number(&json, "printer-id", printer->id);
 
-  return (1);
-}
+    cupsRWLockRead(&printer->rwlock);
 
+    json_start(&json, "media-ready", '[');
+    if ((attr = ippFindAttribute(printer->pinfo.attrs, "media-ready", IPP_TAG_ZERO)) != NULL && ippGetValueTag(attr) != IPP_TAG_NOVALUE)
+    {
+      for (i = 0, num_values = ippGetCount(attr); i < num_values; i ++)
+        json_string(&json, NULL, ippGetString(attr, i, NULL));
+    }
+    json_end(&json, ']');
 
-/*
- * 'send_printer_payload()' - Send the mobile configuration payload for a
- *                            printer.
- */
+    json_start(&json, "media-sources", '[');
+    if ((attr = ippFindAttribute(printer->pinfo.attrs, "media-source-supported", IPP_TAG_ZERO)) != NULL)
+    {
+      media_col_ready = ippFindAttribute(printer->pinfo.attrs, "media-col-ready", IPP_TAG_BEGIN_COLLECTION);
+      desc            = ippFindAttribute(printer->pinfo.attrs, "printer-input-tray", IPP_TAG_STRING);
 
-static void
-send_printer_payload(
-    server_client_t  *client,		/* I - Client connection */
-    server_printer_t *printer)		/* I - Printer to send */
-{
+      for (i = 0, num_values = ippGetCount(attr); i < num_values; i ++)
+      {
+        source = ippGetString(attr, i, NULL);
 
-  const char	*make_and_model,	/* printer-make-and-model value */
-		*uuid;			/* printer-uuid value */
+        json_start(&json, NULL, '{');
+        json_string(&json, "media-source", source);
 
-  cupsRWLockRead(&printer->rwlock);
+        for (j = 0; j < ippGetCount(media_col_ready); j ++)
+        {
+          media_col = ippGetCollection(media_col_ready, j);
 
-  make_and_model = ippGetString(ippFindAttribute(printer->pinfo.attrs, "printer-make-and-model", IPP_TAG_TEXT), 0, NULL);
-  uuid           = ippGetString(ippFindAttribute(printer->pinfo.attrs, "printer-uuid", IPP_TAG_URI), 0, NULL);
+          ready_source = ippGetString(ippFindAttribute(media_col, "media-source", IPP_TAG_ZERO), 0, NULL);
 
-  if (uuid)
-    uuid += 9;				/* Skip "urn:uuid:" URI prefix */
+          if (source && ready_source && !strcmp(source, ready_source))
+          {
+            json_string(&json, "media-size-name", ippGetString(ippFindAttribute(media_col, "media-size-name", IPP_TAG_ZERO), 0, NULL));
+            json_string(&json, "media-type", ippGetString(ippFindAttribute(media_col, "media-type", IPP_TAG_ZERO), 0, NULL));
+            break;
+          }
+        }
+
+        if ((data = ippGetOctetString(desc, i, &datalen)) != NULL)
+        {
+          json_start(&json, "printer-input-tray", '{');
+          json_pairs(&json, data, datalen);
+          json_end(&json, '}');
+        }
+
+        json_end(&json, '}');
+      }
+    }
+    json_end(&json, ']');
+
+    cupsRWUnlock(&printer->rwlock);
+
+    json_end(&json, '}');
+  }
   else
-    uuid = "unknown";
+  {
+   /*
+    * supplies.json: {"printer-id":N,"supplies":[{"description":"...","index":N,...},...]}
+    */
 
-  html_printf(client,
-              "\t\t\t<dict>\n"
-              "\t\t\t\t<key>PayloadIdentifier</key>\n"
-              "\t\t\t\t<string>org.pwg.ippserver.%s.%s</string>\n"
-              "\t\t\t\t<key>PayloadUUID</key>\n"
-              "\t\t\t\t<string>%s</string>\n"
-              "\t\t\t\t<key>PayloadType</key>\n"
-              "\t\t\t\t<string>com.apple.airprint</string>\n"
-              "\t\t\t\t<key>PayloadVersion</key>\n"
-              "\t\t\t\t<integer>1</integer>\n"
-              "\t\t\t\t<key>PayloadDescription</key>\n"
-              "\t\t\t\t<string>%s</string>\n"
-              "\t\t\t\t<key>PayloadDisplayName</key>\n"
-              "\t\t\t\t<string>%s</string>\n"
-              "\t\t\t\t<key>AirPrint</key>\n"
-              "\t\t\t\t<array>\n"
-              "\t\t\t\t\t<dict>\n"
-              "\t\t\t\t\t\t<key>IPAddress</key>\n"
-              "\t\t\t\t\t\t<string>%s</string>\n"
-              "\t\t\t\t\t\t<key>ResourcePath</key>\n"
-              "\t\t\t\t\t\t<string>%s</string>\n"
-              "\t\t\t\t\t\t<key>Port</key>\n"
-              "\t\t\t\t\t\t<integer>%d</integer>\n"
-              "\t\t\t\t\t\t<key>ForceTLS</key>\n"
-              "\t\t\t\t\t\t<true />\n"
-              "\t\t\t\t\t</dict>\n"
-              "\t\t\t\t</array>\n"
-              "\t\t\t</dict>\n", ServerName, uuid, uuid, make_and_model ? make_and_model : "unknown", printer->dns_sd_name, ServerName, printer->resource, DefaultPort);
+    json_start(&json, NULL, '{');
+    json_number(&json, "printer-id", printer->id);
+    json_start(&json, "supplies", '[');
 
-  cupsRWUnlock(&printer->rwlock);
+    cupsRWLockRead(&printer->rwlock);
+
+    if ((attr = ippFindAttribute(printer->pinfo.attrs, "printer-supply", IPP_TAG_STRING)) != NULL)
+    {
+      desc = ippFindAttribute(printer->pinfo.attrs, "printer-supply-description", IPP_TAG_TEXT);
+
+      for (i = 0, num_values = ippGetCount(attr); i < num_values; i ++)
+      {
+        json_start(&json, NULL, '{');
+        json_string(&json, "description", ippGetString(desc, i, NULL));
+        if ((data = ippGetOctetString(attr, i, &datalen)) != NULL)
+          json_pairs(&json, data, datalen);
+        json_end(&json, '}');
+      }
+    }
+
+    cupsRWUnlock(&printer->rwlock);
+
+    json_end(&json, ']');
+    json_end(&json, '}');
+  }
+
+  html_write(client, "\n", 1);
+
+  return (html_send(client, encoding, "application/json"));
 }
 
 
@@ -1451,8 +3330,8 @@ show_materials(
   * Grab the available, ready, and number of materials from the printer.
   */
 
-  if (!serverRespondHTTP(client, HTTP_STATUS_OK, encoding, "text/html", 0))
-    return (0);
+  if (!html_buffer(client))
+    return (serverRespondHTTP(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0));
 
   html_header(client, printer->dns_sd_name, 0);
 
@@ -1463,21 +3342,21 @@ show_materials(
   {
     html_printf(client, "<p>Error: No materials-col-database defined for printer.</p>\n");
     html_footer(client);
-    return (1);
+    return (html_send(client, encoding, "text/html"));
   }
 
   if ((materials_ready = ippFindAttribute(printer->pinfo.attrs, "materials-col-ready", IPP_TAG_ZERO)) == NULL)
   {
     html_printf(client, "<p>Error: No materials-col-ready defined for printer.</p>\n");
     html_footer(client);
-    return (1);
+    return (html_send(client, encoding, "text/html"));
   }
 
   if ((attr = ippFindAttribute(printer->pinfo.attrs, "max-materials-col-supported", IPP_TAG_INTEGER)) == NULL)
   {
     html_printf(client, "<p>Error: No max-materials-col-supported defined for printer.</p>\n");
     html_footer(client);
-    return (1);
+    return (html_send(client, encoding, "text/html"));
   }
 
   max_materials = ippGetInteger(attr, 0);
@@ -1601,7 +3480,7 @@ show_materials(
 
   cupsFreeOptions(num_options, options);
 
-  return (1);
+  return (html_send(client, encoding, "text/html"));
 }
 
 
@@ -1650,8 +3529,8 @@ show_media(server_client_t  *client,	/* I - Client connection */
   };
 
 
-  if (!serverRespondHTTP(client, HTTP_STATUS_OK, encoding, "text/html", 0))
-    return (0);
+  if (!html_buffer(client))
+    return (serverRespondHTTP(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0));
 
   html_header(client, printer->name, 0);
 
@@ -1662,7 +3541,7 @@ show_media(server_client_t  *client,	/* I - Client connection */
   {
     html_printf(client, "<p>Error: No media-col-ready defined for printer.</p>\n");
     html_footer(client);
-    return (1);
+    return (html_send(client, encoding, "text/html"));
   }
 
   media_ready = ippFindAttribute(printer->pinfo.attrs, "media-ready", IPP_TAG_ZERO);
@@ -1671,28 +3550,28 @@ show_media(server_client_t  *client,	/* I - Client connection */
   {
     html_printf(client, "<p>Error: No media-supported defined for printer.</p>\n");
     html_footer(client);
-    return (1);
+    return (html_send(client, encoding, "text/html"));
   }
 
   if ((media_sources = ippFindAttribute(printer->pinfo.attrs, "media-source-supported", IPP_TAG_ZERO)) == NULL)
   {
     html_printf(client, "<p>Error: No media-source-supported defined for printer.</p>\n");
     html_footer(client);
-    return (1);
+    return (html_send(client, encoding, "text/html"));
   }
 
   if ((media_types = ippFindAttribute(printer->pinfo.attrs, "media-type-supported", IPP_TAG_ZERO)) == NULL)
   {
     html_printf(client, "<p>Error: No media-type-supported defined for printer.</p>\n");
     html_footer(client);
-    return (1);
+    return (html_send(client, encoding, "text/html"));
   }
 
   if ((input_tray = ippFindAttribute(printer->pinfo.attrs, "printer-input-tray", IPP_TAG_STRING)) == NULL)
   {
     html_printf(client, "<p>Error: No printer-input-tray defined for printer.</p>\n");
     html_footer(client);
-    return (1);
+    return (html_send(client, encoding, "text/html"));
   }
 
   num_ready   = ippGetCount(media_col_ready);
@@ -1704,7 +3583,7 @@ show_media(server_client_t  *client,	/* I - Client connection */
   {
     html_printf(client, "<p>Error: Different number of trays in media-source-supported and printer-input-tray defined for printer.</p>\n");
     html_footer(client);
-    return (1);
+    return (html_send(client, encoding, "text/html"));
   }
 
  /*
@@ -1819,6 +3698,8 @@ show_media(server_client_t  *client,	/* I - Client connection */
       media_ready = ippAddOutOfBand(printer->pinfo.attrs, IPP_TAG_PRINTER, IPP_TAG_NOVALUE, "media-ready");
 
     cupsRWUnlock(&printer->rwlock);
+
+    serverUpdatePrinterStatus(printer);
   }
 
   if (printer->pinfo.web_forms)
@@ -1936,12 +3817,16 @@ show_media(server_client_t  *client,	/* I - Client connection */
 
   cupsFreeOptions(num_options, options);
 
-  return (1);
+  return (html_send(client, encoding, "text/html"));
 }
 
 
 /*
  * 'show_status()' - Show printer/system state.
+ *
+ * Pages are rendered into a buffer and cached by printer status version so
+ * that repeated refreshes don't walk the job list again.  Clients that send
+ * "If-Modified-Since" get a 304 response when nothing has changed.
  */
 
 static int				/* O - 1 on success, 0 on failure */
@@ -1952,32 +3837,63 @@ show_status(server_client_t  *client,	/* I - Client connection */
   server_job_t		*job;		/* Current job */
   int			i, j;		/* Looping vars */
   server_preason_t	reason;		/* Current reason */
-  int			apple_client;	/* Is the client running an Apple OS? */
-  static const char * const reasons[] =	/* Reason strings */
-  {
-    "Other",
-    "Cover Open",
-    "Input Tray Missing",
-    "Marker Supply Empty",
-    "Marker Supply Low",
-    "Marker Waste Almost Full",
-    "Marker Waste Full",
-    "Media Empty",
-    "Media Jam",
-    "Media Low",
-    "Media Needed",
-    "Moving to Paused",
-    "Paused",
-    "Spool Area Full",
-    "Toner Empty",
-    "Toner Low"
-  };
+  bool			apple_client;	/* Is the client running an Apple OS? */
+  int			page = 1,	/* Page of jobs */
+			count,		/* Number of jobs */
+			first,		/* First job on page */
+			last,		/* Last job on page */
+			version;	/* Status version */
+  time_t		modified,	/* Time of last status change */
+			since;		/* If-Modified-Since time */
 
 
   apple_client = strstr(httpGetField(client->http, HTTP_FIELD_USER_AGENT), "Mac OS X") != NULL;
 
-  if (!serverRespondHTTP(client, HTTP_STATUS_OK, encoding, "text/html", 0))
-    return (0);
+  if (printer && client->options)
+  {
+    cups_option_t	*options;	/* URL options */
+    size_t		num_options;	/* Number of URL options */
+    const char		*val;		/* "page" value */
+
+    num_options = parse_options(client, &options);
+
+    if ((val = cupsGetOption("page", num_options, options)) != NULL && (page = atoi(val)) < 1)
+      page = 1;
+
+    cupsFreeOptions(num_options, options);
+  }
+
+ /*
+  * See whether the client already has the current page...
+  */
+
+  cupsMutexLock(&SystemStatusMutex);
+  version  = printer ? printer->status_version : SystemStatusVersion;
+  modified = printer ? printer->status_time : SystemStatusTime;
+  cupsMutexUnlock(&SystemStatusMutex);
+
+  if (modified < time(NULL))
+  {
+   /*
+    * Only report changes from past seconds since the client would miss a
+    * second change in the current second...
+    */
+
+    client->last_modified = modified;
+
+    if ((since = httpGetDateTime(httpGetField(client->http, HTTP_FIELD_IF_MODIFIED_SINCE))) > 0 && modified <= since)
+      return (serverRespondHTTP(client, HTTP_STATUS_NOT_MODIFIED, NULL, NULL, 0));
+  }
+
+  if (get_cached_page(client, printer ? printer->id : 0, page, apple_client, version))
+    goto send_page;
+
+ /*
+  * Render the page into the client's page buffer...
+  */
+
+  if (!html_buffer(client))
+    return (serverRespondHTTP(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0));
 
   if (printer)
   {
@@ -1994,61 +3910,66 @@ show_status(server_client_t  *client,	/* I - Client connection */
       html_printf(client, "</p>\n");
     }
     html_printf(client, "<h1><img align=\"left\" src=\"%s/icon.png\" width=\"64\" height=\"64\">%s Jobs</h1>\n", printer->resource, printer->dns_sd_name);
-    html_printf(client, "<p>%s, %u job(s).", printer->state == IPP_PSTATE_IDLE ? "Idle" : printer->state == IPP_PSTATE_PROCESSING ? "Printing" : "Stopped", (unsigned)cupsArrayGetCount(printer->jobs));
-    for (i = 0, reason = 1; i < (int)(sizeof(reasons) / sizeof(reasons[0])); i ++, reason <<= 1)
+    html_printf(client, "<p id=\"printer-%d\">%s, %u job(s).", printer->id, printer->state == IPP_PSTATE_IDLE ? "Idle" : printer->state == IPP_PSTATE_PROCESSING ? "Printing" : "Stopped", (unsigned)cupsArrayGetCount(printer->jobs));
+    for (i = 0, reason = 1; i < (int)(sizeof(printer_reasons) / sizeof(printer_reasons[0])); i ++, reason <<= 1)
       if (printer->state_reasons & reason)
-        html_printf(client, "\n<br>&nbsp;&nbsp;&nbsp;&nbsp;%s", reasons[i]);
+        html_printf(client, "\n<br>&nbsp;&nbsp;&nbsp;&nbsp;%s", printer_reasons[i]);
     html_printf(client, "</p>\n");
 
-    if (cupsArrayGetCount(printer->jobs) > 0)
+    cupsRWLockRead(&(printer->rwlock));
+
+    if ((count = (int)cupsArrayGetCount(printer->jobs)) > 0)
     {
-      cupsRWLockRead(&(printer->rwlock));
+     /*
+      * Show one page of jobs, newest first...
+      */
+
+      if ((first = (page - 1) * WEB_JOBS_MAX) >= count)
+        first = ((count - 1) / WEB_JOBS_MAX) * WEB_JOBS_MAX;
+
+      if ((last = first + WEB_JOBS_MAX) > count)
+        last = count;
 
-      html_printf(client, "<table class=\"striped\" summary=\"Jobs\"><thead><tr><th>Job #</th><th>Name</th><th>Owner</th><th>When</th></tr></thead><tbody>\n");
-      for (job = (server_job_t *)cupsArrayGetFirst(printer->jobs); job; job = (server_job_t *)cupsArrayGetNext(printer->jobs))
+      html_printf(client, "<table class=\"striped\" summary=\"Jobs\"><thead><tr><th>Job #</th><th>Name</th><th>Owner</th><th>When</th></tr></thead><tbody id=\"jobs\">\n");
+      for (i = first; i < last; i ++)
       {
-        char	when[256],		/* When job queued/started/finished */
-                hhmmss[64];		/* Time HH:MM:SS */
+        char	when[256];		/* When job queued/started/finished */
 
-        switch (job->state)
-        {
-          case IPP_JSTATE_PENDING :
-          case IPP_JSTATE_HELD :
-              snprintf(when, sizeof(when), "Queued at %s", serverTimeString(job->created, hhmmss, sizeof(hhmmss)));
-              break;
-          case IPP_JSTATE_PROCESSING :
-          case IPP_JSTATE_STOPPED :
-              snprintf(when, sizeof(when), "Started at %s", serverTimeString(job->processing, hhmmss, sizeof(hhmmss)));
-              break;
-          case IPP_JSTATE_ABORTED :
-              snprintf(when, sizeof(when), "Aborted at %s", serverTimeString(job->completed, hhmmss, sizeof(hhmmss)));
-              break;
-          case IPP_JSTATE_CANCELED :
-              snprintf(when, sizeof(when), "Canceled at %s", serverTimeString(job->completed, hhmmss, sizeof(hhmmss)));
-              break;
-          case IPP_JSTATE_COMPLETED :
-              snprintf(when, sizeof(when), "Completed at %s", serverTimeString(job->completed, hhmmss, sizeof(hhmmss)));
-              break;
-        }
+        job = (server_job_t *)cupsArrayGetElement(printer->jobs, (size_t)i);
 
-        html_printf(client, "<tr><td>%d</td><td>%s</td><td>%s</td><td>%s</td></tr>\n", job->id, job->name, job->username, when);
+        html_printf(client, "<tr id=\"job-%d\"><td>%d</td><td>%s</td><td>%s</td><td>%s</td></tr>\n", job->id, job->id, job->name, job->username, job_when(job, when, sizeof(when)));
       }
       html_printf(client, "</tbody></table>\n");
 
-      cupsRWUnlock(&(printer->rwlock));
+      if (count > WEB_JOBS_MAX)
+      {
+        html_printf(client, "<p class=\"buttons\">Jobs %d to %d of %d.", first + 1, last, count);
+        if (first > 0)
+          html_printf(client, " <a class=\"button\" href=\"%s?page=%d\">Newer Jobs</a>", printer->resource, first / WEB_JOBS_MAX);
+        if (last < count)
+          html_printf(client, " <a class=\"button\" href=\"%s?page=%d\">Older Jobs</a>", printer->resource, first / WEB_JOBS_MAX + 2);
+        html_printf(client, "</p>\n");
+      }
     }
+
+    cupsRWUnlock(&(printer->rwlock));
+
+    html_script(client, printer->resource, page);
   }
   else
   {
     html_header(client, IPPSAMPLE_VERSION, 0);
+
+    cupsRWLockRead(&PrintersRWLock);
+
     for (i = 0, printer = (server_printer_t *)cupsArrayGetFirst(Printers); printer; i ++, printer = (server_printer_t *)cupsArrayGetNext(Printers))
     {
       html_printf(client, "<div class=\"%s\">\n", (i & 1) ? "odd" : "even");
       html_printf(client, "  <h1><img align=\"left\" src=\"%s/icon.png\" width=\"64\" height=\"64\">%s</h1>\n", printer->resource, printer->dns_sd_name);
-      html_printf(client, "  <p>%s, %u job(s).", printer->state == IPP_PSTATE_IDLE ? "Idle" : printer->state == IPP_PSTATE_PROCESSING ? "Printing" : "Stopped", (unsigned)cupsArrayGetCount(printer->jobs));
-      for (j = 0, reason = 1; j < (int)(sizeof(reasons) / sizeof(reasons[0])); j ++, reason <<= 1)
+      html_printf(client, "  <p id=\"printer-%d\">%s, %u job(s).", printer->id, printer->state == IPP_PSTATE_IDLE ? "Idle" : printer->state == IPP_PSTATE_PROCESSING ? "Printing" : "Stopped", (unsigned)cupsArrayGetCount(printer->jobs));
+      for (j = 0, reason = 1; j < (int)(sizeof(printer_reasons) / sizeof(printer_reasons[0])); j ++, reason <<= 1)
         if (printer->state_reasons & reason)
-          html_printf(client, "\n<br>&nbsp;&nbsp;&nbsp;&nbsp;%s", reasons[j]);
+          html_printf(client, "\n<br>&nbsp;&nbsp;&nbsp;&nbsp;%s", printer_reasons[j]);
       html_printf(client, "</p>\n");
       if (!strncmp(printer->resource, "/ipp/print3d", 12))
       {
@@ -2063,10 +3984,23 @@ show_status(server_client_t  *client,	/* I - Client connection */
       }
       html_printf(client, "</div>\n");
     }
+
+    cupsRWUnlock(&PrintersRWLock);
+
+    html_script(client, "", 0);
   }
   html_footer(client);
 
-  return (1);
+  if (client->html)
+    put_cached_page(client, printer ? printer->id : 0, page, apple_client, version);
+
+ /*
+  * Send the page...
+  */
+
+  send_page:
+
+  return (html_send(client, encoding, "text/html"));
 }
 
 
@@ -2122,8 +4056,8 @@ show_supplies(
   };
 
 
-  if (!serverRespondHTTP(client, HTTP_STATUS_OK, encoding, "text/html", 0))
-    return (0);
+  if (!html_buffer(client))
+    return (serverRespondHTTP(client, HTTP_STATUS_SERVER_ERROR, NULL, NULL, 0));
 
   html_header(client, printer->name, 0);
 
@@ -2134,7 +4068,7 @@ show_supplies(
   {
     html_printf(client, "<p>Error: No printer-supply defined for printer.</p>\n");
     html_footer(client);
-    return (1);
+    return (html_send(client, encoding, "text/html"));
   }
 
   num_supply = ippGetCount(supply);
@@ -2143,14 +4077,14 @@ show_supplies(
   {
     html_printf(client, "<p>Error: No printer-supply-description defined for printer.</p>\n");
     html_footer(client);
-    return (1);
+    return (html_send(client, encoding, "text/html"));
   }
 
   if (num_supply != ippGetCount(supply_desc))
   {
     html_printf(client, "<p>Error: Different number of values for printer-supply and printer-supply-description defined for printer.</p>\n");
     html_footer(client);
-    return (1);
+    return (html_send(client, encoding, "text/html"));
   }
 
   if (printer->pinfo.web_forms)
@@ -2207,6 +4141,8 @@ show_supplies(
     }
 
     cupsRWUnlock(&printer->rwlock);
+
+    serverUpdatePrinterStatus(printer);
   }
 
   if (printer->pinfo.web_forms)
@@ -2261,5 +4197,31 @@ show_supplies(
 
   cupsFreeOptions(num_options, options);
 
-  return (1);
+  return (html_send(client, encoding, "text/html"));
+}
+
+
+/*
+ * 'wait_request()' - Wait up to 30 seconds for the next request from a client.
+ *
+ * The wait is done one second at a time so that idle keep-alive connections
+ * are closed promptly when the server is draining clients for a restart.
+ */
+
+static bool				/* O - `true` if data is ready, `false` otherwise */
+wait_request(server_client_t *client)	/* I - Client */
+{
+  int	i;				/* Looping var */
+
+
+  for (i = 0; i < 30; i ++)
+  {
+    if (httpWait(client->http, 1000))
+      return (true);
+
+    if (is_draining())
+      break;
+  }
+
+  return (false);
 }
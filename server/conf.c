@@ -25,6 +25,8 @@
  */
 
 static char		*default_printer = NULL;
+static size_t		inherited_listeners = 0;
+					/* Number of inherited listeners */
 
 
 /*
@@ -70,6 +72,8 @@ serverAddPrinter(
   cupsArrayAdd(Printers, printer);
 
   cupsRWUnlock(&SystemRWLock);
+
+  serverUpdatePrinterStatus(NULL);
 }
 
 
@@ -140,7 +144,13 @@ serverCreateSystem(
   server_pinfo_t pinfo;			/* Printer information */
 
 
-  SystemStartTime = SystemConfigChangeTime = time(NULL);
+  SystemStartTime = SystemConfigChangeTime = SystemStatusTime = time(NULL);
+
+ /*
+  * Use any listeners from a previous server or the service manager...
+  */
+
+  inherited_listeners = serverInheritListeners();
 
   if (directory)
   {
@@ -2709,6 +2719,13 @@ load_system(const char *conf)		/* I - Configuration file */
 		*ptr;			/* Pointer into host value */
       int	port;			/* Port number */
 
+      if (inherited_listeners)
+      {
+        // Inherited listeners replace the configured ones...
+        serverLog(SERVER_LOGLEVEL_INFO, "Ignoring Listen on line %d of \"%s\", using %u inherited listeners.", linenum, conf, (unsigned)inherited_listeners);
+        continue;
+      }
+
 #ifdef _WIN32
       char *curvalue = value;		/* Current value */
 
@@ -2721,6 +2738,15 @@ load_system(const char *conf)		/* I - Configuration file */
 	curvalue = NULL;
 #endif /* _WIN32 */
 
+        if (*host == '/')
+        {
+          // Listen on a UNIX domain socket...
+          if ((status = serverCreateListeners(host, 0)) == 0)
+            break;
+
+          continue;
+        }
+
 	if ((ptr = strrchr(host, ':')) != NULL && !isdigit(ptr[1] & 255))
 	{
 	  fprintf(stderr, "ippserver: Bad Listen value \"%s\" on line %d of \"%s\".\n", value, linenum, conf);
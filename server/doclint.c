@@ -0,0 +1,2543 @@
+/*
+ * Document lint library for checking common print file formats.
+ *
+ * Copyright © 2018-2022 by the Printer Working Group.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more
+ * information.
+ */
+
+#include <config.h>
+#include "doclint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+#include <cups/raster.h>
+#include <cups/thread.h>
+#ifdef _WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif /* !_WIN32 */
+
+#ifdef HAVE_COREGRAPHICS
+#  include <CoreGraphics/CoreGraphics.h>
+#endif /* HAVE_COREGRAPHICS */
+#ifdef __AVX2__
+#  include <immintrin.h>
+#endif /* __AVX2__ */
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif /* __SSE2__ */
+
+
+/*
+ * Constants...
+ */
+
+#define LINT_BUFSIZE	262144		/* Size of raster read buffer */
+#define LINT_MAX_THREADS 8		/* Maximum number of raster page threads */
+#define LINT_MAX_PENDING 4		/* Maximum queued raster pages per thread */
+#define LINT_MAX_BPP	30		/* Maximum bytes per pixel (15 colors at 16 bits) */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct lint_context_s		/**** Lint Context ****/
+{
+  doclint_results_t	*results;	/* Counters and error/warning counts */
+  doclint_message_cb_t	message_cb;	/* Message callback */
+  doclint_progress_cb_t	progress_cb;	/* Progress callback */
+  void			*cb_data;	/* Callback data */
+  int			streaming;	/* Reading from the standard input or a pipe? */
+  int			fd;		/* File descriptor to read or -1 */
+} lint_context_t;
+
+typedef struct lint_raster_s		/**** Buffered Raster Stream ****/
+{
+  cups_file_t	*fp;			/* File pointer or `NULL` for memory */
+  unsigned char	*bufptr,		/* Pointer into buffer */
+		*bufend,		/* End of buffer */
+		*buffer;		/* Read buffer */
+} lint_raster_t;
+
+typedef struct lint_page_s		/**** Raster Page ****/
+{
+  unsigned		page;		/* Page number */
+  cups_page_header_t	header;		/* Page header */
+  unsigned char		*data;		/* Compressed page image data */
+  size_t		datalen,	/* Length of page image data */
+			datasize;	/* Allocated size of page image data */
+  int			blank,		/* Is the page blank? */
+			color,		/* Is the page in color? */
+			error,		/* Was the page image bad? */
+			decoded;	/* Has the page been decoded? */
+} lint_page_t;
+
+typedef struct lint_pool_s		/**** Raster Page Thread Pool ****/
+{
+  cups_mutex_t		mutex;		/* Mutex for pool */
+  cups_cond_t		cond;		/* Condition variable for changes */
+  lint_page_t		**pages;	/* Pages in file order */
+  size_t		num_pages,	/* Number of pages queued */
+			alloc_pages,	/* Allocated pages */
+			next_page,	/* Next page to decode */
+			num_done,	/* Number of pages decoded */
+			next_merge,	/* Next page to merge into the counters */
+			max_pending;	/* Maximum pages queued but not decoded */
+  int			done;		/* Non-zero when no more pages will be queued */
+} lint_pool_t;
+
+
+/*
+ * Local functions...
+ */
+
+static lint_page_t *index_raster_image(lint_context_t *lint, lint_raster_t *r, cups_page_header_t *header, unsigned page);
+static void	lint_close(lint_context_t *lint, cups_file_t *fp);
+static bool	lint_document(lint_context_t *lint, const char *filename, const char *content_type, size_t num_options, cups_option_t *options);
+static int	lint_jpeg(lint_context_t *lint, const char *filename, size_t num_options, cups_option_t *options);
+#ifndef _WIN32
+static int	lint_jpeg_map(lint_context_t *lint, const char *filename, int copies, const char *color_mode);
+#endif /* !_WIN32 */
+static void	lint_jpeg_page(lint_context_t *lint, int ncolors, int copies, const char *color_mode);
+static void	lint_message(lint_context_t *lint, doclint_level_t level, const char *message, ...) _CUPS_FORMAT(3, 4);
+static cups_file_t *lint_open(lint_context_t *lint, const char *filename);
+static int	lint_pdf(lint_context_t *lint, const char *filename, size_t num_options, cups_option_t *options);
+static void	lint_progress(lint_context_t *lint);
+static int	lint_raster(lint_context_t *lint, const char *filename, const char *content_type);
+static void	merge_raster_pages(lint_context_t *lint, lint_pool_t *pool, int wait);
+static unsigned char *page_reserve(lint_page_t *p, size_t bytes);
+static void	queue_raster_page(lint_context_t *lint, lint_pool_t *pool, lint_page_t *p);
+static int	raster_getc(lint_raster_t *r);
+static int	raster_is_gray(const unsigned char *line, size_t size, unsigned bpp, unsigned bpc, unsigned num_colors);
+static int	raster_is_white(const unsigned char *line, size_t size, unsigned char white);
+static size_t	raster_read(lint_raster_t *r, void *data, size_t bytes);
+static void	*raster_worker(lint_pool_t *pool);
+static int	read_apple_raster_header(lint_context_t *lint, lint_raster_t *r, cups_page_header_t *header);
+static int	read_pwg_raster_header(lint_context_t *lint, lint_raster_t *r, unsigned syncword, cups_page_header_t *header);
+static int	read_raster_image(lint_raster_t *r, lint_page_t *p);
+
+
+/*
+ * 'doclintFile()' - Check a print file.
+ *
+ * The "filename" argument can be "-" to read from the standard input, in
+ * which case the "progress_cb" function is also called as pages are counted
+ * and the input is always read to the end, even after an error.
+ * The "progress_cb" function is always called once the file has been checked
+ * with the final counters.  The "message_cb" function receives each error,
+ * warning, and debugging message without a prefix or trailing newline.  Both
+ * callbacks are invoked on the calling thread and may be `NULL`.
+ *
+ * The "results" structure is always filled in, even on failure.
+ */
+
+bool					/* O - `true` if the file is OK, `false` otherwise */
+doclintFile(
+    const char            *filename,	/* I - File to check or "-" for stdin */
+    const char            *content_type,/* I - MIME media type of file */
+    size_t                num_options,	/* I - Number of options */
+    cups_option_t         *options,	/* I - Options */
+    doclint_message_cb_t  message_cb,	/* I - Message callback or `NULL` */
+    doclint_progress_cb_t progress_cb,	/* I - Progress callback or `NULL` */
+    void                  *cb_data,	/* I - Callback data */
+    doclint_results_t     *results)	/* O - Results */
+{
+  lint_context_t	lint;		/* Lint context */
+
+
+  memset(results, 0, sizeof(doclint_results_t));
+
+  lint.results     = results;
+  lint.message_cb  = message_cb;
+  lint.progress_cb = progress_cb;
+  lint.cb_data     = cb_data;
+  lint.streaming   = !strcmp(filename, "-");
+  lint.fd          = -1;
+
+  return (lint_document(&lint, filename, content_type, num_options, options));
+}
+
+
+/*
+ * 'doclintGetContentType()' - Guess the MIME media type from a filename extension.
+ */
+
+const char *				/* O - MIME media type or `NULL` if unknown */
+doclintGetContentType(
+    const char *filename)		/* I - Filename */
+{
+  const char	*ext;			/* Filename extension */
+
+
+  if ((ext = strrchr(filename, '.')) == NULL)
+    return (NULL);
+  else if (!strcmp(ext, ".pdf"))
+    return ("application/pdf");
+  else if (!strcmp(ext, ".jpg") || !strcmp(ext, ".jpeg"))
+    return ("image/jpeg");
+  else if (!strcmp(ext, ".pwg"))
+    return ("image/pwg-raster");
+  else if (!strcmp(ext, ".urf"))
+    return ("image/urf");
+  else
+    return (NULL);
+}
+
+
+/*
+ * 'doclintIsSupported()' - Determine whether a MIME media type can be checked.
+ */
+
+bool					/* O - `true` if supported, `false` otherwise */
+doclintIsSupported(
+    const char *content_type)		/* I - MIME media type */
+{
+  return (!strcmp(content_type, "application/pdf") || !strcmp(content_type, "image/jpeg") || !strcmp(content_type, "image/pwg-raster") || !strcmp(content_type, "image/urf"));
+}
+
+
+/*
+ * 'doclintStream()' - Check a print stream.
+ *
+ * This is the same as 'doclintFile()' with a filename of "-", except that the
+ * document is read from the file descriptor "fd" (usually the read end of a
+ * pipe).  The stream is always read to the end, even after an error, so the
+ * writer never sees a broken pipe, and "fd" is closed before returning.  PDF
+ * files cannot be checked as a stream.
+ */
+
+bool					/* O - `true` if the stream is OK, `false` otherwise */
+doclintStream(
+    int                   fd,		/* I - File descriptor to read */
+    const char            *content_type,/* I - MIME media type of stream */
+    size_t                num_options,	/* I - Number of options */
+    cups_option_t         *options,	/* I - Options */
+    doclint_message_cb_t  message_cb,	/* I - Message callback or `NULL` */
+    doclint_progress_cb_t progress_cb,	/* I - Progress callback or `NULL` */
+    void                  *cb_data,	/* I - Callback data */
+    doclint_results_t     *results)	/* O - Results */
+{
+  lint_context_t	lint;		/* Lint context */
+
+
+  memset(results, 0, sizeof(doclint_results_t));
+
+  lint.results     = results;
+  lint.message_cb  = message_cb;
+  lint.progress_cb = progress_cb;
+  lint.cb_data     = cb_data;
+  lint.streaming   = 1;
+  lint.fd          = fd;
+
+  return (lint_document(&lint, "-", content_type, num_options, options));
+}
+
+
+/*
+ * 'index_raster_image()' - Validate and copy the compressed page image.
+ *
+ * Only the PackBits codes are interpreted here, which is enough to find the
+ * end of the page and report any errors.  The copied data is decoded later by
+ * 'read_raster_image()'.
+ */
+
+static lint_page_t *			/* O - Page or `NULL` on error */
+index_raster_image(
+    lint_context_t     *lint,		/* I - Lint context */
+    lint_raster_t      *r,		/* I - Raster stream */
+    cups_page_header_t *header,	/* I - Page header */
+    unsigned            page)		/* I - Page number */
+{
+  int		ch;			/* Character from stream */
+  unsigned	height,			/* Height (lines) remaining */
+		width,			/* Width (columns/pixels) remaining */
+		repeat,			/* Line repeat value */
+		count,			/* Number of columns/pixels */
+		bytes,			/* Bytes in sequence */
+		bpp;			/* Bytes per pixel */
+  unsigned char	*dataptr;		/* Pointer into page data */
+  lint_page_t	*p;			/* Page */
+
+
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "Reading page %u.", page);
+
+  if ((p = calloc(1, sizeof(lint_page_t))) == NULL)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to allocate memory for page %u.", page);
+    lint->results->errors ++;
+    return (NULL);
+  }
+
+  p->page   = page;
+  p->header = *header;
+
+  if (header->cupsBitsPerPixel == 1)
+    bpp = 1;
+  else
+    bpp = header->cupsBitsPerPixel / 8;
+
+  if (bpp > LINT_MAX_BPP)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Unsupported BitsPerPixel value %u on page %u.", header->cupsBitsPerPixel, page);
+    goto error;
+  }
+
+  for (height = header->cupsHeight; height > 0; height -= repeat)
+  {
+   /*
+    * Read the line repeat code...
+    */
+
+    if ((ch = raster_getc(r)) == EOF)
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Early end-of-file at line %u.", header->cupsHeight - height + 1);
+      goto error;
+    }
+
+    repeat = (unsigned)ch + 1;
+
+    if (repeat > height)
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad repeat count %u at line %u.", repeat, header->cupsHeight - height + 1);
+      goto error;
+    }
+
+    if ((dataptr = page_reserve(p, 1)) == NULL)
+      goto nomem;
+
+    *dataptr = (unsigned char)ch;
+    p->datalen ++;
+
+    for (width = header->cupsWidth; width > 0; width -= count)
+    {
+     /*
+      * Read the packbits code...
+      */
+
+      if ((ch = raster_getc(r)) == EOF)
+      {
+	lint_message(lint, DOCLINT_LEVEL_ERROR, "Early end-of-file at line %u, column %u.", header->cupsHeight - height + 1, header->cupsWidth - width + 1);
+	goto error;
+      }
+
+      if ((dataptr = page_reserve(p, 1)) == NULL)
+	goto nomem;
+
+      *dataptr = (unsigned char)ch;
+      p->datalen ++;
+
+      if (ch == 0x80)
+      {
+       /*
+        * Clear to end of line...
+	*/
+
+        break;
+      }
+      else if (ch & 0x80)
+      {
+       /*
+        * Literal sequence...
+        */
+
+        count = 257 - (unsigned)ch;
+        bytes = count * bpp;
+      }
+      else
+      {
+       /*
+        * Repeat sequence...
+        */
+
+        count = (unsigned)ch + 1;
+        bytes = bpp;
+      }
+
+      if (header->cupsBitsPerPixel == 1)
+      {
+	count *= 8;
+	if (count > width && (count - width) < 8)
+	  count = width;
+      }
+
+      if (count > width)
+      {
+	lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad literal count %u at line %u, column %u.", count, header->cupsHeight - height + 1, header->cupsWidth - width + 1);
+	goto error;
+      }
+
+     /*
+      * Copy the pixel fragment...
+      */
+
+      if ((dataptr = page_reserve(p, bytes)) == NULL)
+        goto nomem;
+
+      if (raster_read(r, dataptr, bytes) < bytes)
+      {
+	lint_message(lint, DOCLINT_LEVEL_ERROR, "Early end-of-file at line %u, column %u.", header->cupsHeight - height + 1, header->cupsWidth - width + 1);
+	goto error;
+      }
+
+      p->datalen += bytes;
+    }
+  }
+
+  return (p);
+
+ /*
+  * If we get here there was an error...
+  */
+
+  nomem:
+
+  lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to allocate memory for page %u.", page);
+
+  error:
+
+  lint->results->errors ++;
+
+  free(p->data);
+  free(p);
+
+  return (NULL);
+}
+
+
+/*
+ * 'lint_close()' - Close a file, reading any remaining stream data first.
+ */
+
+static void
+lint_close(lint_context_t *lint,	/* I - Lint context */
+           cups_file_t    *fp)		/* I - File pointer */
+{
+  char	buffer[65536];			/* Discard buffer */
+
+
+  if (lint->streaming)
+  {
+   /*
+    * Consume the rest of the stream so the writer doesn't get a broken pipe...
+    */
+
+    while (cupsFileRead(fp, buffer, sizeof(buffer)) > 0);
+  }
+
+  cupsFileClose(fp);
+}
+
+
+/*
+ * 'lint_document()' - Check a file or stream of the given type.
+ */
+
+static bool				/* O - `true` if OK, `false` otherwise */
+lint_document(
+    lint_context_t *lint,		/* I - Lint context */
+    const char     *filename,		/* I - File to check or "-" for a stream */
+    const char     *content_type,	/* I - MIME media type */
+    size_t         num_options,		/* I - Number of options */
+    cups_option_t  *options)		/* I - Options */
+{
+  int		ret;			/* Return value */
+  cups_file_t	*fp;			/* Stream to drain */
+
+
+  if (!content_type || !doclintIsSupported(content_type) || (lint->streaming && !strcmp(content_type, "application/pdf")))
+  {
+    if (!content_type || !doclintIsSupported(content_type))
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Unsupported format \"%s\" for \"%s\".", content_type ? content_type : "(null)", filename);
+    else
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "PDF files cannot be checked from the standard input.");
+
+    lint->results->errors ++;
+
+    if (lint->streaming && (fp = lint_open(lint, filename)) != NULL)
+      lint_close(lint, fp);
+
+    return (false);
+  }
+  else if (!strcmp(content_type, "image/jpeg"))
+    ret = lint_jpeg(lint, filename, num_options, options);
+  else if (!strcmp(content_type, "application/pdf"))
+    ret = lint_pdf(lint, filename, num_options, options);
+  else
+    ret = lint_raster(lint, filename, content_type);
+
+  lint_progress(lint);
+
+  return (ret != 0);
+}
+
+
+/*
+ * 'lint_jpeg()' - Check a JPEG file.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+lint_jpeg(lint_context_t *lint,		/* I - Lint context */
+          const char     *filename,	/* I - File to check */
+          size_t         num_options,	/* I - Number of options */
+          cups_option_t  *options)	/* I - Options */
+{
+  const char	*value;			/* Option value */
+  int		copies;			/* copies value */
+  const char	*color_mode;		/* print-color-mode value */
+  cups_file_t	*fp;			/* File pointer */
+  unsigned char	buffer[65536],		/* Read buffer */
+		*bufptr,		/* Pointer info buffer */
+		*bufend;		/* Pointer to end of buffer */
+  ssize_t	bytes;			/* Bytes read */
+  size_t	length;			/* Length of marker */
+
+
+  if ((value = cupsGetOption("copies", num_options, options)) != NULL)
+    copies = atoi(value);
+  else
+    copies = 1;
+
+  color_mode = cupsGetOption("print-color-mode", num_options, options);
+
+#ifndef _WIN32
+  if (!lint->streaming)
+  {
+   /*
+    * Try scanning a memory-mapped copy of the file first...
+    */
+
+    int ret = lint_jpeg_map(lint, filename, copies, color_mode);
+					/* Result of memory-mapped scan */
+
+    if (ret >= 0)
+      return (ret);
+  }
+#endif /* !_WIN32 */
+
+  if ((fp = lint_open(lint, filename)) == NULL)
+    return (0);
+
+  if ((bytes = cupsFileRead(fp, (char *)buffer, sizeof(buffer))) < 3)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to read JPEG file.");
+    lint->results->errors ++;
+    lint_close(lint, fp);
+    return (0);
+  }
+
+  if (memcmp(buffer, "\377\330\377", 3))
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad JPEG file.");
+    lint->results->errors ++;
+    lint_close(lint, fp);
+    return (0);
+  }
+
+  bufptr = buffer + 2;
+  bufend = buffer + bytes;
+
+ /*
+  * Scan the file for a SOFn marker, then we can get the dimensions...
+  */
+
+  while (bufptr < bufend)
+  {
+    if (*bufptr == 0xff)
+    {
+      bufptr ++;
+
+      if (bufptr >= bufend)
+      {
+       /*
+	* If we are at the end of the current buffer, re-fill and continue...
+	*/
+
+	if ((bytes = cupsFileRead(fp, (char *)buffer, sizeof(buffer))) <= 0)
+	{
+	  lint_message(lint, DOCLINT_LEVEL_ERROR, "Short JPEG file.");
+	  lint->results->errors ++;
+	  lint_close(lint, fp);
+	  return (0);
+	}
+
+	bufptr = buffer;
+	bufend = buffer + bytes;
+      }
+
+      if (*bufptr == 0xff)
+	continue;
+
+      if ((bufptr + 16) >= bufend)
+      {
+       /*
+	* Read more of the marker...
+	*/
+
+	bytes = (ssize_t)(bufend - bufptr);
+
+	memmove(buffer, bufptr, bytes);
+	bufptr = buffer;
+	bufend = buffer + bytes;
+
+	if ((bytes = cupsFileRead(fp, (char *)bufend, sizeof(buffer) - (size_t)bytes)) <= 0)
+	{
+	  lint_message(lint, DOCLINT_LEVEL_ERROR, "Short JPEG file.");
+	  lint->results->errors ++;
+	  lint_close(lint, fp);
+	  return (0);
+	}
+
+	bufend += bytes;
+      }
+
+      length = (size_t)((bufptr[1] << 8) | bufptr[2]);
+
+      if ((*bufptr >= 0xc0 && *bufptr <= 0xc3) || (*bufptr >= 0xc5 && *bufptr <= 0xc7) || (*bufptr >= 0xc9 && *bufptr <= 0xcb) || (*bufptr >= 0xcd && *bufptr <= 0xcf))
+      {
+       /*
+	* SOFn marker, look for dimensions...
+	*/
+
+	int width  = (bufptr[6] << 8) | bufptr[7];
+	int height = (bufptr[4] << 8) | bufptr[5];
+	int ncolors = bufptr[8];
+
+        lint_message(lint, DOCLINT_LEVEL_DEBUG, "JPEG image is %dx%dx%d", width, height, ncolors);
+        lint_jpeg_page(lint, ncolors, copies, color_mode);
+
+        if (lint->streaming)
+        {
+         /*
+          * Report the counts right away, the rest of the image is consumed
+          * by lint_close()...
+          */
+
+          lint_progress(lint);
+        }
+        break;
+      }
+
+     /*
+      * Skip past this marker...
+      */
+
+      bufptr ++;
+      bytes = (ssize_t)(bufend - bufptr);
+
+      while (length >= bytes)
+      {
+	length -= (size_t)bytes;
+
+	if ((bytes = cupsFileRead(fp, (char *)buffer, sizeof(buffer))) <= 0)
+	{
+	  lint_message(lint, DOCLINT_LEVEL_ERROR, "Short JPEG file.");
+	  lint->results->errors ++;
+	  lint_close(lint, fp);
+	  return (0);
+	}
+
+	bufptr = buffer;
+	bufend = buffer + bytes;
+      }
+
+      if (length > bytes)
+	break;
+
+      bufptr += length;
+    }
+  }
+
+  lint_close(lint, fp);
+
+  return (1);
+}
+
+
+#ifndef _WIN32
+/*
+ * 'lint_jpeg_map()' - Check a memory-mapped JPEG file.
+ *
+ * This jumps from marker to marker using the segment lengths, and uses
+ * memchr() to find the next marker after the entropy-coded data of each scan,
+ * so only the marker segments are actually read.  The whole file is checked
+ * through to the EOI marker.
+ */
+
+static int				/* O - 1 on success, 0 on failure, -1 if the file cannot be mapped */
+lint_jpeg_map(
+    lint_context_t *lint,		/* I - Lint context */
+    const char     *filename,		/* I - File to check */
+    int            copies,		/* I - Number of copies */
+    const char     *color_mode)		/* I - print-color-mode value */
+{
+  int			fd;		/* File descriptor */
+  struct stat		fileinfo;	/* File information */
+  unsigned char		*data;		/* Mapped file */
+  const unsigned char	*ptr,		/* Pointer into file */
+			*end;		/* End of file */
+  unsigned char		marker;		/* Current marker */
+  size_t		length;		/* Length of marker segment */
+  int			ret = 1,	/* Return value */
+			eoi = 0,	/* Saw the EOI marker? */
+			frames = 0,	/* Number of SOFn markers */
+			scans = 0,	/* Number of SOS markers */
+			progressive = 0,/* Progressive JPEG? */
+			width = 0,	/* Width in pixels */
+			height = 0,	/* Height in lines */
+			ncolors = 0;	/* Number of color components */
+
+
+  if ((fd = open(filename, O_RDONLY)) < 0)
+    return (-1);
+
+  if (fstat(fd, &fileinfo) || !S_ISREG(fileinfo.st_mode) || fileinfo.st_size < 4)
+  {
+    close(fd);
+    return (-1);
+  }
+
+  data = mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED)
+    return (-1);
+
+  if (memcmp(data, "\377\330\377", 3))
+  {
+   /*
+    * Not a plain JPEG file (possibly compressed), use the buffered code...
+    */
+
+    munmap(data, (size_t)fileinfo.st_size);
+    return (-1);
+  }
+
+  ptr = data + 2;
+  end = data + fileinfo.st_size;
+
+  while (ptr < end)
+  {
+    if (*ptr != 0xff)
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad JPEG marker at offset %ld.", (long)(ptr - data));
+      lint->results->errors ++;
+      ret = 0;
+      break;
+    }
+
+   /*
+    * Skip fill bytes and get the marker...
+    */
+
+    while (ptr < end && *ptr == 0xff)
+      ptr ++;
+
+    if (ptr >= end)
+      break;
+
+    marker = *ptr++;
+
+    if (marker == 0xd9)
+    {
+      eoi = 1;
+      break;
+    }
+    else if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7))
+    {
+      continue;				/* TEM and RSTn markers have no segment */
+    }
+    else if (marker == 0x00 || marker == 0xd8)
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad JPEG marker 0x%02X at offset %ld.", marker, (long)(ptr - data - 1));
+      lint->results->errors ++;
+      ret = 0;
+      break;
+    }
+
+    if ((end - ptr) < 2)
+      break;
+
+    length = (size_t)((ptr[0] << 8) | ptr[1]);
+
+    if (length < 2 || length > (size_t)(end - ptr))
+      break;
+
+    if ((marker >= 0xc0 && marker <= 0xc3) || (marker >= 0xc5 && marker <= 0xc7) || (marker >= 0xc9 && marker <= 0xcb) || (marker >= 0xcd && marker <= 0xcf))
+    {
+     /*
+      * SOFn marker, get the dimensions from the first one...
+      */
+
+      if (length < 8)
+      {
+	lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad JPEG SOF%d marker length %u.", marker & 15, (unsigned)length);
+	lint->results->errors ++;
+	ret = 0;
+	break;
+      }
+
+      if (!frames)
+      {
+	height      = (ptr[3] << 8) | ptr[4];
+	width       = (ptr[5] << 8) | ptr[6];
+	ncolors     = ptr[7];
+	progressive = (marker & 3) == 2;
+      }
+
+      frames ++;
+    }
+
+    ptr += length;
+
+    if (marker == 0xda)
+    {
+     /*
+      * SOS marker, skip the entropy-coded data that follows to the next
+      * marker, ignoring stuffed 0xFF bytes and restart markers...
+      */
+
+      scans ++;
+
+      while ((ptr = memchr(ptr, 0xff, (size_t)(end - ptr))) != NULL && (ptr + 1) < end && (ptr[1] == 0x00 || (ptr[1] >= 0xd0 && ptr[1] <= 0xd7)))
+        ptr += 2;
+
+      if (!ptr)
+        ptr = end;
+    }
+  }
+
+  munmap(data, (size_t)fileinfo.st_size);
+
+  if (ret)
+  {
+    if (!eoi)
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Short JPEG file.");
+      lint->results->errors ++;
+      ret = 0;
+    }
+    else if (!frames)
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "No SOFn marker in JPEG file.");
+      lint->results->errors ++;
+      ret = 0;
+    }
+    else if (!scans)
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "No image data in JPEG file.");
+      lint->results->errors ++;
+      ret = 0;
+    }
+  }
+
+  if (ret)
+  {
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "JPEG image is %dx%dx%d", width, height, ncolors);
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "JPEG image is %s with %d scan(s).", progressive ? "progressive" : "sequential", scans);
+
+    lint_jpeg_page(lint, ncolors, copies, color_mode);
+  }
+
+  return (ret);
+}
+#endif /* !_WIN32 */
+
+
+/*
+ * 'lint_jpeg_page()' - Count the page for a JPEG image.
+ */
+
+static void
+lint_jpeg_page(
+    lint_context_t *lint,		/* I - Lint context */
+    int            ncolors,		/* I - Number of color components */
+    int            copies,		/* I - Number of copies */
+    const char     *color_mode)		/* I - print-color-mode value */
+{
+  if (ncolors > 1 && (!color_mode || strcmp(color_mode, "monochrome")))
+  {
+    lint->results->pages.full_color ++;
+    lint->results->impressions.full_color += copies;
+  }
+  else
+  {
+    lint->results->pages.monochrome ++;
+    lint->results->impressions.monochrome += copies;
+  }
+}
+
+
+/*
+ * 'lint_message()' - Report an error, warning, or debugging message.
+ */
+
+static void
+lint_message(lint_context_t  *lint,	/* I - Lint context */
+             doclint_level_t level,	/* I - Message level */
+             const char      *message,	/* I - printf-style message */
+             ...)			/* I - Additional arguments as needed */
+{
+  char		buffer[2048];		/* Formatted message */
+  va_list	ap;			/* Pointer to arguments */
+
+
+  if (!lint->message_cb)
+    return;
+
+  va_start(ap, message);
+  vsnprintf(buffer, sizeof(buffer), message, ap);
+  va_end(ap);
+
+  (*lint->message_cb)(lint->cb_data, level, buffer);
+}
+
+
+/*
+ * 'lint_open()' - Open a file or the standard input ("-") for reading.
+ */
+
+static cups_file_t *			/* O - File pointer or `NULL` on error */
+lint_open(lint_context_t *lint,		/* I - Lint context */
+          const char     *filename)	/* I - File to open */
+{
+  cups_file_t	*fp;			/* File pointer */
+
+
+  if (lint->fd >= 0)
+  {
+    if ((fp = cupsFileOpenFd(lint->fd, "r")) == NULL)
+      close(lint->fd);
+
+    lint->fd = -1;
+  }
+  else if (!strcmp(filename, "-"))
+    fp = cupsFileStdin();
+  else
+    fp = cupsFileOpen(filename, "rb");
+
+  if (!fp)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to open \"%s\": %s", filename, cupsGetErrorString());
+    lint->results->errors ++;
+  }
+
+  return (fp);
+}
+
+
+/*
+ * 'lint_pdf()' - Check a PDF file.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+lint_pdf(lint_context_t *lint,		/* I - Lint context */
+         const char     *filename,	/* I - File to check */
+	 size_t         num_options,	/* I - Number of options */
+	 cups_option_t  *options)	/* I - Options */
+{
+  const char		*value;		/* Option value */
+  int			copies;		/* copies value */
+  const char		*color_mode;	/* print-color-mode value */
+  int			duplex;		/* Duplex printing? */
+  int			first_page,	/* First page in range */
+			last_page,	/* Last page in range */
+			num_pages;	/* Number of pages */
+#ifdef HAVE_COREGRAPHICS
+  CFURLRef		url;		/* CFURL object for PDF filename */
+  CGPDFDocumentRef	document = NULL;/* Input document */
+#elif defined(HAVE_MUPDF)
+  fz_context		*context;	/* MuPDF context */
+  fz_document		*document;	/* Document to print */
+#endif /* HAVE_COREGRAPHICS */
+
+
+ /*
+  * Gather options...
+  */
+
+  if ((value = cupsGetOption("copies", num_options, options)) != NULL)
+    copies = atoi(value);
+  else
+    copies = 1;
+
+  if ((value = cupsGetOption("page-ranges", num_options, options)) != NULL)
+  {
+    if (sscanf(value, "%u-%u", &first_page, &last_page) != 2)
+    {
+      first_page = 1;
+      last_page  = INT_MAX;
+    }
+  }
+  else
+  {
+    first_page = 1;
+    last_page  = INT_MAX;
+  }
+
+  color_mode = cupsGetOption("print-color-mode", num_options, options);
+
+  if ((value = cupsGetOption("sides", num_options, options)) != NULL)
+    duplex = !strncmp(value, "two-sided-", 10);
+  else
+    duplex = 0;
+
+#ifdef HAVE_COREGRAPHICS
+ /*
+  * Open the PDF...
+  */
+
+  if ((url = CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault, (const UInt8 *)filename, (CFIndex)strlen(filename), false)) == NULL)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to create CFURL for file.");
+    return (0);
+  }
+
+  document = CGPDFDocumentCreateWithURL(url);
+  CFRelease(url);
+
+  if (!document)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to create CFPDFDocument for file.");
+    return (0);
+  }
+
+  if (CGPDFDocumentIsEncrypted(document))
+  {
+   /*
+    * Only support encrypted PDFs with a blank password...
+    */
+
+    if (!CGPDFDocumentUnlockWithPassword(document, ""))
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Document is encrypted and cannot be unlocked.");
+      CGPDFDocumentRelease(document);
+      lint->results->errors ++;
+      return (0);
+    }
+  }
+
+  if (!CGPDFDocumentAllowsPrinting(document))
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Document does not allow printing.");
+    CGPDFDocumentRelease(document);
+    lint->results->errors ++;
+    return (0);
+  }
+
+  num_pages = (int)CGPDFDocumentGetNumberOfPages(document);
+
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "Total pages in PDF document is %d.", num_pages);
+
+  if (first_page > num_pages)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "\"page-ranges\" value does not include any pages to print in the document.");
+    CGPDFDocumentRelease(document);
+    return (0);
+  }
+
+  if (last_page > num_pages)
+    last_page = num_pages;
+
+ /*
+  * Close the PDF file...
+  */
+
+  CGPDFDocumentRelease(document);
+
+ /*
+  * For now, assume all pages are color unless 'monochrome' is specified.  In
+  * the future we can use the CGPDFContentStream, CGPDFOperatorTable, and
+  * CGPDFScanner APIs to capture the graphics operations on each page and then
+  * mark pages as color or grayscale...
+  */
+
+
+#elif defined(HAVE_MUPDF)
+ /*
+  * Open the PDF file...
+  */
+
+  if ((context = fz_new_context(NULL, NULL, FZ_STORE_UNLIMITED)) == NULL)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to create context.");
+    lint->results->errors ++;
+    return (0);
+  }
+
+  fz_register_document_handlers(context);
+
+  fz_try(context) document = fz_open_document(context, filename);
+  fz_catch(context)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to open '%s': %s", filename, fz_caught_message(context));
+    fz_drop_context(context);
+    lint->results->errors ++;
+    return (0);
+  }
+
+  if (fz_needs_password(context, document))
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Document is encrypted and cannot be unlocked.");
+    fz_drop_document(context, document);
+    fz_drop_context(context);
+    lint->results->errors ++;
+    return (0);
+  }
+
+  num_pages = (int)fz_count_pages(context, document);
+  if (first_page > num_pages)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "\"page-ranges\" value does not include any pages to print in the document.");
+
+    fz_drop_document(context, document);
+    fz_drop_context(context);
+
+    return (0);
+  }
+
+  if (last_page > num_pages)
+    last_page = num_pages;
+
+ /*
+  * Close the PDF file...
+  */
+
+  fz_drop_document(context, document);
+  fz_drop_context(context);
+
+ /*
+  * For now, assume all pages are color unless 'monochrome' is specified.  In
+  * the future we might use MuPDF functions to mark individual pages as color or
+  * grayscale...
+  */
+
+#endif /* HAVE_COREGRAPHICS */
+
+ /*
+  * Update the page counters...
+  */
+
+  num_pages = last_page - first_page + 1;
+
+  if (!color_mode || strcmp(color_mode, "monochrome"))
+  {
+   /*
+    * All pages are color...
+    */
+
+    lint->results->pages.full_color += num_pages;
+
+    if (duplex)
+    {
+      if (num_pages & 1)
+        lint->results->impressions_two_sided.blank += copies;
+
+      lint->results->impressions_two_sided.full_color += copies * num_pages;
+    }
+    else
+    {
+      lint->results->impressions.full_color += copies * num_pages;
+    }
+  }
+  else
+  {
+   /*
+    * All pages are grayscale...
+    */
+
+    lint->results->pages.monochrome += num_pages;
+
+    if (duplex)
+    {
+      if (num_pages & 1)
+        lint->results->impressions_two_sided.blank += copies;
+
+      lint->results->impressions_two_sided.monochrome += copies * num_pages;
+    }
+    else
+    {
+      lint->results->impressions.monochrome += copies * num_pages;
+    }
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'lint_progress()' - Update the sheet counters and report progress.
+ */
+
+static void
+lint_progress(lint_context_t *lint)	/* I - Lint context */
+{
+  doclint_results_t	*results = lint->results;
+					/* Results */
+
+
+  results->sheets.blank      = results->impressions.blank + (results->impressions_two_sided.blank + 1) / 2;
+  results->sheets.full_color = results->impressions.full_color + (results->impressions_two_sided.full_color + 1) / 2;
+  results->sheets.monochrome = results->impressions.monochrome + (results->impressions_two_sided.monochrome + 1) / 2;
+
+  if (lint->progress_cb)
+    (*lint->progress_cb)(lint->cb_data, results);
+}
+
+
+/*
+ * 'lint_raster()' - Check an Apple/CUPS/PWG Raster file.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+lint_raster(lint_context_t *lint,	/* I - Lint context */
+            const char     *filename,	/* I - File to check */
+	    const char     *content_type)/* I - Content type */
+{
+  cups_file_t		*fp;		/* File pointer */
+  lint_raster_t		r;		/* Buffered raster stream */
+  lint_pool_t		pool;		/* Page thread pool */
+  lint_page_t		*p;		/* Current page */
+  cups_thread_t		threads[LINT_MAX_THREADS];
+					/* Page threads */
+  int			i,		/* Looping var */
+			num_threads = 1;/* Number of page threads */
+  cups_page_header_t	header;		/* Page header */
+  unsigned		page = 0;	/* Page number */
+
+
+  (void)content_type;
+
+  if ((fp = lint_open(lint, filename)) == NULL)
+    return (0);
+
+  memset(&r, 0, sizeof(r));
+
+  if ((r.buffer = malloc(LINT_BUFSIZE)) == NULL)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to allocate memory for \"%s\": %s", filename, strerror(errno));
+    lint->results->errors ++;
+    lint_close(lint, fp);
+    return (0);
+  }
+
+  r.fp     = fp;
+  r.bufptr = r.buffer;
+  r.bufend = r.buffer;
+
+ /*
+  * Pages are indexed (and their PackBits data validated) sequentially, and
+  * then decoded and checked for blank/color on a pool of threads...
+  */
+
+#ifdef _SC_NPROCESSORS_ONLN
+  if ((num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+    num_threads = 1;
+  else if (num_threads > LINT_MAX_THREADS)
+    num_threads = LINT_MAX_THREADS;
+#endif /* _SC_NPROCESSORS_ONLN */
+
+  memset(&pool, 0, sizeof(pool));
+  cupsMutexInit(&pool.mutex);
+  cupsCondInit(&pool.cond);
+
+  pool.max_pending = (size_t)num_threads * LINT_MAX_PENDING;
+
+  for (i = 0; i < num_threads; i ++)
+    threads[i] = cupsThreadCreate((cups_thread_func_t)raster_worker, &pool);
+
+  if (!strcasecmp(content_type, "image/pwg-raster"))
+  {
+    unsigned		syncword;	/* Sync word */
+
+    if (raster_read(&r, &syncword, sizeof(syncword)) != sizeof(syncword))
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to read sync word from PWG Raster file.");
+      lint->results->errors ++;
+    }
+    else if (syncword != CUPS_RASTER_SYNCv2 && syncword != CUPS_RASTER_REVSYNCv2)
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad sync word 0x%08x seen in PWG Raster file.", syncword);
+      lint->results->errors ++;
+    }
+    else
+    {
+      while (read_pwg_raster_header(lint, &r, syncword, &header))
+      {
+	page ++;
+	if ((p = index_raster_image(lint, &r, &header, page)) == NULL)
+	  break;
+
+        queue_raster_page(lint, &pool, p);
+        merge_raster_pages(lint, &pool, 0);
+      }
+    }
+  }
+  else
+  {
+    unsigned char	fheader[12];	/* File header */
+    unsigned		num_pages;	/* Number of pages */
+
+    if (raster_read(&r, fheader, sizeof(fheader)) != sizeof(fheader))
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to read header from Apple raster file.");
+      lint->results->errors ++;
+    }
+    else  if (memcmp(fheader, "UNIRAST", 8))
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad Apple Raster header seen.");
+      lint->results->errors ++;
+    }
+    else
+    {
+      num_pages = (unsigned)((fheader[8] << 24) | (fheader[9] << 16) | (fheader[10] << 8) | fheader[11]);
+
+      while (read_apple_raster_header(lint, &r, &header))
+      {
+	page ++;
+	if ((p = index_raster_image(lint, &r, &header, page)) == NULL)
+	  break;
+
+        queue_raster_page(lint, &pool, p);
+        merge_raster_pages(lint, &pool, 0);
+      }
+
+      if (num_pages > 0 && page != num_pages)
+      {
+	lint_message(lint, DOCLINT_LEVEL_ERROR, "Actual number of pages (%u) does not match file header (%u).", page, num_pages);
+	lint->results->errors ++;
+      }
+    }
+  }
+
+ /*
+  * Merge the remaining pages and then wait for the threads to finish...
+  */
+
+  cupsMutexLock(&pool.mutex);
+  pool.done = 1;
+  cupsCondBroadcast(&pool.cond);
+  cupsMutexUnlock(&pool.mutex);
+
+  merge_raster_pages(lint, &pool, 1);
+
+  for (i = 0; i < num_threads; i ++)
+    cupsThreadWait(threads[i]);
+
+  free(pool.pages);
+  cupsCondDestroy(&pool.cond);
+  cupsMutexDestroy(&pool.mutex);
+
+  free(r.buffer);
+  lint_close(lint, fp);
+
+  return (lint->results->errors == 0);
+}
+
+
+/*
+ * 'merge_raster_pages()' - Merge decoded pages into the counters in page order.
+ */
+
+static void
+merge_raster_pages(
+    lint_context_t *lint,		/* I - Lint context */
+    lint_pool_t    *pool,		/* I - Page thread pool */
+    int            wait)		/* I - Wait for all pages to be decoded? */
+{
+  lint_page_t	*p;			/* Current page */
+  int		merged = 0;		/* Did we merge any pages? */
+
+
+  for (;;)
+  {
+    cupsMutexLock(&pool->mutex);
+
+    while (wait && pool->next_merge < pool->num_pages && !pool->pages[pool->next_merge]->decoded)
+      cupsCondWait(&pool->cond, &pool->mutex, 1.0);
+
+    if (pool->next_merge < pool->num_pages && pool->pages[pool->next_merge]->decoded)
+    {
+      p = pool->pages[pool->next_merge];
+      pool->pages[pool->next_merge ++] = NULL;
+    }
+    else
+      p = NULL;
+
+    cupsMutexUnlock(&pool->mutex);
+
+    if (!p)
+      break;
+
+    if (p->error)
+    {
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to decode page %u.", p->page);
+      lint->results->errors ++;
+    }
+    else
+    {
+      lint_message(lint, DOCLINT_LEVEL_DEBUG, "Page %u is %s-sided %s", p->page, p->header.Duplex ? "two" : "one", p->blank ? "blank" : p->color ? "full-color" : "monochrome");
+
+      if (p->header.Duplex)
+      {
+	if (p->blank)
+	  lint->results->impressions_two_sided.blank ++;
+	else if (p->color)
+	  lint->results->impressions_two_sided.full_color ++;
+	else
+	  lint->results->impressions_two_sided.monochrome ++;
+      }
+      else
+      {
+	if (p->blank)
+	  lint->results->impressions.blank ++;
+	else if (p->color)
+	  lint->results->impressions.full_color ++;
+	else
+	  lint->results->impressions.monochrome ++;
+      }
+
+      if (p->color)
+	lint->results->pages.full_color ++;
+      else
+	lint->results->pages.monochrome ++;
+    }
+
+    free(p);
+
+    merged = 1;
+  }
+
+  if (merged && lint->streaming)
+    lint_progress(lint);
+}
+
+
+/*
+ * 'page_reserve()' - Reserve space for more page image data.
+ */
+
+static unsigned char *			/* O - Pointer to end of data or `NULL` on error */
+page_reserve(lint_page_t *p,		/* I - Page */
+             size_t      bytes)		/* I - Number of bytes needed */
+{
+  if ((p->datalen + bytes) > p->datasize)
+  {
+    size_t		datasize;	/* New allocation size */
+    unsigned char	*data;		/* New page data */
+
+    for (datasize = p->datasize ? p->datasize : 65536; datasize < (p->datalen + bytes); datasize *= 2);
+
+    if ((data = realloc(p->data, datasize)) == NULL)
+      return (NULL);
+
+    p->data     = data;
+    p->datasize = datasize;
+  }
+
+  return (p->data + p->datalen);
+}
+
+
+/*
+ * 'queue_raster_page()' - Queue a page for decoding.
+ *
+ * This waits if too many pages are already waiting to be decoded so that
+ * memory use stays bounded.
+ */
+
+static void
+queue_raster_page(
+    lint_context_t *lint,		/* I - Lint context */
+    lint_pool_t    *pool,		/* I - Page thread pool */
+    lint_page_t    *p)			/* I - Page */
+{
+  cupsMutexLock(&pool->mutex);
+
+  while ((pool->num_pages - pool->num_done) >= pool->max_pending)
+    cupsCondWait(&pool->cond, &pool->mutex, 1.0);
+
+  if (pool->num_pages >= pool->alloc_pages)
+  {
+    size_t	alloc_pages = pool->alloc_pages ? 2 * pool->alloc_pages : 64;
+					/* New allocation */
+    lint_page_t	**pages;		/* New pages array */
+
+    if ((pages = realloc(pool->pages, alloc_pages * sizeof(lint_page_t *))) == NULL)
+    {
+      cupsMutexUnlock(&pool->mutex);
+
+      lint_message(lint, DOCLINT_LEVEL_ERROR, "Unable to allocate memory for page %u.", p->page);
+      lint->results->errors ++;
+
+      free(p->data);
+      free(p);
+      return;
+    }
+
+    pool->pages       = pages;
+    pool->alloc_pages = alloc_pages;
+  }
+
+  pool->pages[pool->num_pages ++] = p;
+
+  cupsCondBroadcast(&pool->cond);
+  cupsMutexUnlock(&pool->mutex);
+}
+
+
+/*
+ * 'raster_getc()' - Get a byte from a raster stream.
+ */
+
+static int				/* O - Byte or `EOF` */
+raster_getc(lint_raster_t *r)		/* I - Raster stream */
+{
+  if (r->bufptr >= r->bufend)
+  {
+    ssize_t	bytes;			/* Bytes read */
+
+    if (!r->fp || (bytes = cupsFileRead(r->fp, (char *)r->buffer, LINT_BUFSIZE)) <= 0)
+      return (EOF);
+
+    r->bufptr = r->buffer;
+    r->bufend = r->buffer + bytes;
+  }
+
+  return (*(r->bufptr)++);
+}
+
+
+/*
+ * 'raster_is_gray()' - Determine whether a line of raster data is gray.
+ *
+ * A pixel is gray when its first three color values (or two for two-color
+ * data) are equal.  For CMYK data the K value is ignored.
+ */
+
+static int				/* O - 1 if gray, 0 if color */
+raster_is_gray(
+    const unsigned char *line,		/* I - Line buffer */
+    size_t              size,		/* I - Size of line buffer */
+    unsigned            bpp,		/* I - Bytes per pixel */
+    unsigned            bpc,		/* I - Bytes per color */
+    unsigned            num_colors)	/* I - Number of colors */
+{
+  size_t	i = 0;			/* Looping var */
+  unsigned	k,			/* Byte within pixel */
+		span;			/* Number of bytes to compare in each pixel */
+
+
+  if (num_colors > 3)
+    num_colors = 3;
+
+  span = (num_colors - 1) * bpc;
+
+#ifdef __SSE2__
+ /*
+  * Compare each byte with the byte one color value later, 48 bytes (a
+  * multiple of every supported pixel size) at a time...
+  */
+
+  if (bpp <= 8 && (48 % bpp) == 0)
+  {
+    unsigned	masks[3] = { 0, 0, 0 };	/* Bytes that must match in each 16-byte block */
+    unsigned	j;			/* Looping var */
+
+    for (j = 0; j < 48; j ++)
+    {
+      if ((j % bpp) < span)
+        masks[j / 16] |= 1U << (j % 16);
+    }
+
+    for (; (i + 48 + bpc) <= size; i += 48)
+    {
+      for (j = 0; j < 3; j ++)
+      {
+        __m128i	a = _mm_loadu_si128((const __m128i *)(line + i + 16 * j)),
+		b = _mm_loadu_si128((const __m128i *)(line + i + 16 * j + bpc));
+					/* Bytes to compare */
+
+        if (((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & masks[j]) != masks[j])
+          return (0);
+      }
+    }
+  }
+#endif /* __SSE2__ */
+
+  for (; (i + bpp) <= size; i += bpp)
+  {
+    for (k = 0; k < span; k ++)
+    {
+      if (line[i + k] != line[i + k + bpc])
+        return (0);
+    }
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'raster_is_white()' - Determine whether a line of raster data is all white.
+ */
+
+static int				/* O - 1 if white, 0 otherwise */
+raster_is_white(
+    const unsigned char *line,		/* I - Line buffer */
+    size_t              size,		/* I - Size of line buffer */
+    unsigned char       white)		/* I - White value */
+{
+#ifdef __AVX2__
+  __m256i	white32 = _mm256_set1_epi8((char)white);
+					/* 32 white bytes */
+
+  for (; size >= 32; line += 32, size -= 32)
+  {
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)line), white32)) != -1)
+      return (0);
+  }
+#endif /* __AVX2__ */
+
+#ifdef __SSE2__
+  __m128i	white16 = _mm_set1_epi8((char)white);
+					/* 16 white bytes */
+
+  for (; size >= 16; line += 16, size -= 16)
+  {
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)line), white16)) != 0xffff)
+      return (0);
+  }
+
+#else
+  unsigned long long	white8;		/* 8 white bytes */
+
+  memset(&white8, white, sizeof(white8));
+
+  for (; size >= 8; line += 8, size -= 8)
+  {
+    unsigned long long	value;		/* 8 bytes from the line */
+
+    memcpy(&value, line, sizeof(value));
+    if (value != white8)
+      return (0);
+  }
+#endif /* __SSE2__ */
+
+  for (; size > 0; line ++, size --)
+  {
+    if (*line != white)
+      return (0);
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'raster_read()' - Read bytes from a raster stream.
+ */
+
+static size_t				/* O - Number of bytes read */
+raster_read(lint_raster_t *r,		/* I - Raster stream */
+            void          *data,	/* I - Buffer */
+            size_t        bytes)	/* I - Number of bytes to read */
+{
+  unsigned char	*dataptr = (unsigned char *)data;
+					/* Pointer into buffer */
+  size_t	total = 0,		/* Total bytes read */
+		count;			/* Bytes to copy */
+  ssize_t	rbytes;			/* Bytes read from file */
+
+
+  while (total < bytes)
+  {
+    if (r->bufptr >= r->bufend)
+    {
+      if (!r->fp)
+        break;
+
+      if ((bytes - total) >= LINT_BUFSIZE)
+      {
+       /*
+        * Read large requests directly into the caller's buffer...
+	*/
+
+	if ((rbytes = cupsFileRead(r->fp, (char *)dataptr, bytes - total)) <= 0)
+	  break;
+
+        dataptr += rbytes;
+        total   += (size_t)rbytes;
+        continue;
+      }
+
+      if ((rbytes = cupsFileRead(r->fp, (char *)r->buffer, LINT_BUFSIZE)) <= 0)
+        break;
+
+      r->bufptr = r->buffer;
+      r->bufend = r->buffer + rbytes;
+    }
+
+    if ((count = (size_t)(r->bufend - r->bufptr)) > (bytes - total))
+      count = bytes - total;
+
+    memcpy(dataptr, r->bufptr, count);
+
+    r->bufptr += count;
+    dataptr   += count;
+    total     += count;
+  }
+
+  return (total);
+}
+
+
+/*
+ * 'raster_worker()' - Decode queued raster pages.
+ */
+
+static void *				/* O - Thread exit status */
+raster_worker(lint_pool_t *pool)	/* I - Page thread pool */
+{
+  lint_page_t	*p;			/* Current page */
+  lint_raster_t	r;			/* Memory stream for page data */
+
+
+  cupsMutexLock(&pool->mutex);
+
+  for (;;)
+  {
+    while (pool->next_page >= pool->num_pages && !pool->done)
+      cupsCondWait(&pool->cond, &pool->mutex, 1.0);
+
+    if (pool->next_page >= pool->num_pages)
+      break;
+
+    p = pool->pages[pool->next_page ++];
+
+    cupsMutexUnlock(&pool->mutex);
+
+    r.fp     = NULL;
+    r.buffer = p->data;
+    r.bufptr = p->data;
+    r.bufend = p->data + p->datalen;
+
+    p->error = !read_raster_image(&r, p);
+
+    free(p->data);
+    p->data = NULL;
+
+    cupsMutexLock(&pool->mutex);
+    p->decoded = 1;
+    pool->num_done ++;
+    cupsCondBroadcast(&pool->cond);
+  }
+
+  cupsMutexUnlock(&pool->mutex);
+
+  return (NULL);
+}
+
+
+/*
+ * 'read_apple_raster_header()' - Read a page header from an Apple raster file.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+read_apple_raster_header(
+    lint_context_t     *lint,		/* I - Lint context */
+    lint_raster_t      *r,		/* I - Raster stream */
+    cups_page_header_t *header)	/* O - Raster header */
+{
+  unsigned char	pheader[32];		/* Page header */
+
+
+  memset(header, 0, sizeof(cups_page_header_t));
+
+  if (raster_read(r, pheader, sizeof(pheader)) != sizeof(pheader))
+    return (0);
+
+  switch (pheader[1])
+  {
+    case 0 : /* W */
+        header->cupsColorSpace = CUPS_CSPACE_SW;
+        header->cupsNumColors  = 1;
+        break;
+
+    case 1 : /* sRGB */
+        header->cupsColorSpace = CUPS_CSPACE_SRGB;
+        header->cupsNumColors  = 3;
+        break;
+
+    case 3 : /* AdobeRGB */
+        header->cupsColorSpace = CUPS_CSPACE_ADOBERGB;
+        header->cupsNumColors  = 3;
+        break;
+
+    case 4 : /* DeviceW */
+        header->cupsColorSpace = CUPS_CSPACE_W;
+        header->cupsNumColors  = 1;
+        break;
+
+    case 5 : /* DeviceRGB */
+        header->cupsColorSpace = CUPS_CSPACE_RGB;
+        header->cupsNumColors  = 3;
+        break;
+
+    case 6 : /* DeviceCMYK */
+        header->cupsColorSpace = CUPS_CSPACE_CMYK;
+        header->cupsNumColors  = 4;
+        break;
+
+    default :
+        lint_message(lint, DOCLINT_LEVEL_ERROR, "Unknown Apple Raster colorspace %u.", pheader[1]);
+        lint->results->errors ++;
+        return (0);
+  }
+
+  if ((header->cupsNumColors == 1 && pheader[0] != 8 && pheader[0] != 16) ||
+      (header->cupsNumColors == 3 && pheader[0] != 24 && pheader[0] != 48) ||
+      (header->cupsNumColors == 4 && pheader[0] != 32 && pheader[0] != 64))
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Invalid bits per pixel value %u.", pheader[0]);
+    lint->results->errors ++;
+    return (0);
+  }
+
+  header->cupsBitsPerPixel = pheader[0];
+  header->cupsBitsPerColor = pheader[0] / header->cupsNumColors;
+  header->cupsWidth        = (unsigned)((pheader[12] << 24) | (pheader[13] << 16) | (pheader[14] << 8) | pheader[15]);
+  header->cupsHeight       = (unsigned)((pheader[16] << 24) | (pheader[17] << 16) | (pheader[18] << 8) | pheader[19]);
+  header->cupsBytesPerLine = header->cupsWidth * header->cupsBitsPerPixel / 8;
+
+  return (1);
+}
+
+
+/*
+ * 'read_pwg_raster_header()' - Read a page header from a PWG raster file.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+read_pwg_raster_header(
+    lint_context_t     *lint,		/* I - Lint context */
+    lint_raster_t      *r,		/* I - Raster stream */
+    unsigned            syncword,	/* I - Sync word from the file */
+    cups_page_header_t *header)	/* O - Raster header */
+{
+  int		i;			/* Looping/temp var */
+  unsigned	num_colors,		/* Number of colors */
+		bytes_per_line;		/* Expected bytes per line */
+  static const char * const when_enum[] =
+  {					/* Human-readable 'When' values, also used by AdvanceMedia, Jog */
+    "Never",
+    "AfterDocument",
+    "AfterJob",
+    "AfterSet",
+    "AfterPage"
+  };
+  static const char * const media_position_enum[] =
+  {					/* Human-readable media position values */
+    "Auto",
+    "Main",
+    "Alternate",
+    "LargeCapacity",
+    "Manual",
+    "Envelope",
+    "Disc",
+    "Photo",
+    "Hagaki",
+    "MainRoll",
+    "AlternateRoll",
+    "Top",
+    "Middle",
+    "Bottom",
+    "Side",
+    "Left",
+    "Right",
+    "Center",
+    "Rear",
+    "ByPassTray",
+    "Tray1",
+    "Tray2",
+    "Tray3",
+    "Tray4",
+    "Tray5",
+    "Tray6",
+    "Tray7",
+    "Tray8",
+    "Tray9",
+    "Tray10",
+    "Tray11",
+    "Tray12",
+    "Tray13",
+    "Tray14",
+    "Tray15",
+    "Tray16",
+    "Tray17",
+    "Tray18",
+    "Tray19",
+    "Tray20",
+    "Roll1",
+    "Roll2",
+    "Roll3",
+    "Roll4",
+    "Roll5",
+    "Roll6",
+    "Roll7",
+    "Roll8",
+    "Roll9",
+    "Roll10",
+  };
+  static const char * const orientation_enum[] =
+  {					/* Human-readable orientation values */
+    "Portrait",
+    "Landscape",
+    "ReversePortrait",
+    "ReverseLandscape"
+  };
+  static const char * const print_quality_enum[] =
+  {					/* Human-readable print quality values */
+    "Default",
+    "",
+    "",
+    "Draft",
+    "Normal",
+    "High"
+  };
+  static const char * const color_space_enum[] =
+  {					/* Human-readable color space values */
+    "W",	/* 0 */
+    "Rgb",	/* 1 */
+    "",		/* 2 */
+    "Black",	/* 3 */
+    "",		/* 4 */
+    "",		/* 5 */
+    "Cmyk",	/* 6 */
+    "",		/* 7 */
+    "",		/* 8 */
+    "",		/* 9 */
+    "",		/* 10 */
+    "",		/* 11 */
+    "",		/* 12 */
+    "",		/* 13 */
+    "",		/* 14 */
+    "",		/* 15 */
+    "",		/* 16 */
+    "",		/* 17 */
+    "Sgray",	/* 18 */
+    "Srgb",	/* 19 */
+    "AdobeRgb",	/* 20 */
+    "",		/* 21 */
+    "",		/* 22 */
+    "",		/* 23 */
+    "",		/* 24 */
+    "",		/* 25 */
+    "",		/* 26 */
+    "",		/* 27 */
+    "",		/* 28 */
+    "",		/* 29 */
+    "",		/* 30 */
+    "",		/* 31 */
+    "",		/* 32 */
+    "",		/* 33 */
+    "",		/* 34 */
+    "",		/* 35 */
+    "",		/* 36 */
+    "",		/* 37 */
+    "",		/* 38 */
+    "",		/* 39 */
+    "",		/* 40 */
+    "",		/* 41 */
+    "",		/* 42 */
+    "",		/* 43 */
+    "",		/* 44 */
+    "",		/* 45 */
+    "",		/* 46 */
+    "",		/* 47 */
+    "Device1",	/* 48 */
+    "Device2",	/* 49 */
+    "Device3",	/* 50 */
+    "Device4",	/* 51 */
+    "Device5",	/* 52 */
+    "Device6",	/* 53 */
+    "Device7",	/* 54 */
+    "Device8",	/* 55 */
+    "Device9",	/* 56 */
+    "Device10",	/* 57 */
+    "Device11",	/* 58 */
+    "Device12",	/* 59 */
+    "Device13",	/* 60 */
+    "Device14",	/* 61 */
+    "Device15"	/* 62 */
+  };
+
+
+  if (raster_read(r, header, sizeof(cups_page_header_t)) != sizeof(cups_page_header_t))
+    return (0);
+
+  if (syncword == CUPS_RASTER_REVSYNCv2)
+  {
+   /*
+    * Swap bytes for integer values in page header...
+    */
+
+    unsigned	len,			/* Looping var */
+		*s,			/* Current word */
+		temp;			/* Temporary copy */
+
+    for (len = 81, s = &(header->AdvanceDistance); len > 0; len --, s ++)
+    {
+      temp = *s;
+      *s   = ((temp & 0xff) << 24) |
+	     ((temp & 0xff00) << 8) |
+	     ((temp & 0xff0000) >> 8) |
+	     ((temp & 0xff000000) >> 24);
+    }
+  }
+
+  if (memcmp(header->MediaClass, "PwgRaster", 10))
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "PwgRaster value in header is incorrect.");
+    lint->results->errors ++;
+    return (0);
+  }
+
+  if (header->AdvanceDistance != 0 || header->AdvanceMedia != 0 || header->Collate != 0)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Non-zero values present in Reserved[256-267] area.");
+    lint->results->warnings ++;
+  }
+
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "MediaColor=\"%s\"", header->MediaColor);
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "MediaType=\"%s\"", header->MediaType);
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "PrintContentOptimize=\"%s\"", header->OutputType);
+
+  if (header->CutMedia > CUPS_CUT_PAGE)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad CutMedia value %u.", header->CutMedia);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "CutMedia=%u (%s)", header->CutMedia, when_enum[header->CutMedia]);
+
+  if (header->Duplex > 1)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad Duplex value %u.", header->Duplex);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "Duplex=%u (%s)", header->Duplex, header->Duplex ? "true" : "false");
+
+  if (header->HWResolution[0] == 0 || header->HWResolution[1] == 0)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad HWResolution value [%u %u].", header->HWResolution[0], header->HWResolution[1]);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "HWResolution=[%u %u]", header->HWResolution[0], header->HWResolution[1]);
+
+  if (header->ImagingBoundingBox[0] != 0 || header->ImagingBoundingBox[1] != 0 || header->ImagingBoundingBox[2] != 0 || header->ImagingBoundingBox[3] != 0)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Non-zero values present in Reserved[284-299] area.");
+    lint->results->warnings ++;
+  }
+
+  if (header->InsertSheet > 1)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad InsertSheet value %u.", header->InsertSheet);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "InsertSheet=%u (%s)", header->InsertSheet, header->InsertSheet ? "true" : "false");
+
+
+  if (header->Jog > CUPS_JOG_SET)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad Jog value %u.", header->Jog);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "Jog=%u (%s)", header->Jog, when_enum[header->Jog]);
+
+  if (header->LeadingEdge > CUPS_EDGE_RIGHT)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad LeadingEdge value %u.", header->LeadingEdge);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "LeadingEdge=%u (%s)", header->LeadingEdge, header->LeadingEdge ? "LongEdgeFirst" : "ShortEdgeFirst");
+
+  if (header->Margins[0] != 0 || header->Margins[1] != 0 || header->ManualFeed != 0)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Non-zero values present in Reserved[312-323] area.");
+    lint->results->warnings ++;
+  }
+
+  if (header->MediaPosition >= (sizeof(media_position_enum) / sizeof(media_position_enum[0])))
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad MediaPosition value %u.", header->MediaPosition);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "MediaPosition=%u (%s)", header->MediaPosition, media_position_enum[header->MediaPosition]);
+
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "MediaWeight=%u", header->MediaWeight);
+
+  if (header->MirrorPrint != 0 || header->NegativePrint != 0)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Non-zero values present in Reserved[332-339] area.");
+    lint->results->warnings ++;
+  }
+
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "NumCopies=%u", header->NumCopies);
+
+  if (header->Orientation > CUPS_ORIENT_270)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad Orientation value %u.", header->Orientation);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "Orientation=%u (%s)", header->Orientation, orientation_enum[header->Orientation]);
+
+  if (header->OutputFaceUp != 0)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Non-zero values present in Reserved[348-351] area.");
+    lint->results->warnings ++;
+  }
+
+  if (header->PageSize[0] == 0 || header->PageSize[1] == 0)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad PageSize value [%u %u].", header->PageSize[0], header->PageSize[1]);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "PageSize=[%u %u]", header->PageSize[0], header->PageSize[1]);
+
+  if (header->Separations != 0 || header->TraySwitch != 0)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Non-zero values present in Reserved[360-367] area.");
+    lint->results->warnings ++;
+  }
+
+  if (header->Tumble > 1)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad Tumble value %u.", header->Tumble);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "Tumble=%u (%s)", header->Tumble, header->Tumble ? "true" : "false");
+
+  if (header->cupsWidth == 0 || header->cupsHeight == 0)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad Width x Height value %u x %u.", header->cupsWidth, header->cupsHeight);
+    lint->results->errors ++;
+    return (0);
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "Width x Height=%u x %u", header->cupsWidth, header->cupsHeight);
+
+  if (header->cupsMediaType != 0)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Non-zero values present in Reserved[380-383] area.");
+    lint->results->warnings ++;
+  }
+
+  switch (header->cupsColorSpace)
+  {
+    case CUPS_CSPACE_W :
+    case CUPS_CSPACE_K :
+    case CUPS_CSPACE_SW :
+        num_colors = 1;
+        break;
+
+    case CUPS_CSPACE_RGB :
+    case CUPS_CSPACE_SRGB :
+    case CUPS_CSPACE_ADOBERGB :
+        num_colors = 3;
+        break;
+
+    case CUPS_CSPACE_CMYK :
+        num_colors = 4;
+        break;
+
+    case CUPS_CSPACE_DEVICE1 :
+    case CUPS_CSPACE_DEVICE2 :
+    case CUPS_CSPACE_DEVICE3 :
+    case CUPS_CSPACE_DEVICE4 :
+    case CUPS_CSPACE_DEVICE5 :
+    case CUPS_CSPACE_DEVICE6 :
+    case CUPS_CSPACE_DEVICE7 :
+    case CUPS_CSPACE_DEVICE8 :
+    case CUPS_CSPACE_DEVICE9 :
+    case CUPS_CSPACE_DEVICEA :
+    case CUPS_CSPACE_DEVICEB :
+    case CUPS_CSPACE_DEVICEC :
+    case CUPS_CSPACE_DEVICED :
+    case CUPS_CSPACE_DEVICEE :
+    case CUPS_CSPACE_DEVICEF :
+        num_colors = header->cupsColorSpace - CUPS_CSPACE_DEVICE1 + 1;
+        break;
+
+    default :
+        lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad ColorSpace value %u.", header->cupsColorSpace);
+        lint->results->errors ++;
+        return (0);
+  }
+
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "ColorSpace=%u (%s)", header->cupsColorSpace, color_space_enum[header->cupsColorSpace]);
+
+  if (header->cupsColorOrder != CUPS_ORDER_CHUNKED)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad ColorOrder value %u.", header->cupsColorOrder);
+    lint->results->errors ++;
+    return (0);
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "ColorOrder=0 (Chunky)");
+
+  if (header->cupsNumColors != num_colors)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad NumColors value %u.", header->cupsNumColors);
+    lint->results->warnings ++;
+    header->cupsNumColors = (unsigned)num_colors;
+  }
+
+  switch (header->cupsBitsPerColor)
+  {
+    case 1 :
+        if (num_colors != 1)
+        {
+	  lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad BitsPerColor value %u.", header->cupsBitsPerColor);
+	  lint->results->errors ++;
+	  return (0);
+        }
+        else
+          lint_message(lint, DOCLINT_LEVEL_DEBUG, "BitsPerColor=1");
+	break;
+
+    case 8 :
+    case 16 :
+        lint_message(lint, DOCLINT_LEVEL_DEBUG, "BitsPerColor=%u", header->cupsBitsPerColor);
+        break;
+
+    default :
+        lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad BitsPerColor value %u.", header->cupsBitsPerColor);
+        lint->results->errors ++;
+        return (0);
+  }
+
+  if (header->cupsBitsPerPixel != (num_colors * header->cupsBitsPerColor))
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad BitsPerPixel value %u.", header->cupsBitsPerPixel);
+    lint->results->errors ++;
+    return (0);
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "BitsPerPixel=%u", header->cupsBitsPerPixel);
+
+  bytes_per_line = (header->cupsWidth * header->cupsBitsPerPixel + 7) / 8;
+
+  if (header->cupsBytesPerLine != bytes_per_line)
+  {
+    lint_message(lint, DOCLINT_LEVEL_ERROR, "Bad BytesPerLine value %u.", header->cupsBytesPerLine);
+    lint->results->errors ++;
+    return (0);
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "BytesPerLine=%u", header->cupsBytesPerLine);
+
+  if (header->cupsCompression != 0 || header->cupsRowCount != 0 || header->cupsRowFeed != 0 || header->cupsRowStep != 0)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Non-zero values present in Reserved[404-419] area.");
+    lint->results->warnings ++;
+  }
+
+  if (header->cupsBorderlessScalingFactor != 0 || header->cupsPageSize[0] != 0 || header->cupsPageSize[1] != 0 || header->cupsImagingBBox[0] != 0 || header->cupsImagingBBox[1] != 0 || header->cupsImagingBBox[2] != 0 || header->cupsImagingBBox[3] != 0)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Non-zero values present in Reserved[424-451] area.");
+    lint->results->warnings ++;
+  }
+
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "TotalPageCount=%u", header->cupsInteger[0]);
+
+  i = (int)header->cupsInteger[1];
+
+  if (i != 1 && i != -1)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad CrossFeedTransform value %d.", i);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "CrossFeedTransform=%d", i);
+
+  i = (int)header->cupsInteger[2];
+
+  if (i != 1 && i != -1)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad FeedTransform value %d.", i);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "FeedTransform=%d", i);
+
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "ImageBoxLeft=%u", header->cupsInteger[3]);
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "ImageBoxTop=%u", header->cupsInteger[4]);
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "ImageBoxRight=%u", header->cupsInteger[5]);
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "ImageBoxBottom=%u", header->cupsInteger[6]);
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "AlternatePrimary=0x%08x", header->cupsInteger[7]);
+
+  if (header->cupsInteger[8] == 1 || header->cupsInteger[8] == 2 || header->cupsInteger[8] > 5)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Bad PrintQuality value %u.", header->cupsInteger[8]);
+    lint->results->warnings ++;
+  }
+  else
+    lint_message(lint, DOCLINT_LEVEL_DEBUG, "PrintQuality=%u (%s)", header->cupsInteger[8], print_quality_enum[header->cupsInteger[8]]);
+
+  for (i = 9; i < 14; i ++)
+  {
+    if (header->cupsInteger[i] != 0)
+      break;
+  }
+
+  if (i < 14)
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Non-zero values present in Reserved[488-507] area.");
+    lint->results->warnings ++;
+  }
+
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "VendorIdentifier=%u", header->cupsInteger[14]);
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "VendorLength=%u", header->cupsInteger[15]);
+
+  if (header->cupsMarkerType[0] != 0 || memcmp(header->cupsMarkerType, header->cupsMarkerType + 1, sizeof(header->cupsMarkerType) - 1))
+  {
+    lint_message(lint, DOCLINT_LEVEL_WARNING, "Non-zero values present in Reserved[1604-1667] area.");
+    lint->results->warnings ++;
+  }
+
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "RenderingIntent=\"%s\"", header->cupsRenderingIntent);
+  lint_message(lint, DOCLINT_LEVEL_DEBUG, "PageSizeName=\"%s\"", header->cupsPageSizeName);
+
+  return (1);
+}
+
+
+/*
+ * 'read_raster_image()' - Read the raster page image...
+ *
+ * Each line is decoded into a line buffer (expanding runs with memset/memcpy)
+ * and then checked for blank/color one line at a time.  The page image has
+ * already been validated by 'index_raster_image()', so errors are only
+ * reported through the return value.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+read_raster_image(
+    lint_raster_t *r,			/* I - Raster stream */
+    lint_page_t   *p)			/* I - Page */
+{
+  cups_page_header_t *header = &p->header;
+					/* Page header */
+  int		ch;			/* Character from stream */
+  unsigned	height,			/* Height (lines) remaining */
+		width,			/* Width (columns/pixels) remaining */
+		repeat,			/* Line repeat value */
+		count,			/* Number of columns/pixels */
+		bytes,			/* Bytes in sequence */
+		bpp;			/* Bytes per pixel */
+  size_t	linesize;		/* Size of decoded line */
+  unsigned char	*line,			/* Line buffer */
+		*lineptr,		/* Pointer into line buffer */
+		*lineend,		/* End of line buffer */
+		pixel[LINT_MAX_BPP],	/* Repeated pixel */
+		white;			/* White color */
+  int		blank = 1,		/* Is the page blank? */
+		color = header->cupsNumColors > 4;
+					/* Is the page in color? */
+
+
+  if (header->cupsColorSpace == CUPS_CSPACE_W || header->cupsColorSpace == CUPS_CSPACE_RGB || header->cupsColorSpace == CUPS_CSPACE_SW || header->cupsColorSpace == CUPS_CSPACE_SRGB || header->cupsColorSpace == CUPS_CSPACE_ADOBERGB)
+    white = 0xff;
+  else
+    white = 0x00;
+
+  if (header->cupsBitsPerPixel == 1)
+  {
+    bpp      = 1;
+    linesize = (header->cupsWidth + 7) / 8;
+  }
+  else
+  {
+    bpp      = header->cupsBitsPerPixel / 8;
+    linesize = (size_t)header->cupsWidth * bpp;
+  }
+
+  if (bpp > LINT_MAX_BPP || (line = malloc(linesize)) == NULL)
+    return (0);
+
+  lineend = line + linesize;
+
+  for (height = header->cupsHeight; height > 0; height -= repeat)
+  {
+   /*
+    * Read the line repeat code...
+    */
+
+    if ((ch = raster_getc(r)) == EOF)
+    {
+      free(line);
+      return (0);
+    }
+
+    repeat = (unsigned)ch + 1;
+
+    if (repeat > height)
+    {
+      free(line);
+      return (0);
+    }
+
+    for (width = header->cupsWidth, lineptr = line; width > 0; width -= count)
+    {
+     /*
+      * Read the packbits code...
+      */
+
+      if ((ch = raster_getc(r)) == EOF)
+      {
+	free(line);
+	return (0);
+      }
+
+      if (ch == 0x80)
+      {
+       /*
+        * Clear to end of line...
+	*/
+
+        break;
+      }
+      else if (ch & 0x80)
+      {
+       /*
+        * Literal sequence...
+        */
+
+        count = 257 - (unsigned)ch;
+        bytes = count * bpp;
+      }
+      else
+      {
+       /*
+        * Repeat sequence...
+        */
+
+        count = (unsigned)ch + 1;
+        bytes = bpp;
+      }
+
+      if (header->cupsBitsPerPixel == 1)
+      {
+	count *= 8;
+	if (count > width && (count - width) < 8)
+	  count = width;
+      }
+
+      if (count > width)
+      {
+	free(line);
+	return (0);
+      }
+
+     /*
+      * Read a pixel fragment and expand it into the line buffer...
+      */
+
+      if (ch & 0x80)
+      {
+	if (bytes > (size_t)(lineend - lineptr) || raster_read(r, lineptr, bytes) < bytes)
+	{
+	  free(line);
+	  return (0);
+	}
+
+        lineptr += bytes;
+      }
+      else
+      {
+        size_t	runsize = header->cupsBitsPerPixel == 1 ? (size_t)ch + 1 : (size_t)count * bpp;
+					/* Bytes in run */
+
+	if (raster_read(r, pixel, bytes) < bytes)
+	{
+	  free(line);
+	  return (0);
+	}
+
+        if (runsize > (size_t)(lineend - lineptr))
+          runsize = (size_t)(lineend - lineptr);
+
+        if (bpp == 1)
+        {
+          memset(lineptr, pixel[0], runsize);
+        }
+        else if (runsize > 0)
+        {
+         /*
+          * Copy the pixel once and then keep doubling the copied area...
+          */
+
+          size_t	copied = bpp;	/* Bytes copied so far */
+
+          memcpy(lineptr, pixel, bpp);
+
+          while (copied < runsize)
+          {
+            size_t	chunk = copied < (runsize - copied) ? copied : runsize - copied;
+					/* Bytes to copy */
+
+            memcpy(lineptr + copied, lineptr, chunk);
+            copied += chunk;
+	  }
+        }
+
+        lineptr += runsize;
+      }
+    }
+
+   /*
+    * Anything not covered by the line data is white...
+    */
+
+    if (lineptr < lineend)
+      memset(lineptr, white, (size_t)(lineend - lineptr));
+
+   /*
+    * Check for blank/color...
+    */
+
+    if (blank && !raster_is_white(line, linesize, white))
+      blank = 0;
+
+    if (!color && header->cupsNumColors > 1 && !raster_is_gray(line, linesize, bpp, header->cupsBitsPerColor / 8, header->cupsNumColors))
+      color = 1;
+  }
+
+  p->blank = blank;
+  p->color = color;
+
+  free(line);
+
+  return (1);
+}
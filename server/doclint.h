@@ -0,0 +1,67 @@
+/*
+ * Header file for the document lint library used by ippdoclint and ippserver.
+ *
+ * Copyright © 2018-2022 by the Printer Working Group.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more
+ * information.
+ */
+
+#ifndef DOCLINT_H
+#  define DOCLINT_H
+
+
+/*
+ * Include necessary headers...
+ */
+
+#  include <cups/cups.h>
+#  include <stdbool.h>
+
+
+/*
+ * Types...
+ */
+
+typedef enum doclint_level_e		/**** Message Levels ****/
+{
+  DOCLINT_LEVEL_ERROR,			/* Error in the document */
+  DOCLINT_LEVEL_WARNING,		/* Non-fatal problem in the document */
+  DOCLINT_LEVEL_DEBUG			/* Debugging information */
+} doclint_level_t;
+
+typedef struct doclint_counters_s	/**** Page/Sheet/Etc. Counters ****/
+{
+  int	blank,				/* Number of blank pages/sheets/impressions */
+	full_color,			/* Number of color pages/sheets/impressions */
+	monochrome;			/* Number of monochrome pages/sheets/impressions */
+} doclint_counters_t;
+
+typedef struct doclint_results_s	/**** Document Lint Results ****/
+{
+  int			errors,		/* Number of errors found */
+			warnings;	/* Number of warnings found */
+  doclint_counters_t	impressions,	/* Number of one-sided impressions */
+			impressions_two_sided,
+					/* Number of two-sided impressions */
+			pages,		/* Number of input pages */
+			sheets;		/* Number of media sheets */
+} doclint_results_t;
+
+typedef void (*doclint_message_cb_t)(void *cb_data, doclint_level_t level, const char *message);
+					/**** Message callback ****/
+typedef void (*doclint_progress_cb_t)(void *cb_data, const doclint_results_t *results);
+					/**** Progress (counters) callback ****/
+
+
+/*
+ * Functions...
+ */
+
+extern bool		doclintFile(const char *filename, const char *content_type, size_t num_options, cups_option_t *options, doclint_message_cb_t message_cb, doclint_progress_cb_t progress_cb, void *cb_data, doclint_results_t *results);
+extern const char	*doclintGetContentType(const char *filename);
+extern bool		doclintIsSupported(const char *content_type);
+extern bool		doclintStream(int fd, const char *content_type, size_t num_options, cups_option_t *options, doclint_message_cb_t message_cb, doclint_progress_cb_t progress_cb, void *cb_data, doclint_results_t *results);
+
+
+#endif /* !DOCLINT_H */
@@ -3367,6 +3367,7 @@ ipp_delete_printer(
   serverLogPrinter(SERVER_LOGLEVEL_DEBUG, client->printer, "Removing printer %d from printers list.", client->printer->id);
 
   cupsArrayRemove(Printers, client->printer);
+  serverUpdatePrinterStatus(NULL);
 
   client->printer->is_deleted = 1;
 
@@ -3745,7 +3746,7 @@ ipp_fetch_document(
       ippAddString(client->response, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "compression", NULL, compression ? "gzip" : "none");
 
       if (httpGetState(client->http) != HTTP_STATE_POST_SEND)
-	httpFlush(client->http);	/* Flush trailing (junk) data */
+	serverFlushRequest(client);	/* Flush trailing (junk) data */
 
       serverLogAttributes(client, "Response:", client->response, 2);
 
@@ -4344,6 +4345,8 @@ ipp_get_notifications(
 
         serverLogClient(SERVER_LOGLEVEL_DEBUG, client, "Waiting for events.");
 
+        httpFlushWrite(client->http);	/* Send responses to earlier pipelined requests */
+
 	cupsMutexLock(&NotificationMutex);
 	cupsCondWait(&NotificationCondition, &NotificationMutex, 30.0);
 	cupsMutexUnlock(&NotificationMutex);
@@ -4508,7 +4511,7 @@ ipp_get_printer_resources(
     if (ippGetGroupTag(resource_formats) != IPP_TAG_OPERATION || ippGetValueTag(resource_formats) != IPP_TAG_MIMETYPE)
     {
       serverRespondUnsupported(client, resource_formats);
-      httpFlush(client->http);
+      serverFlushRequest(client);
       return;
     }
   }
@@ -4518,7 +4521,7 @@ ipp_get_printer_resources(
     if (ippGetGroupTag(resource_ids) != IPP_TAG_OPERATION || ippGetValueTag(resource_ids) != IPP_TAG_INTEGER)
     {
       serverRespondUnsupported(client, resource_ids);
-      httpFlush(client->http);
+      serverFlushRequest(client);
       return;
     }
   }
@@ -4528,7 +4531,7 @@ ipp_get_printer_resources(
     if (ippGetGroupTag(resource_states) != IPP_TAG_OPERATION || ippGetValueTag(resource_states) != IPP_TAG_ENUM)
     {
       serverRespondUnsupported(client, resource_states);
-      httpFlush(client->http);
+      serverFlushRequest(client);
       return;
     }
   }
@@ -4538,7 +4541,7 @@ ipp_get_printer_resources(
     if (ippGetGroupTag(resource_types) != IPP_TAG_OPERATION || ippGetValueTag(resource_types) != IPP_TAG_KEYWORD)
     {
       serverRespondUnsupported(client, resource_types);
-      httpFlush(client->http);
+      serverFlushRequest(client);
       return;
     }
   }
@@ -4950,7 +4953,7 @@ ipp_get_resources(
     if (ippGetGroupTag(resource_formats) != IPP_TAG_OPERATION || ippGetValueTag(resource_formats) != IPP_TAG_MIMETYPE)
     {
       serverRespondUnsupported(client, resource_formats);
-      httpFlush(client->http);
+      serverFlushRequest(client);
       return;
     }
   }
@@ -4960,7 +4963,7 @@ ipp_get_resources(
     if (ippGetGroupTag(resource_ids) != IPP_TAG_OPERATION || ippGetValueTag(resource_ids) != IPP_TAG_INTEGER)
     {
       serverRespondUnsupported(client, resource_ids);
-      httpFlush(client->http);
+      serverFlushRequest(client);
       return;
     }
   }
@@ -4970,7 +4973,7 @@ ipp_get_resources(
     if (ippGetGroupTag(resource_states) != IPP_TAG_OPERATION || ippGetValueTag(resource_states) != IPP_TAG_ENUM)
     {
       serverRespondUnsupported(client, resource_states);
-      httpFlush(client->http);
+      serverFlushRequest(client);
       return;
     }
   }
@@ -4980,7 +4983,7 @@ ipp_get_resources(
     if (ippGetGroupTag(resource_types) != IPP_TAG_OPERATION || ippGetValueTag(resource_types) != IPP_TAG_KEYWORD)
     {
       serverRespondUnsupported(client, resource_types);
-      httpFlush(client->http);
+      serverFlushRequest(client);
       return;
     }
   }
@@ -5618,6 +5621,8 @@ ipp_hold_new_jobs(
 
   cupsRWUnlock(&client->printer->rwlock);
 
+  serverUpdatePrinterStatus(client->printer);
+
   serverRespondIPP(client, IPP_STATUS_OK, NULL);
 }
 
@@ -5864,6 +5869,7 @@ ipp_print_job(server_client_t *client)	/* I - Client */
   char			filename[1024],	/* Filename buffer */
 			buffer[4096];	/* Copy buffer */
   ssize_t		bytes;		/* Bytes read */
+  server_lint_t		*lint;		/* Document check, if any */
   cups_array_t		*ra;		/* Attributes to send in response */
   ipp_attribute_t	*hold_until,	/* job-hold-until-xxx attribute, if any */
 			*doc_name;	/* document-name attribute, if any */
@@ -5951,6 +5957,8 @@ ipp_print_job(server_client_t *client)	/* I - Client */
     return;
   }
 
+  lint = serverStartLint(job);
+
   while ((bytes = httpRead(client->http, buffer, sizeof(buffer))) > 0)
   {
     if (write(job->fd, buffer, (size_t)bytes) < bytes)
@@ -5963,11 +5971,15 @@ ipp_print_job(server_client_t *client)	/* I - Client */
       job->fd = -1;
 
       unlink(filename);
+      serverFinishLint(lint);
 
       serverRespondIPP(client, IPP_STATUS_ERROR_INTERNAL,
                   "Unable to write print file: %s", strerror(error));
       return;
     }
+
+    if (!serverWriteLint(lint, buffer, (size_t)bytes))
+      break;
   }
 
   if (bytes < 0)
@@ -5982,12 +5994,33 @@ ipp_print_job(server_client_t *client)	/* I - Client */
     job->fd = -1;
 
     unlink(filename);
+    serverFinishLint(lint);
 
     serverRespondIPP(client, IPP_STATUS_ERROR_INTERNAL,
                 "Unable to read print file.");
     return;
   }
 
+  if (!serverFinishLint(lint))
+  {
+   /*
+    * The document has errors, so reject it without reading the rest...
+    */
+
+    job->state         = IPP_JSTATE_ABORTED;
+    job->state_reasons |= SERVER_JREASON_DOCUMENT_FORMAT_ERROR;
+
+    close(job->fd);
+    job->fd = -1;
+
+    unlink(filename);
+
+    serverRespondIPP(client, IPP_STATUS_ERROR_DOCUMENT_FORMAT_ERROR,
+                "Document has errors.");
+    serverFlushRequest(client);
+    return;
+  }
+
   if (close(job->fd))
   {
     int error = errno;		/* Write error */
@@ -6356,6 +6389,8 @@ ipp_release_held_new_jobs(
 
   cupsRWUnlock(&client->printer->rwlock);
 
+  serverUpdatePrinterStatus(client->printer);
+
   serverRespondIPP(client, IPP_STATUS_OK, NULL);
 }
 
@@ -6652,6 +6687,7 @@ ipp_send_document(server_client_t *client)/* I - Client */
   char			filename[1024],	/* Filename buffer */
 			buffer[4096];	/* Copy buffer */
   ssize_t		bytes;		/* Bytes read */
+  server_lint_t		*lint;		/* Document check, if any */
   ipp_attribute_t	*attr;		/* Current attribute */
   cups_array_t		*ra;		/* Attributes to send in response */
 
@@ -6673,14 +6709,14 @@ ipp_send_document(server_client_t *client)/* I - Client */
   if ((job = serverFindJob(client, 0)) == NULL)
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_NOT_FOUND, "Job does not exist.");
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
   if (Authentication && !serverAuthorizeUser(client, job->username, SERVER_GROUP_NONE, JobPrivacyScope))
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_NOT_AUTHORIZED, "Not authorized to access this job.");
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
@@ -6693,14 +6729,14 @@ ipp_send_document(server_client_t *client)/* I - Client */
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_NOT_POSSIBLE,
                 "Job is not in a pending state.");
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
   else if (job->filename || job->fd >= 0)
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_MULTIPLE_JOBS_NOT_SUPPORTED,
                 "Multiple document jobs are not supported.");
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
@@ -6709,14 +6745,14 @@ ipp_send_document(server_client_t *client)/* I - Client */
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_BAD_REQUEST,
                 "Missing required last-document attribute.");
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
   else if (ippGetValueTag(attr) != IPP_TAG_BOOLEAN || ippGetCount(attr) != 1 ||
            !ippGetBoolean(attr, 0))
   {
     serverRespondUnsupported(client, attr);
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
@@ -6726,7 +6762,7 @@ ipp_send_document(server_client_t *client)/* I - Client */
 
   if (!valid_doc_attributes(client))
   {
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
@@ -6769,6 +6805,8 @@ ipp_send_document(server_client_t *client)/* I - Client */
     return;
   }
 
+  lint = serverStartLint(job);
+
   while ((bytes = httpRead(client->http, buffer, sizeof(buffer))) > 0)
   {
     if (write(job->fd, buffer, (size_t)bytes) < bytes)
@@ -6781,11 +6819,15 @@ ipp_send_document(server_client_t *client)/* I - Client */
       job->fd = -1;
 
       unlink(filename);
+      serverFinishLint(lint);
 
       serverRespondIPP(client, IPP_STATUS_ERROR_INTERNAL,
                   "Unable to write print file: %s", strerror(error));
       return;
     }
+
+    if (!serverWriteLint(lint, buffer, (size_t)bytes))
+      break;
   }
 
   if (bytes < 0)
@@ -6800,12 +6842,33 @@ ipp_send_document(server_client_t *client)/* I - Client */
     job->fd = -1;
 
     unlink(filename);
+    serverFinishLint(lint);
 
     serverRespondIPP(client, IPP_STATUS_ERROR_INTERNAL,
                 "Unable to read print file.");
     return;
   }
 
+  if (!serverFinishLint(lint))
+  {
+   /*
+    * The document has errors, so reject it without reading the rest...
+    */
+
+    job->state         = IPP_JSTATE_ABORTED;
+    job->state_reasons |= SERVER_JREASON_DOCUMENT_FORMAT_ERROR;
+
+    close(job->fd);
+    job->fd = -1;
+
+    unlink(filename);
+
+    serverRespondIPP(client, IPP_STATUS_ERROR_DOCUMENT_FORMAT_ERROR,
+                "Document has errors.");
+    serverFlushRequest(client);
+    return;
+  }
+
   if (close(job->fd))
   {
     int error = errno;			/* Write error */
@@ -6898,51 +6961,51 @@ ipp_send_resource_data(
   if ((attr = ippFindAttribute(client->request, "resource-id", IPP_TAG_ZERO)) == NULL)
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_BAD_REQUEST, "Missing required 'resource-id' attribute.");
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
   else if (ippGetGroupTag(attr) != IPP_TAG_OPERATION || ippGetValueTag(attr) != IPP_TAG_INTEGER || ippGetCount(attr) != 1 || (resource_id = ippGetInteger(attr, 0)) < 1)
   {
     serverRespondUnsupported(client, attr);
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
   else if ((resource = serverFindResourceById(resource_id)) == NULL)
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_NOT_FOUND, "Resource #%d not found.", resource_id);
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
   else if (resource->state != IPP_RSTATE_PENDING)
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_NOT_POSSIBLE, "Resource #%d is not in the pending state.", resource_id);
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
   else if (resource->fd >= 0)
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_NOT_POSSIBLE, "Resource #%d is already incoming.", resource_id);
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
   if ((attr = ippFindAttribute(client->request, "resource-format", IPP_TAG_ZERO)) == NULL)
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_BAD_REQUEST, "Missing required 'resource-format' attribute.");
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
   else if (ippGetGroupTag(attr) != IPP_TAG_OPERATION || ippGetValueTag(attr) != IPP_TAG_MIMETYPE || ippGetCount(attr) != 1 || (format = ippGetString(attr, 0, NULL)) == NULL || (strcmp(format, "application/ipp") && strcmp(format, "application/pdf") && strcmp(format, "application/vnd.iccprofile") && strcmp(format, "image/jpeg") && strcmp(format, "image/png") && strcmp(format, "text/strings")))
   {
     serverRespondUnsupported(client, attr);
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
   if ((signature = ippFindAttribute(client->request, "resource-signature", IPP_TAG_ZERO)) != NULL && (ippGetGroupTag(signature) != IPP_TAG_OPERATION || ippGetValueTag(signature) != IPP_TAG_STRING))
   {
     serverRespondUnsupported(client, attr);
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
@@ -6960,7 +7023,7 @@ ipp_send_resource_data(
 
     serverSetResourceState(resource, IPP_RSTATE_ABORTED, "Unable to create resource file: %s", strerror(error));
     serverRespondIPP(client, IPP_STATUS_ERROR_INTERNAL, "Unable to create resource file: %s", strerror(error));
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
@@ -6976,7 +7039,7 @@ ipp_send_resource_data(
 
       serverSetResourceState(resource, IPP_RSTATE_ABORTED, "Unable to write resource file: %s", strerror(error));
       serverRespondIPP(client, IPP_STATUS_ERROR_INTERNAL, "Unable to write resource file: %s", strerror(error));
-      httpFlush(client->http);
+      serverFlushRequest(client);
       return;
     }
   }
@@ -7070,7 +7133,7 @@ ipp_send_uri(server_client_t *client)	/* I - Client */
   if ((job = serverFindJob(client, 0)) == NULL)
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_NOT_FOUND, "Job does not exist.");
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
@@ -7089,14 +7152,14 @@ ipp_send_uri(server_client_t *client)	/* I - Client */
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_NOT_POSSIBLE,
                 "Job is not in a pending state.");
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
   else if (job->filename || job->fd >= 0)
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_MULTIPLE_JOBS_NOT_SUPPORTED,
                 "Multiple document jobs are not supported.");
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
@@ -7105,14 +7168,14 @@ ipp_send_uri(server_client_t *client)	/* I - Client */
   {
     serverRespondIPP(client, IPP_STATUS_ERROR_BAD_REQUEST,
                 "Missing required last-document attribute.");
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
   else if (ippGetValueTag(attr) != IPP_TAG_BOOLEAN || ippGetCount(attr) != 1 ||
            !ippGetBoolean(attr, 0))
   {
     serverRespondUnsupported(client, attr);
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
@@ -7122,7 +7185,7 @@ ipp_send_uri(server_client_t *client)	/* I - Client */
 
   if (!valid_doc_attributes(client))
   {
-    httpFlush(client->http);
+    serverFlushRequest(client);
     return;
   }
 
@@ -7849,6 +7912,8 @@ ipp_shutdown_all_printers(
       printer->state = IPP_PSTATE_STOPPED;
 
     cupsRWUnlock(&printer->rwlock);
+
+    serverUpdatePrinterStatus(printer);
   }
 
   cupsRWUnlock(&PrintersRWLock);
@@ -7896,6 +7961,8 @@ ipp_shutdown_printer(
 
   cupsRWUnlock(&client->printer->rwlock);
 
+  serverUpdatePrinterStatus(client->printer);
+
   serverRespondIPP(client, IPP_STATUS_OK, NULL);
 }
 
@@ -7965,6 +8032,8 @@ ipp_startup_all_printers(
 	serverCheckJobs(printer);
       }
     }
+
+    serverUpdatePrinterStatus(printer);
   }
 
   cupsRWUnlock(&PrintersRWLock);
@@ -8030,6 +8099,8 @@ ipp_startup_printer(
     }
   }
 
+  serverUpdatePrinterStatus(client->printer);
+
   serverRespondIPP(client, IPP_STATUS_OK, NULL);
 }
 
@@ -9361,7 +9432,7 @@ serverProcessIPP(
   if (httpGetState(client->http) != HTTP_STATE_WAITING)
   {
     if (httpGetState(client->http) != HTTP_STATE_POST_SEND)
-      httpFlush(client->http);		/* Flush trailing (junk) data */
+      serverFlushRequest(client);	/* Flush trailing (junk) data */
 
     serverLogAttributes(client, "Response:", client->response, 2);
 
@@ -389,6 +389,8 @@ typedef struct server_filter_s		/**** Attribute filter ****/
 
 typedef struct server_job_s server_job_t;
 
+typedef struct server_lint_s server_lint_t;
+
 typedef struct server_device_s		/**** Output Device data ****/
 {
   cups_rwlock_t		rwlock;		/* Printer lock */
@@ -469,6 +471,8 @@ typedef struct server_printer_s		/**** Printer data ****/
   server_preason_t	state_reasons,	/* printer-state-reasons values */
 			dev_reasons;	/* Current device printer-state-reasons values */
   time_t		state_time;	/* printer-state-change-time */
+  int			status_version;	/* Web status version */
+  time_t		status_time;	/* Web status change time */
   cups_array_t		*jobs,		/* Jobs */
 			*active_jobs,	/* Active jobs */
 			*completed_jobs;/* Completed jobs */
@@ -571,19 +575,24 @@ typedef struct server_client_s		/**** Client data ****/
 			username[32],	/* Client authenticated username */
 			host_field[256];/* Host: hostname */
   int			host_port;	/* Host: port number */
+  bool			is_local;	/* Connected over a UNIX domain socket? */
   server_printer_t	*printer;	/* Printer */
   server_job_t		*job;		/* Current job, if any */
   server_resource_t	*resource;	/* Current resource, if any */
   int			fetch_compression,
 					/* Compress file? */
 			fetch_file;	/* File to fetch */
+  time_t		last_modified;	/* Last-Modified time for response, if any */
+  char			*html;		/* Buffered web page, if any */
+  size_t		html_length,	/* Length of buffered web page */
+			html_size;	/* Size of web page buffer */
 } server_client_t;
 
 typedef struct server_listener_s	/**** Listener data ****/
 {
   int			fd;		/* Listener socket */
-  char			host[256];	/* Hostname, if any */
-  int			port;		/* Port number */
+  char			host[256];	/* Hostname or socket path, if any */
+  int			port;		/* Port number (0 for UNIX domain sockets) */
 } server_listener_t;
 
 
@@ -621,6 +630,9 @@ VAR time_t		SystemStartTime,
 VAR int			SystemConfigChanges VALUE(0);
 VAR size_t		SystemNumSettings VALUE(0);
 VAR cups_option_t	*SystemSettings	VALUE(NULL);
+VAR cups_mutex_t	SystemStatusMutex VALUE(CUPS_MUTEX_INITIALIZER);
+VAR int			SystemStatusVersion VALUE(0);
+VAR time_t		SystemStatusTime VALUE(0);
 
 VAR char		*BinDir		VALUE(NULL);
 VAR char		*ConfigDirectory VALUE(NULL);
@@ -640,6 +652,7 @@ VAR int			MaxJobs		VALUE(100),
 VAR cups_array_t	*Printers	VALUE(NULL);
 VAR cups_rwlock_t	PrintersRWLock	VALUE(CUPS_RWLOCK_INITIALIZER);
 VAR int			RelaxedConformance VALUE(0);
+VAR char		**ServerArgv	VALUE(NULL);
 VAR char		*ServerName	VALUE(NULL);
 VAR char		*SpoolDirectory	VALUE(NULL);
 VAR char		*StateDirectory	VALUE(NULL);
@@ -673,6 +686,7 @@ extern void		serverAddEventNoLock(server_printer_t *printer, server_job_t *job,
 extern void		serverAddPrinter(server_printer_t *printer);
 extern void		serverAddResourceFile(server_resource_t *res, const char *filename, const char *format);
 extern void		serverAddStringsFileNoLock(server_printer_t *printer, const char *language, server_resource_t *resource);
+extern void		serverAddWebEventNoLock(server_printer_t *printer, server_job_t *job, server_event_t event);
 extern void		serverAllocatePrinterResource(server_printer_t *printer, server_resource_t *resource);
 extern http_status_t	serverAuthenticateClient(server_client_t *client);
 extern int		serverAuthorizeUser(server_client_t *client, const char *owner, gid_t group, const char *scope);
@@ -709,11 +723,14 @@ extern server_resource_t *serverFindResourceById(int id);
 extern server_resource_t *serverFindResourceByPath(const char *resource);
 extern server_resource_t *serverFindResourceByFilename(const char *filename);
 extern server_subscription_t *serverFindSubscription(server_client_t *client, int sub_id);
+extern bool		serverFinishLint(server_lint_t *lint);
+extern void		serverFlushRequest(server_client_t *client);
 extern server_jreason_t	serverGetJobStateReasonsBits(ipp_attribute_t *attr);
 extern server_event_t	serverGetNotifyEventsBits(ipp_attribute_t *attr);
 extern const char	*serverGetNotifySubscribedEvent(server_event_t event);
 extern server_preason_t	serverGetPrinterStateReasonsBits(ipp_attribute_t *attr);
 extern int		serverHoldJob(server_job_t *job, ipp_attribute_t *hold_until);
+extern size_t		serverInheritListeners(void);
 extern int		serverLoadAttributes(const char *filename, server_pinfo_t *pinfo);
 extern void		serverLog(server_loglevel_t level, const char *format, ...) _CUPS_FORMAT(2, 3);
 extern void		serverLogAttributes(server_client_t *client, const char *title, ipp_t *ipp, int type);
@@ -736,12 +753,15 @@ extern void		serverResumePrinter(server_printer_t *printer);
 extern void		serverRun(void);
 extern void		serverSaveSystem(void);
 extern void		serverSetResourceState(server_resource_t *resource, ipp_rstate_t state, const char *message, ...) _CUPS_FORMAT(3, 4);
+extern server_lint_t	*serverStartLint(server_job_t *job);
 extern void		serverStopJob(server_job_t *job);
 extern char		*serverTimeString(time_t tv, char *buffer, size_t bufsize);
 extern int		serverTransformJob(server_client_t *client, server_job_t *job, const char *command, const char *format, server_transform_t mode);
 extern void		serverUnregisterPrinter(server_printer_t *printer);
 extern void		serverUpdateDeviceAttributesNoLock(server_printer_t *printer);
 extern void		serverUpdateDeviceStateNoLock(server_printer_t *printer);
+extern void		serverUpdatePrinterStatus(server_printer_t *printer);
+extern bool		serverWriteLint(server_lint_t *lint, const void *buffer, size_t bytes);
 
 
 #endif // !IPPSERVER_H
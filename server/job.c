@@ -136,6 +136,8 @@ serverCleanJobs(server_printer_t *printer)	/* I - Printer */
       serverLogJob(SERVER_LOGLEVEL_DEBUG, job, "Cleaning job #%d.", job->id);
       cupsArrayRemove(printer->completed_jobs, job);
       cupsArrayRemove(printer->jobs, job); /* Last since removing a job from here calls serverDeleteJob() */
+
+      serverUpdatePrinterStatus(printer);
     }
     else if (job->completed)
       serverLogJob(SERVER_LOGLEVEL_DEBUG, job, "Not cleaning job #%d - completed on %ld.", job->id, (long)job->completed);
@@ -297,6 +299,8 @@ serverCreateJob(
   cupsArrayAdd(client->printer->jobs, job);
   cupsArrayAdd(client->printer->active_jobs, job);
 
+  serverUpdatePrinterStatus(client->printer);
+
   cupsRWUnlock(&(client->printer->rwlock));
 
   return (job);
@@ -648,15 +652,24 @@ serverProcessJob(server_job_t *job)	/* I - Job */
   while (job->printer->state_reasons & SERVER_PREASON_MEDIA_EMPTY)
   {
     cupsRWLockWrite(&job->printer->rwlock);
-    job->printer->state_reasons |= SERVER_PREASON_MEDIA_NEEDED;
+    if (!(job->printer->state_reasons & SERVER_PREASON_MEDIA_NEEDED))
+    {
+      job->printer->state_reasons |= SERVER_PREASON_MEDIA_NEEDED;
+      serverUpdatePrinterStatus(job->printer);
+    }
     cupsRWUnlock(&job->printer->rwlock);
 
     sleep(1);
   }
 
-  cupsRWLockWrite(&job->printer->rwlock);
-  job->printer->state_reasons &= (server_preason_t)~SERVER_PREASON_MEDIA_NEEDED;
-  cupsRWUnlock(&job->printer->rwlock);
+  if (job->printer->state_reasons & SERVER_PREASON_MEDIA_NEEDED)
+  {
+    cupsRWLockWrite(&job->printer->rwlock);
+    job->printer->state_reasons &= (server_preason_t)~SERVER_PREASON_MEDIA_NEEDED;
+    cupsRWUnlock(&job->printer->rwlock);
+
+    serverUpdatePrinterStatus(job->printer);
+  }
 
   if (job->printer->pinfo.command)
   {
@@ -39,6 +39,8 @@ main(int  argc,				/* I - Number of command-line args */
   * Parse command-line arguments...
   */
 
+  ServerArgv = argv;
+
   memset(&pinfo, 0, sizeof(pinfo));
   pinfo.print_group = SERVER_GROUP_NONE;
   pinfo.proxy_group = SERVER_GROUP_NONE;
@@ -831,6 +831,7 @@ serverCreatePrinter(
   printer->state          = IPP_PSTATE_STOPPED;
   printer->state_reasons  = SERVER_PREASON_PAUSED;
   printer->state_time     = printer->start_time;
+  printer->status_time    = printer->start_time;
   printer->jobs           = cupsArrayNew((cups_array_cb_t)compare_jobs, NULL, NULL, 0, NULL, (cups_afree_cb_t)serverDeleteJob);
   printer->active_jobs    = cupsArrayNew((cups_array_cb_t)compare_active_jobs, NULL, NULL, 0, NULL, NULL);
   printer->completed_jobs = cupsArrayNew((cups_array_cb_t)compare_completed_jobs, NULL, NULL, 0, NULL, NULL);
@@ -2331,6 +2332,37 @@ serverUnregisterPrinter(
 }
 
 
+/*
+ * 'serverUpdatePrinterStatus()' - Note a change to the status of a printer or
+ *                                 its jobs.
+ *
+ * The web interface uses the status version to cache rendered pages and the
+ * status time for the Last-Modified header.  Pass `NULL` when printers are
+ * added or removed.
+ */
+
+void
+serverUpdatePrinterStatus(
+    server_printer_t *printer)		/* I - Printer or `NULL` for system */
+{
+  time_t	curtime = time(NULL);	/* Current time */
+
+
+  cupsMutexLock(&SystemStatusMutex);
+
+  if (printer)
+  {
+    printer->status_version ++;
+    printer->status_time = curtime;
+  }
+
+  SystemStatusVersion ++;
+  SystemStatusTime = curtime;
+
+  cupsMutexUnlock(&SystemStatusMutex);
+}
+
+
 /*
  * 'compare_active_jobs()' - Compare two active jobs.
  */
@@ -51,6 +51,12 @@ serverAddEventNoLock(
 
   serverLog(SERVER_LOGLEVEL_DEBUG, "serverAddEventNoLock(printer=%p(%s), job=%p(%d), event=0x%x, message=\"%s\")", (void *)printer, printer ? printer->name : "(null)", (void *)job, job ? job->id : -1, event, text);
 
+  if (printer || job)
+  {
+    serverUpdatePrinterStatus(printer ? printer : job->printer);
+    serverAddWebEventNoLock(printer ? printer : job->printer, job, event);
+  }
+
   cupsRWLockRead(&SubscriptionsRWLock);
 
   for (sub = (server_subscription_t *)cupsArrayGetFirst(Subscriptions); sub; sub = (server_subscription_t *)cupsArrayGetNext(Subscriptions))
@@ -9,6 +9,7 @@
  */
 
 #include "ippserver.h"
+#include "doclint.h"
 
 #ifdef _WIN32
 #  include <sys/timeb.h>
@@ -18,6 +19,26 @@
 #endif /* _WIN32 */
 
 
+/*
+ * Local types...
+ */
+
+struct server_lint_s			/**** Document check while receiving ****/
+{
+  server_job_t		*job;		/* Job */
+  int			fd,		/* Pipe to lint thread */
+			read_fd;	/* Read end of pipe for lint thread */
+  cups_thread_t		thread;		/* Lint thread */
+  cups_mutex_t		mutex;		/* Mutex for error count */
+  int			errors;		/* Number of errors seen so far */
+  bool			failed,		/* Unable to send data to the thread? */
+			ok;		/* Was the document OK? */
+  size_t		num_options;	/* Number of options */
+  cups_option_t		*options;	/* Options */
+  doclint_results_t	results;	/* Lint results */
+};
+
+
 /*
  * Local functions...
  */
@@ -25,11 +46,138 @@
 #ifdef _WIN32
 static int	asprintf(char **s, const char *format, ...);
 #endif /* _WIN32 */
+static size_t	lint_add_options(ipp_t *ipp, bool defaults, size_t num_options, cups_option_t **options);
+static int	lint_job(server_job_t *job);
+static void	lint_message(server_job_t *job, doclint_level_t level, const char *message);
+static size_t	lint_options(server_job_t *job, cups_option_t **options);
+static void	lint_progress(server_job_t *job, const doclint_results_t *results);
+#ifndef _WIN32
+static void	*lint_stream(server_lint_t *lint);
+static void	lint_stream_message(server_lint_t *lint, doclint_level_t level, const char *message);
+#endif /* !_WIN32 */
 static void	process_attr_message(server_job_t *job, char *message, server_transform_t mode);
 static void	process_state_message(server_job_t *job, char *message);
 static double	time_seconds(void);
 
 
+/*
+ * 'serverFinishLint()' - Finish checking a document while receiving it.
+ *
+ * The pipe to the lint thread is closed and the thread is waited for, so this
+ * must be called once for every non-`NULL` value from 'serverStartLint()'.
+ */
+
+bool					/* O - `true` if the document is OK, `false` otherwise */
+serverFinishLint(server_lint_t *lint)	/* I - Lint data or `NULL` */
+{
+  bool	ok;				/* Was the document OK? */
+
+
+  if (!lint)
+    return (true);
+
+#ifdef _WIN32
+  ok = true;
+
+#else
+  if (lint->fd >= 0)
+    close(lint->fd);
+
+  cupsThreadWait(lint->thread);
+
+ /*
+  * If the data could not be sent to the thread, leave the document to be
+  * checked by the "ippdoclint" command as usual...
+  */
+
+  ok = lint->ok || lint->failed;
+
+  if (!ok)
+    serverLogJob(SERVER_LOGLEVEL_ERROR, lint->job, "Document failed checks with %d error(s) and %d warning(s).", lint->results.errors, lint->results.warnings);
+
+  cupsMutexDestroy(&lint->mutex);
+  cupsFreeOptions(lint->num_options, lint->options);
+#endif /* _WIN32 */
+
+  free(lint);
+
+  return (ok);
+}
+
+
+/*
+ * 'serverStartLint()' - Start checking a document while receiving it.
+ *
+ * Documents are only checked as they are received when the printer uses the
+ * "ippdoclint" command and the format can be checked as a stream (PDF cannot).
+ * The document data is then passed to 'serverWriteLint()' as it is received.
+ */
+
+server_lint_t *				/* O - Lint data or `NULL` if not checking */
+serverStartLint(server_job_t *job)	/* I - Job */
+{
+#ifdef _WIN32
+  (void)job;
+
+  return (NULL);
+
+#else
+  server_lint_t	*lint;			/* Lint data */
+  const char	*command = job->printer->pinfo.command,
+					/* Command to run */
+		*base;			/* Base name of command */
+  int		fds[2];			/* Pipe */
+
+
+  if (!command || !job->format || !doclintIsSupported(job->format) || !strcmp(job->format, "application/pdf"))
+    return (NULL);
+
+  if ((base = strrchr(command, '/')) != NULL)
+    base ++;
+  else
+    base = command;
+
+  if (strcmp(base, "ippdoclint"))
+    return (NULL);
+
+  if ((lint = calloc(1, sizeof(server_lint_t))) == NULL)
+  {
+    serverLogJob(SERVER_LOGLEVEL_ERROR, job, "Unable to allocate memory for document check: %s", strerror(errno));
+    return (NULL);
+  }
+
+  if (pipe(fds))
+  {
+    serverLogJob(SERVER_LOGLEVEL_ERROR, job, "Unable to create pipe for document check: %s", strerror(errno));
+    free(lint);
+    return (NULL);
+  }
+
+  lint->job         = job;
+  lint->fd          = fds[1];
+  lint->read_fd     = fds[0];
+  lint->num_options = lint_options(job, &lint->options);
+
+  cupsMutexInit(&lint->mutex);
+
+  if ((lint->thread = cupsThreadCreate((cups_thread_func_t)lint_stream, lint)) == 0)
+  {
+    serverLogJob(SERVER_LOGLEVEL_ERROR, job, "Unable to create document check thread: %s", strerror(errno));
+    close(fds[0]);
+    close(fds[1]);
+    cupsMutexDestroy(&lint->mutex);
+    cupsFreeOptions(lint->num_options, lint->options);
+    free(lint);
+    return (NULL);
+  }
+
+  serverLogJob(SERVER_LOGLEVEL_DEBUG, job, "Checking document in-process while receiving it.");
+
+  return (lint);
+#endif /* _WIN32 */
+}
+
+
 /*
  * 'serverStopJob()' - Stop processing/transforming a job.
  */
@@ -76,6 +224,7 @@ serverTransformJob(
 		*myenvp[400];		/* Environment variables */
   int		myenvc;			/* Number of environment variables */
   ipp_attribute_t *attr;		/* Job attribute */
+  const char	*base;			/* Base name of command */
   char		val[1280],		/* IPP_NAME=value */
                 *valptr,		/* Pointer into string */
                 fullcommand[1024];	/* Full command path */
@@ -97,6 +246,20 @@ serverTransformJob(
 #endif /* _WIN32 */
 
 
+  if ((base = strrchr(command, '/')) != NULL)
+    base ++;
+  else
+    base = command;
+
+  if (mode == SERVER_TRANSFORM_COMMAND && !strcmp(base, "ippdoclint") && job->format && doclintIsSupported(job->format))
+  {
+   /*
+    * Check the document in-process rather than running ippdoclint...
+    */
+
+    return (lint_job(job));
+  }
+
   if (command[0] != '/')
   {
     snprintf(fullcommand, sizeof(fullcommand), "%s/%s", BinDir, command);
@@ -527,6 +690,66 @@ serverTransformJob(
 }
 
 
+/*
+ * 'serverWriteLint()' - Send received document data to the document check.
+ *
+ * Errors are reported as soon as the lint thread sees them, so the caller can
+ * stop receiving a bad document early.
+ */
+
+bool					/* O - `true` to keep going, `false` if the document has errors */
+serverWriteLint(server_lint_t *lint,	/* I - Lint data or `NULL` */
+                const void    *buffer,	/* I - Document data */
+                size_t        bytes)	/* I - Number of bytes */
+{
+#ifdef _WIN32
+  (void)lint;
+  (void)buffer;
+  (void)bytes;
+
+  return (true);
+
+#else
+  const char	*ptr = (const char *)buffer;
+					/* Pointer into buffer */
+  ssize_t	written;		/* Bytes written */
+  int		errors;			/* Errors seen so far */
+
+
+  if (!lint || lint->fd < 0)
+    return (true);
+
+  cupsMutexLock(&lint->mutex);
+  errors = lint->errors;
+  cupsMutexUnlock(&lint->mutex);
+
+  if (errors)
+    return (false);
+
+  while (bytes > 0)
+  {
+    if ((written = write(lint->fd, ptr, bytes)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      serverLogJob(SERVER_LOGLEVEL_ERROR, lint->job, "Unable to send document data to check: %s", strerror(errno));
+
+      close(lint->fd);
+      lint->fd     = -1;
+      lint->failed = true;
+      break;
+    }
+
+    ptr   += written;
+    bytes -= (size_t)written;
+  }
+
+  return (true);
+#endif /* _WIN32 */
+}
+
+
 #ifdef _WIN32
 /*
  * 'asprintf()' - Format and allocate a string.
@@ -556,6 +779,204 @@ asprintf(char       **s,		/* O - Allocated string or `NULL` on error */
 #endif /* _WIN32 */
 
 
+/*
+ * 'lint_add_options()' - Add attributes as options for the document lint library.
+ *
+ * When "defaults" is `true`, only "xxx-default" attributes are added as "xxx"
+ * and only if "xxx" has not already been set.  Otherwise all attributes are
+ * added unless already set.
+ */
+
+static size_t				/* O - Number of options */
+lint_add_options(
+    ipp_t         *ipp,			/* I - Attributes */
+    bool          defaults,		/* I - Add "xxx-default" attributes? */
+    size_t        num_options,		/* I - Number of options */
+    cups_option_t **options)		/* IO - Options */
+{
+  ipp_attribute_t *attr;		/* Current attribute */
+  const char	*name,			/* Attribute name */
+		*suffix;		/* Suffix on attribute name */
+  char		optname[256],		/* Option name */
+		value[1024];		/* Option value */
+
+
+  for (attr = ippGetFirstAttribute(ipp); attr; attr = ippGetNextAttribute(ipp))
+  {
+    if ((name = ippGetName(attr)) == NULL)
+      continue;
+
+    cupsCopyString(optname, name, sizeof(optname));
+
+    if (defaults)
+    {
+      if ((suffix = strstr(optname, "-default")) == NULL || suffix[8])
+        continue;
+
+      optname[suffix - optname] = '\0';
+    }
+
+    if (cupsGetOption(optname, num_options, *options))
+      continue;
+
+    ippAttributeString(attr, value, sizeof(value));
+    num_options = cupsAddOption(optname, value, num_options, options);
+  }
+
+  return (num_options);
+}
+
+
+/*
+ * 'lint_job()' - Check a job's document in-process with the document lint library.
+ *
+ * This is used in place of running the "ippdoclint" command so that no
+ * process or environment needs to be created for each job.  Messages are
+ * logged and the counters are applied as if they came from the command.
+ */
+
+static int				/* O - 0 on success, non-zero on error */
+lint_job(server_job_t *job)		/* I - Job */
+{
+  size_t	num_options;		/* Number of options */
+  cups_option_t	*options;		/* Options */
+  doclint_results_t results;		/* Lint results */
+  bool		ok;			/* Was the document OK? */
+  double	start;			/* Start time */
+  char		state[] = "STATE: +document-format-error";
+					/* State message for bad documents */
+
+
+  serverLogJob(SERVER_LOGLEVEL_DEBUG, job, "Checking document \"%s\" in-process.", job->filename);
+  start = time_seconds();
+
+  num_options = lint_options(job, &options);
+
+  ok = doclintFile(job->filename, job->format, num_options, options, (doclint_message_cb_t)lint_message, (doclint_progress_cb_t)lint_progress, job, &results);
+
+  cupsFreeOptions(num_options, options);
+
+  if (results.errors)
+    process_state_message(job, state);
+
+  serverLogJob(SERVER_LOGLEVEL_DEBUG, job, "Total transform time is %.3f seconds.", time_seconds() - start);
+
+  if (!ok)
+    serverLogJob(SERVER_LOGLEVEL_ERROR, job, "Document failed checks with %d error(s) and %d warning(s).", results.errors, results.warnings);
+
+  return (ok ? 0 : 1);
+}
+
+
+/*
+ * 'lint_message()' - Log a message from the document lint library.
+ */
+
+static void
+lint_message(server_job_t    *job,	/* I - Job */
+             doclint_level_t level,	/* I - Message level */
+             const char      *message)	/* I - Message */
+{
+  serverLogJob(level == DOCLINT_LEVEL_ERROR ? SERVER_LOGLEVEL_ERROR : level == DOCLINT_LEVEL_WARNING ? SERVER_LOGLEVEL_INFO : SERVER_LOGLEVEL_DEBUG, job, "ippdoclint: %s", message);
+}
+
+
+/*
+ * 'lint_options()' - Collect the options for checking a job's document.
+ *
+ * Document attributes override Job attributes, which override the Printer
+ * defaults, just like the IPP_xxx environment variables for commands.
+ */
+
+static size_t				/* O - Number of options */
+lint_options(server_job_t  *job,	/* I - Job */
+             cups_option_t **options)	/* O - Options */
+{
+  size_t	num_options = 0;	/* Number of options */
+
+
+  *options = NULL;
+
+  num_options = lint_add_options(job->doc_attrs, false, num_options, options);
+  num_options = lint_add_options(job->attrs, false, num_options, options);
+  num_options = lint_add_options(job->printer->dev_attrs, true, num_options, options);
+  num_options = lint_add_options(job->printer->pinfo.attrs, true, num_options, options);
+
+  return (num_options);
+}
+
+
+/*
+ * 'lint_progress()' - Apply counters from the document lint library to a job.
+ */
+
+static void
+lint_progress(
+    server_job_t            *job,	/* I - Job */
+    const doclint_results_t *results)	/* I - Current counters */
+{
+  const doclint_counters_t *imp = &results->impressions,
+			*imp2 = &results->impressions_two_sided,
+			*sheets = &results->sheets;
+					/* Counters */
+  int		impressions,		/* Total impressions */
+		media_sheets;		/* Total media sheets */
+  char		message[1024];		/* ATTR: message */
+
+
+  impressions  = imp->blank + imp->full_color + imp->monochrome + imp2->blank + imp2->full_color + imp2->monochrome;
+  media_sheets = sheets->blank + sheets->full_color + sheets->monochrome;
+
+  snprintf(message, sizeof(message), "ATTR: job-impressions=%d job-impressions-completed=%d job-media-sheets=%d job-media-sheets-completed=%d", impressions, impressions, media_sheets, media_sheets);
+  process_attr_message(job, message, SERVER_TRANSFORM_COMMAND);
+
+  snprintf(message, sizeof(message), "ATTR: job-impressions-col={blank=%d blank-two-sided=%d full-color=%d full-color-two-sided=%d monochrome=%d monochrome-two-sided=%d} job-impressions-completed-col={blank=%d blank-two-sided=%d full-color=%d full-color-two-sided=%d monochrome=%d monochrome-two-sided=%d}", imp->blank, imp2->blank, imp->full_color, imp2->full_color, imp->monochrome, imp2->monochrome, imp->blank, imp2->blank, imp->full_color, imp2->full_color, imp->monochrome, imp2->monochrome);
+  process_attr_message(job, message, SERVER_TRANSFORM_COMMAND);
+
+  snprintf(message, sizeof(message), "ATTR: job-media-sheets-col={blank=%d full-color=%d monochrome=%d} job-media-sheets-completed-col={blank=%d full-color=%d monochrome=%d}", sheets->blank, sheets->full_color, sheets->monochrome, sheets->blank, sheets->full_color, sheets->monochrome);
+  process_attr_message(job, message, SERVER_TRANSFORM_COMMAND);
+}
+
+
+#ifndef _WIN32
+/*
+ * 'lint_stream()' - Check document data from the receive pipe.
+ *
+ * The pipe is always read to the end so that the receiving thread never
+ * blocks or gets a broken pipe, even after an error has been seen.
+ */
+
+static void *				/* O - Thread exit status */
+lint_stream(server_lint_t *lint)	/* I - Lint data */
+{
+  lint->ok = doclintStream(lint->read_fd, lint->job->format, lint->num_options, lint->options, (doclint_message_cb_t)lint_stream_message, NULL, lint, &lint->results);
+
+  return (NULL);
+}
+
+
+/*
+ * 'lint_stream_message()' - Log a message and count errors from the lint thread.
+ */
+
+static void
+lint_stream_message(
+    server_lint_t   *lint,		/* I - Lint data */
+    doclint_level_t level,		/* I - Message level */
+    const char      *message)		/* I - Message */
+{
+  if (level == DOCLINT_LEVEL_ERROR)
+  {
+    cupsMutexLock(&lint->mutex);
+    lint->errors ++;
+    cupsMutexUnlock(&lint->mutex);
+  }
+
+  lint_message(lint->job, level, message);
+}
+#endif /* !_WIN32 */
+
+
 /*
  * 'process_attr_message()' - Process an ATTR: message from a command.
  */
@@ -604,6 +1025,8 @@ process_attr_message(
       job->impressions = atoi(option->value);
 
       cupsRWUnlock(&job->rwlock);
+
+      serverUpdatePrinterStatus(job->printer);
     }
     else if (mode == SERVER_TRANSFORM_COMMAND && !strcmp(option->name, "job-impressions-completed"))
     {
@@ -618,6 +1041,8 @@ process_attr_message(
       job->impcompleted = atoi(option->value);
 
       cupsRWUnlock(&job->rwlock);
+
+      serverUpdatePrinterStatus(job->printer);
     }
     else if (!strcmp(option->name, "job-impressions-col") || !strcmp(option->name, "job-media-sheets") || !strcmp(option->name, "job-media-sheets-col") ||
         (mode == SERVER_TRANSFORM_COMMAND && (!strcmp(option->name, "job-impressions-completed-col") || !strcmp(option->name, "job-media-sheets-completed") || !strcmp(option->name, "job-media-sheets-completed-col"))))
@@ -769,8 +1194,13 @@ process_state_message(
       break;
   }
 
-  job->state_reasons          = jreasons;
-  job->printer->state_reasons = preasons;
+  if (job->printer->state_reasons != preasons || job->state_reasons != jreasons)
+  {
+    job->printer->state_reasons = preasons;
+    job->state_reasons          = jreasons;
+
+    serverUpdatePrinterStatus(job->printer);
+  }
 }
 
 
@@ -0,0 +1,210 @@
+#!/bin/sh
+#
+# Benchmark script for ippproxy.
+#
+# Copyright © 2018-2023 by The Printer Working Group.
+#
+# Licensed under Apache License v2.0.  See the file "LICENSE" for more
+# information.
+#
+# Usage:
+#
+#   test/run-proxy-bench.sh [-d ipp|socket] [-m mime/type] [-n jobs] [-s kbytes[,kbytes...]] [ippproxy options]
+#
+# Starts ippserver with the "infra" test queue, a local sink device, and
+# ippproxy, submits the requested number of jobs, and then reports the number
+# of jobs per minute, bytes per second, and the average latency of each stage
+# (notify -> fetch -> first byte to device -> complete) from the ippproxy log.
+#
+# The "socket" sink discards all data and requires "socat" or a "nc" that
+# supports "-k".  The "ipp" sink uses ippeveprinter from libcups.
+#
+# Set IPPEVEPRINTERPORT, IPPSERVERPORT, and IPPSINKPORT environment variables
+# to override the default 8xxx, 9xxx, and 7xxx port numbers.
+
+# Verify we have been run from the correct location...
+if test ! -d test; then
+	echo "Usage: test/run-proxy-bench.sh [options]"
+	exit 1
+fi
+
+# Parse command-line...
+device="socket"
+format=""
+jobs=10
+sizes="64,1024"
+
+while test $# -gt 0; do
+	case "$1" in
+		-d)
+			shift
+			device="$1"
+			;;
+		-m)
+			shift
+			format="$1"
+			;;
+		-n)
+			shift
+			jobs="$1"
+			;;
+		-s)
+			shift
+			sizes="$1"
+			;;
+		*)
+			break
+			;;
+	esac
+	shift
+done
+
+case "$device" in
+	ipp | socket)
+		;;
+	*)
+		echo "Usage: test/run-proxy-bench.sh [-d ipp|socket] [-m mime/type] [-n jobs] [-s kbytes[,kbytes...]] [ippproxy options]"
+		exit 1
+		;;
+esac
+
+# Support running with shared libraries as necessary on macOS and Linux...
+DYLD_LIBRARY_PATH="$(pwd)/libcups/cups"; export DYLD_LIBRARY_PATH
+LD_LIBRARY_PATH="$(pwd)/libcups/cups"; export LD_LIBRARY_PATH
+
+# Determine port numbers to use...
+ippeveprinterport=${IPPEVEPRINTERPORT:=$((8000 + ( $(id -u) % 1000 ) ))}
+ippserverport=${IPPSERVERPORT:=$((9000 + ( $(id -u) % 1000 ) ))}
+ippsinkport=${IPPSINKPORT:=$((7000 + ( $(id -u) % 1000 ) ))}
+
+# Create the documents to print...
+tmpdir="${TMPDIR:-/tmp}/ippproxy-bench$$"
+mkdir -p "$tmpdir" || exit 1
+
+for size in $(echo "$sizes" | tr ',' ' '); do
+	dd if=/dev/urandom of="$tmpdir/$size.prn" bs=1024 count="$size" 2>/dev/null
+done
+
+# Start the local sink device...
+case "$device" in
+	ipp)
+		echo "Running ippeveprinter on port $ippeveprinterport..."
+		libcups/tools/ippeveprinter-static -p "$ippeveprinterport" -a libcups/tools/test.conf "Bench Printer $(date +%H%M%S)" 2>"$tmpdir/ippeveprinter.log" &
+		sink=$!
+		device_uri="ipp://localhost:$ippeveprinterport/ipp/print"
+		;;
+
+	socket)
+		echo "Running socket sink on port $ippsinkport..."
+		if which socat >/dev/null 2>&1; then
+			socat -u "TCP-LISTEN:$ippsinkport,reuseaddr,fork" OPEN:/dev/null &
+		elif which nc >/dev/null 2>&1; then
+			nc -l -k "$ippsinkport" >/dev/null &
+		else
+			echo "You must install socat or nc to use a socket sink."
+			rm -rf "$tmpdir"
+			exit 1
+		fi
+		sink=$!
+		device_uri="socket://localhost:$ippsinkport"
+		;;
+esac
+
+# Run ippserver and ippproxy...
+echo "Running ippserver on port $ippserverport..."
+server/ippserver -p "$ippserverport" -C test 2>"$tmpdir/ippserver.log" &
+ippserver=$!
+echo "ippserver has PID $ippserver, waiting for server to come up..."
+sleep 10
+
+infra_uri="ipp://localhost:$ippserverport/ipp/print/infra"
+
+echo "Running ippproxy..."
+tools/ippproxy ${format:+-m "$format"} "$@" -d "$device_uri" "$infra_uri" 2>"$tmpdir/ippproxy.log" &
+ippproxy=$!
+sleep 2
+
+# Submit the jobs, cycling through the document sizes...
+echo "Submitting $jobs jobs..."
+i=0
+while test $i -lt $jobs; do
+	for size in $(echo "$sizes" | tr ',' ' '); do
+		if test $i -lt $jobs; then
+			libcups/tools/ipptool-static -f "$tmpdir/$size.prn" -d "filetype=${format:-application/octet-stream}" "$infra_uri" libcups/examples/print-job.test >/dev/null || echo "Unable to submit job $i."
+			i=$(($i + 1))
+		fi
+	done
+done
+
+# Wait for ippproxy to finish the jobs (up to 10 minutes)...
+echo "Waiting for jobs to complete..."
+count=0
+while test $count -lt 600; do
+	if test $(grep -c "Stage latency:" "$tmpdir/ippproxy.log") -ge $jobs; then
+		break
+	fi
+
+	sleep 1
+	count=$(($count + 1))
+done
+
+# Clean up
+kill $ippproxy $ippserver $sink
+
+# Report the results...
+awk -v jobs=$jobs '
+function seconds(stamp) {
+	# YYYY-MM-DDTHH:MM:SS.mmmZ -> seconds since midnight
+	return (substr(stamp, 12, 2) * 3600 + substr(stamp, 15, 2) * 60 + substr(stamp, 18, 6));
+}
+
+/Job is now fetchable/ {
+	t = seconds($1);
+	if (!first || t < first)
+		first = t;
+}
+
+/Sent .* bytes to the local printer/ {
+	for (i = 1; i < NF; i ++)
+		if ($i == "Sent")
+			bytes += $(i + 1);
+}
+
+/Stage latency:/ {
+	last = seconds($1);
+	done ++;
+	for (i = 1; i <= NF; i ++) {
+		split($i, kv, "=");
+		if (kv[2] != "")
+			total[kv[1]] += kv[2];
+	}
+}
+
+END {
+	elapsed = last - first;
+	if (elapsed < 0)
+		elapsed += 86400;
+	if (elapsed < 0.001)
+		elapsed = 0.001;
+
+	printf("Completed %d of %d jobs in %.3f seconds.\n", done, jobs, elapsed);
+	printf("%.1f jobs/minute, %.1f bytes/second.\n", done * 60.0 / elapsed, bytes / elapsed);
+
+	if (done > 0) {
+		printf("Average stage latency:\n");
+		printf("  notify -> fetch:           %.3f seconds\n", total["notify-to-fetch"] / done);
+		printf("  fetch -> first byte:       %.3f seconds\n", total["fetch-to-first-byte"] / done);
+		printf("  first byte -> complete:    %.3f seconds\n", total["first-byte-to-complete"] / done);
+		printf("  total:                     %.3f seconds\n", total["total"] / done);
+	}
+}' "$tmpdir/ippproxy.log"
+
+status=0
+if test $(grep -c "Stage latency:" "$tmpdir/ippproxy.log") -lt $jobs; then
+	echo "Not all jobs completed, see $tmpdir for logs."
+	status=1
+else
+	rm -rf "$tmpdir"
+fi
+
+exit $status
@@ -131,11 +131,23 @@ typedef struct ipp3d_filter_s		/**** Attribute filter ****/
 
 typedef struct ipp3d_job_s ipp3d_job_t;
 
+typedef enum ipp3d_slice_e		/**** Slicing state ****/
+{
+  IPP3D_SLICE_NONE,			/* No slicing ahead of time */
+  IPP3D_SLICE_PENDING,			/* Waiting for a slicing thread */
+  IPP3D_SLICE_ACTIVE,			/* Being sliced */
+  IPP3D_SLICE_DONE,			/* Sliced G-code is in the spool directory */
+  IPP3D_SLICE_FAILED			/* Slicing failed, process the job normally */
+} ipp3d_slice_t;
+
+typedef struct ipp3d_listener_s		/**** Listener data ****/
+{
+  int			fd;		/* Listener socket */
+  http_addr_t		addr;		/* Listen address */
+} ipp3d_listener_t;
+
 typedef struct ipp3d_printer_s		/**** Printer data ****/
 {
-  /* TODO: One IPv4 and one IPv6 listener are really not sufficient */
-  int			ipv4,		/* IPv4 listener */
-			ipv6;		/* IPv6 listener */
   cups_dnssd_t		*dnssd;		/* DNS-SD context */
   cups_dnssd_service_t	*services;	/* DNS-SD services */
   char			*dnssd_subtypes;/* DNS-SD subtypes */
@@ -146,8 +158,10 @@ typedef struct ipp3d_printer_s		/**** Printer data ****/
 			*directory,	/* Spool directory */
 			*hostname,	/* Hostname */
 			*uri,		/* printer-uri-supported */
+			*resource,	/* IPP resource path */
 			*device_uri,	/* Device URI (if any) */
 			*command;	/* Command to run with job file */
+  const char		*webroot;	/* Web interface path prefix */
   int			port;		/* Port */
   int			web_forms;	/* Enable web interface forms? */
   size_t		urilen;		/* Length of printer URI */
@@ -158,9 +172,12 @@ typedef struct ipp3d_printer_s		/**** Printer data ****/
   ipp3d_preason_t	state_reasons;	/* printer-state-reasons values */
   time_t		state_time;	/* printer-state-change-time */
   cups_array_t		*jobs;		/* Jobs */
-  ipp3d_job_t		*active_job;	/* Current active/pending job */
+  cups_array_t		*queue;		/* Pending jobs in print order */
+  ipp3d_job_t		*active_job;	/* Current printing job */
   int			next_job_id;	/* Next job-id value */
   cups_rwlock_t	rwlock;		/* Printer lock */
+  cups_mutex_t		queue_mutex;	/* Job queue mutex */
+  cups_cond_t		queue_cond;	/* Job queue condition */
 } ipp3d_printer_t;
 
 struct ipp3d_job_s			/**** Job data ****/
@@ -169,6 +186,7 @@ struct ipp3d_job_s			/**** Job data ****/
   const char		*name,		/* job-name */
 			*username,	/* job-originating-user-name */
 			*format;	/* document-format */
+  int			priority;	/* job-priority value */
   ipp_jstate_t		state;		/* job-state value */
   char			*message;	/* job-state-message value */
   int			msglevel;	/* job-state-message log level (0=error, 1=info) */
@@ -181,6 +199,9 @@ struct ipp3d_job_s			/**** Job data ****/
   int			cancel;		/* Non-zero when job canceled */
   char			*filename;	/* Print file name */
   int			fd;		/* Print file descriptor */
+  ipp3d_slice_t		slice;		/* Slicing state */
+  int			slice_pid;	/* Slicing command process ID, if any */
+  char			*gcode;		/* Sliced G-code file name */
   ipp3d_printer_t	*printer;	/* Printer */
 };
 
@@ -194,10 +215,13 @@ typedef struct ipp3d_client_s		/**** Client data ****/
   ipp_op_t		operation_id;	/* IPP operation-id */
   char			uri[1024],	/* Request URI */
 			*options;	/* URI options */
+  const char		*path;		/* Request path within printer web pages */
   http_addr_t		addr;		/* Client address */
   char			hostname[256];	/* Client hostname */
   ipp3d_printer_t	*printer;	/* Printer */
   ipp3d_job_t		*job;		/* Current job, if any */
+  bool			started;	/* Has the first request been read? */
+  time_t		idle_time;	/* Time connection became idle */
 } ipp3d_client_t;
 
 
@@ -205,15 +229,17 @@ typedef struct ipp3d_client_s		/**** Client data ****/
  * Local functions...
  */
 
-static void		clean_jobs(ipp3d_printer_t *printer);
+static time_t		clean_jobs(ipp3d_printer_t *printer);
 static int		compare_jobs(ipp3d_job_t *a, ipp3d_job_t *b);
+static int		compare_queue(ipp3d_job_t *a, ipp3d_job_t *b);
 static void		copy_attributes(ipp_t *to, ipp_t *from, cups_array_t *ra, ipp_tag_t group_tag, int quickcopy);
 static void		copy_job_attributes(ipp3d_client_t *client, ipp3d_job_t *job, cups_array_t *ra);
 static ipp3d_client_t	*create_client(ipp3d_printer_t *printer, int sock);
 static ipp3d_job_t	*create_job(ipp3d_client_t *client);
+static int		create_job_env(ipp3d_job_t *job, const char *format, bool device, char **envp, int envsize);
 static int		create_job_file(ipp3d_job_t *job, char *fname, size_t fnamesize, const char *dir, const char *ext);
-static int		create_listener(const char *name, int port, int family);
-static ipp3d_printer_t	*create_printer(const char *servername, int serverport, const char *name, const char *location, const char *icon, cups_array_t *docformats, const char *subtypes, const char *directory, const char *command, const char *device_uri, ipp_t *attrs);
+static bool		create_listeners(const char *name, int port);
+static ipp3d_printer_t	*create_printer(const char *servername, int serverport, const char *name, const char *resource, const char *location, const char *icon, cups_array_t *docformats, const char *subtypes, const char *directory, const char *command, const char *device_uri, ipp_t *attrs);
 static void		debug_attributes(const char *title, ipp_t *ipp, int response);
 static void		delete_client(ipp3d_client_t *client);
 static void		delete_job(ipp3d_job_t *job);
@@ -221,12 +247,14 @@ static void		delete_printer(ipp3d_printer_t *printer);
 static void		dnssd_callback(cups_dnssd_service_t *service, ipp3d_printer_t *printer, cups_dnssd_flags_t flags);
 static int		filter_cb(ipp3d_filter_t *filter, ipp_t *dst, ipp_attribute_t *attr);
 static ipp3d_job_t	*find_job(ipp3d_client_t *client);
+static ipp3d_printer_t	*find_printer(const char *resource, bool ipp, const char **path);
 static void		finish_document_data(ipp3d_client_t *client, ipp3d_job_t *job);
 static void		finish_document_uri(ipp3d_client_t *client, ipp3d_job_t *job);
 static void		html_escape(ipp3d_client_t *client, const char *s, size_t slen);
 static void		html_footer(ipp3d_client_t *client);
 static void		html_header(ipp3d_client_t *client, const char *title, int refresh);
 static void		html_printf(ipp3d_client_t *client, const char *format, ...) _CUPS_FORMAT(2, 3);
+static void		idle_client(ipp3d_client_t *client);
 static void		ipp_cancel_job(ipp3d_client_t *client);
 static void		ipp_close_job(ipp3d_client_t *client);
 static void		ipp_create_job(ipp3d_client_t *client);
@@ -238,23 +266,29 @@ static void		ipp_send_document(ipp3d_client_t *client);
 static void		ipp_send_uri(ipp3d_client_t *client);
 static void		ipp_validate_job(ipp3d_client_t *client);
 static ipp_t		*load_ippserver_attributes(const char *servername, int serverport, const char *filename, cups_array_t *docformats);
+static bool		load_printers(const char *confdir, const char *servername, int serverport, const char *location, const char *icon, cups_array_t *docformats, const char *subtypes, const char *directory, const char *command, const char *device_uri, int web_forms);
 static size_t		parse_options(ipp3d_client_t *client, cups_option_t **options);
 static void		process_attr_message(ipp3d_job_t *job, char *message);
-static void		*process_client(ipp3d_client_t *client);
+static void		process_client(ipp3d_client_t *client);
+static void		*process_clients(void *data);
 static int		process_http(ipp3d_client_t *client);
 static int		process_ipp(ipp3d_client_t *client);
 static void		*process_job(ipp3d_job_t *job);
+static void		*process_jobs(ipp3d_printer_t *printer);
 static void		process_state_message(ipp3d_job_t *job, char *message);
+static void		queue_job(ipp3d_job_t *job);
 static int		register_printer(ipp3d_printer_t *printer);
 static int		respond_http(ipp3d_client_t *client, http_status_t code, const char *content_coding, const char *type, size_t length);
 static void		respond_ipp(ipp3d_client_t *client, ipp_status_t status, const char *message, ...) _CUPS_FORMAT(3, 4);
 static void		respond_unsupported(ipp3d_client_t *client, ipp_attribute_t *attr);
-static void		run_printer(ipp3d_printer_t *printer);
+static void		run_printers(void);
 static int		show_materials(ipp3d_client_t *client);
 static int		show_status(ipp3d_client_t *client);
 #ifndef _WIN32
 static void		signal_handler(int signum);
 #endif // !_WIN32
+static bool		slice_job(ipp3d_job_t *job);
+static void		*slice_jobs(void *data);
 static char		*time_string(time_t tv, char *buffer, size_t bufsize);
 static void		usage(int status) _CUPS_NORETURN;
 static bool		valid_doc_attributes(ipp3d_client_t *client);
@@ -265,11 +299,32 @@ static bool		valid_job_attributes(ipp3d_client_t *client);
  * Globals...
  */
 
+static cups_array_t	*Clients = NULL;/* Clients waiting for a thread */
+static cups_cond_t	ClientCond = CUPS_COND_INITIALIZER;
+					/* Client queue condition */
+static cups_mutex_t	ClientMutex = CUPS_MUTEX_INITIALIZER;
+					/* Client queue mutex */
+static cups_array_t	*IdleClients = NULL;
+					/* Clients waiting for a request */
 static int		KeepFiles = 0,	/* Keep spooled job files? */
 			MaxVersion = 20,/* Maximum IPP version (20 = 2.0, 11 = 1.1, etc.) */
+			NumSlicers = 1,	/* Number of slicing threads */
+			NumThreads = 10,/* Number of client threads */
 			Verbosity = 0;	/* Verbosity level */
+static ipp3d_listener_t	*Listeners = NULL;
+					/* Listeners */
+static size_t		NumListeners = 0;
+					/* Number of listeners */
+static cups_array_t	*Printers = NULL;
+					/* Printers */
+static cups_cond_t	SliceCond = CUPS_COND_INITIALIZER;
+					/* Slicing queue condition */
+static cups_mutex_t	SliceMutex = CUPS_MUTEX_INITIALIZER;
+					/* Slicing queue mutex */
 #ifndef _WIN32
 static int		StopPrinter = 0;/* Stop the printer server? */
+static int		WakeupPipe[2] = { -1, -1 };
+					/* Pipe to wake up the main loop */
 #endif // !_WIN32
 
 
@@ -285,6 +340,7 @@ main(int  argc,				/* I - Number of command-line args */
   const char	*opt,			/* Current option character */
 		*attrfile = NULL,	/* ippserver attributes file */
 		*command = NULL,	/* Command to run with job files */
+		*confdir = NULL,	/* Configuration directory */
 		*device_uri = NULL,	/* Device URI */
 		*icon = NULL,		/* Icon file */
 		*keypath = NULL,	/* Keychain path */
@@ -294,12 +350,14 @@ main(int  argc,				/* I - Number of command-line args */
 		*name = NULL,		/* Printer name */
 		*subtypes = "_print";	/* DNS-SD service subtype */
   int		web_forms = 1;		/* Enable web site forms? */
+  cups_array_t	*listen_addrs = NULL;	/* Listen addresses */
   ipp_t		*attrs = NULL;		/* Printer attributes */
   char		directory[1024] = "";	/* Spool directory */
   cups_array_t	*docformats = NULL;	/* Supported formats */
   const char	*servername = NULL;	/* Server host name */
   int		serverport = 0;		/* Server port number (0 = auto) */
   ipp3d_printer_t *printer;		/* Printer object */
+  ipp3d_listener_t *lis;		/* Current listener */
 
 
  /*
@@ -332,6 +390,14 @@ main(int  argc,				/* I - Number of command-line args */
       {
         switch (*opt)
 	{
+	  case 'C' : /* -C config-directory */
+	      i ++;
+	      if (i >= argc)
+	        usage(1);
+
+	      confdir = argv[i];
+	      break;
+
           case 'D' : /* -D device-uri */
 	      i ++;
 	      if (i >= argc)
@@ -348,6 +414,17 @@ main(int  argc,				/* I - Number of command-line args */
 	      keypath = argv[i];
 	      break;
 
+	  case 'L' : /* -L address[:port] or -L /path/to/socket */
+	      i ++;
+	      if (i >= argc)
+	        usage(1);
+
+	      if (!listen_addrs)
+	        listen_addrs = cupsArrayNew(NULL, NULL, NULL, 0, NULL, NULL);
+
+	      cupsArrayAdd(listen_addrs, argv[i]);
+	      break;
+
 #if 0
 	  case 'M' : /* -M manufacturer */
 	      i ++;
@@ -444,6 +521,20 @@ main(int  argc,				/* I - Number of command-line args */
 	      subtypes = argv[i];
 	      break;
 
+	  case 's' : /* -s slicers */
+	      i ++;
+	      if (i >= argc || !isdigit(argv[i][0] & 255))
+	        usage(1);
+
+	      NumSlicers = atoi(argv[i]);
+	      break;
+
+	  case 't' : /* -t threads */
+	      i ++;
+	      if (i >= argc || !isdigit(argv[i][0] & 255) || (NumThreads = atoi(argv[i])) < 1)
+	        usage(1);
+	      break;
+
 	  case 'v' : /* -v (be verbose) */
 	      Verbosity ++;
 	      break;
@@ -465,7 +556,7 @@ main(int  argc,				/* I - Number of command-line args */
     }
   }
 
-  if (!name)
+  if ((!name && !confdir) || (name && confdir))
     usage(1);
 
  /*
@@ -521,19 +612,72 @@ main(int  argc,				/* I - Number of command-line args */
   }
 
  /*
-  * Create the printer...
+  * Create the listener sockets...
+  */
+
+  if (listen_addrs)
+  {
+    const char	*value;			/* Listen value */
+
+    for (value = (const char *)cupsArrayGetFirst(listen_addrs); value; value = (const char *)cupsArrayGetNext(listen_addrs))
+    {
+      char	host[256],		/* Hostname */
+		*ptr;			/* Pointer to port */
+      int	port = serverport;	/* Port number */
+
+      cupsCopyString(host, value, sizeof(host));
+
+      if (host[0] != '/' && (ptr = strrchr(host, ':')) != NULL && !strchr(ptr, ']'))
+      {
+        if (!isdigit(ptr[1] & 255))
+        {
+          fprintf(stderr, "Bad listen address \"%s\".\n", value);
+          return (1);
+        }
+
+        *ptr++ = '\0';
+        port   = atoi(ptr);
+      }
+
+      if (!create_listeners(host, port))
+        return (1);
+    }
+
+    cupsArrayDelete(listen_addrs);
+  }
+  else if (!create_listeners(servername, serverport))
+  {
+    return (1);
+  }
+
+ /*
+  * Create the printer(s)...
   */
 
   if (!docformats)
     docformats = cupsArrayNewStrings("application/vnd.pwg-safe-gcode", ',');
 
-  if (attrfile)
-    attrs = load_ippserver_attributes(servername, serverport, attrfile, docformats);
+  Printers = cupsArrayNew(NULL, NULL, NULL, 0, NULL, NULL);
 
-  if ((printer = create_printer(servername, serverport, name, location, icon, docformats, subtypes, directory, command, device_uri, attrs)) == NULL)
-    return (1);
+  if (confdir)
+  {
+    if (!load_printers(confdir, servername, serverport, location, icon, docformats, subtypes, directory, command, device_uri, web_forms))
+      return (1);
+  }
+  else
+  {
+    if (attrfile)
+      attrs = load_ippserver_attributes(servername, serverport, attrfile, docformats);
+
+    if ((printer = create_printer(servername, serverport, name, "/ipp/print3d", location, icon, docformats, subtypes, directory, command, device_uri, attrs)) == NULL)
+      return (1);
+
+    printer->web_forms = web_forms;
+
+    cupsArrayAdd(Printers, printer);
+  }
 
-  printer->web_forms = web_forms;
+  printer = (ipp3d_printer_t *)cupsArrayGetFirst(Printers);
 
   cupsSetServerCredentials(keypath, printer->hostname, 1);
 
@@ -541,13 +685,21 @@ main(int  argc,				/* I - Number of command-line args */
   * Run the print service...
   */
 
-  run_printer(printer);
+  run_printers();
 
  /*
-  * Destroy the printer and exit...
+  * Destroy the printers and listeners and exit...
   */
 
-  delete_printer(printer);
+  for (printer = (ipp3d_printer_t *)cupsArrayGetFirst(Printers); printer; printer = (ipp3d_printer_t *)cupsArrayGetNext(Printers))
+    delete_printer(printer);
+
+  cupsArrayDelete(Printers);
+
+  for (lis = Listeners; NumListeners > 0; NumListeners --, lis ++)
+    httpAddrClose(&(lis->addr), lis->fd);
+
+  free(Listeners);
 
   return (0);
 }
@@ -555,32 +707,61 @@ main(int  argc,				/* I - Number of command-line args */
 
 /*
  * 'clean_jobs()' - Clean out old (completed) jobs.
+ *
+ * Completed jobs are kept for 60 seconds.  The return value is the next time
+ * the jobs need to be cleaned, or 0 if there are no jobs.
  */
 
-static void
+static time_t				/* O - Next clean time or 0 for none */
 clean_jobs(ipp3d_printer_t *printer)	/* I - Printer */
 {
   ipp3d_job_t	*job;			/* Current job */
-  time_t	cleantime;		/* Clean time */
+  time_t	curtime,		/* Current time */
+		cleantime,		/* Clean time */
+		next = 0;		/* Next clean time */
 
 
   if (cupsArrayGetCount(printer->jobs) == 0)
-    return;
+    return (0);
 
-  cleantime = time(NULL) - 60;
+  curtime   = time(NULL);
+  cleantime = curtime - 60;
 
+  cupsMutexLock(&(printer->queue_mutex));
   cupsRWLockWrite(&(printer->rwlock));
   for (job = (ipp3d_job_t *)cupsArrayGetFirst(printer->jobs);
        job;
        job = (ipp3d_job_t *)cupsArrayGetNext(printer->jobs))
-    if (job->completed && job->completed < cleantime)
+  {
+   /*
+    * Canceled jobs may still be in use by a slicing thread, and newer jobs
+    * may still be queued...
+    */
+
+    if (job->completed && job->completed < cleantime && job->slice != IPP3D_SLICE_ACTIVE)
     {
+      cupsArrayRemove(printer->queue, job);
       cupsArrayRemove(printer->jobs, job);
       delete_job(job);
     }
-    else
-      break;
+    else if (job->completed && job->completed >= cleantime)
+    {
+      if (!next || next > (job->completed + 61))
+        next = job->completed + 61;
+    }
+    else if (!next || next > (curtime + 60))
+    {
+     /*
+      * Check unfinished jobs again in 60 seconds...
+      */
+
+      next = curtime + 60;
+    }
+  }
   cupsRWUnlock(&(printer->rwlock));
+  cupsMutexUnlock(&(printer->queue_mutex));
+
+  return (next);
 }
 
 
@@ -596,6 +777,24 @@ compare_jobs(ipp3d_job_t *a,		/* I - First job */
 }
 
 
+/*
+ * 'compare_queue()' - Compare two queued jobs.
+ *
+ * Higher priority jobs print first, and jobs with the same priority print in
+ * the order they were submitted.
+ */
+
+static int				/* O - Result of comparison */
+compare_queue(ipp3d_job_t *a,		/* I - First job */
+              ipp3d_job_t *b)		/* I - Second job */
+{
+  if (a->priority != b->priority)
+    return (b->priority - a->priority);
+  else
+    return (a->id - b->id);
+}
+
+
 /*
  * 'copy_attributes()' - Copy attributes from one request to another.
  */
@@ -837,16 +1036,6 @@ create_job(ipp3d_client_t *client)	/* I - Client */
 
 
   cupsRWLockWrite(&(client->printer->rwlock));
-  if (client->printer->active_job &&
-      client->printer->active_job->state < IPP_JSTATE_CANCELED)
-  {
-   /*
-    * Only accept a single job at a time...
-    */
-
-    cupsRWUnlock(&(client->printer->rwlock));
-    return (NULL);
-  }
 
  /*
   * Allocate and initialize the job object...
@@ -897,6 +1086,16 @@ create_job(ipp3d_client_t *client)	/* I - Client */
   if ((attr = ippFindAttribute(client->request, "job-name", IPP_TAG_NAME)) != NULL)
     job->name = ippGetString(attr, 0, NULL);
 
+  if ((attr = ippFindAttribute(client->request, "job-priority", IPP_TAG_INTEGER)) != NULL)
+  {
+    job->priority = ippGetInteger(attr, 0);
+  }
+  else
+  {
+    job->priority = 50;
+    ippAddInteger(job->attrs, IPP_TAG_JOB, IPP_TAG_INTEGER, "job-priority", job->priority);
+  }
+
  /*
   * Add job description attributes and add to the jobs array...
   */
@@ -917,7 +1116,6 @@ create_job(ipp3d_client_t *client)	/* I - Client */
   ippAddInteger(job->attrs, IPP_TAG_JOB, IPP_TAG_INTEGER, "time-at-creation", (int)(job->created - client->printer->start_time));
 
   cupsArrayAdd(client->printer->jobs, job);
-  client->printer->active_job = job;
 
   cupsRWUnlock(&(client->printer->rwlock));
 
@@ -925,6 +1123,134 @@ create_job(ipp3d_client_t *client)	/* I - Client */
 }
 
 
+/*
+ * 'create_job_env()' - Create the environment for a job command.
+ */
+
+static int				/* O - Number of environment variables or -1 on error */
+create_job_env(ipp3d_job_t *job,	/* I - Job */
+               const char  *format,	/* I - Document format */
+               bool        device,	/* I - Include DEVICE_URI? */
+               char        **envp,	/* I - Environment array */
+               int         envsize)	/* I - Size of environment array */
+{
+  int			envc;		/* Number of environment variables */
+  ipp_attribute_t	*attr;		/* Job attribute */
+  char			val[1280],	/* IPP_NAME=value */
+			*valptr;	/* Pointer into string */
+
+
+ /*
+  * Copy the current environment, then add environment variables for every
+  * Job attribute and Printer -default attributes...
+  */
+
+  for (envc = 0; environ[envc] && envc < envsize - 1; envc ++)
+    envp[envc] = strdup(environ[envc]);
+
+  if (envc > envsize - 32)
+  {
+    fprintf(stderr, "[Job %d] Too many environment variables to process job.\n", job->id);
+
+    while (envc > 0)
+      free(envp[-- envc]);
+
+    return (-1);
+  }
+
+  snprintf(val, sizeof(val), "CONTENT_TYPE=%s", format);
+  envp[envc ++] = strdup(val);
+
+  if (device && job->printer->device_uri)
+  {
+    snprintf(val, sizeof(val), "DEVICE_URI=%s", job->printer->device_uri);
+    envp[envc ++] = strdup(val);
+  }
+
+  for (attr = ippGetFirstAttribute(job->printer->attrs); attr && envc < envsize - 1; attr = ippGetNextAttribute(job->printer->attrs))
+  {
+   /*
+    * Convert "attribute-name-default" to "IPP_ATTRIBUTE_NAME_DEFAULT=" and
+    * "pwg-xxx" to "IPP_PWG_XXX", then add the value(s) from the attribute.
+    */
+
+    const char	*name = ippGetName(attr),
+					/* Attribute name */
+		*suffix = strstr(name, "-default");
+					/* Suffix on attribute name */
+
+    if (strncmp(name, "pwg-", 4) && (!suffix || suffix[8]))
+      continue;
+
+    valptr = val;
+    *valptr++ = 'I';
+    *valptr++ = 'P';
+    *valptr++ = 'P';
+    *valptr++ = '_';
+    while (*name && valptr < (val + sizeof(val) - 2))
+    {
+      if (*name == '-')
+	*valptr++ = '_';
+      else
+	*valptr++ = (char)toupper(*name & 255);
+
+      name ++;
+    }
+    *valptr++ = '=';
+    ippAttributeString(attr, valptr, sizeof(val) - (size_t)(valptr - val));
+
+    envp[envc++] = strdup(val);
+  }
+
+  for (attr = ippGetFirstAttribute(job->attrs); attr && envc < envsize - 1; attr = ippGetNextAttribute(job->attrs))
+  {
+   /*
+    * Convert "attribute-name" to "IPP_ATTRIBUTE_NAME=" and then add the
+    * value(s) from the attribute.
+    */
+
+    const char *name = ippGetName(attr);
+					/* Attribute name */
+
+    if (!name)
+      continue;
+
+    valptr = val;
+    *valptr++ = 'I';
+    *valptr++ = 'P';
+    *valptr++ = 'P';
+    *valptr++ = '_';
+    while (*name && valptr < (val + sizeof(val) - 2))
+    {
+      if (*name == '-')
+	*valptr++ = '_';
+      else
+	*valptr++ = (char)toupper(*name & 255);
+
+      name ++;
+    }
+    *valptr++ = '=';
+    ippAttributeString(attr, valptr, sizeof(val) - (size_t)(valptr - val));
+
+    envp[envc++] = strdup(val);
+  }
+
+  if (attr)
+  {
+    fprintf(stderr, "[Job %d] Too many environment variables to process job.\n", job->id);
+
+    while (envc > 0)
+      free(envp[-- envc]);
+
+    return (-1);
+  }
+
+  envp[envc] = NULL;
+
+  return (envc);
+}
+
+
 /*
  * 'create_job_file()' - Create a file for the document in a job.
  */
@@ -1001,34 +1327,73 @@ create_job_file(
 
 
 /*
- * 'create_listener()' - Create a listener socket.
+ * 'create_listeners()' - Create listener sockets for an address.
+ *
+ * The name can be a hostname or IP address (all of its addresses are used),
+ * `NULL` or "*" for any address, or the path of a UNIX domain socket.
  */
 
-static int				/* O - Listener socket or -1 on error */
-create_listener(const char *name,	/* I - Host name (`NULL` for any address) */
-                int        port,	/* I - Port number */
-                int        family)	/* I - Address family */
+static bool				/* O - `true` on success, `false` on error */
+create_listeners(
+    const char *name,			/* I - Host name, socket path, or `NULL` for any address */
+    int        port)			/* I - Port number */
 {
   int			sock;		/* Listener socket */
-  http_addrlist_t	*addrlist;	/* Listen address */
+  http_addrlist_t	*addrlist,	/* Listen addresses */
+			*addr;		/* Current address */
+  ipp3d_listener_t	*lis;		/* New listener */
   char			service[255];	/* Service port */
+  size_t		count = 0;	/* Number of sockets */
+
 
+  if (name && !strcmp(name, "*"))
+    name = NULL;
 
   snprintf(service, sizeof(service), "%d", port);
-  if ((addrlist = httpAddrGetList(name, family, service)) == NULL)
-    return (-1);
+  if ((addrlist = httpAddrGetList(name, AF_UNSPEC, service)) == NULL)
+  {
+    fprintf(stderr, "Unable to resolve listen address \"%s\": %s\n", name ? name : "*", cupsGetErrorString());
+    return (false);
+  }
+
+  for (addr = addrlist; addr; addr = addr->next)
+  {
+    if ((sock = httpAddrListen(&(addr->addr), port)) < 0)
+    {
+      char	temp[256];		/* Address string */
+
+      fprintf(stderr, "Unable to listen on \"%s\": %s\n", httpAddrGetString(&(addr->addr), temp, sizeof(temp)), strerror(errno));
+      continue;
+    }
+
+    if ((lis = realloc(Listeners, (NumListeners + 1) * sizeof(ipp3d_listener_t))) == NULL)
+    {
+      perror("Unable to allocate memory for listener");
+      httpAddrClose(&(addr->addr), sock);
+      break;
+    }
 
-  sock = httpAddrListen(&(addrlist->addr), port);
+    Listeners = lis;
+    lis += NumListeners;
+    NumListeners ++;
+
+    lis->fd   = sock;
+    lis->addr = addr->addr;
+    count ++;
+  }
 
   httpAddrFreeList(addrlist);
 
-  return (sock);
+  return (count > 0);
 }
 
 
 /*
- * 'create_printer()' - Create, register, and listen for connections to a
- *                      printer object.
+ * 'create_printer()' - Create and register a printer object.
+ *
+ * The resource path is "/ipp/print3d" for a single printer and
+ * "/ipp/print3d/name" when hosting multiple printers; the web pages use the
+ * remainder of the resource path ("" or "/name") as their prefix.
  */
 
 static ipp3d_printer_t *		/* O - Printer */
@@ -1036,6 +1401,7 @@ create_printer(
     const char   *servername,		/* I - Server hostname (NULL for default) */
     int          serverport,		/* I - Server port */
     const char   *name,			/* I - printer-name */
+    const char   *resource,		/* I - IPP resource path */
     const char   *location,		/* I - printer-location */
     const char   *icon,			/* I - printer-icons */
     cups_array_t *docformats,		/* I - document-format-supported */
@@ -1265,8 +1631,6 @@ create_printer(
     return (NULL);
   }
 
-  printer->ipv4           = -1;
-  printer->ipv6           = -1;
   printer->name           = strdup(name);
   printer->dnssd_name     = strdup(name);
   printer->dnssd_subtypes = subtypes ? strdup(subtypes) : NULL;
@@ -1274,6 +1638,8 @@ create_printer(
   printer->device_uri     = device_uri ? strdup(device_uri) : NULL;
   printer->directory      = strdup(directory);
   printer->icon           = icon ? strdup(icon) : NULL;
+  printer->resource       = strdup(resource);
+  printer->webroot        = printer->resource + 12;
   printer->port           = serverport;
   printer->start_time     = time(NULL);
   printer->config_time    = printer->start_time;
@@ -1281,6 +1647,7 @@ create_printer(
   printer->state_reasons  = IPP3D_PREASON_NONE;
   printer->state_time     = printer->start_time;
   printer->jobs           = cupsArrayNew((cups_array_cb_t)compare_jobs, NULL, NULL, 0, NULL, NULL);
+  printer->queue          = cupsArrayNew((cups_array_cb_t)compare_queue, NULL, NULL, 0, NULL, NULL);
   printer->next_job_id    = 1;
 
   if (servername)
@@ -1295,35 +1662,21 @@ create_printer(
   }
 
   cupsRWInit(&(printer->rwlock));
-
- /*
-  * Create the listener sockets...
-  */
-
-  if ((printer->ipv4 = create_listener(servername, printer->port, AF_INET)) < 0)
-  {
-    perror("Unable to create IPv4 listener");
-    goto bad_printer;
-  }
-
-  if ((printer->ipv6 = create_listener(servername, printer->port, AF_INET6)) < 0)
-  {
-    perror("Unable to create IPv6 listener");
-    goto bad_printer;
-  }
+  cupsMutexInit(&(printer->queue_mutex));
+  cupsCondInit(&(printer->queue_cond));
 
  /*
   * Prepare URI values for the printer attributes...
   */
 
-  httpAssembleURI(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL, printer->hostname, printer->port, "/ipp/print3d");
+  httpAssembleURI(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL, printer->hostname, printer->port, printer->resource);
   printer->uri    = strdup(uri);
   printer->urilen = strlen(uri);
 
-  httpAssembleURI(HTTP_URI_CODING_ALL, securi, sizeof(securi), "ipps", NULL, printer->hostname, printer->port, "/ipp/print3d");
+  httpAssembleURI(HTTP_URI_CODING_ALL, securi, sizeof(securi), "ipps", NULL, printer->hostname, printer->port, printer->resource);
 
-  httpAssembleURI(HTTP_URI_CODING_ALL, icons, sizeof(icons), WEB_SCHEME, NULL, printer->hostname, printer->port, "/icon.png");
-  httpAssembleURI(HTTP_URI_CODING_ALL, adminurl, sizeof(adminurl), WEB_SCHEME, NULL, printer->hostname, printer->port, "/");
+  httpAssembleURIf(HTTP_URI_CODING_ALL, icons, sizeof(icons), WEB_SCHEME, NULL, printer->hostname, printer->port, "%s/icon.png", printer->webroot);
+  httpAssembleURIf(HTTP_URI_CODING_ALL, adminurl, sizeof(adminurl), WEB_SCHEME, NULL, printer->hostname, printer->port, "%s/", printer->webroot);
   httpAssembleUUID(printer->hostname, serverport, name, 0, uuid, sizeof(uuid));
 
   if (Verbosity)
@@ -1446,7 +1799,7 @@ create_printer(
   ippAddInteger(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "job-priority-default", 50);
 
   /* job-priority-supported */
-  ippAddInteger(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "job-priority-supported", 1);
+  ippAddInteger(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "job-priority-supported", 100);
 
   /* job-sheets-default */
   ippAddString(printer->attrs, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_NAME), "job-sheets-default", NULL, "none");
@@ -1664,6 +2017,14 @@ delete_job(ipp3d_job_t *job)		/* I - Job */
     free(job->filename);
   }
 
+  if (job->gcode)
+  {
+    if (!KeepFiles)
+      unlink(job->gcode);
+
+    free(job->gcode);
+  }
+
   free(job);
 }
 
@@ -1676,12 +2037,6 @@ delete_job(ipp3d_job_t *job)		/* I - Job */
 static void
 delete_printer(ipp3d_printer_t *printer)	/* I - Printer */
 {
-  if (printer->ipv4 >= 0)
-    close(printer->ipv4);
-
-  if (printer->ipv6 >= 0)
-    close(printer->ipv6);
-
   cupsDNSSDDelete(printer->dnssd);
 
   free(printer->dnssd_name);
@@ -1692,8 +2047,10 @@ delete_printer(ipp3d_printer_t *printer)	/* I - Printer */
   free(printer->directory);
   free(printer->hostname);
   free(printer->uri);
+  free(printer->resource);
 
   ippDelete(printer->attrs);
+  cupsArrayDelete(printer->queue);
   cupsArrayDelete(printer->jobs);
 
   free(printer);
@@ -1780,6 +2137,48 @@ find_job(ipp3d_client_t *client)		/* I - Client */
 }
 
 
+/*
+ * 'find_printer()' - Find the printer for a resource path.
+ *
+ * IPP resources are matched against each printer's resource path and other
+ * resources against each printer's web prefix.  The remainder of the resource
+ * path after the match is returned in "path".
+ */
+
+static ipp3d_printer_t *		/* O - Printer or `NULL` if not found */
+find_printer(const char  *resource,	/* I - Resource path */
+             bool        ipp,		/* I - `true` for IPP resources, `false` for web pages */
+             const char  **path)	/* O - Path after the printer prefix */
+{
+  size_t		i,		/* Looping var */
+			count,		/* Number of printers */
+			len;		/* Length of prefix */
+  ipp3d_printer_t	*printer;	/* Current printer */
+  const char		*prefix;	/* Printer prefix */
+
+
+ /*
+  * The printers array does not change while running, so use indices rather
+  * than the (shared) current element...
+  */
+
+  for (i = 0, count = cupsArrayGetCount(Printers); i < count; i ++)
+  {
+    printer = (ipp3d_printer_t *)cupsArrayGetElement(Printers, i);
+    prefix  = ipp ? printer->resource : printer->webroot;
+    len     = strlen(prefix);
+
+    if (!strncmp(resource, prefix, len) && (resource[len] == '/' || (ipp && !resource[len])))
+    {
+      *path = resource + len;
+      return (printer);
+    }
+  }
+
+  return (NULL);
+}
+
+
 /*
  * 'finish_document()' - Finish receiving a document file and start processing.
  */
@@ -1793,7 +2192,6 @@ finish_document_data(
 			buffer[4096];	/* Copy buffer */
   ssize_t		bytes;		/* Bytes read */
   cups_array_t		*ra;		/* Attributes to send in response */
-  cups_thread_t        t;              /* Thread */
 
 
  /*
@@ -1860,23 +2258,12 @@ finish_document_data(
 
   job->fd       = -1;
   job->filename = strdup(filename);
-  job->state    = IPP_JSTATE_PENDING;
 
  /*
-  * Process the job...
+  * Queue the job for processing...
   */
 
-  t = cupsThreadCreate((cups_thread_func_t)process_job, job);
-
-  if (t)
-  {
-    cupsThreadDetach(t);
-  }
-  else
-  {
-    respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to process job.");
-    goto abort_job;
-  }
+  queue_job(job);
 
  /*
   * Return the job info...
@@ -2145,15 +2532,14 @@ finish_document_uri(
 
   job->fd       = -1;
   job->filename = strdup(filename);
-  job->state    = IPP_JSTATE_PENDING;
 
   cupsRWUnlock(&(client->printer->rwlock));
 
  /*
-  * Process the job...
+  * Queue the job for processing...
   */
 
-  process_job(job);
+  queue_job(job);
 
  /*
   * Return the job info...
@@ -2261,9 +2647,9 @@ html_header(ipp3d_client_t *client,	/* I - Client */
 	      "<html>\n"
 	      "<head>\n"
 	      "<title>%s</title>\n"
-	      "<link rel=\"shortcut icon\" href=\"/icon.png\" type=\"image/png\">\n"
-	      "<link rel=\"apple-touch-icon\" href=\"/icon.png\" type=\"image/png\">\n"
-	      "<meta http-equiv=\"X-UA-Compatible\" content=\"IE=9\">\n", title);
+	      "<link rel=\"shortcut icon\" href=\"%s/icon.png\" type=\"image/png\">\n"
+	      "<link rel=\"apple-touch-icon\" href=\"%s/icon.png\" type=\"image/png\">\n"
+	      "<meta http-equiv=\"X-UA-Compatible\" content=\"IE=9\">\n", title, client->printer->webroot, client->printer->webroot);
   if (refresh > 0)
     html_printf(client, "<meta http-equiv=\"refresh\" content=\"%d\">\n", refresh);
   html_printf(client,
@@ -2293,10 +2679,10 @@ html_header(ipp3d_client_t *client,	/* I - Client */
 	      "</head>\n"
 	      "<body>\n"
 	      "<table class=\"nav\"><tr>"
-	      "<td class=\"nav%s\"><a href=\"/\">Status</a></td>"
-	      "<td class=\"nav%s\"><a href=\"/materials\">Materials</a></td>"
+	      "<td class=\"nav%s\"><a href=\"%s/\">Status</a></td>"
+	      "<td class=\"nav%s\"><a href=\"%s/materials\">Materials</a></td>"
 	      "</tr></table>\n"
-	      "<div class=\"body\">\n", !strcmp(client->uri, "/") ? " sel" : "", !strcmp(client->uri, "/materials") ? " sel" : "");
+	      "<div class=\"body\">\n", !strcmp(client->path, "/") ? " sel" : "", client->printer->webroot, !strcmp(client->path, "/materials") ? " sel" : "", client->printer->webroot);
 }
 
 
@@ -2520,6 +2906,33 @@ html_printf(ipp3d_client_t *client,	/* I - Client */
 }
 
 
+/*
+ * 'idle_client()' - Wait for the next request from a client.
+ *
+ * The connection is added to the idle list that run_printers() polls, and is
+ * closed if no request arrives within 30 seconds.
+ */
+
+static void
+idle_client(ipp3d_client_t *client)	/* I - Client */
+{
+  client->idle_time = time(NULL);
+
+  cupsMutexLock(&ClientMutex);
+  cupsArrayAdd(IdleClients, client);
+  cupsMutexUnlock(&ClientMutex);
+
+#ifndef _WIN32
+ /*
+  * Wake up the main loop so it polls the connection...
+  */
+
+  if (WakeupPipe[1] >= 0 && write(WakeupPipe[1], "", 1) < 0 && errno != EAGAIN)
+    perror("Unable to write wakeup pipe");
+#endif // !_WIN32
+}
+
+
 /*
  * 'ipp_cancel_job()' - Cancel a job.
  */
@@ -2578,8 +2991,25 @@ ipp_cancel_job(ipp3d_client_t *client)	/* I - Client */
 	  job->completed = time(NULL);
 	}
 
+#ifndef _WIN32
+        if (job->slice_pid > 0)
+        {
+         /*
+          * Stop slicing the job - slice_job() waits for the command to exit
+          * and discards the G-code...
+          */
+
+          fprintf(stderr, "[Job %d] Stopping slicing command (PID %d).\n", job->id, job->slice_pid);
+          kill(job->slice_pid, SIGTERM);
+        }
+#endif /* !_WIN32 */
+
 	cupsRWUnlock(&(client->printer->rwlock));
 
+        cupsMutexLock(&(client->printer->queue_mutex));
+        cupsCondBroadcast(&(client->printer->queue_cond));
+        cupsMutexUnlock(&(client->printer->queue_mutex));
+
 	respond_ipp(client, IPP_STATUS_OK, NULL);
         break;
   }
@@ -2679,8 +3109,8 @@ ipp_create_job(ipp3d_client_t *client)	/* I - Client */
 
   if ((job = create_job(client)) == NULL)
   {
-    respond_ipp(client, IPP_STATUS_ERROR_BUSY,
-                "Currently printing another job.");
+    respond_ipp(client, IPP_STATUS_ERROR_INTERNAL,
+                "Unable to create job.");
     return;
   }
 
@@ -2988,7 +3418,18 @@ ipp_get_printer_attributes(
     ippAddInteger(client->response, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "printer-up-time", (int)(time(NULL) - printer->start_time));
 
   if (!ra || cupsArrayFind(ra, "queued-job-count"))
-    ippAddInteger(client->response, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "queued-job-count", printer->active_job && printer->active_job->state < IPP_JSTATE_CANCELED);
+  {
+    ipp3d_job_t	*job;			/* Current job */
+    int		count = 0;		/* Number of queued jobs */
+
+    for (job = (ipp3d_job_t *)cupsArrayGetFirst(printer->jobs); job; job = (ipp3d_job_t *)cupsArrayGetNext(printer->jobs))
+    {
+      if (job->state < IPP_JSTATE_CANCELED)
+        count ++;
+    }
+
+    ippAddInteger(client->response, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "queued-job-count", count);
+  }
 
   cupsRWUnlock(&(printer->rwlock));
 
@@ -3407,6 +3848,106 @@ load_ippserver_attributes(
 }
 
 
+/*
+ * 'load_printers()' - Load printers from a configuration directory.
+ *
+ * Each "name.conf" file in the directory is an ippserver attributes file for
+ * a printer called "name", with an optional "name.png" icon.  Each printer
+ * uses the IPP resource path "/ipp/print3d/name", the web pages under
+ * "/name/", and a spool subdirectory called "name".
+ */
+
+static bool				/* O - `true` on success, `false` on error */
+load_printers(
+    const char   *confdir,		/* I - Configuration directory */
+    const char   *servername,		/* I - Server name or `NULL` for default */
+    int          serverport,		/* I - Server port number */
+    const char   *location,		/* I - printer-location */
+    const char   *icon,			/* I - Default icon file, if any */
+    cups_array_t *docformats,		/* I - document-format-supported values */
+    const char   *subtypes,		/* I - DNS-SD service subtype(s) */
+    const char   *directory,		/* I - Spool directory */
+    const char   *command,		/* I - Command to run on job files, if any */
+    const char   *device_uri,		/* I - Output device, if any */
+    int          web_forms)		/* I - Enable web interface forms? */
+{
+  cups_dir_t		*dir;		/* Directory pointer */
+  cups_dentry_t		*dent;		/* Directory entry */
+  char			name[256],	/* Printer name */
+			*ptr,		/* Pointer into name */
+			filename[1024],	/* Attributes filename */
+			iconname[1024],	/* Icon filename */
+			spooldir[1024],	/* Spool directory */
+			resource[256];	/* Resource path */
+  ipp3d_printer_t	*printer;	/* New printer */
+
+
+  if ((dir = cupsDirOpen(confdir)) == NULL)
+  {
+    fprintf(stderr, "Unable to open configuration directory \"%s\": %s\n", confdir, strerror(errno));
+    return (false);
+  }
+
+  while ((dent = cupsDirRead(dir)) != NULL)
+  {
+    cupsCopyString(name, dent->filename, sizeof(name));
+
+    if ((ptr = strrchr(name, '.')) == NULL || strcmp(ptr, ".conf"))
+      continue;
+
+    *ptr = '\0';
+
+   /*
+    * The name is used in URLs, so limit it to letters, numbers, '-', and
+    * '_'...
+    */
+
+    for (ptr = name; *ptr; ptr ++)
+    {
+      if (!isalnum(*ptr & 255) && *ptr != '-' && *ptr != '_')
+        break;
+    }
+
+    if (!name[0] || *ptr)
+    {
+      fprintf(stderr, "Skipping \"%s\": Printer names can only contain letters, numbers, '-', and '_'.\n", dent->filename);
+      continue;
+    }
+
+    snprintf(filename, sizeof(filename), "%s/%s", confdir, dent->filename);
+    snprintf(iconname, sizeof(iconname), "%s/%s.png", confdir, name);
+    snprintf(spooldir, sizeof(spooldir), "%s/%s", directory, name);
+    snprintf(resource, sizeof(resource), "/ipp/print3d/%s", name);
+
+    if (mkdir(spooldir, 0755) && errno != EEXIST)
+    {
+      fprintf(stderr, "Unable to create spool directory \"%s\": %s\n", spooldir, strerror(errno));
+      continue;
+    }
+
+    if (Verbosity)
+      fprintf(stderr, "Loading printer \"%s\" from \"%s\".\n", name, filename);
+
+    if ((printer = create_printer(servername, serverport, name, resource, location, access(iconname, R_OK) ? icon : iconname, docformats, subtypes, spooldir, command, device_uri, load_ippserver_attributes(servername, serverport, filename, docformats))) == NULL)
+      continue;
+
+    printer->web_forms = web_forms;
+
+    cupsArrayAdd(Printers, printer);
+  }
+
+  cupsDirClose(dir);
+
+  if (cupsArrayGetCount(Printers) == 0)
+  {
+    fprintf(stderr, "No printers found in \"%s\".\n", confdir);
+    return (false);
+  }
+
+  return (true);
+}
+
+
 /*
  * 'parse_options()' - Parse URL options into CUPS options.
  *
@@ -3515,53 +4056,104 @@ process_attr_message(
 
 
 /*
- * 'process_client()' - Process client requests on a thread.
+ * 'process_client()' - Process the pending requests from a client.
+ *
+ * Only the requests that have already arrived are processed, after which the
+ * connection is handed back to run_printers() so that idle keep-alive
+ * connections do not tie up the client threads.
  */
 
-static void *				/* O - Exit status */
+static void
 process_client(ipp3d_client_t *client)	/* I - Client */
 {
- /*
-  * Loop until we are out of requests or timeout (30 seconds)...
-  */
+  if (!client->started)
+  {
+   /*
+    * See if we need to negotiate a TLS connection...
+    */
 
-  int first_time = 1;			/* First time request? */
+    char buf[1];			/* First byte from client */
 
-  while (httpWait(client->http, 30000))
-  {
-    if (first_time)
+    if (recv(httpGetFd(client->http), buf, 1, MSG_PEEK) == 1 && (!buf[0] || !strchr("DGHOPT", buf[0])))
     {
-     /*
-      * See if we need to negotiate a TLS connection...
-      */
-
-      char buf[1];			/* First byte from client */
+      fprintf(stderr, "%s Starting HTTPS session.\n", client->hostname);
 
-      if (recv(httpGetFd(client->http), buf, 1, MSG_PEEK) == 1 && (!buf[0] || !strchr("DGHOPT", buf[0])))
+      if (httpSetEncryption(client->http, HTTP_ENCRYPTION_ALWAYS))
       {
-        fprintf(stderr, "%s Starting HTTPS session.\n", client->hostname);
-
-	if (httpSetEncryption(client->http, HTTP_ENCRYPTION_ALWAYS))
-	{
-	  fprintf(stderr, "%s Unable to encrypt connection: %s\n", client->hostname, cupsGetErrorString());
-	  break;
-        }
-
-        fprintf(stderr, "%s Connection now encrypted.\n", client->hostname);
+	fprintf(stderr, "%s Unable to encrypt connection: %s\n", client->hostname, cupsGetErrorString());
+	delete_client(client);
+	return;
       }
 
-      first_time = 0;
+      fprintf(stderr, "%s Connection now encrypted.\n", client->hostname);
     }
 
+    client->started = true;
+  }
+
+ /*
+  * Process requests until the client has to send more...
+  */
+
+  do
+  {
     if (!process_http(client))
-      break;
+    {
+     /*
+      * Close the conection to the client...
+      */
+
+      delete_client(client);
+      return;
+    }
   }
+  while (httpGetReady(client->http));
 
  /*
-  * Close the conection to the client and return...
+  * Wait for the next request in the main loop...
   */
 
-  delete_client(client);
+  idle_client(client);
+}
+
+
+/*
+ * 'process_clients()' - Process clients from the client queue.
+ *
+ * A fixed number of these threads is started by run_printers() so that the
+ * number of client threads stays bounded.  The threads are shared by all
+ * printers.
+ */
+
+static void *				/* O - Thread exit status */
+process_clients(void *data)		/* I - Thread data (unused) */
+{
+  ipp3d_client_t	*client;	/* Current client */
+
+
+  (void)data;
+
+  for (;;)
+  {
+   /*
+    * Wait for a client...
+    */
+
+    cupsMutexLock(&ClientMutex);
+
+    while ((client = (ipp3d_client_t *)cupsArrayGetFirst(Clients)) == NULL)
+      cupsCondWait(&ClientCond, &ClientMutex, 30.0);
+
+    cupsArrayRemove(Clients, client);
+
+    cupsMutexUnlock(&ClientMutex);
+
+   /*
+    * Process the client's requests...
+    */
+
+    process_client(client);
+  }
 
   return (NULL);
 }
@@ -3583,6 +4175,7 @@ process_http(ipp3d_client_t *client)	/* I - Client connection */
 			hostname[HTTP_MAX_HOST];
 					/* Hostname */
   int			port;		/* Port number */
+  ipp3d_printer_t	*printer;	/* Printer */
 
 
  /*
@@ -3650,6 +4243,16 @@ process_http(ipp3d_client_t *client)	/* I - Client connection */
   if ((client->options = strchr(client->uri, '?')) != NULL)
     *(client->options)++ = '\0';
 
+ /*
+  * Find the printer for web pages; IPP requests are directed to a printer
+  * using the printer-uri or job-uri attribute...
+  */
+
+  if ((printer = find_printer(client->uri, false, &client->path)) != NULL)
+    client->printer = printer;
+  else
+    client->path = "";
+
  /*
   * Process the request...
   */
@@ -3748,15 +4351,15 @@ process_http(ipp3d_client_t *client)	/* I - Client connection */
 	return (respond_http(client, HTTP_STATUS_OK, NULL, NULL, 0));
 
     case HTTP_STATE_HEAD :
-        if (!strcmp(client->uri, "/icon.png"))
+        if (!strcmp(client->path, "/icon.png"))
 	  return (respond_http(client, HTTP_STATUS_OK, NULL, "image/png", 0));
-	else if (!strcmp(client->uri, "/") || !strcmp(client->uri, "/materials"))
+	else if (!strcmp(client->path, "/") || !strcmp(client->path, "/materials"))
 	  return (respond_http(client, HTTP_STATUS_OK, NULL, "text/html", 0));
 	else
 	  return (respond_http(client, HTTP_STATUS_NOT_FOUND, NULL, NULL, 0));
 
     case HTTP_STATE_GET :
-        if (!strcmp(client->uri, "/icon.png"))
+        if (!strcmp(client->path, "/icon.png"))
 	{
 	 /*
 	  * Send PNG icon file.
@@ -3800,7 +4403,7 @@ process_http(ipp3d_client_t *client)	/* I - Client connection */
 	    httpFlushWrite(client->http);
 	  }
 	}
-	else if (!strcmp(client->uri, "/"))
+	else if (!strcmp(client->path, "/"))
 	{
 	 /*
 	  * Show web status page...
@@ -3808,7 +4411,7 @@ process_http(ipp3d_client_t *client)	/* I - Client connection */
 
           return (show_status(client));
 	}
-	else if (!strcmp(client->uri, "/materials"))
+	else if (!strcmp(client->path, "/materials"))
 	{
 	 /*
 	  * Show web materials page...
@@ -4008,6 +4611,8 @@ process_ipp(ipp3d_client_t *client)	/* I - Client */
 			host[256],	/* Host name in URI */
 			resource[256];	/* Resource path in URI */
 	int		port;		/* Port number in URI */
+	ipp3d_printer_t	*printer;	/* Printer */
+	const char	*path;		/* Path after the printer resource */
 
         name = ippGetName(uri);
 
@@ -4018,10 +4623,9 @@ process_ipp(ipp3d_client_t *client)	/* I - Client */
                             resource, sizeof(resource)) < HTTP_URI_STATUS_OK)
 	  respond_ipp(client, IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES,
 	              "Bad %s value '%s'.", name, ippGetString(uri, 0, NULL));
-        else if ((!strcmp(name, "job-uri") &&
-                  strncmp(resource, "/ipp/print3d/", 13)) ||
-                 (!strcmp(name, "printer-uri") &&
-                  strcmp(resource, "/ipp/print3d")))
+        else if ((printer = find_printer(resource, true, &path)) == NULL ||
+                 (!strcmp(name, "job-uri") && !*path) ||
+                 (!strcmp(name, "printer-uri") && *path))
 	  respond_ipp(client, IPP_STATUS_ERROR_NOT_FOUND, "%s %s not found.",
 		      name, ippGetString(uri, 0, NULL));
 	else
@@ -4030,6 +4634,8 @@ process_ipp(ipp3d_client_t *client)	/* I - Client */
 	  * Try processing the operation...
 	  */
 
+          client->printer = printer;
+
 	  switch (ippGetOperation(client->request))
 	  {
 	    case IPP_OP_VALIDATE_JOB :
@@ -4105,15 +4711,29 @@ process_job(ipp3d_job_t *job)		/* I - Job */
   job->printer->state = IPP_PSTATE_PROCESSING;
   job->processing     = time(NULL);
 
-  while (job->printer->state_reasons & IPP3D_PREASON_MATERIAL_EMPTY)
+  cupsMutexLock(&(job->printer->queue_mutex));
+
+  while ((job->printer->state_reasons & IPP3D_PREASON_MATERIAL_EMPTY) && !job->cancel)
   {
+   /*
+    * Wait for material to be loaded or the job to be canceled...
+    */
+
     job->printer->state_reasons |= IPP3D_PREASON_MATERIAL_NEEDED;
 
-    sleep(1);
+    cupsCondWait(&(job->printer->queue_cond), &(job->printer->queue_mutex), 10.0);
   }
 
+  cupsMutexUnlock(&(job->printer->queue_mutex));
+
   job->printer->state_reasons &= (ipp3d_preason_t)~IPP3D_PREASON_MATERIAL_NEEDED;
 
+  if (job->cancel)
+  {
+    job->state = IPP_JSTATE_CANCELED;
+    goto error;
+  }
+
   if (job->printer->command)
   {
    /*
@@ -4127,9 +4747,10 @@ process_job(ipp3d_job_t *job)		/* I - Job */
     char		*myargv[3],	/* Command-line arguments */
 			*myenvp[400];	/* Environment variables */
     int			myenvc;		/* Number of environment variables */
-    ipp_attribute_t	*attr;		/* Job attribute */
-    char		val[1280],	/* IPP_NAME=value */
-			*valptr;	/* Pointer into string */
+    char		*filename = job->filename;
+					/* File to print */
+    const char		*format = job->format;
+					/* Format of file */
 #ifndef _WIN32
     int			mystdout = -1;	/* File for stdout */
     int			mypipe[2];	/* Pipe for stderr */
@@ -4139,7 +4760,17 @@ process_job(ipp3d_job_t *job)		/* I - Job */
     ssize_t		bytes;		/* Bytes read */
 #endif /* !_WIN32 */
 
-    fprintf(stderr, "[Job %d] Running command \"%s %s\".\n", job->id, job->printer->command, job->filename);
+    if (job->slice == IPP3D_SLICE_DONE)
+    {
+     /*
+      * Print the G-code that was sliced ahead of time...
+      */
+
+      filename = job->gcode;
+      format   = "application/g-code";
+    }
+
+    fprintf(stderr, "[Job %d] Running command \"%s %s\".\n", job->id, job->printer->command, filename);
     gettimeofday(&start, NULL);
 
    /*
@@ -4147,7 +4778,7 @@ process_job(ipp3d_job_t *job)		/* I - Job */
     */
 
     myargv[0] = job->printer->command;
-    myargv[1] = job->filename;
+    myargv[1] = filename;
     myargv[2] = NULL;
 
    /*
@@ -4155,102 +4786,12 @@ process_job(ipp3d_job_t *job)		/* I - Job */
     * Job attribute and Printer -default attributes...
     */
 
-    for (myenvc = 0; environ[myenvc] && myenvc < (int)(sizeof(myenvp) / sizeof(myenvp[0]) - 1); myenvc ++)
-      myenvp[myenvc] = strdup(environ[myenvc]);
-
-    if (myenvc > (int)(sizeof(myenvp) / sizeof(myenvp[0]) - 32))
-    {
-      fprintf(stderr, "[Job %d] Too many environment variables to process job.\n", job->id);
-      job->state = IPP_JSTATE_ABORTED;
-      goto error;
-    }
-
-    snprintf(val, sizeof(val), "CONTENT_TYPE=%s", job->format);
-    myenvp[myenvc ++] = strdup(val);
-
-    if (job->printer->device_uri)
-    {
-      snprintf(val, sizeof(val), "DEVICE_URI=%s", job->printer->device_uri);
-      myenvp[myenvc ++] = strdup(val);
-    }
-
-    for (attr = ippGetFirstAttribute(job->printer->attrs); attr && myenvc < (int)(sizeof(myenvp) / sizeof(myenvp[0]) - 1); attr = ippGetNextAttribute(job->printer->attrs))
-    {
-     /*
-      * Convert "attribute-name-default" to "IPP_ATTRIBUTE_NAME_DEFAULT=" and
-      * "pwg-xxx" to "IPP_PWG_XXX", then add the value(s) from the attribute.
-      */
-
-      const char	*name = ippGetName(attr),
-					/* Attribute name */
-			*suffix = strstr(name, "-default");
-					/* Suffix on attribute name */
-
-      if (strncmp(name, "pwg-", 4) && (!suffix || suffix[8]))
-        continue;
-
-      valptr = val;
-      *valptr++ = 'I';
-      *valptr++ = 'P';
-      *valptr++ = 'P';
-      *valptr++ = '_';
-      while (*name && valptr < (val + sizeof(val) - 2))
-      {
-        if (*name == '-')
-	  *valptr++ = '_';
-	else
-	  *valptr++ = (char)toupper(*name & 255);
-
-	name ++;
-      }
-      *valptr++ = '=';
-      ippAttributeString(attr, valptr, sizeof(val) - (size_t)(valptr - val));
-
-      myenvp[myenvc++] = strdup(val);
-    }
-
-    for (attr = ippGetFirstAttribute(job->attrs); attr && myenvc < (int)(sizeof(myenvp) / sizeof(myenvp[0]) - 1); attr = ippGetNextAttribute(job->attrs))
-    {
-     /*
-      * Convert "attribute-name" to "IPP_ATTRIBUTE_NAME=" and then add the
-      * value(s) from the attribute.
-      */
-
-      const char *name = ippGetName(attr);
-					/* Attribute name */
-
-      if (!name)
-        continue;
-
-      valptr = val;
-      *valptr++ = 'I';
-      *valptr++ = 'P';
-      *valptr++ = 'P';
-      *valptr++ = '_';
-      while (*name && valptr < (val + sizeof(val) - 2))
-      {
-        if (*name == '-')
-	  *valptr++ = '_';
-	else
-	  *valptr++ = (char)toupper(*name & 255);
-
-	name ++;
-      }
-      *valptr++ = '=';
-      ippAttributeString(attr, valptr, sizeof(val) - (size_t)(valptr - val));
-
-      myenvp[myenvc++] = strdup(val);
-    }
-
-    if (attr)
+    if ((myenvc = create_job_env(job, format, true, myenvp, (int)(sizeof(myenvp) / sizeof(myenvp[0])))) < 0)
     {
-      fprintf(stderr, "[Job %d] Too many environment variables to process job.\n", job->id);
       job->state = IPP_JSTATE_ABORTED;
       goto error;
     }
 
-    myenvp[myenvc] = NULL;
-
    /*
     * Now run the program...
     */
@@ -4515,10 +5056,20 @@ process_job(ipp3d_job_t *job)		/* I - Job */
   else
   {
    /*
-    * Sleep for a semi-random amount of time to simulate job processing.
+    * Wait for a semi-random amount of time to simulate job processing,
+    * stopping early if the job is canceled.
     */
 
-    sleep((unsigned)(5 + (time(NULL) % 11)));
+    time_t	curtime = time(NULL),	/* Current time */
+		endtime = curtime + 5 + (curtime % 11);
+					/* End of processing */
+
+    cupsMutexLock(&(job->printer->queue_mutex));
+
+    while (!job->cancel && (curtime = time(NULL)) < endtime)
+      cupsCondWait(&(job->printer->queue_cond), &(job->printer->queue_mutex), (double)(endtime - curtime));
+
+    cupsMutexUnlock(&(job->printer->queue_mutex));
   }
 
   if (job->cancel)
@@ -4536,6 +5087,68 @@ process_job(ipp3d_job_t *job)		/* I - Job */
 }
 
 
+/*
+ * 'process_jobs()' - Print queued jobs in order.
+ *
+ * Jobs are printed one at a time in priority order, and in the order they
+ * were submitted for the same priority.  When the next job is still being
+ * sliced ahead of time we wait for the slicing thread to finish rather than
+ * skipping to a later job.
+ */
+
+static void *				/* O - Thread exit status */
+process_jobs(ipp3d_printer_t *printer)	/* I - Printer */
+{
+  ipp3d_job_t	*next;			/* Next job to print */
+
+
+  cupsMutexLock(&(printer->queue_mutex));
+
+  for (;;)
+  {
+   /*
+    * Get the next job from the queue, dropping any that were canceled while
+    * they were queued...
+    */
+
+    cupsRWLockWrite(&(printer->rwlock));
+
+    while ((next = (ipp3d_job_t *)cupsArrayGetFirst(printer->queue)) != NULL && next->state != IPP_JSTATE_PENDING)
+      cupsArrayRemove(printer->queue, next);
+
+    if (next && next->slice != IPP3D_SLICE_PENDING && next->slice != IPP3D_SLICE_ACTIVE)
+    {
+      cupsArrayRemove(printer->queue, next);
+
+      next->state         = IPP_JSTATE_PROCESSING;
+      printer->active_job = next;
+    }
+    else
+      next = NULL;
+
+    cupsRWUnlock(&(printer->rwlock));
+
+    if (!next)
+    {
+      cupsCondWait(&(printer->queue_cond), &(printer->queue_mutex), 10.0);
+      continue;
+    }
+
+   /*
+    * Print it...
+    */
+
+    cupsMutexUnlock(&(printer->queue_mutex));
+
+    process_job(next);
+
+    cupsMutexLock(&(printer->queue_mutex));
+  }
+
+  return (NULL);
+}
+
+
 /*
  * 'process_state_message()' - Process a STATE: message from a command.
  */
@@ -4625,6 +5238,51 @@ process_state_message(
 }
 
 
+/*
+ * 'queue_job()' - Queue a job for printing and, for 3D models, slicing.
+ *
+ * The slicing state is set before the job becomes pending so that the print
+ * thread never starts a model that a slicing thread is about to pick up.
+ */
+
+static void
+queue_job(ipp3d_job_t *job)		/* I - Job */
+{
+  ipp3d_printer_t	*printer = job->printer;
+					/* Printer */
+  bool			slice = false;	/* Slice ahead of time? */
+
+
+  cupsMutexLock(&(printer->queue_mutex));
+  cupsRWLockWrite(&(printer->rwlock));
+
+  if (printer->command && NumSlicers > 0 && job->format && (!strcmp(job->format, "model/3mf") || !strcmp(job->format, "application/sla")))
+  {
+    job->slice = IPP3D_SLICE_PENDING;
+    slice      = true;
+  }
+
+  job->state = IPP_JSTATE_PENDING;
+
+  cupsArrayAdd(printer->queue, job);
+
+  cupsRWUnlock(&(printer->rwlock));
+  cupsCondBroadcast(&(printer->queue_cond));
+  cupsMutexUnlock(&(printer->queue_mutex));
+
+  if (slice)
+  {
+   /*
+    * Wake up the (shared) slicing threads...
+    */
+
+    cupsMutexLock(&SliceMutex);
+    cupsCondBroadcast(&SliceCond);
+    cupsMutexUnlock(&SliceMutex);
+  }
+}
+
+
 /*
  * 'register_printer()' - Register a printer object via Bonjour.
  */
@@ -4657,7 +5315,7 @@ register_printer(
   printer_make_and_model    = ippFindAttribute(printer->attrs, "printer-make-and-model", IPP_TAG_TEXT);
   printer_uuid              = ippFindAttribute(printer->attrs, "printer-uuid", IPP_TAG_URI);
 
-  httpAssembleURI(HTTP_URI_CODING_ALL, adminurl, sizeof(adminurl), WEB_SCHEME, NULL, printer->hostname, printer->port, "/");
+  httpAssembleURIf(HTTP_URI_CODING_ALL, adminurl, sizeof(adminurl), WEB_SCHEME, NULL, printer->hostname, printer->port, "%s/", printer->webroot);
 
   for (i = 0, count = ippGetCount(document_format_supported), ptr = formats; i < count; i ++)
   {
@@ -4704,7 +5362,7 @@ register_printer(
   * Build the TXT record for IPP...
   */
 
-  num_txt = cupsAddOption("rp", "ipp/print3d", 0, &txt);
+  num_txt = cupsAddOption("rp", printer->resource + 1, 0, &txt);
   if ((value = ippGetString(printer_make_and_model, 0, NULL)) != NULL)
     num_txt = cupsAddOption("ty", value, num_txt, &txt);
   num_txt = cupsAddOption("adminurl", adminurl, num_txt, &txt);
@@ -4933,37 +5591,90 @@ respond_unsupported(
 
 
 /*
- * 'run_printer()' - Run the printer service.
+ * 'run_printers()' - Run the printer service.
+ *
+ * All printers share the listeners and the client and slicing threads, while
+ * each printer has its own print thread.  Idle client connections are polled
+ * here and queued for the client threads when a request arrives.
  */
 
 static void
-run_printer(ipp3d_printer_t *printer)	/* I - Printer */
+run_printers(void)
 {
-  int		num_fds;		/* Number of file descriptors */
-  struct pollfd	polldata[3];		/* poll() data */
+  int		i;			/* Looping var */
+  size_t	j,			/* Looping var */
+		count,			/* Number of printers */
+		num_fds,		/* Number of file descriptors */
+		num_idle,		/* Number of idle clients */
+		max_idle = 0;		/* Allocated idle clients */
+  struct pollfd	*polldata = NULL,	/* poll() data */
+		*pfd;			/* Current poll() data */
+  ipp3d_client_t **idle = NULL;		/* Idle clients being polled */
+  int		timeout;		/* Timeout in milliseconds */
+  time_t	curtime,		/* Current time */
+		clean_time = 0,		/* Next time to clean out old jobs */
+		idle_time,		/* Next time to close idle clients */
+		next_time;		/* Next time for a printer */
+  ipp3d_printer_t *printer;		/* Current printer */
   ipp3d_client_t *client;		/* New client */
+  cups_thread_t	t;			/* Print/slicing/client thread */
 
 
 #ifndef _WIN32
  /*
-  * Set signal handlers for SIGINT and SIGTERM...
+  * Set signal handlers for SIGINT and SIGTERM...  The handler writes to a pipe
+  * so that poll() wakes up no matter which thread gets the signal.
   */
 
+  if (pipe(WakeupPipe))
+  {
+    perror("Unable to create wakeup pipe");
+  }
+  else
+  {
+   /*
+    * Never block a client thread or the signal handler on a full pipe...
+    */
+
+    fcntl(WakeupPipe[0], F_SETFL, fcntl(WakeupPipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(WakeupPipe[1], F_SETFL, fcntl(WakeupPipe[1], F_GETFL) | O_NONBLOCK);
+  }
+
   signal(SIGINT, signal_handler);
   signal(SIGTERM, signal_handler);
 #endif // !_WIN32
 
  /*
-  * Setup poll() data for the Bonjour service socket and IPv4/6 listeners...
+  * Start the print, slicing, and client threads...
   */
 
-  polldata[0].fd     = printer->ipv4;
-  polldata[0].events = POLLIN;
+  Clients     = cupsArrayNew(NULL, NULL, NULL, 0, NULL, NULL);
+  IdleClients = cupsArrayNew(NULL, NULL, NULL, 0, NULL, NULL);
+  count       = cupsArrayGetCount(Printers);
 
-  polldata[1].fd     = printer->ipv6;
-  polldata[1].events = POLLIN;
+  for (j = 0; j < count; j ++)
+  {
+    if ((t = cupsThreadCreate((cups_thread_func_t)process_jobs, cupsArrayGetElement(Printers, j))) != 0)
+      cupsThreadDetach(t);
+    else
+      perror("Unable to create print thread");
+  }
 
-  num_fds = 2;
+  for (i = 0; i < NumSlicers; i ++)
+  {
+    if ((t = cupsThreadCreate((cups_thread_func_t)slice_jobs, NULL)) != 0)
+      cupsThreadDetach(t);
+    else
+      perror("Unable to create slicing thread");
+  }
+
+  for (i = 0; i < NumThreads; i ++)
+  {
+    if ((t = cupsThreadCreate((cups_thread_func_t)process_clients, NULL)) != 0)
+      cupsThreadDetach(t);
+    else
+      perror("Unable to create client thread");
+  }
 
  /*
   * Loop until we are killed or have a hard error...
@@ -4971,59 +5682,186 @@ run_printer(ipp3d_printer_t *printer)	/* I - Printer */
 
   for (;;)
   {
-    if (poll(polldata, (nfds_t)num_fds, 1000) < 0 && errno != EINTR)
+   /*
+    * Setup poll() data for the listeners, wakeup pipe, and idle clients...
+    */
+
+    curtime   = time(NULL);
+    idle_time = 0;
+
+    cupsMutexLock(&ClientMutex);
+
+    num_idle = cupsArrayGetCount(IdleClients);
+
+    if (!polldata || num_idle > max_idle)
     {
-      perror("poll() failed");
-      break;
+      struct pollfd	*newpoll;	/* New poll() data */
+      ipp3d_client_t	**newidle;	/* New idle clients */
+
+      max_idle = num_idle + 16;
+
+      if ((newpoll = realloc(polldata, (NumListeners + 1 + max_idle) * sizeof(struct pollfd))) != NULL)
+        polldata = newpoll;
+      if ((newidle = realloc(idle, max_idle * sizeof(ipp3d_client_t *))) != NULL)
+        idle = newidle;
+
+      if (!newpoll || !newidle)
+      {
+        cupsMutexUnlock(&ClientMutex);
+        perror("Unable to allocate memory for poll() data");
+        break;
+      }
+    }
+
+    for (num_fds = 0, pfd = polldata; num_fds < NumListeners; num_fds ++, pfd ++)
+    {
+      pfd->fd     = Listeners[num_fds].fd;
+      pfd->events = POLLIN;
     }
 
 #ifndef _WIN32
-    if (StopPrinter)
-      break;
+    if (WakeupPipe[0] >= 0)
+    {
+      pfd->fd     = WakeupPipe[0];
+      pfd->events = POLLIN;
+      pfd ++;
+      num_fds ++;
+    }
 #endif // !_WIN32
 
-    if (polldata[0].revents & POLLIN)
+    for (j = 0; j < num_idle; j ++, pfd ++)
     {
-      if ((client = create_client(printer, printer->ipv4)) != NULL)
-      {
-        cups_thread_t t = cupsThreadCreate((cups_thread_func_t)process_client, client);
+      idle[j]     = (ipp3d_client_t *)cupsArrayGetElement(IdleClients, j);
+      pfd->fd     = httpGetFd(idle[j]->http);
+      pfd->events = POLLIN;
 
-        if (t)
-        {
-          cupsThreadDetach(t);
-        }
-        else
-	{
-	  perror("Unable to create client thread");
-	  delete_client(client);
-	}
-      }
+      if (!idle_time || (idle[j]->idle_time + 30) < idle_time)
+        idle_time = idle[j]->idle_time + 30;
     }
 
-    if (polldata[1].revents & POLLIN)
+    cupsMutexUnlock(&ClientMutex);
+
+   /*
+    * Wait for a connection, a request, or the next time old jobs or idle
+    * clients need to be cleaned...
+    */
+
+    if (clean_time && clean_time <= curtime)
     {
-      if ((client = create_client(printer, printer->ipv6)) != NULL)
+      for (j = 0, clean_time = 0; j < count; j ++)
       {
-        cups_thread_t t = cupsThreadCreate((cups_thread_func_t)process_client, client);
+        printer = (ipp3d_printer_t *)cupsArrayGetElement(Printers, j);
 
-        if (t)
-        {
-          cupsThreadDetach(t);
-        }
-        else
-	{
-	  perror("Unable to create client thread");
-	  delete_client(client);
-	}
+        if ((next_time = clean_jobs(printer)) != 0 && (!clean_time || next_time < clean_time))
+          clean_time = next_time;
       }
     }
 
+    if (clean_time && (!idle_time || clean_time < idle_time))
+      next_time = clean_time;
+    else
+      next_time = idle_time;
+
+    if (next_time)
+      timeout = next_time > curtime ? (int)(next_time - curtime) * 1000 : 0;
+    else
+      timeout = -1;
+
+#ifdef _WIN32
+   /*
+    * There is no wakeup pipe on Windows, so check for new idle clients every
+    * second...
+    */
+
+    if (timeout < 0 || timeout > 1000)
+      timeout = 1000;
+#endif // _WIN32
+
+    if (poll(polldata, (nfds_t)(num_fds + num_idle), timeout) < 0 && errno != EINTR)
+    {
+      perror("poll() failed");
+      break;
+    }
+
+#ifndef _WIN32
+    if (StopPrinter)
+      break;
+
+    if (WakeupPipe[0] >= 0 && (polldata[NumListeners].revents & POLLIN))
+    {
+      char	buffer[256];		/* Wakeup data */
+      ssize_t	bytes;			/* Bytes read */
+
+      while ((bytes = read(WakeupPipe[0], buffer, sizeof(buffer))) > 0);
+
+      if (bytes < 0 && errno != EAGAIN)
+        perror("Unable to read wakeup pipe");
+    }
+#endif // !_WIN32
+
    /*
-    * Clean out old jobs...
+    * Queue clients that have sent a request for the next available client
+    * thread, and close clients that have been idle for too long...
     */
 
-    clean_jobs(printer);
+    curtime = time(NULL);
+
+    cupsMutexLock(&ClientMutex);
+
+    for (j = 0, pfd = polldata + num_fds; j < num_idle; j ++, pfd ++)
+    {
+      client = idle[j];
+
+      if (pfd->revents & (POLLIN | POLLHUP | POLLERR))
+      {
+        cupsArrayRemove(IdleClients, client);
+        cupsArrayAdd(Clients, client);
+        cupsCondBroadcast(&ClientCond);
+      }
+      else if ((client->idle_time + 30) <= curtime)
+      {
+        cupsArrayRemove(IdleClients, client);
+        delete_client(client);
+      }
+    }
+
+    cupsMutexUnlock(&ClientMutex);
+
+    for (j = 0, pfd = polldata; j < NumListeners; j ++, pfd ++)
+    {
+      if (!(pfd->revents & POLLIN))
+        continue;
+
+     /*
+      * Clients start with the first printer; each request then selects the
+      * printer using its resource path...
+      */
+
+      if ((client = create_client((ipp3d_printer_t *)cupsArrayGetElement(Printers, 0), pfd->fd)) == NULL)
+        continue;
+
+     /*
+      * Poll the new connection until the client sends its first request...
+      */
+
+      client->idle_time = curtime;
+
+      cupsMutexLock(&ClientMutex);
+      cupsArrayAdd(IdleClients, client);
+      cupsMutexUnlock(&ClientMutex);
+
+     /*
+      * The client may be creating a job, so check for old jobs at least once a
+      * minute...
+      */
+
+      if (!clean_time)
+        clean_time = time(NULL) + 60;
+    }
   }
+
+  free(polldata);
+  free(idle);
 }
 
 
@@ -5060,7 +5898,7 @@ show_materials(ipp3d_client_t  *client)	/* I - Client connection */
 
   html_header(client, printer->dnssd_name, 0);
 
-  html_printf(client, "<p class=\"buttons\"><a class=\"button\" href=\"/\">Show Jobs</a></p>\n");
+  html_printf(client, "<p class=\"buttons\"><a class=\"button\" href=\"%s/\">Show Jobs</a></p>\n", printer->webroot);
   html_printf(client, "<h1><img align=\"left\" src=\"/icon.png\" width=\"64\" height=\"64\">%s Materials</h1>\n", printer->dnssd_name);
 
   if ((materials_db = ippFindAttribute(printer->attrs, "materials-col-database", IPP_TAG_BEGIN_COLLECTION)) == NULL)
@@ -5135,8 +5973,18 @@ show_materials(ipp3d_client_t  *client)	/* I - Client connection */
 
     if (!materials_ready)
       materials_ready = ippAddOutOfBand(printer->attrs, IPP_TAG_PRINTER, IPP_TAG_NOVALUE, "materials-col-ready");
+    else
+      printer->state_reasons &= (ipp3d_preason_t)~IPP3D_PREASON_MATERIAL_EMPTY;
 
     cupsRWUnlock(&printer->rwlock);
+
+   /*
+    * Wake up the print thread if it is waiting for material...
+    */
+
+    cupsMutexLock(&(printer->queue_mutex));
+    cupsCondBroadcast(&(printer->queue_cond));
+    cupsMutexUnlock(&(printer->queue_mutex));
   }
 
  /*
@@ -5144,7 +5992,7 @@ show_materials(ipp3d_client_t  *client)	/* I - Client connection */
   */
 
   if (printer->web_forms)
-    html_printf(client, "<form method=\"GET\" action=\"/materials\">\n");
+    html_printf(client, "<form method=\"GET\" action=\"%s/materials\">\n", printer->webroot);
 
   html_printf(client, "<table class=\"form\" summary=\"Materials\">\n");
 
@@ -5306,13 +6154,234 @@ show_status(ipp3d_client_t  *client)	/* I - Client connection */
 static void
 signal_handler(int signum)		/* I - Signal number (not used) */
 {
+  int	saved_errno = errno;		/* Saved errno value */
+
+
   (void)signum;
 
   StopPrinter = 1;
+
+ /*
+  * A full pipe means poll() is already going to wake up, so just preserve the
+  * errno value for the interrupted thread...
+  */
+
+  if (WakeupPipe[1] >= 0 && write(WakeupPipe[1], "", 1) < 0)
+    errno = saved_errno;
 }
 #endif // !_WIN32
 
 
+/*
+ * 'slice_job()' - Slice a 3D model to G-code in the spool directory.
+ *
+ * The print command is run without a device URI so that it writes the
+ * G-code to the standard output, which is saved as "job-name.gcode".
+ */
+
+static bool				/* O - `true` on success, `false` on failure */
+slice_job(ipp3d_job_t *job)		/* I - Job */
+{
+#ifdef _WIN32
+  (void)job;
+
+  return (false);
+
+#else
+  int 			pid,		/* Process ID */
+			status;		/* Exit status */
+  struct timeval	start,		/* Start time */
+			end;		/* End time */
+  char			*myargv[3],	/* Command-line arguments */
+			*myenvp[400];	/* Environment variables */
+  int			myenvc;		/* Number of environment variables */
+  char			gcode[1024];	/* G-code file */
+  int			gcode_fd,	/* G-code file descriptor */
+			null_fd;	/* /dev/null for stdin and stderr */
+
+
+  if ((gcode_fd = create_job_file(job, gcode, sizeof(gcode), job->printer->directory, "gcode")) < 0)
+  {
+    fprintf(stderr, "[Job %d] Unable to create \"%s\": %s\n", job->id, gcode, strerror(errno));
+    return (false);
+  }
+
+  if ((myenvc = create_job_env(job, job->format, false, myenvp, (int)(sizeof(myenvp) / sizeof(myenvp[0])))) < 0)
+  {
+    close(gcode_fd);
+    unlink(gcode);
+    return (false);
+  }
+
+  myargv[0] = job->printer->command;
+  myargv[1] = job->filename;
+  myargv[2] = NULL;
+
+  fprintf(stderr, "[Job %d] Slicing with command \"%s %s\".\n", job->id, job->printer->command, job->filename);
+  gettimeofday(&start, NULL);
+
+  if ((pid = fork()) == 0)
+  {
+   /*
+    * Child comes here...
+    */
+
+    null_fd = open("/dev/null", O_RDWR);
+
+    dup2(null_fd, 0);
+    dup2(gcode_fd, 1);
+    if (Verbosity < 2)
+      dup2(null_fd, 2);
+
+    close(null_fd);
+    close(gcode_fd);
+
+    execve(job->printer->command, myargv, myenvp);
+    exit(errno);
+  }
+
+  while (myenvc > 0)
+    free(myenvp[-- myenvc]);
+
+  close(gcode_fd);
+
+  if (pid < 0)
+  {
+    fprintf(stderr, "[Job %d] Unable to start slicing command: %s\n", job->id, strerror(errno));
+    unlink(gcode);
+    return (false);
+  }
+
+ /*
+  * Record the process ID so that canceling the job can stop the command...
+  */
+
+  cupsRWLockWrite(&(job->printer->rwlock));
+  job->slice_pid = pid;
+  if (job->cancel || job->state >= IPP_JSTATE_CANCELED)
+    kill(pid, SIGTERM);			/* Canceled before the command started */
+  cupsRWUnlock(&(job->printer->rwlock));
+
+#  ifdef HAVE_WAITPID
+  while (waitpid(pid, &status, 0) < 0);
+#  else
+  while (wait(&status) < 0);
+#  endif /* HAVE_WAITPID */
+
+  cupsRWLockWrite(&(job->printer->rwlock));
+  job->slice_pid = 0;
+  cupsRWUnlock(&(job->printer->rwlock));
+
+  gettimeofday(&end, NULL);
+
+  if (status)
+  {
+    if (WIFEXITED(status))
+      fprintf(stderr, "[Job %d] Slicing command \"%s\" exited with status %d.\n", job->id, job->printer->command, WEXITSTATUS(status));
+    else
+      fprintf(stderr, "[Job %d] Slicing command \"%s\" terminated with signal %d.\n", job->id, job->printer->command, WTERMSIG(status));
+
+    unlink(gcode);
+    return (false);
+  }
+
+  fprintf(stderr, "[Job %d] Sliced to \"%s\" in %.3f seconds.\n", job->id, gcode, end.tv_sec - start.tv_sec + 0.000001 * (end.tv_usec - start.tv_usec));
+
+  job->gcode = strdup(gcode);
+
+  return (job->gcode != NULL);
+#endif /* _WIN32 */
+}
+
+
+/*
+ * 'slice_jobs()' - Slice queued 3D models ahead of printing.
+ *
+ * The slicing threads are shared by all printers.  Each thread looks at the
+ * printers in turn, starting after the last printer it served, and slices the
+ * first queued job that needs it so that models are sliced in the order they
+ * will be printed.
+ */
+
+static void *				/* O - Thread exit status */
+slice_jobs(void *data)			/* I - Thread data (unused) */
+{
+  size_t		i,		/* Looping var */
+			count,		/* Number of printers */
+			first = 0;	/* First printer to look at */
+  ipp3d_printer_t	*printer;	/* Current printer */
+  ipp3d_job_t		*job,		/* Current job */
+			*next;		/* Next job to slice */
+  bool			sliced;		/* Sliced successfully? */
+
+
+  (void)data;
+
+  count = cupsArrayGetCount(Printers);
+
+  cupsMutexLock(&SliceMutex);
+
+  for (;;)
+  {
+   /*
+    * Find the next job that needs slicing...
+    */
+
+    for (i = 0, next = NULL; i < count && !next; i ++)
+    {
+      printer = (ipp3d_printer_t *)cupsArrayGetElement(Printers, (first + i) % count);
+
+      cupsMutexLock(&(printer->queue_mutex));
+      cupsRWLockRead(&(printer->rwlock));
+
+      for (job = (ipp3d_job_t *)cupsArrayGetFirst(printer->queue); job; job = (ipp3d_job_t *)cupsArrayGetNext(printer->queue))
+      {
+        if (job->state == IPP_JSTATE_PENDING && job->slice == IPP3D_SLICE_PENDING)
+        {
+          next = job;
+          break;
+        }
+      }
+
+      cupsRWUnlock(&(printer->rwlock));
+
+      if (next)
+      {
+        next->slice = IPP3D_SLICE_ACTIVE;
+        first       = (first + i + 1) % count;
+      }
+
+      cupsMutexUnlock(&(printer->queue_mutex));
+    }
+
+    if (!next)
+    {
+      cupsCondWait(&SliceCond, &SliceMutex, 10.0);
+      continue;
+    }
+
+   /*
+    * Slice it while the printer works on earlier jobs...
+    */
+
+    cupsMutexUnlock(&SliceMutex);
+
+    sliced = slice_job(next);
+
+    printer = next->printer;
+
+    cupsMutexLock(&(printer->queue_mutex));
+    next->slice = sliced ? IPP3D_SLICE_DONE : IPP3D_SLICE_FAILED;
+    cupsCondBroadcast(&(printer->queue_cond));
+    cupsMutexUnlock(&(printer->queue_mutex));
+
+    cupsMutexLock(&SliceMutex);
+  }
+
+  return (NULL);
+}
+
+
 /*
  * 'time_string()' - Return the local time in hours, minutes, and seconds.
  */
@@ -5341,12 +6410,15 @@ static void
 usage(int status)			/* O - Exit status */
 {
   puts("Usage: ipp3dprinter [options] \"name\"");
+  puts("       ipp3dprinter [options] -C config-directory");
   puts("Options:");
   puts("--help                  Show program help");
   puts("--no-web-forms          Disable web forms for media and supplies");
   puts("--version               Show program version");
+  puts("-C config-directory     Load printers from a directory of conf files");
   puts("-D device-uri           Set the device URI for the printer");
   puts("-K keypath              Set location of server X.509 certificates and keys.");
+  puts("-L address[:port]       Listen on the address or UNIX domain socket path");
   puts("-M manufacturer         Set manufacturer name (default=Test)");
   puts("-a filename.conf        Load printer attributes from conf file");
   puts("-c command              Set print command");
@@ -5359,6 +6431,8 @@ usage(int status)			/* O - Exit status */
   puts("-n hostname             Set hostname for printer");
   puts("-p port                 Set port number for printer");
   puts("-r subtype,[subtype]    Set DNS-SD service subtype");
+  puts("-s slicers              Set number of slicing threads (default=1)");
+  puts("-t threads              Set number of client threads (default=10)");
   puts("-v                      Be verbose");
 
   exit(status);
@@ -1,65 +1,88 @@
 /*
  * ippdoclint utility for checking common print file formats.
  *
- * Copyright © 2018-2022 by the Printer Working Group.
+ * Copyright © 2018-2022 by the Printer Working Group.
  *
  * Licensed under Apache License v2.0.  See the file "LICENSE" for more
  * information.
  */
 
 #include <config.h>
+#include "../server/doclint.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
-#include <limits.h>
-#include <cups/cups.h>
-#include <cups/raster.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <cups/dir.h>
+#include <cups/json.h>
+#include <cups/thread.h>
+#ifdef _WIN32
+#  include <sys/timeb.h>
+#else
+#  include <unistd.h>
+#  include <sys/time.h>
+#endif /* _WIN32 */
 
-#ifdef HAVE_COREGRAPHICS
-#  include <CoreGraphics/CoreGraphics.h>
-#endif /* HAVE_COREGRAPHICS */
+
+/*
+ * Constants...
+ */
+
+#define BATCH_MAX_THREADS 32		/* Maximum number of batch threads */
 
 
 /*
  * Local types...
  */
 
-typedef struct lint_counters_s		/**** Page/Sheet/Etc. Counters ****/
+typedef struct batch_file_s		/**** File in a Batch ****/
 {
-  int	blank,				/* Number of blank pages/sheets/impressions */
-	full_color,			/* Number of color pages/sheets/impressions */
-	monochrome;			/* Number of monochrome pages/sheets/impressions */
-} lint_counters_t;
+  char			*filename;	/* Filename */
+  const char		*content_type;	/* MIME media type or `NULL` if unknown */
+  doclint_results_t	results;	/* Lint results */
+  bool			ok;		/* Is the file OK? */
+  double		elapsed;	/* Time to check the file in seconds */
+  cups_array_t		*errors,	/* Error messages */
+			*warnings;	/* Warning messages */
+} batch_file_t;
+
+typedef struct batch_s			/**** Batch of Files ****/
+{
+  cups_mutex_t		mutex;		/* Mutex for next_file */
+  batch_file_t		*files;		/* Files to check */
+  size_t		num_files,	/* Number of files */
+			alloc_files,	/* Allocated files */
+			next_file;	/* Next file to check */
+  const char		*content_type;	/* MIME media type from command-line */
+  size_t		num_options;	/* Number of options */
+  cups_option_t		*options;	/* Options */
+} batch_t;
 
 
 /*
  * Local globals...
  */
 
-static int		Errors = 0;		/* Number of errors found */
-static lint_counters_t	Impressions = { 0, 0, 0 },
-						/* Number of impressions */
-			ImpressionsTwoSided = { 0, 0, 0 },
-						/* Number of two-sided impressions */
-			Pages = { 0, 0, 0 },	/* Number of input pages */
-			Sheets = { 0, 0, 0 };	/* Number of media sheets */
 static int		Verbosity = 0;		/* Log level */
-static int		Warnings = 0;		/* Number of warnings found */
 
 
 /*
  * Local functions...
  */
 
-static int	lint_jpeg(const char *filename, size_t num_options, cups_option_t *options);
-static int	lint_pdf(const char *filename, size_t num_options, cups_option_t *options);
-static int	lint_raster(const char *filename, const char *content_type);
+static bool	batch_add(batch_t *batch, const char *filename, bool from_dir);
+static void	batch_message_cb(batch_file_t *file, doclint_level_t level, const char *message);
+static int	batch_run(batch_t *batch, int num_threads, const char *report);
+static void	*batch_worker(batch_t *batch);
+static cups_json_t *json_add_counters(cups_json_t *parent, cups_json_t *after, const char *key, const doclint_counters_t *counters);
+static cups_json_t *json_add_number(cups_json_t *parent, cups_json_t *after, const char *key, double value);
+static cups_json_t *json_add_strings(cups_json_t *parent, cups_json_t *after, const char *key, cups_array_t *strings);
 static size_t	load_env_options(cups_option_t **options);
-static int	read_apple_raster_header(cups_file_t *fp, cups_page_header_t *header);
-static int	read_pwg_raster_header(cups_file_t *fp, unsigned syncword, cups_page_header_t *header);
-static int	read_raster_image(cups_file_t *fp, cups_page_header_t *header, unsigned page);
+static void	message_cb(void *cb_data, doclint_level_t level, const char *message);
+static void	progress_cb(void *cb_data, const doclint_results_t *results);
+static double	time_seconds(void);
 static void	usage(int status);
 
 
@@ -74,9 +97,21 @@ main(int  argc,				/* I - Number of command-line arguments */
   int		i;			/* Looping var */
   const char	*opt,			/* Current option */
 		*content_type,		/* Content type of file */
-		*filename;		/* File to check */
+		*filename,		/* File to check */
+		*report = NULL;		/* JSON report file */
+  const char	**filenames;		/* Files to check */
+  int		num_files = 0,		/* Number of files to check */
+		num_threads = 0;	/* Number of batch threads */
+  struct stat	fileinfo;		/* File information */
   size_t	num_options;		/* Number of options */
   cups_option_t	*options;		/* Options */
+  int		streaming;		/* Reading from the standard input? */
+  doclint_results_t results;		/* Lint results */
+  const doclint_counters_t *imp = &results.impressions,
+			*imp2 = &results.impressions_two_sided,
+			*pages = &results.pages,
+			*sheets = &results.sheets;
+					/* Counters */
 
 
  /*
@@ -84,9 +119,14 @@ main(int  argc,				/* I - Number of command-line arguments */
   */
 
   content_type = getenv("CONTENT_TYPE");
-  filename     = NULL;
   num_options  = load_env_options(&options);
 
+  if ((filenames = calloc((size_t)argc, sizeof(char *))) == NULL)
+  {
+    perror("ippdoclint");
+    return (1);
+  }
+
   if ((opt = getenv("SERVER_LOGLEVEL")) != NULL)
   {
     if (!strcmp(opt, "debug"))
@@ -113,7 +153,7 @@ main(int  argc,				/* I - Number of command-line arguments */
 	usage(1);
       }
     }
-    else if (argv[i][0] == '-')
+    else if (argv[i][0] == '-' && argv[i][1])
     {
       for (opt = argv[i] + 1; *opt; opt ++)
       {
@@ -135,6 +175,20 @@ main(int  argc,				/* I - Number of command-line arguments */
 	      num_options = cupsParseOptions(argv[i], /*end*/NULL, num_options, &options);
 	      break;
 
+	  case 'j' : /* Number of files to check at once */
+	      i ++;
+	      if (i >= argc || (num_threads = atoi(argv[i])) < 1)
+	        usage(1);
+	      break;
+
+	  case 'r' : /* JSON report file */
+	      i ++;
+	      if (i >= argc)
+	        usage(1);
+
+	      report = argv[i];
+	      break;
+
 	  case 'v' : /* Be verbose... */
 	      Verbosity ++;
 	      break;
@@ -146,60 +200,60 @@ main(int  argc,				/* I - Number of command-line arguments */
 	}
       }
     }
-    else if (!filename)
-      filename = argv[i];
     else
-      usage(1);
+      filenames[num_files ++] = argv[i];
   }
 
  /*
   * Check that we have everything we need...
   */
 
-  if (!filename)
+  if (num_files == 0)
     usage(1);
 
-  if (!content_type)
+  if (num_files > 1 || report || (!stat(filenames[0], &fileinfo) && S_ISDIR(fileinfo.st_mode)))
   {
-    if ((opt = strrchr(filename, '.')) != NULL)
+   /*
+    * Check a batch of files and/or directories...
+    */
+
+    batch_t	batch;			/* Batch of files */
+
+    memset(&batch, 0, sizeof(batch));
+    batch.content_type = content_type;
+    batch.num_options  = num_options;
+    batch.options      = options;
+
+    for (i = 0; i < num_files; i ++)
     {
-      if (!strcmp(opt, ".pdf"))
-        content_type = "application/pdf";
-      else if (!strcmp(opt, ".jpg") || !strcmp(opt, ".jpeg"))
-        content_type = "image/jpeg";
-      else if (!strcmp(opt, ".pwg"))
-        content_type = "image/pwg-raster";
-      else if (!strcmp(opt, ".urf"))
-        content_type = "image/urf";
+      if (!batch_add(&batch, filenames[i], false))
+        return (1);
     }
+
+    return (batch_run(&batch, num_threads, report ? report : "-"));
   }
 
+  filename = filenames[0];
+
+  streaming = !strcmp(filename, "-");
+
+  if (!content_type && !streaming)
+    content_type = doclintGetContentType(filename);
+
   if (!content_type)
   {
     fprintf(stderr, "ERROR: Unknown format for \"%s\", please specify with '-i' option.\n", filename);
     usage(1);
   }
-  else if (!strcmp(content_type, "image/jpeg"))
-  {
-    if (!lint_jpeg(filename, num_options, options))
-      return (1);
-  }
-  else if (!strcmp(content_type, "application/pdf"))
-  {
-    if (!lint_pdf(filename, num_options, options))
-      return (1);
-  }
-  else if (!strcmp(content_type, "image/pwg-raster") || !strcmp(content_type, "image/urf"))
-  {
-    if (!lint_raster(filename, content_type))
-      return (1);
-  }
-  else
+  else if (!doclintIsSupported(content_type))
   {
     fprintf(stderr, "ERROR: Unsupported format \"%s\" for \"%s\".\n", content_type, filename);
     usage(1);
   }
 
+  if (!doclintFile(filename, content_type, num_options, options, message_cb, streaming ? progress_cb : NULL, NULL, &results))
+    return (1);
+
  /*
   * Write ATTR lines for the following Job attributes:
   *
@@ -219,509 +273,386 @@ main(int  argc,				/* I - Number of command-line arguments */
   * Also write a STATE line if the document format is bad...
   */
 
-  if (Errors)
+  if (results.errors)
     fputs("STATE: +document-format-error\n", stderr);
 
-  fprintf(stderr, "ATTR: job-pages=%d job-pages-completed=%d\n", Pages.full_color + Pages.monochrome, Pages.full_color + Pages.monochrome);
-  fprintf(stderr, "ATTR: job-pages-col={full-color=%d monochrome=%d} job-pages-completed-col={full-color=%d monochrome=%d}\n", Pages.full_color, Pages.monochrome, Pages.full_color, Pages.monochrome);
-
-  fprintf(stderr, "ATTR: job-impressions=%d job-impressions-completed=%d\n", Impressions.blank + Impressions.full_color + Impressions.monochrome + ImpressionsTwoSided.blank + ImpressionsTwoSided.full_color + ImpressionsTwoSided.monochrome, Impressions.blank + Impressions.full_color + Impressions.monochrome + Impressions.monochrome + ImpressionsTwoSided.blank + ImpressionsTwoSided.full_color + ImpressionsTwoSided.monochrome);
-  fprintf(stderr, "ATTR: job-impressions-col={blank=%d blank-two-sided=%d full-color=%d full-color-two-sided=%d monochrome=%d monochrome-two-sided=%d} job-impressions-completed-col={blank=%d blank-two-sided=%d full-color=%d full-color-two-sided=%d monochrome=%d monochrome-two-sided=%d}\n", Impressions.blank, ImpressionsTwoSided.blank, Impressions.full_color, ImpressionsTwoSided.full_color, Impressions.monochrome, ImpressionsTwoSided.monochrome, Impressions.blank, ImpressionsTwoSided.blank, Impressions.full_color, ImpressionsTwoSided.full_color, Impressions.monochrome, ImpressionsTwoSided.monochrome);
+  fprintf(stderr, "ATTR: job-pages=%d job-pages-completed=%d\n", pages->full_color + pages->monochrome, pages->full_color + pages->monochrome);
+  fprintf(stderr, "ATTR: job-pages-col={full-color=%d monochrome=%d} job-pages-completed-col={full-color=%d monochrome=%d}\n", pages->full_color, pages->monochrome, pages->full_color, pages->monochrome);
 
-  Sheets.blank      = Impressions.blank + (ImpressionsTwoSided.blank + 1) / 2;
-  Sheets.full_color = Impressions.full_color + (ImpressionsTwoSided.full_color + 1) / 2;
-  Sheets.monochrome = Impressions.monochrome + (ImpressionsTwoSided.monochrome + 1) / 2;
+  fprintf(stderr, "ATTR: job-impressions=%d job-impressions-completed=%d\n", imp->blank + imp->full_color + imp->monochrome + imp2->blank + imp2->full_color + imp2->monochrome, imp->blank + imp->full_color + imp->monochrome + imp2->blank + imp2->full_color + imp2->monochrome);
+  fprintf(stderr, "ATTR: job-impressions-col={blank=%d blank-two-sided=%d full-color=%d full-color-two-sided=%d monochrome=%d monochrome-two-sided=%d} job-impressions-completed-col={blank=%d blank-two-sided=%d full-color=%d full-color-two-sided=%d monochrome=%d monochrome-two-sided=%d}\n", imp->blank, imp2->blank, imp->full_color, imp2->full_color, imp->monochrome, imp2->monochrome, imp->blank, imp2->blank, imp->full_color, imp2->full_color, imp->monochrome, imp2->monochrome);
 
-  fprintf(stderr, "ATTR: job-media-sheets=%d job-media-sheets-completed=%d\n", Sheets.blank + Sheets.full_color + Sheets.monochrome, Sheets.blank + Sheets.full_color + Sheets.monochrome);
-  fprintf(stderr, "ATTR: job-media-sheets-col={blank=%d full-color=%d monochrome=%d} job-media-sheets-completed-col={blank=%d full-color=%d monochrome=%d}\n", Sheets.blank, Sheets.full_color, Sheets.monochrome, Sheets.blank, Sheets.full_color, Sheets.monochrome);
+  fprintf(stderr, "ATTR: job-media-sheets=%d job-media-sheets-completed=%d\n", sheets->blank + sheets->full_color + sheets->monochrome, sheets->blank + sheets->full_color + sheets->monochrome);
+  fprintf(stderr, "ATTR: job-media-sheets-col={blank=%d full-color=%d monochrome=%d} job-media-sheets-completed-col={blank=%d full-color=%d monochrome=%d}\n", sheets->blank, sheets->full_color, sheets->monochrome, sheets->blank, sheets->full_color, sheets->monochrome);
 
   return (0);
 }
 
 
 /*
- * 'lint_jpeg()' - Check a JPEG file.
+ * 'batch_add()' - Add a file or directory to a batch.
+ *
+ * Directories are scanned recursively for files with a known extension.
  */
 
-static int				/* O - 1 on success, 0 on failure */
-lint_jpeg(const char    *filename,	/* I - File to check */
-          size_t        num_options,	/* I - Number of options */
-          cups_option_t *options)	/* I - Options */
+static bool				/* O - `true` on success, `false` on error */
+batch_add(batch_t    *batch,		/* I - Batch of files */
+          const char *filename,		/* I - File or directory */
+          bool       from_dir)		/* I - Found while scanning a directory? */
 {
-  const char	*value;			/* Option value */
-  int		copies;			/* copies value */
-  const char	*color_mode;		/* print-color-mode value */
-  cups_file_t	*fp;			/* File pointer */
-  unsigned char	buffer[65536],		/* Read buffer */
-		*bufptr,		/* Pointer info buffer */
-		*bufend;		/* Pointer to end of buffer */
-  ssize_t	bytes;			/* Bytes read */
-  size_t	length;			/* Length of marker */
-
-
-  if ((value = cupsGetOption("copies", num_options, options)) != NULL)
-    copies = atoi(value);
-  else
-    copies = 1;
+  struct stat	fileinfo;		/* File information */
+  batch_file_t	*file;			/* New file */
+  const char	*content_type;		/* MIME media type */
 
-  color_mode = cupsGetOption("print-color-mode", num_options, options);
 
-  if ((fp = cupsFileOpen(filename, "rb")) == NULL)
+  if (!strcmp(filename, "-"))
   {
-    fprintf(stderr, "ERROR: Unable to open \"%s\": %s\n", filename, cupsGetErrorString());
-    return (0);
+    fputs("ERROR: The standard input cannot be checked in batch mode.\n", stderr);
+    return (false);
   }
 
-  if ((bytes = cupsFileRead(fp, (char *)buffer, sizeof(buffer))) < 3)
+  if (stat(filename, &fileinfo))
   {
-    fputs("ERROR: Unable to read JPEG file.\n", stderr);
-    cupsFileClose(fp);
-    return (0);
+    fprintf(stderr, "ERROR: Unable to access \"%s\": %s\n", filename, strerror(errno));
+    return (false);
   }
 
-  if (memcmp(buffer, "\377\330\377", 3))
+  if (S_ISDIR(fileinfo.st_mode))
   {
-    fputs("ERROR: Bad JPEG file.\n", stderr);
-    cupsFileClose(fp);
-    return (0);
-  }
-
-  bufptr = buffer + 2;
-  bufend = buffer + bytes;
-
- /*
-  * Scan the file for a SOFn marker, then we can get the dimensions...
-  */
+    cups_dir_t		*dir;		/* Directory */
+    cups_dentry_t	*dent;		/* Directory entry */
+    char		path[1024];	/* Path to directory entry */
+    bool		ret = true;	/* Return value */
 
-  while (bufptr < bufend)
-  {
-    if (*bufptr == 0xff)
+    if ((dir = cupsDirOpen(filename)) == NULL)
     {
-      bufptr ++;
-
-      if (bufptr >= bufend)
-      {
-       /*
-	* If we are at the end of the current buffer, re-fill and continue...
-	*/
-
-	if ((bytes = cupsFileRead(fp, (char *)buffer, sizeof(buffer))) <= 0)
-	{
-	  fputs("ERROR: Short JPEG file.\n", stderr);
-	  cupsFileClose(fp);
-	  return (0);
-	}
-
-	bufptr = buffer;
-	bufend = buffer + bytes;
-      }
-
-      if (*bufptr == 0xff)
-	continue;
+      fprintf(stderr, "ERROR: Unable to open directory \"%s\": %s\n", filename, cupsGetErrorString());
+      return (false);
+    }
 
-      if ((bufptr + 16) >= bufend)
-      {
-       /*
-	* Read more of the marker...
-	*/
+    while (ret && (dent = cupsDirRead(dir)) != NULL)
+    {
+      if (dent->filename[0] == '.')
+        continue;
 
-	bytes = (ssize_t)(bufend - bufptr);
+      snprintf(path, sizeof(path), "%s/%s", filename, dent->filename);
 
-	memmove(buffer, bufptr, bytes);
-	bufptr = buffer;
-	bufend = buffer + bytes;
+      if (!S_ISDIR(dent->fileinfo.st_mode) && !doclintGetContentType(path))
+        continue;			/* Skip files we don't know about */
 
-	if ((bytes = cupsFileRead(fp, (char *)bufend, sizeof(buffer) - (size_t)bytes)) <= 0)
-	{
-	  fputs("ERROR: Short JPEG file.\n", stderr);
-	  cupsFileClose(fp);
-	  return (0);
-	}
+      ret = batch_add(batch, path, true);
+    }
 
-	bufend += bytes;
-      }
+    cupsDirClose(dir);
 
-      length = (size_t)((bufptr[1] << 8) | bufptr[2]);
+    return (ret);
+  }
 
-      if ((*bufptr >= 0xc0 && *bufptr <= 0xc3) || (*bufptr >= 0xc5 && *bufptr <= 0xc7) || (*bufptr >= 0xc9 && *bufptr <= 0xcb) || (*bufptr >= 0xcd && *bufptr <= 0xcf))
-      {
-       /*
-	* SOFn marker, look for dimensions...
-	*/
-
-	int width  = (bufptr[6] << 8) | bufptr[7];
-	int height = (bufptr[4] << 8) | bufptr[5];
-	int ncolors = bufptr[8];
-
-        fprintf(stderr, "DEBUG: JPEG image is %dx%dx%d\n", width, height, ncolors);
-        if (ncolors > 1 && (!color_mode || strcmp(color_mode, "monochrome")))
-        {
-          Pages.full_color ++;
-          Impressions.full_color += copies;
-	}
-	else
-	{
-	  Pages.monochrome ++;
-	  Impressions.monochrome += copies;
-	}
-        break;
-      }
+ /*
+  * Files found in directories always use the extension to determine the
+  * format, otherwise the "-i" option (if any) is used...
+  */
 
-     /*
-      * Skip past this marker...
-      */
+  if (from_dir || !batch->content_type)
+    content_type = doclintGetContentType(filename);
+  else
+    content_type = batch->content_type;
 
-      bufptr ++;
-      bytes = (ssize_t)(bufend - bufptr);
+  if (batch->num_files >= batch->alloc_files)
+  {
+    size_t	alloc_files = batch->alloc_files ? 2 * batch->alloc_files : 64;
+					/* New allocation */
 
-      while (length >= bytes)
-      {
-	length -= (size_t)bytes;
+    if ((file = realloc(batch->files, alloc_files * sizeof(batch_file_t))) == NULL)
+    {
+      fprintf(stderr, "ERROR: Unable to allocate memory for \"%s\": %s\n", filename, strerror(errno));
+      return (false);
+    }
 
-	if ((bytes = cupsFileRead(fp, (char *)buffer, sizeof(buffer))) <= 0)
-	{
-	  fputs("ERROR: Short JPEG file.\n", stderr);
-	  cupsFileClose(fp);
-	  return (0);
-	}
+    batch->files       = file;
+    batch->alloc_files = alloc_files;
+  }
 
-	bufptr = buffer;
-	bufend = buffer + bytes;
-      }
+  file = batch->files + batch->num_files;
+  memset(file, 0, sizeof(batch_file_t));
 
-      if (length > bytes)
-	break;
+  file->filename     = strdup(filename);
+  file->content_type = content_type;
+  file->errors       = cupsArrayNew(NULL, NULL, NULL, 0, (cups_acopy_cb_t)strdup, (cups_afree_cb_t)free);
+  file->warnings     = cupsArrayNew(NULL, NULL, NULL, 0, (cups_acopy_cb_t)strdup, (cups_afree_cb_t)free);
 
-      bufptr += length;
-    }
+  if (!file->filename || !file->errors || !file->warnings)
+  {
+    fprintf(stderr, "ERROR: Unable to allocate memory for \"%s\": %s\n", filename, strerror(errno));
+    free(file->filename);
+    cupsArrayDelete(file->errors);
+    cupsArrayDelete(file->warnings);
+    return (false);
   }
 
-  cupsFileClose(fp);
+  batch->num_files ++;
 
-  return (1);
+  return (true);
 }
 
 
 /*
- * 'lint_pdf()' - Check a PDF file.
+ * 'batch_message_cb()' - Save an error or warning message for a file in a batch.
  */
 
-static int				/* O - 1 on success, 0 on failure */
-lint_pdf(const char    *filename,	/* I - File to check */
-	 size_t        num_options,	/* I - Number of options */
-	 cups_option_t *options)	/* I - Options */
+static void
+batch_message_cb(
+    batch_file_t    *file,		/* I - File */
+    doclint_level_t level,		/* I - Message level */
+    const char      *message)		/* I - Message */
 {
-  const char		*value;		/* Option value */
-  int			copies;		/* copies value */
-  const char		*color_mode;	/* print-color-mode value */
-  int			duplex;		/* Duplex printing? */
-  int			first_page,	/* First page in range */
-			last_page,	/* Last page in range */
-			num_pages;	/* Number of pages */
-#ifdef HAVE_COREGRAPHICS
-  CFURLRef		url;		/* CFURL object for PDF filename */
-  CGPDFDocumentRef	document = NULL;/* Input document */
-#elif defined(HAVE_MUPDF)
-  fz_context		*context;	/* MuPDF context */
-  fz_document		*document;	/* Document to print */
-#endif /* HAVE_COREGRAPHICS */
+  if (level == DOCLINT_LEVEL_ERROR)
+    cupsArrayAdd(file->errors, (void *)message);
+  else if (level == DOCLINT_LEVEL_WARNING)
+    cupsArrayAdd(file->warnings, (void *)message);
 
+  if (Verbosity > 1 || (Verbosity && level != DOCLINT_LEVEL_DEBUG))
+    fprintf(stderr, "%s: %s: %s\n", level == DOCLINT_LEVEL_ERROR ? "ERROR" : level == DOCLINT_LEVEL_WARNING ? "INFO" : "DEBUG", file->filename, message);
+}
 
- /*
-  * Gather options...
-  */
 
-  if ((value = cupsGetOption("copies", num_options, options)) != NULL)
-    copies = atoi(value);
-  else
-    copies = 1;
-
-  if ((value = cupsGetOption("page-ranges", num_options, options)) != NULL)
-  {
-    if (sscanf(value, "%u-%u", &first_page, &last_page) != 2)
-    {
-      first_page = 1;
-      last_page  = INT_MAX;
-    }
-  }
-  else
-  {
-    first_page = 1;
-    last_page  = INT_MAX;
-  }
+/*
+ * 'batch_run()' - Check a batch of files and write a JSON report.
+ */
 
-  color_mode = cupsGetOption("print-color-mode", num_options, options);
+static int				/* O - Exit status */
+batch_run(batch_t    *batch,		/* I - Batch of files */
+          int        num_threads,	/* I - Number of threads or 0 for auto */
+          const char *report)		/* I - Report file or "-" for stdout */
+{
+  int		i;			/* Looping var */
+  size_t	j;			/* Looping var */
+  cups_thread_t	threads[BATCH_MAX_THREADS];
+					/* Batch threads */
+  double	start;			/* Start time */
+  int		failed = 0;		/* Number of files that failed */
+  batch_file_t	*file;			/* Current file */
+  cups_json_t	*json,			/* JSON report */
+		*files,			/* "files" array */
+		*jfile,			/* Object for current file */
+		*current,		/* Current node in report */
+		*fcurrent;		/* Current node in file object */
+  bool		ret;			/* Did the report get written? */
 
-  if ((value = cupsGetOption("sides", num_options, options)) != NULL)
-    duplex = !strncmp(value, "two-sided-", 10);
-  else
-    duplex = 0;
 
-#ifdef HAVE_COREGRAPHICS
  /*
-  * Open the PDF...
+  * Check the files on a pool of threads, one file per thread at a time...
   */
 
-  if ((url = CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault, (const UInt8 *)filename, (CFIndex)strlen(filename), false)) == NULL)
+  if (num_threads < 1)
   {
-    fputs("ERROR: Unable to create CFURL for file.\n", stderr);
-    return (0);
+    num_threads = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+    if ((num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+      num_threads = 1;
+#endif /* _SC_NPROCESSORS_ONLN */
   }
 
-  document = CGPDFDocumentCreateWithURL(url);
-  CFRelease(url);
+  if (num_threads > BATCH_MAX_THREADS)
+    num_threads = BATCH_MAX_THREADS;
+  if ((size_t)num_threads > batch->num_files)
+    num_threads = batch->num_files > 0 ? (int)batch->num_files : 1;
 
-  if (!document)
-  {
-    fputs("ERROR: Unable to create CFPDFDocument for file.\n", stderr);
-    return (0);
-  }
+  start = time_seconds();
 
-  if (CGPDFDocumentIsEncrypted(document))
-  {
-   /*
-    * Only support encrypted PDFs with a blank password...
-    */
+  cupsMutexInit(&batch->mutex);
 
-    if (!CGPDFDocumentUnlockWithPassword(document, ""))
-    {
-      fputs("ERROR: Document is encrypted and cannot be unlocked.\n", stderr);
-      CGPDFDocumentRelease(document);
-      Errors ++;
-      return (0);
-    }
-  }
+  for (i = 0; i < num_threads; i ++)
+    threads[i] = cupsThreadCreate((cups_thread_func_t)batch_worker, batch);
 
-  if (!CGPDFDocumentAllowsPrinting(document))
-  {
-    fputs("ERROR: Document does not allow printing.\n", stderr);
-    CGPDFDocumentRelease(document);
-    Errors ++;
-    return (0);
-  }
+  for (i = 0; i < num_threads; i ++)
+    cupsThreadWait(threads[i]);
 
-  num_pages = (int)CGPDFDocumentGetNumberOfPages(document);
-
-  fprintf(stderr, "DEBUG: Total pages in PDF document is %d.\n", num_pages);
-
-  if (first_page > num_pages)
-  {
-    fputs("ERROR: \"page-ranges\" value does not include any pages to print in the document.\n", stderr);
-    CGPDFDocumentRelease(document);
-    return (0);
-  }
-
-  if (last_page > num_pages)
-    last_page = num_pages;
+  cupsMutexDestroy(&batch->mutex);
 
  /*
-  * Close the PDF file...
+  * Build the report:
+  *
+  * {
+  *   "files": [
+  *     {
+  *       "filename": "...", "format": "...", "ok": true|false,
+  *       "pages": {...}, "impressions": {...}, "sheets": {...},
+  *       "errors": [...], "warnings": [...], "time": seconds
+  *     }, ...
+  *   ],
+  *   "total-files": N, "failed-files": N, "total-time": seconds
+  * }
   */
 
-  CGPDFDocumentRelease(document);
-
- /*
-  * For now, assume all pages are color unless 'monochrome' is specified.  In
-  * the future we can use the CGPDFContentStream, CGPDFOperatorTable, and
-  * CGPDFScanner APIs to capture the graphics operations on each page and then
-  * mark pages as color or grayscale...
-  */
+  json    = cupsJSONNew(NULL, NULL, CUPS_JTYPE_OBJECT);
+  current = cupsJSONNewKey(json, NULL, "files");
+  files   = cupsJSONNew(json, current, CUPS_JTYPE_ARRAY);
+  current = files;
+  jfile   = NULL;
 
+  for (j = batch->num_files, file = batch->files; j > 0; j --, file ++)
+  {
+    if (!file->ok)
+      failed ++;
 
-#elif defined(HAVE_MUPDF)
- /*
-  * Open the PDF file...
-  */
+    jfile    = cupsJSONNew(files, jfile, CUPS_JTYPE_OBJECT);
+    fcurrent = cupsJSONNewKey(jfile, NULL, "filename");
+    fcurrent = cupsJSONNewString(jfile, fcurrent, file->filename);
+    fcurrent = cupsJSONNewKey(jfile, fcurrent, "format");
+    if (file->content_type)
+      fcurrent = cupsJSONNewString(jfile, fcurrent, file->content_type);
+    else
+      fcurrent = cupsJSONNew(jfile, fcurrent, CUPS_JTYPE_NULL);
+    fcurrent = cupsJSONNewKey(jfile, fcurrent, "ok");
+    fcurrent = cupsJSONNew(jfile, fcurrent, file->ok ? CUPS_JTYPE_TRUE : CUPS_JTYPE_FALSE);
+    fcurrent = json_add_counters(jfile, fcurrent, "pages", &file->results.pages);
+    fcurrent = json_add_counters(jfile, fcurrent, "impressions", &file->results.impressions);
+    fcurrent = json_add_counters(jfile, fcurrent, "impressions-two-sided", &file->results.impressions_two_sided);
+    fcurrent = json_add_counters(jfile, fcurrent, "sheets", &file->results.sheets);
+    fcurrent = json_add_strings(jfile, fcurrent, "errors", file->errors);
+    fcurrent = json_add_strings(jfile, fcurrent, "warnings", file->warnings);
+    json_add_number(jfile, fcurrent, "time", file->elapsed);
 
-  if ((context = fz_new_context(NULL, NULL, FZ_STORE_UNLIMITED)) == NULL)
-  {
-    fputs("ERROR: Unable to create context.\n", stderr);
-    Errors ++;
-    return (0);
+    free(file->filename);
+    cupsArrayDelete(file->errors);
+    cupsArrayDelete(file->warnings);
   }
 
-  fz_register_document_handlers(context);
+  current = json_add_number(json, current, "total-files", (double)batch->num_files);
+  current = json_add_number(json, current, "failed-files", failed);
+  json_add_number(json, current, "total-time", time_seconds() - start);
 
-  fz_try(context) document = fz_open_document(context, filename);
-  fz_catch(context)
-  {
-    fprintf(stderr, "ERROR: Unable to open '%s': %s\n", filename, fz_caught_message(context));
-    fz_drop_context(context);
-    Errors ++;
-    return (0);
-  }
+  free(batch->files);
 
-  if (fz_needs_password(context, document))
+  if (!strcmp(report, "-"))
   {
-    fputs("ERROR: Document is encrypted and cannot be unlocked.\n", stderr);
-    fz_drop_document(context, document);
-    fz_drop_context(context);
-    Errors ++;
-    return (0);
-  }
+    char *s = cupsJSONExportString(json);
+					/* JSON string */
 
-  num_pages = (int)fz_count_pages(context, document);
-  if (first_page > num_pages)
-  {
-    fputs("ERROR: \"page-ranges\" value does not include any pages to print in the document.\n", stderr);
+    if ((ret = s != NULL) == true)
+    {
+      puts(s);
+      free(s);
+    }
+  }
+  else
+    ret = cupsJSONExportFile(json, report);
 
-    fz_drop_document(context, document);
-    fz_drop_context(context);
+  cupsJSONDelete(json);
 
-    return (0);
+  if (!ret)
+  {
+    fprintf(stderr, "ERROR: Unable to write report \"%s\": %s\n", report, cupsGetErrorString());
+    return (1);
   }
 
-  if (last_page > num_pages)
-    last_page = num_pages;
-
- /*
-  * Close the PDF file...
-  */
+  return (failed ? 1 : 0);
+}
 
-  fz_drop_document(context, document);
-  fz_drop_context(context);
 
- /*
-  * For now, assume all pages are color unless 'monochrome' is specified.  In
-  * the future we might use MuPDF functions to mark individual pages as color or
-  * grayscale...
-  */
-
-#endif /* HAVE_COREGRAPHICS */
+/*
+ * 'batch_worker()' - Check files in a batch.
+ */
 
- /*
-  * Update the page counters...
-  */
+static void *				/* O - Thread exit status */
+batch_worker(batch_t *batch)		/* I - Batch of files */
+{
+  batch_file_t	*file;			/* Current file */
+  double	start;			/* Start time */
 
-  num_pages = last_page - first_page + 1;
 
-  if (!color_mode || strcmp(color_mode, "monochrome"))
+  for (;;)
   {
-   /*
-    * All pages are color...
-    */
-
-    Pages.full_color += num_pages;
-
-    if (duplex)
-    {
-      if (num_pages & 1)
-        ImpressionsTwoSided.blank += copies;
-
-      ImpressionsTwoSided.full_color += copies * num_pages;
-    }
+    cupsMutexLock(&batch->mutex);
+    if (batch->next_file < batch->num_files)
+      file = batch->files + batch->next_file ++;
     else
-    {
-      Impressions.full_color += copies * num_pages;
-    }
-  }
-  else
-  {
-   /*
-    * All pages are grayscale...
-    */
+      file = NULL;
+    cupsMutexUnlock(&batch->mutex);
 
-    Pages.monochrome += num_pages;
+    if (!file)
+      break;
 
-    if (duplex)
-    {
-      if (num_pages & 1)
-        ImpressionsTwoSided.blank += copies;
+    start = time_seconds();
 
-      ImpressionsTwoSided.monochrome += copies * num_pages;
+    if (file->content_type)
+    {
+      file->ok = doclintFile(file->filename, file->content_type, batch->num_options, batch->options, (doclint_message_cb_t)batch_message_cb, NULL, file, &file->results);
     }
     else
     {
-      Impressions.monochrome += copies * num_pages;
+      cupsArrayAdd(file->errors, "Unknown format, please specify with '-i' option.");
+      file->results.errors ++;
     }
+
+    file->elapsed = time_seconds() - start;
   }
 
-  return (1);
+  return (NULL);
 }
 
 
 /*
- * 'lint_raster()' - Check an Apple/CUPS/PWG Raster file.
+ * 'json_add_counters()' - Add a counters object to a JSON object.
  */
 
-static int				/* O - 1 on success, 0 on failure */
-lint_raster(const char *filename,	/* I - File to check */
-	    const char *content_type)	/* I - Content type */
+static cups_json_t *			/* O - New value */
+json_add_counters(
+    cups_json_t              *parent,	/* I - Parent object */
+    cups_json_t              *after,	/* I - Previous node */
+    const char               *key,	/* I - Key */
+    const doclint_counters_t *counters)	/* I - Counters */
 {
-  cups_file_t		*fp;		/* File pointer */
-  cups_page_header_t	header;		/* Page header */
-  unsigned		page = 0;	/* Page number */
+  cups_json_t	*obj,			/* Counters object */
+		*current;		/* Current node */
 
 
-  (void)content_type;
+  obj     = cupsJSONNew(parent, cupsJSONNewKey(parent, after, key), CUPS_JTYPE_OBJECT);
+  current = json_add_number(obj, NULL, "blank", counters->blank);
+  current = json_add_number(obj, current, "full-color", counters->full_color);
+  current = json_add_number(obj, current, "monochrome", counters->monochrome);
+  json_add_number(obj, current, "total", counters->blank + counters->full_color + counters->monochrome);
 
-  if ((fp = cupsFileOpen(filename, "rb")) == NULL)
-  {
-    fprintf(stderr, "ERROR: Unable to open \"%s\": %s\n", filename, cupsGetErrorString());
-    return (0);
-  }
+  return (obj);
+}
 
-  if (!strcasecmp(content_type, "image/pwg-raster"))
-  {
-    unsigned		syncword;	/* Sync word */
 
-    if (cupsFileRead(fp, (char *)&syncword, sizeof(syncword)) != sizeof(syncword))
-    {
-      fputs("ERROR: Unable to read sync word from PWG Raster file.\n", stderr);
-      Errors ++;
-    }
-    else if (syncword != CUPS_RASTER_SYNCv2 && syncword != CUPS_RASTER_REVSYNCv2)
-    {
-      fprintf(stderr, "ERROR: Bad sync word 0x%08x seen in PWG Raster file.\n", syncword);
-      Errors ++;
-    }
-    else
-    {
-      while (read_pwg_raster_header(fp, syncword, &header))
-      {
-	page ++;
-	if (!read_raster_image(fp, &header, page))
-	  break;
-      }
-    }
-  }
-  else
-  {
-    unsigned char	fheader[12];	/* File header */
-    unsigned		num_pages;	/* Number of pages */
+/*
+ * 'json_add_number()' - Add a number to a JSON object.
+ */
 
-    if (cupsFileRead(fp, (char *)fheader, sizeof(fheader)) != sizeof(fheader))
-    {
-      fputs("ERROR: Unable to read header from Apple raster file.\n", stderr);
-      Errors ++;
-    }
-    else  if (memcmp(fheader, "UNIRAST", 8))
-    {
-      fputs("ERROR: Bad Apple Raster header seen.\n", stderr);
-      Errors ++;
-    }
-    else
-    {
-      num_pages = (unsigned)((fheader[8] << 24) | (fheader[9] << 16) | (fheader[10] << 8) | fheader[11]);
+static cups_json_t *			/* O - New value */
+json_add_number(cups_json_t *parent,	/* I - Parent object */
+                cups_json_t *after,	/* I - Previous node */
+                const char  *key,	/* I - Key */
+                double      value)	/* I - Value */
+{
+  return (cupsJSONNewNumber(parent, cupsJSONNewKey(parent, after, key), value));
+}
 
-      while (read_apple_raster_header(fp, &header))
-      {
-	page ++;
-	if (!read_raster_image(fp, &header, page))
-	  break;
-      }
 
-      if (num_pages > 0 && page != num_pages)
-      {
-	fprintf(stderr, "ERROR: Actual number of pages (%u) does not match file header (%u).\n", page, num_pages);
-	Errors ++;
-      }
-    }
-  }
+/*
+ * 'json_add_strings()' - Add an array of strings to a JSON object.
+ */
+
+static cups_json_t *			/* O - New value */
+json_add_strings(cups_json_t  *parent,	/* I - Parent object */
+                 cups_json_t  *after,	/* I - Previous node */
+                 const char   *key,	/* I - Key */
+                 cups_array_t *strings)	/* I - Strings */
+{
+  cups_json_t	*array,			/* JSON array */
+		*current = NULL;	/* Current string */
+  const char	*s;			/* Current string */
+
 
-  cupsFileClose(fp);
+  array = cupsJSONNew(parent, cupsJSONNewKey(parent, after, key), CUPS_JTYPE_ARRAY);
 
-  return (Errors == 0);
+  for (s = (const char *)cupsArrayGetFirst(strings); s; s = (const char *)cupsArrayGetNext(strings))
+    current = cupsJSONNewString(array, current, s);
+
+  return (array);
 }
 
 
@@ -794,818 +725,74 @@ load_env_options(
 
 
 /*
- * 'read_apple_raster_header()' - Read a page header from an Apple raster file.
+ * 'message_cb()' - Write an error, warning, or debugging message.
+ *
+ * Warnings are written as "INFO:" messages so that ippserver logs them.
  */
 
-static int				/* O - 1 on success, 0 on error */
-read_apple_raster_header(
-    cups_file_t         *fp,		/* I - File pointer */
-    cups_page_header_t *header)	/* O - Raster header */
+static void
+message_cb(void            *cb_data,	/* I - Callback data (unused) */
+           doclint_level_t level,	/* I - Message level */
+           const char      *message)	/* I - Message */
 {
-  unsigned char	pheader[32];		/* Page header */
-
-
-  memset(header, 0, sizeof(cups_page_header_t));
-
-  if (cupsFileRead(fp, (char *)pheader, sizeof(pheader)) != sizeof(pheader))
-    return (0);
-
-  switch (pheader[1])
-  {
-    case 0 : /* W */
-        header->cupsColorSpace = CUPS_CSPACE_SW;
-        header->cupsNumColors  = 1;
-        break;
-
-    case 1 : /* sRGB */
-        header->cupsColorSpace = CUPS_CSPACE_SRGB;
-        header->cupsNumColors  = 3;
-        break;
-
-    case 3 : /* AdobeRGB */
-        header->cupsColorSpace = CUPS_CSPACE_ADOBERGB;
-        header->cupsNumColors  = 3;
-        break;
-
-    case 4 : /* DeviceW */
-        header->cupsColorSpace = CUPS_CSPACE_W;
-        header->cupsNumColors  = 1;
-        break;
-
-    case 5 : /* DeviceRGB */
-        header->cupsColorSpace = CUPS_CSPACE_RGB;
-        header->cupsNumColors  = 3;
-        break;
-
-    case 6 : /* DeviceCMYK */
-        header->cupsColorSpace = CUPS_CSPACE_CMYK;
-        header->cupsNumColors  = 4;
-        break;
-
-    default :
-        fprintf(stderr, "ERROR: Unknown Apple Raster colorspace %u.\n", pheader[1]);
-        Errors ++;
-        return (0);
-  }
+  static const char * const prefixes[] =
+  {					/* Message prefixes */
+    "ERROR",
+    "INFO",
+    "DEBUG"
+  };
 
-  if ((header->cupsNumColors == 1 && pheader[0] != 8 && pheader[0] != 16) ||
-      (header->cupsNumColors == 3 && pheader[0] != 24 && pheader[0] != 48) ||
-      (header->cupsNumColors == 4 && pheader[0] != 32 && pheader[0] != 64))
-  {
-    fprintf(stderr, "ERROR: Invalid bits per pixel value %u.\n", pheader[0]);
-    Errors ++;
-    return (0);
-  }
 
-  header->cupsBitsPerPixel = pheader[0];
-  header->cupsBitsPerColor = pheader[0] / header->cupsNumColors;
-  header->cupsWidth        = (unsigned)((pheader[12] << 24) | (pheader[13] << 16) | (pheader[14] << 8) | pheader[15]);
-  header->cupsHeight       = (unsigned)((pheader[16] << 24) | (pheader[17] << 16) | (pheader[18] << 8) | pheader[19]);
-  header->cupsBytesPerLine = header->cupsWidth * header->cupsBitsPerPixel / 8;
+  (void)cb_data;
 
-  return (1);
+  fprintf(stderr, "%s: %s\n", prefixes[level], message);
 }
 
 
 /*
- * 'read_pwg_raster_header()' - Read a page header from a PWG raster file.
+ * 'progress_cb()' - Write the current page counts while streaming.
  */
 
-static int				/* O - 1 on success, 0 on error */
-read_pwg_raster_header(
-    cups_file_t         *fp,		/* I - File pointer */
-    unsigned            syncword,	/* I - Sync word from the file */
-    cups_page_header_t *header)	/* O - Raster header */
+static void
+progress_cb(
+    void                    *cb_data,	/* I - Callback data (unused) */
+    const doclint_results_t *results)	/* I - Current counters */
 {
-  int		i;			/* Looping/temp var */
-  unsigned	num_colors,		/* Number of colors */
-		bytes_per_line;		/* Expected bytes per line */
-  static const char * const when_enum[] =
-  {					/* Human-readable 'When' values, also used by AdvanceMedia, Jog */
-    "Never",
-    "AfterDocument",
-    "AfterJob",
-    "AfterSet",
-    "AfterPage"
-  };
-  static const char * const media_position_enum[] =
-  {					/* Human-readable media position values */
-    "Auto",
-    "Main",
-    "Alternate",
-    "LargeCapacity",
-    "Manual",
-    "Envelope",
-    "Disc",
-    "Photo",
-    "Hagaki",
-    "MainRoll",
-    "AlternateRoll",
-    "Top",
-    "Middle",
-    "Bottom",
-    "Side",
-    "Left",
-    "Right",
-    "Center",
-    "Rear",
-    "ByPassTray",
-    "Tray1",
-    "Tray2",
-    "Tray3",
-    "Tray4",
-    "Tray5",
-    "Tray6",
-    "Tray7",
-    "Tray8",
-    "Tray9",
-    "Tray10",
-    "Tray11",
-    "Tray12",
-    "Tray13",
-    "Tray14",
-    "Tray15",
-    "Tray16",
-    "Tray17",
-    "Tray18",
-    "Tray19",
-    "Tray20",
-    "Roll1",
-    "Roll2",
-    "Roll3",
-    "Roll4",
-    "Roll5",
-    "Roll6",
-    "Roll7",
-    "Roll8",
-    "Roll9",
-    "Roll10",
-  };
-  static const char * const orientation_enum[] =
-  {					/* Human-readable orientation values */
-    "Portrait",
-    "Landscape",
-    "ReversePortrait",
-    "ReverseLandscape"
-  };
-  static const char * const print_quality_enum[] =
-  {					/* Human-readable print quality values */
-    "Default",
-    "",
-    "",
-    "Draft",
-    "Normal",
-    "High"
-  };
-  static const char * const color_space_enum[] =
-  {					/* Human-readable color space values */
-    "W",	/* 0 */
-    "Rgb",	/* 1 */
-    "",		/* 2 */
-    "Black",	/* 3 */
-    "",		/* 4 */
-    "",		/* 5 */
-    "Cmyk",	/* 6 */
-    "",		/* 7 */
-    "",		/* 8 */
-    "",		/* 9 */
-    "",		/* 10 */
-    "",		/* 11 */
-    "",		/* 12 */
-    "",		/* 13 */
-    "",		/* 14 */
-    "",		/* 15 */
-    "",		/* 16 */
-    "",		/* 17 */
-    "Sgray",	/* 18 */
-    "Srgb",	/* 19 */
-    "AdobeRgb",	/* 20 */
-    "",		/* 21 */
-    "",		/* 22 */
-    "",		/* 23 */
-    "",		/* 24 */
-    "",		/* 25 */
-    "",		/* 26 */
-    "",		/* 27 */
-    "",		/* 28 */
-    "",		/* 29 */
-    "",		/* 30 */
-    "",		/* 31 */
-    "",		/* 32 */
-    "",		/* 33 */
-    "",		/* 34 */
-    "",		/* 35 */
-    "",		/* 36 */
-    "",		/* 37 */
-    "",		/* 38 */
-    "",		/* 39 */
-    "",		/* 40 */
-    "",		/* 41 */
-    "",		/* 42 */
-    "",		/* 43 */
-    "",		/* 44 */
-    "",		/* 45 */
-    "",		/* 46 */
-    "",		/* 47 */
-    "Device1",	/* 48 */
-    "Device2",	/* 49 */
-    "Device3",	/* 50 */
-    "Device4",	/* 51 */
-    "Device5",	/* 52 */
-    "Device6",	/* 53 */
-    "Device7",	/* 54 */
-    "Device8",	/* 55 */
-    "Device9",	/* 56 */
-    "Device10",	/* 57 */
-    "Device11",	/* 58 */
-    "Device12",	/* 59 */
-    "Device13",	/* 60 */
-    "Device14",	/* 61 */
-    "Device15"	/* 62 */
-  };
-
-
-  if (cupsFileRead(fp, (char *)header, sizeof(cups_page_header_t)) != sizeof(cups_page_header_t))
-    return (0);
-
-  if (syncword == CUPS_RASTER_REVSYNCv2)
-  {
-   /*
-    * Swap bytes for integer values in page header...
-    */
-
-    unsigned	len,			/* Looping var */
-		*s,			/* Current word */
-		temp;			/* Temporary copy */
-
-    for (len = 81, s = &(header->AdvanceDistance); len > 0; len --, s ++)
-    {
-      temp = *s;
-      *s   = ((temp & 0xff) << 24) |
-	     ((temp & 0xff00) << 8) |
-	     ((temp & 0xff0000) >> 8) |
-	     ((temp & 0xff000000) >> 24);
-    }
-  }
-
-  if (memcmp(header->MediaClass, "PwgRaster", 10))
-  {
-    fputs("ERROR: PwgRaster value in header is incorrect.\n", stderr);
-    Errors ++;
-    return (0);
-  }
-
-  if (header->AdvanceDistance != 0 || header->AdvanceMedia != 0 || header->Collate != 0)
-  {
-    fputs("INFO: Non-zero values present in Reserved[256-267] area.\n", stderr);
-    Warnings ++;
-  }
-
-  fprintf(stderr, "DEBUG: MediaColor=\"%s\"\n", header->MediaColor);
-  fprintf(stderr, "DEBUG: MediaType=\"%s\"\n", header->MediaType);
-  fprintf(stderr, "DEBUG: PrintContentOptimize=\"%s\"\n", header->OutputType);
+  const doclint_counters_t *imp = &results->impressions,
+			*imp2 = &results->impressions_two_sided,
+			*sheets = &results->sheets;
+					/* Counters */
 
-  if (header->CutMedia > CUPS_CUT_PAGE)
-  {
-    fprintf(stderr, "INFO: Bad CutMedia value %u.\n", header->CutMedia);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: CutMedia=%u (%s)\n", header->CutMedia, when_enum[header->CutMedia]);
-
-  if (header->Duplex > 1)
-  {
-    fprintf(stderr, "INFO: Bad Duplex value %u.\n", header->Duplex);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: Duplex=%u (%s)\n", header->Duplex, header->Duplex ? "true" : "false");
-
-  if (header->HWResolution[0] == 0 || header->HWResolution[1] == 0)
-  {
-    fprintf(stderr, "INFO: Bad HWResolution value [%u %u].\n", header->HWResolution[0], header->HWResolution[1]);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: HWResolution=[%u %u]\n", header->HWResolution[0], header->HWResolution[1]);
-
-  if (header->ImagingBoundingBox[0] != 0 || header->ImagingBoundingBox[1] != 0 || header->ImagingBoundingBox[2] != 0 || header->ImagingBoundingBox[3] != 0)
-  {
-    fputs("INFO: Non-zero values present in Reserved[284-299] area.\n", stderr);
-    Warnings ++;
-  }
 
-  if (header->InsertSheet > 1)
-  {
-    fprintf(stderr, "INFO: Bad InsertSheet value %u.\n", header->InsertSheet);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: InsertSheet=%u (%s)\n", header->InsertSheet, header->InsertSheet ? "true" : "false");
-
-
-  if (header->Jog > CUPS_JOG_SET)
-  {
-    fprintf(stderr, "INFO: Bad Jog value %u.\n", header->Jog);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: Jog=%u (%s)\n", header->Jog, when_enum[header->Jog]);
+  (void)cb_data;
 
-  if (header->LeadingEdge > CUPS_EDGE_RIGHT)
-  {
-    fprintf(stderr, "INFO: Bad LeadingEdge value %u.\n", header->LeadingEdge);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: LeadingEdge=%u (%s)\n", header->LeadingEdge, header->LeadingEdge ? "LongEdgeFirst" : "ShortEdgeFirst");
-
-  if (header->Margins[0] != 0 || header->Margins[1] != 0 || header->ManualFeed != 0)
-  {
-    fputs("INFO: Non-zero values present in Reserved[312-323] area.\n", stderr);
-    Warnings ++;
-  }
-
-  if (header->MediaPosition >= (sizeof(media_position_enum) / sizeof(media_position_enum[0])))
-  {
-    fprintf(stderr, "INFO: Bad MediaPosition value %u.\n", header->MediaPosition);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: MediaPosition=%u (%s)\n", header->MediaPosition, media_position_enum[header->MediaPosition]);
-
-  fprintf(stderr, "DEBUG: MediaWeight=%u\n", header->MediaWeight);
-
-  if (header->MirrorPrint != 0 || header->NegativePrint != 0)
-  {
-    fputs("INFO: Non-zero values present in Reserved[332-339] area.\n", stderr);
-    Warnings ++;
-  }
-
-  fprintf(stderr, "DEBUG: NumCopies=%u\n", header->NumCopies);
-
-  if (header->Orientation > CUPS_ORIENT_270)
-  {
-    fprintf(stderr, "INFO: Bad Orientation value %u.\n", header->Orientation);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: Orientation=%u (%s)\n", header->Orientation, orientation_enum[header->Orientation]);
-
-  if (header->OutputFaceUp != 0)
-  {
-    fputs("INFO: Non-zero values present in Reserved[348-351] area.\n", stderr);
-    Warnings ++;
-  }
-
-  if (header->PageSize[0] == 0 || header->PageSize[1] == 0)
-  {
-    fprintf(stderr, "INFO: Bad PageSize value [%u %u].\n", header->PageSize[0], header->PageSize[1]);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: PageSize=[%u %u]\n", header->PageSize[0], header->PageSize[1]);
-
-  if (header->Separations != 0 || header->TraySwitch != 0)
-  {
-    fputs("INFO: Non-zero values present in Reserved[360-367] area.\n", stderr);
-    Warnings ++;
-  }
-
-  if (header->Tumble > 1)
-  {
-    fprintf(stderr, "INFO: Bad Tumble value %u.\n", header->Tumble);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: Tumble=%u (%s)\n", header->Tumble, header->Tumble ? "true" : "false");
-
-  if (header->cupsWidth == 0 || header->cupsHeight == 0)
-  {
-    fprintf(stderr, "ERROR: Bad Width x Height value %u x %u.\n", header->cupsWidth, header->cupsHeight);
-    Errors ++;
-    return (0);
-  }
-  else
-    fprintf(stderr, "DEBUG: Width x Height=%u x %u\n", header->cupsWidth, header->cupsHeight);
-
-  if (header->cupsMediaType != 0)
-  {
-    fputs("INFO: Non-zero values present in Reserved[380-383] area.\n", stderr);
-    Warnings ++;
-  }
-
-  switch (header->cupsColorSpace)
-  {
-    case CUPS_CSPACE_W :
-    case CUPS_CSPACE_K :
-    case CUPS_CSPACE_SW :
-        num_colors = 1;
-        break;
-
-    case CUPS_CSPACE_RGB :
-    case CUPS_CSPACE_SRGB :
-    case CUPS_CSPACE_ADOBERGB :
-        num_colors = 3;
-        break;
-
-    case CUPS_CSPACE_CMYK :
-        num_colors = 4;
-        break;
-
-    case CUPS_CSPACE_DEVICE1 :
-    case CUPS_CSPACE_DEVICE2 :
-    case CUPS_CSPACE_DEVICE3 :
-    case CUPS_CSPACE_DEVICE4 :
-    case CUPS_CSPACE_DEVICE5 :
-    case CUPS_CSPACE_DEVICE6 :
-    case CUPS_CSPACE_DEVICE7 :
-    case CUPS_CSPACE_DEVICE8 :
-    case CUPS_CSPACE_DEVICE9 :
-    case CUPS_CSPACE_DEVICEA :
-    case CUPS_CSPACE_DEVICEB :
-    case CUPS_CSPACE_DEVICEC :
-    case CUPS_CSPACE_DEVICED :
-    case CUPS_CSPACE_DEVICEE :
-    case CUPS_CSPACE_DEVICEF :
-        num_colors = header->cupsColorSpace - CUPS_CSPACE_DEVICE1 + 1;
-        break;
-
-    default :
-        fprintf(stderr, "ERROR: Bad ColorSpace value %u.\n", header->cupsColorSpace);
-        Errors ++;
-        return (0);
-  }
-
-  fprintf(stderr, "DEBUG: ColorSpace=%u (%s)\n", header->cupsColorSpace, color_space_enum[header->cupsColorSpace]);
-
-  if (header->cupsColorOrder != CUPS_ORDER_CHUNKED)
-  {
-    fprintf(stderr, "ERROR: Bad ColorOrder value %u.\n", header->cupsColorOrder);
-    Errors ++;
-    return (0);
-  }
-  else
-    fputs("DEBUG: ColorOrder=0 (Chunky)\n", stderr);
-
-  if (header->cupsNumColors != num_colors)
-  {
-    fprintf(stderr, "INFO: Bad NumColors value %u.\n", header->cupsNumColors);
-    Warnings ++;
-    header->cupsNumColors = (unsigned)num_colors;
-  }
-
-  switch (header->cupsBitsPerColor)
-  {
-    case 1 :
-        if (num_colors != 1)
-        {
-	  fprintf(stderr, "ERROR: Bad BitsPerColor value %u.\n", header->cupsBitsPerColor);
-	  Errors ++;
-	  return (0);
-        }
-        else
-          fputs("DEBUG: BitsPerColor=1\n", stderr);
-	break;
-
-    case 8 :
-    case 16 :
-        fprintf(stderr, "DEBUG: BitsPerColor=%u\n", header->cupsBitsPerColor);
-        break;
-
-    default :
-        fprintf(stderr, "ERROR: Bad BitsPerColor value %u.\n", header->cupsBitsPerColor);
-        Errors ++;
-        return (0);
-  }
-
-  if (header->cupsBitsPerPixel != (num_colors * header->cupsBitsPerColor))
-  {
-    fprintf(stderr, "ERROR: Bad BitsPerPixel value %u.\n", header->cupsBitsPerPixel);
-    Errors ++;
-    return (0);
-  }
-  else
-    fprintf(stderr, "DEBUG: BitsPerPixel=%u\n", header->cupsBitsPerPixel);
-
-  bytes_per_line = (header->cupsWidth * header->cupsBitsPerPixel + 7) / 8;
-
-  if (header->cupsBytesPerLine != bytes_per_line)
-  {
-    fprintf(stderr, "ERROR: Bad BytesPerLine value %u.\n", header->cupsBytesPerLine);
-    Errors ++;
-    return (0);
-  }
-  else
-    fprintf(stderr, "DEBUG: BytesPerLine=%u\n", header->cupsBytesPerLine);
-
-  if (header->cupsCompression != 0 || header->cupsRowCount != 0 || header->cupsRowFeed != 0 || header->cupsRowStep != 0)
-  {
-    fputs("INFO: Non-zero values present in Reserved[404-419] area.\n", stderr);
-    Warnings ++;
-  }
-
-  if (header->cupsBorderlessScalingFactor != 0 || header->cupsPageSize[0] != 0 || header->cupsPageSize[1] != 0 || header->cupsImagingBBox[0] != 0 || header->cupsImagingBBox[1] != 0 || header->cupsImagingBBox[2] != 0 || header->cupsImagingBBox[3] != 0)
-  {
-    fputs("INFO: Non-zero values present in Reserved[424-451] area.\n", stderr);
-    Warnings ++;
-  }
-
-  fprintf(stderr, "DEBUG: TotalPageCount=%u\n", header->cupsInteger[0]);
-
-  i = (int)header->cupsInteger[1];
-
-  if (i != 1 && i != -1)
-  {
-    fprintf(stderr, "INFO: Bad CrossFeedTransform value %d.\n", i);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: CrossFeedTransform=%d\n", i);
-
-  i = (int)header->cupsInteger[2];
-
-  if (i != 1 && i != -1)
-  {
-    fprintf(stderr, "INFO: Bad FeedTransform value %d.\n", i);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: FeedTransform=%d\n", i);
-
-  fprintf(stderr, "DEBUG: ImageBoxLeft=%u\n", header->cupsInteger[3]);
-  fprintf(stderr, "DEBUG: ImageBoxTop=%u\n", header->cupsInteger[4]);
-  fprintf(stderr, "DEBUG: ImageBoxRight=%u\n", header->cupsInteger[5]);
-  fprintf(stderr, "DEBUG: ImageBoxBottom=%u\n", header->cupsInteger[6]);
-  fprintf(stderr, "DEBUG: AlternatePrimary=0x%08x\n", header->cupsInteger[7]);
-
-  if (header->cupsInteger[8] == 1 || header->cupsInteger[8] == 2 || header->cupsInteger[8] > 5)
-  {
-    fprintf(stderr, "INFO: Bad PrintQuality value %u.\n", header->cupsInteger[8]);
-    Warnings ++;
-  }
-  else
-    fprintf(stderr, "DEBUG: PrintQuality=%u (%s)\n", header->cupsInteger[8], print_quality_enum[header->cupsInteger[8]]);
-
-  for (i = 9; i < 14; i ++)
-  {
-    if (header->cupsInteger[i] != 0)
-      break;
-  }
-
-  if (i < 14)
-  {
-    fputs("INFO: Non-zero values present in Reserved[488-507] area.\n", stderr);
-    Warnings ++;
-  }
-
-  fprintf(stderr, "DEBUG: VendorIdentifier=%u\n", header->cupsInteger[14]);
-  fprintf(stderr, "DEBUG: VendorLength=%u\n", header->cupsInteger[15]);
-
-  if (header->cupsMarkerType[0] != 0 || memcmp(header->cupsMarkerType, header->cupsMarkerType + 1, sizeof(header->cupsMarkerType) - 1))
-  {
-    fputs("INFO: Non-zero values present in Reserved[1604-1667] area.\n", stderr);
-    Warnings ++;
-  }
-
-  fprintf(stderr, "DEBUG: RenderingIntent=\"%s\"\n", header->cupsRenderingIntent);
-  fprintf(stderr, "DEBUG: PageSizeName=\"%s\"\n", header->cupsPageSizeName);
-
-  return (1);
+  fprintf(stderr, "ATTR: job-impressions=%d job-media-sheets=%d job-pages=%d\n", imp->blank + imp->full_color + imp->monochrome + imp2->blank + imp2->full_color + imp2->monochrome, sheets->blank + sheets->full_color + sheets->monochrome, results->pages.full_color + results->pages.monochrome);
 }
 
 
 /*
- * 'read_raster_image()' - Read the raster page image...
+ * 'time_seconds()' - Get the current time in seconds.
  */
 
-static int				/* O - 1 on success, 0 on error */
-read_raster_image(
-    cups_file_t         *fp,		/* I - File to read from */
-    cups_page_header_t *header,	/* I - Page header */
-    unsigned            page)		/* I - Page number */
+static double				/* O - Time in seconds */
+time_seconds(void)
 {
-  int		ch;			/* Character from file */
-  unsigned	height,			/* Height (lines) remaining */
-		width,			/* Width (columns/pixels) remaining */
-		repeat,			/* Line repeat value */
-		count,			/* Number of columns/pixels */
-		bytes,			/* Bytes in sequence */
-		bpp;			/* Bytes per pixel */
-  unsigned char	*buffer,		/* Line buffer */
-		*bufptr,		/* Pointer into buffer */
-		white;			/* White color */
-  int		blank = 1,		/* Is the page blank? */
-		color = header->cupsNumColors > 4;
-					/* Is the page in color? */
-
-
-  fprintf(stderr, "DEBUG: Reading page %u.\n", page);
-
-  buffer = malloc(header->cupsBytesPerLine);
-
-  if (header->cupsColorSpace == CUPS_CSPACE_W || header->cupsColorSpace == CUPS_CSPACE_RGB || header->cupsColorSpace == CUPS_CSPACE_SW || header->cupsColorSpace == CUPS_CSPACE_SRGB || header->cupsColorSpace == CUPS_CSPACE_ADOBERGB)
-    white = 0xff;
-  else
-    white = 0x00;
-
-  if (header->cupsBitsPerPixel == 1)
-    bpp = 1;
-  else
-    bpp = header->cupsBitsPerPixel / 8;
-
-  for (height = header->cupsHeight; height > 0; height -= repeat)
-  {
-   /*
-    * Read the line repeat code...
-    */
-
-    if ((ch = cupsFileGetChar(fp)) == EOF)
-    {
-      fprintf(stderr, "ERROR: Early end-of-file at line %u.\n", header->cupsHeight - height + 1);
-      Errors ++;
-      free(buffer);
-      return (0);
-    }
-
-    repeat = (unsigned)ch + 1;
-
-    if (repeat > height)
-    {
-      fprintf(stderr, "ERROR: Bad repeat count %u at line %u.\n", repeat, header->cupsHeight - height + 1);
-      Errors ++;
-      free(buffer);
-      return (0);
-    }
-
-    for (width = header->cupsWidth; width > 0; width -= count)
-    {
-     /*
-      * Read the packbits code...
-      */
-
-      if ((ch = cupsFileGetChar(fp)) == EOF)
-      {
-	fprintf(stderr, "ERROR: Early end-of-file at line %u, column %u.\n", header->cupsHeight - height + 1, header->cupsWidth - width + 1);
-	Errors ++;
-	free(buffer);
-	return (0);
-      }
-
-      if (ch == 0x80)
-      {
-       /*
-        * Clear to end of line...
-	*/
+#ifdef _WIN32
+  struct _timeb curtime;		/* Current time */
 
-        break;
-      }
-      else if (ch & 0x80)
-      {
-       /*
-        * Literal sequwnce...
-        */
 
-        count = 257 - (unsigned)ch;
-        bytes = count * bpp;
-      }
-      else
-      {
-       /*
-        * Repeat sequence...
-        */
+  _ftime(&curtime);
 
-        count = (unsigned)ch + 1;
-        bytes = bpp;
-      }
+  return ((double)curtime.time + 0.001 * curtime.millitm);
 
-      if (header->cupsBitsPerPixel == 1)
-      {
-	count *= 8;
-	if (count > width && (count - width) < 8)
-	  count = width;
-      }
+#else
+  struct timeval curtime;		/* Current time */
 
-      if (count > width)
-      {
-	fprintf(stderr, "ERROR: Bad literal count %u at line %u, column %u.\n", count, header->cupsHeight - height + 1, header->cupsWidth - width + 1);
-	Errors ++;
-	free(buffer);
-	return (0);
-      }
 
-     /*
-      * Read a pixel fragment...
-      */
+  gettimeofday(&curtime, NULL);
 
-      if (cupsFileRead(fp, (char *)buffer, bytes) < bytes)
-      {
-	fprintf(stderr, "ERROR: Early end-of-file at line %u, column %u.\n", header->cupsHeight - height + 1, header->cupsWidth - width + 1);
-	Errors ++;
-	free(buffer);
-	return (0);
-      }
-
-     /*
-      * Check for blank/color...
-      */
-
-      if (blank && (buffer[0] != white || memcmp(buffer, buffer + 1, bytes - 1)))
-        blank = 0;
-
-      if (!color && header->cupsNumColors > 1)
-      {
-        if (header->cupsNumColors == 3)
-        {
-         /*
-          * Scan RGB data...
-          */
-
-          if (header->cupsBitsPerColor == 8)
-          {
-            for (bufptr = buffer; bytes > 0; bufptr += 3, bytes -= 3)
-            {
-              if (bufptr[0] != bufptr[1] || bufptr[1] != bufptr[2])
-              {
-                color = 1;
-                break;
-	      }
-            }
-          }
-          else
-          {
-            for (bufptr = buffer; bytes > 0; bufptr += 6, bytes -= 6)
-            {
-              if (bufptr[0] != bufptr[2] || bufptr[1] != bufptr[3] || bufptr[2] != bufptr[4] || bufptr[3] != bufptr[5])
-              {
-                color = 1;
-                break;
-	      }
-            }
-          }
-        }
-        else
-        {
-         /*
-          * Scan CMYK data...
-          */
-
-          if (header->cupsBitsPerColor == 8)
-          {
-            for (bufptr = buffer; bytes > 0; bufptr += 4, bytes -= 4)
-            {
-              if (bufptr[0] != bufptr[1] || bufptr[1] != bufptr[2])
-              {
-                color = 1;
-                break;
-	      }
-            }
-          }
-          else
-          {
-            for (bufptr = buffer; bytes > 0; bufptr += 8, bytes -= 8)
-            {
-              if (bufptr[0] != bufptr[2] || bufptr[1] != bufptr[3] || bufptr[2] != bufptr[4] || bufptr[3] != bufptr[5])
-              {
-                color = 1;
-                break;
-	      }
-            }
-          }
-	}
-      }
-    }
-  }
-
-  fprintf(stderr, "DEBUG: %s-sided %s\n", header->Duplex ? "two" : "one", blank ? "blank" : color ? "full-color" : "monochrome");
-
-  if (header->Duplex)
-  {
-    if (blank)
-      ImpressionsTwoSided.blank ++;
-    else if (color)
-      ImpressionsTwoSided.full_color ++;
-    else
-      ImpressionsTwoSided.monochrome ++;
-  }
-  else
-  {
-    if (blank)
-      Impressions.blank ++;
-    else if (color)
-      Impressions.full_color ++;
-    else
-      Impressions.monochrome ++;
-  }
-
-  if (color)
-    Pages.full_color ++;
-  else
-    Pages.monochrome ++;
-
-  free(buffer);
-
-  return (1);
+  return ((double)curtime.tv_sec + 0.000001 * curtime.tv_usec);
+#endif /* _WIN32 */
 }
 
 
@@ -1617,12 +804,18 @@ static void
 usage(int status)			/* I - Exit status */
 {
   puts("Usage: ippdoclint [options] filename");
+  puts("       ippdoclint [options] -i content-type -");
+  puts("       ippdoclint [options] [-r report.json] filename/directory ...");
   puts("Options:");
   puts("  --help              Show program usage.");
   puts("  --version           Show program version.");
   puts("  -i content-type     Set MIME media type for file.");
+  puts("  -j count            Set number of files to check at once.");
   puts("  -o name=value       Set print options.");
+  puts("  -r report.json      Write a JSON report for the files (\"-\" for stdout).");
   puts("  -v                  Be verbose.");
 
   exit(status);
 }
+
+
@@ -8,14 +8,23 @@
 // information.
 //
 
+#if defined(__linux) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE			// For splice()
+#endif // __linux && !_GNU_SOURCE
 #include <config.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#ifndef _WIN32
+#include <ctype.h>
+#include <errno.h>
+#ifdef _WIN32
+#  include <sys/timeb.h>
+#else
 #  include <signal.h>
 #  include <unistd.h>
 #  include <fcntl.h>
+#  include <poll.h>
+#  include <sys/time.h>
 #endif // !_WIN32
 #include <cups/cups.h>
 #include <cups/thread.h>
@@ -29,6 +38,17 @@
 #define FIB_VALUE(v) (v & 255)
 
 
+//
+// Constants...
+//
+
+#define DOC_BUFFER_SIZE	262144		// Size of document copy buffer
+#define SPLICE_MIN_SIZE	1048576		// Minimum document size for splice()
+#define SPLICE_TIMEOUT	60.0		// Timeout for document data with splice() in seconds
+#define DEVICE_MAX_ATTEMPTS 10		// Maximum attempts to print a spooled document
+#define STATUS_INTERVAL	1000		// Default minimum time between status updates in milliseconds
+
+
 //
 // Local types...
 //
@@ -43,8 +63,14 @@ typedef struct proxy_info_s		// Proxy thread information
   const char	*device_uri;		// Output device URI
   char		device_uuid[46];	// Device UUID URN
   const char	*outformat;		// Desired output format (`NULL` for auto)
+  const char	*spool_dir;		// Spool directory (`NULL` for none)
+  double	status_interval;	// Minimum time between status updates in seconds
+  int		subscription_id,	// Event subscription ID
+		seq_number;		// Next event sequence number
 
   cups_array_t	*jobs;			// Local jobs
+  cups_thread_t	jobs_thread;		// Job proxy processing thread
+  bool		jobs_changed;		// `true` when the jobs array has changed
   cups_cond_t	jobs_cond;		// Condition variable to signal changes
   cups_mutex_t	jobs_mutex;		// Mutex for condition variable
   cups_rwlock_t	jobs_rwlock;		// Read/write lock for jobs array
@@ -56,6 +82,14 @@ typedef struct proxy_job_s		// Proxy job information
   int		local_job_id,		// Local job-id value
 		remote_job_id,		// Remote job-id value
 		remote_job_state;	// Remote job-state value
+  size_t	local_bytes;		// Bytes sent to the local printer
+  ipp_jstate_t	sent_job_state;		// Last output-device-job-state sent
+  int		doc_number;		// Document with a pending status update, if any
+  ipp_dstate_t	doc_state;		// Pending output-device-document-state value
+  double	status_time;		// Time of last status update
+  double	queue_time,		// Time job was queued (notified)
+		fetch_time,		// Time job was fetched
+		first_byte_time;	// Time first byte was sent to the local printer
 } proxy_job_t;
 
 
@@ -122,29 +156,50 @@ static int	verbosity = 0;
 // Local functions...
 //
 
+static void	acknowledge_document(http_t *http, proxy_info_t *info, proxy_job_t *pjob, int doc_number);
 static void	acknowledge_identify_printer(http_t *http, proxy_info_t *info);
 static bool	attrs_are_equal(ipp_attribute_t *a, ipp_attribute_t *b);
+static double	backoff(unsigned *interval);
 static int	compare_jobs(proxy_job_t *a, proxy_job_t *b);
 static ipp_t	*create_media_col(const char *media, const char *source, const char *type, int width, int length, int margins);
 static ipp_t	*create_media_size(int width, int length);
-static void	deregister_printer(http_t *http, proxy_info_t *info, int subscription_id);
+static void	deregister_printer(http_t *http, proxy_info_t *info);
+static ipp_t	*fetch_document(http_t *http, proxy_info_t *info, proxy_job_t *pjob, const char *doc_format, int doc_number);
 static proxy_job_t *find_job(proxy_info_t *info, int remote_job_id);
+static void	flush_status(http_t *http, proxy_info_t *info, proxy_job_t *pjob, bool force);
 static ipp_t	*get_device_attrs(const char *device_uri);
 static void	make_uuid(const char *device_uri, char *uuid, size_t uuidsize);
 static const char *password_cb(const char *prompt, http_t *http, const char *method, const char *resource, void *user_data);
 static void	plogipp(proxy_job_t *pjob, bool is_request, ipp_t *ipp);
 static void	plogf(proxy_job_t *pjob, const char *message, ...);
+static void	print_spooled_document(http_t *http, proxy_info_t *info, proxy_job_t *pjob, ipp_t *job_attrs, ipp_t *doc_attrs, int doc_number);
 static void	*proxy_jobs(proxy_info_t *info);
+static ssize_t	read_document(http_t *http, cups_file_t *doc_file, char *buffer, size_t bufsize);
 static int	register_printer(http_t **http, proxy_info_t *info);
 static void	run_job(proxy_info_t *info, proxy_job_t *pjob);
-static void	run_printer(http_t *http, proxy_info_t *info, int subscription_id);
-static void	send_document(http_t *http, proxy_info_t *info, proxy_job_t *pjob, ipp_t *job_attrs, ipp_t *doc_attrs, int doc_number);
+static void	run_printers(http_t *http, proxy_info_t *infos, int num_infos);
+static void	send_document(http_t *http, proxy_info_t *info, proxy_job_t *pjob, ipp_t *job_attrs, ipp_t *doc_attrs, cups_file_t *doc_file, int doc_number);
+static void	send_document_status(http_t *http, proxy_info_t *info, proxy_job_t *pjob, int doc_number, ipp_dstate_t doc_state);
+static void	send_job_status(http_t *http, proxy_info_t *info, proxy_job_t *pjob);
 static void	sighandler(int sig);
+#ifdef __linux
+static bool	splice_document(http_t *http, proxy_info_t *info, proxy_job_t *pjob, int sock, char *doc_buffer, size_t *doc_total);
+#endif // __linux
+static bool	spool_document(http_t *http, proxy_info_t *info, proxy_job_t *pjob, ipp_t *doc_attrs, int doc_number);
+static char	*spool_filename(proxy_info_t *info, proxy_job_t *pjob, int doc_number, char *filename, size_t filesize);
+static bool	start_printer(http_t *http, proxy_info_t *info);
+static double	time_seconds(void);
 static bool	update_device_attrs(http_t *http, proxy_info_t *info, ipp_t *new_attrs);
 static void	update_document_status(http_t *http, proxy_info_t *info, proxy_job_t *pjob, int doc_number, ipp_dstate_t doc_state);
 static void	update_job_status(http_t *http, proxy_info_t *info, proxy_job_t *pjob);
 static bool	update_remote_jobs(http_t *http, proxy_info_t *info);
 static int	usage(FILE *out);
+#ifndef _WIN32
+static bool	wait_device(proxy_info_t *info, proxy_job_t *pjob, int sock);
+#endif // !_WIN32
+static void	wait_seconds(proxy_info_t *info, double secs);
+static void	wake_jobs(proxy_info_t *info);
+static bool	write_device(proxy_info_t *info, proxy_job_t *pjob, int sock, const char *buffer, size_t bytes);
 
 
 //
@@ -158,17 +213,34 @@ main(int  argc,				// I - Number of command-line arguments
   int		i;			// Looping var
   char		*opt;			// Current option
   http_t	*http;			// Connection to printer
-  int		subscription_id;	// Event subscription ID
   unsigned	interval = 1;		// Current retry interval
-  proxy_info_t	info;			// Proxy information
+  int		num_printers = 0,	// Number of printers
+		num_devices = 0;	// Number of devices
+  const char	**printer_uris,		// Infrastructure Printer URIs
+		**device_uris;		// Device URIs
+  const char	*outformat = NULL,	// Desired output format
+		*spool_dir = NULL;	// Spool directory
+  double	status_interval = 0.001 * STATUS_INTERVAL;
+					// Minimum time between status updates
+  proxy_info_t	*infos,			// Proxy information for each printer
+		*info;			// Current proxy information
+  char		scheme[32],		// URI scheme
+		userpass[256],		// URI user:pass
+		host[256],		// URI host
+		first_host[256];	// Host for first printer
+  int		port,			// URI port
+		first_port = 0;		// Port for first printer
 
 
-  // Initialize the proxy information
-  memset(&info, 0, sizeof(info));
+  // Allocate room for the printer and device URIs...
+  printer_uris = calloc((size_t)argc, sizeof(char *));
+  device_uris  = calloc((size_t)argc, sizeof(char *));
 
-  cupsRWInit(&info.jobs_rwlock);
-  cupsMutexInit(&info.jobs_mutex);
-  cupsCondInit(&info.jobs_cond);
+  if (!printer_uris || !device_uris)
+  {
+    perror("ippproxy: Unable to allocate memory");
+    return (1);
+  }
 
   // Parse command-line...
   for (i = 1; i < argc; i ++)
@@ -210,7 +282,18 @@ main(int  argc,				// I - Number of command-line arguments
 		return (usage(stderr));
 	      }
 
-	      info.device_uri = argv[i];
+	      device_uris[num_devices ++] = argv[i];
+	      break;
+
+	  case 'i' : // -i status-interval-msec
+	      i ++;
+	      if (i >= argc || !isdigit(argv[i][0] & 255))
+	      {
+	        fputs("ippproxy: Missing or bad status interval after '-i' option.\n", stderr);
+		return (usage(stderr));
+	      }
+
+	      status_interval = 0.001 * atoi(argv[i]);
 	      break;
 
           case 'm' : // -m mime/type
@@ -221,7 +304,7 @@ main(int  argc,				// I - Number of command-line arguments
 		return (usage(stderr));
 	      }
 
-	      info.outformat = argv[i];
+	      outformat = argv[i];
 	      break;
 
 	  case 'p' : // -p password
@@ -235,6 +318,23 @@ main(int  argc,				// I - Number of command-line arguments
 	      password = argv[i];
 	      break;
 
+	  case 's' : // -s spool-directory
+	      i ++;
+	      if (i >= argc)
+	      {
+	        fputs("ippproxy: Missing spool directory after '-s' option.\n", stderr);
+		return (usage(stderr));
+	      }
+
+	      if (access(argv[i], W_OK))
+	      {
+	        fprintf(stderr, "ippproxy: Unable to use spool directory '%s': %s\n", argv[i], strerror(errno));
+		return (1);
+	      }
+
+	      spool_dir = argv[i];
+	      break;
+
 	  case 'u' : // -u user
 	      i ++;
 	      if (i >= argc)
@@ -256,23 +356,18 @@ main(int  argc,				// I - Number of command-line arguments
 	}
       }
     }
-    else if (info.printer_uri)
-    {
-      fprintf(stderr, "ippproxy: Unexpected option '%s'.\n", argv[i]);
-      return (usage(stderr));
-    }
     else
     {
-      info.printer_uri = strdup(argv[i]);
+      printer_uris[num_printers ++] = argv[i];
     }
   }
 
-  if (!info.printer_uri)
+  if (num_printers == 0)
     return (usage(stderr));
 
-  if (!info.device_uri)
+  if (num_devices != num_printers)
   {
-    fputs("ippproxy: Must specify '-d device-uri'.\n", stderr);
+    fputs("ippproxy: Must specify one '-d device-uri' for each printer.\n", stderr);
     return (usage(stderr));
   }
 
@@ -282,39 +377,86 @@ main(int  argc,				// I - Number of command-line arguments
   if (password)
     cupsSetPasswordCB(password_cb, password);
 
-  make_uuid(info.device_uri, info.device_uuid, sizeof(info.device_uuid));
+  // Initialize the proxy information for each printer...
+  if ((infos = calloc((size_t)num_printers, sizeof(proxy_info_t))) == NULL)
+  {
+    perror("ippproxy: Unable to allocate memory");
+    return (1);
+  }
+
+  srandom((unsigned)time(NULL) ^ (unsigned)getpid());
+
+  for (i = 0, info = infos; i < num_printers; i ++, info ++)
+  {
+    info->printer_uri     = strdup(printer_uris[i]);
+    info->device_uri      = device_uris[i];
+    info->outformat       = outformat;
+    info->spool_dir       = spool_dir;
+    info->status_interval = status_interval;
+
+    cupsRWInit(&info->jobs_rwlock);
+    cupsMutexInit(&info->jobs_mutex);
+    cupsCondInit(&info->jobs_cond);
+
+    make_uuid(info->device_uri, info->device_uuid, sizeof(info->device_uuid));
+
+    if (httpSeparateURI(HTTP_URI_CODING_ALL, info->printer_uri, scheme, sizeof(scheme), userpass, sizeof(userpass), host, sizeof(host), &port, info->resource, sizeof(info->resource)) < HTTP_URI_STATUS_OK)
+    {
+      fprintf(stderr, "ippproxy: Bad printer URI '%s'.\n", info->printer_uri);
+      return (1);
+    }
+
+    // Notifications for all printers are polled using a single connection...
+    if (i == 0)
+    {
+      cupsCopyString(first_host, host, sizeof(first_host));
+      first_port = port;
+    }
+    else if (strcmp(host, first_host) || port != first_port)
+    {
+      fprintf(stderr, "ippproxy: Printer URI '%s' is not on the same Infrastructure System as '%s'.\n", info->printer_uri, infos[0].printer_uri);
+      return (1);
+    }
+  }
+
+  free(printer_uris);
+  free(device_uris);
 
   // Connect to the infrastructure printer...
   if (verbosity)
-    plogf(NULL, "Main thread connecting to '%s'.", info.printer_uri);
+    plogf(NULL, "Main thread connecting to '%s'.", infos[0].printer_uri);
 
-  while ((http = httpConnectURI(info.printer_uri, /*host*/NULL, /*hsize*/0, /*port*/NULL, info.resource, sizeof(info.resource), /*blocking*/true, /*msec*/30000, /*cancel*/NULL, /*require_ca*/false)) == NULL)
+  while ((http = httpConnectURI(infos[0].printer_uri, /*host*/NULL, /*hsize*/0, /*port*/NULL, /*resource*/NULL, /*rsize*/0, /*blocking*/true, /*msec*/30000, /*cancel*/NULL, /*require_ca*/false)) == NULL)
   {
-    interval = FIB_NEXT(interval);
+    double delay = backoff(&interval);	// Delay before retrying
 
-    plogf(NULL, "'%s' is not responding, retrying in %u seconds.", info.printer_uri, FIB_VALUE(interval));
-    sleep(FIB_VALUE(interval));
+    plogf(NULL, "'%s' is not responding, retrying in %.1f seconds.", infos[0].printer_uri, delay);
+    wait_seconds(NULL, delay);
   }
 
   if (verbosity)
-    plogf(NULL, "Connected to '%s'.", info.printer_uri);
+    plogf(NULL, "Connected to '%s'.", infos[0].printer_uri);
 
-  // Register the printer and wait for jobs to process...
+  // Register the printers and wait for jobs to process...
 #ifndef _WIN32
   signal(SIGHUP, sighandler);
   signal(SIGINT, sighandler);
   signal(SIGTERM, sighandler);
 #endif // !_WIN32
 
-  if ((subscription_id = register_printer(&http, &info)) == 0)
+  for (i = 0, info = infos; i < num_printers; i ++, info ++)
   {
-    httpClose(http);
-    return (1);
+    if (!register_printer(&http, info))
+    {
+      httpClose(http);
+      return (1);
+    }
   }
 
-  run_printer(http, &info, subscription_id);
+  run_printers(http, infos, num_printers);
 
-  deregister_printer(http, &info, subscription_id);
+  for (i = 0, info = infos; i < num_printers; i ++, info ++)
+    deregister_printer(http, info);
 
   httpClose(http);
 
@@ -322,6 +464,34 @@ main(int  argc,				// I - Number of command-line arguments
 }
 
 
+//
+// 'acknowledge_document()' - Acknowledge receipt of document data.
+//
+
+static void
+acknowledge_document(
+    http_t       *http,			// I - HTTP connection
+    proxy_info_t *info,			// I - Proxy information
+    proxy_job_t  *pjob,			// I - Proxy job
+    int          doc_number)		// I - Document number
+{
+  ipp_t	*request;			// IPP request
+
+
+  request = ippNewRequest(IPP_OP_ACKNOWLEDGE_DOCUMENT);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, info->printer_uri);
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", pjob->remote_job_id);
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "document-number", doc_number);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "output-device-uuid", NULL, info->device_uuid);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+
+  ippDelete(cupsDoRequest(http, request, info->resource));
+
+  if (cupsGetError() >= IPP_STATUS_REDIRECTION_OTHER_SITE)
+    plogf(pjob, "Unable to acknowledge document #%d: %s", doc_number, cupsGetErrorString());
+}
+
+
 //
 // 'acknowledge_identify_printer()' - Acknowledge an Identify-Printer request.
 //
@@ -413,7 +583,34 @@ attrs_are_equal(ipp_attribute_t *a,	// I - First attribute
 	break;
 
     default :
-	return (false);
+        {
+          // Compare the string representation of other values...
+	  size_t	alen = ippAttributeString(a, NULL, 0),
+			blen = ippAttributeString(b, NULL, 0);
+					// Length of values
+          char		*avalue,	// First value
+			*bvalue;	// Second value
+          bool		equal = false;	// Are the values equal?
+
+          if (alen != blen)
+            return (false);
+
+          avalue = malloc(alen + 1);
+          bvalue = malloc(blen + 1);
+
+          if (avalue && bvalue)
+          {
+            ippAttributeString(a, avalue, alen + 1);
+            ippAttributeString(b, bvalue, blen + 1);
+
+            equal = !strcmp(avalue, bvalue);
+          }
+
+          free(avalue);
+          free(bvalue);
+
+          return (equal);
+        }
   }
 
   // If we get this far we must be the same...
@@ -421,6 +618,22 @@ attrs_are_equal(ipp_attribute_t *a,	// I - First attribute
 }
 
 
+//
+// 'backoff()' - Compute the next retry delay.
+//
+// The delay follows a Fibonacci sequence (1, 2, 3, 5, 8, ... seconds) with
+// random jitter so that many proxies do not retry in lock step.
+//
+
+static double				// O - Delay in seconds
+backoff(unsigned *interval)		// IO - Current retry interval
+{
+  *interval = FIB_NEXT(*interval);
+
+  return (FIB_VALUE(*interval) * (0.5 + 0.5 * (random() & 32767) / 32767.0));
+}
+
+
 //
 // 'compare_jobs()' - Compare two jobs.
 //
@@ -510,8 +723,7 @@ create_media_size(int width,		// I - x-dimension in 2540ths
 static void
 deregister_printer(
     http_t       *http,			// I - Connection to printer
-    proxy_info_t *info,			// I - Proxy information
-    int          subscription_id)	// I - Subscription ID
+    proxy_info_t *info)			// I - Proxy information
 {
   ipp_t	*request;			// IPP request
 
@@ -519,7 +731,7 @@ deregister_printer(
   // Cancel the subscription we are using...
   request = ippNewRequest(IPP_OP_CANCEL_SUBSCRIPTION);
   ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, info->printer_uri);
-  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-id", subscription_id);
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-id", info->subscription_id);
   ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
 
   ippDelete(cupsDoRequest(http, request, info->resource));
@@ -534,6 +746,49 @@ deregister_printer(
 }
 
 
+//
+// 'fetch_document()' - Fetch a document from the Infrastructure Printer.
+//
+// On success the document data is ready to be read from the HTTP connection.
+//
+
+static ipp_t *				// O - Document attributes or `NULL` on error
+fetch_document(
+    http_t       *http,			// I - HTTP connection
+    proxy_info_t *info,			// I - Proxy information
+    proxy_job_t  *pjob,			// I - Proxy job
+    const char   *doc_format,		// I - Desired document format or `NULL`
+    int          doc_number)		// I - Document number
+{
+  ipp_t	*request,			// IPP request
+	*doc_attrs;			// Document attributes
+
+
+  request = ippNewRequest(IPP_OP_FETCH_DOCUMENT);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, info->printer_uri);
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", pjob->remote_job_id);
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "document-number", doc_number);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "output-device-uuid", NULL, info->device_uuid);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+  if (doc_format)
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_MIMETYPE, "document-format-accepted", NULL, doc_format);
+//  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "compression-accepted", NULL, "gzip");
+
+  cupsSendRequest(http, request, info->resource, ippGetLength(request));
+  doc_attrs = cupsGetResponse(http, info->resource);
+  ippDelete(request);
+
+  if (!doc_attrs || cupsGetError() >= IPP_STATUS_REDIRECTION_OTHER_SITE)
+  {
+    plogf(pjob, "Unable to fetch document #%d: %s", doc_number, cupsGetErrorString());
+    ippDelete(doc_attrs);
+    return (NULL);
+  }
+
+  return (doc_attrs);
+}
+
+
 //
 // 'find_job()' - Find a remote job that has been queued for proxying...
 //
@@ -556,6 +811,39 @@ find_job(proxy_info_t *info,		// I - Proxy info
 }
 
 
+//
+// 'flush_status()' - Send any pending job and document status updates.
+//
+// Updates are only sent if `force` is `true` or the status interval has
+// elapsed since the last update.  The HTTP connection must be idle.
+//
+
+static void
+flush_status(http_t       *http,	// I - HTTP connection
+             proxy_info_t *info,	// I - Proxy info
+             proxy_job_t  *pjob,	// I - Proxy job
+             bool         force)	// I - Send updates now?
+{
+  double	curtime = time_seconds();
+					// Current time
+
+
+  if (!force && (curtime - pjob->status_time) < info->status_interval)
+    return;
+
+  if (pjob->doc_number)
+  {
+    send_document_status(http, info, pjob, pjob->doc_number, pjob->doc_state);
+    pjob->doc_number = 0;
+  }
+
+  if (pjob->local_job_state != pjob->sent_job_state)
+    send_job_status(http, info, pjob);
+
+  pjob->status_time = curtime;
+}
+
+
 //
 // 'get_device_attrs()' - Get current attributes for a device.
 //
@@ -581,10 +869,13 @@ get_device_attrs(const char *device_uri)// I - Device URI
     // Connect to the printer...
     while ((http = httpConnectURI(device_uri, /*host*/NULL, /*hsize*/0, /*port*/NULL, resource, sizeof(resource), /*blocking*/true, /*msec*/30000, /*cancel*/NULL, /*require_ca*/false)) == NULL)
     {
-      interval = FIB_NEXT(interval);
+      double delay = backoff(&interval);// Retry delay
+
+      plogf(NULL, "'%s' is not responding, retrying in %.1f seconds.", device_uri, delay);
+      wait_seconds(NULL, delay);
 
-      plogf(NULL, "'%s' is not responding, retrying in %u seconds.", device_uri, FIB_VALUE(interval));
-      sleep(FIB_VALUE(interval));
+      if (stop_running)
+        return (NULL);
     }
 
     // Get the attributes...
@@ -932,6 +1223,66 @@ plogf(proxy_job_t *pjob,			// I - Proxy job, if any
 }
 
 
+//
+// 'print_spooled_document()' - Send a spooled document to the local printer, retrying as needed.
+//
+
+static void
+print_spooled_document(
+    http_t       *http,			// I - HTTP connection
+    proxy_info_t *info,			// I - Proxy information
+    proxy_job_t  *pjob,			// I - Proxy job
+    ipp_t        *job_attrs,		// I - Job attributes
+    ipp_t        *doc_attrs,		// I - Document attributes
+    int          doc_number)		// I - Document number
+{
+  int		attempt;		// Current attempt
+  unsigned	interval = 1;		// Current retry interval
+  double	delay;			// Current retry delay
+  char		filename[1024];		// Spool filename
+  cups_file_t	*doc_file;		// Spool file
+
+
+  spool_filename(info, pjob, doc_number, filename, sizeof(filename));
+
+  for (attempt = 1; attempt <= DEVICE_MAX_ATTEMPTS; attempt ++)
+  {
+    if ((doc_file = cupsFileOpen(filename, "r")) == NULL)
+    {
+      plogf(pjob, "Unable to open spool file '%s': %s", filename, strerror(errno));
+      pjob->local_job_state = IPP_JSTATE_ABORTED;
+      return;
+    }
+
+    pjob->local_job_state = IPP_JSTATE_PROCESSING;
+
+    send_document(http, info, pjob, job_attrs, doc_attrs, doc_file, doc_number);
+
+    cupsFileClose(doc_file);
+
+    if (pjob->local_job_state != IPP_JSTATE_ABORTED || pjob->remote_job_state >= IPP_JSTATE_CANCELED || info->done || stop_running)
+      return;
+
+    if (attempt == DEVICE_MAX_ATTEMPTS)
+      break;
+
+    // Back off and try again without going back to the Infrastructure Printer...
+    pjob->local_job_state = IPP_JSTATE_PROCESSING;
+    delay                 = backoff(&interval);
+
+    plogf(pjob, "Unable to print document #%d, retrying in %.1f seconds.", doc_number, delay);
+
+    flush_status(http, info, pjob, /*force*/false);
+
+    wait_seconds(info, delay);
+  }
+
+  plogf(pjob, "Giving up on document #%d after %d attempts.", doc_number, DEVICE_MAX_ATTEMPTS);
+
+  update_document_status(http, info, pjob, doc_number, IPP_DSTATE_ABORTED);
+}
+
+
 //
 // 'proxy_jobs()' - Relay jobs to the local printer.
 //
@@ -957,8 +1308,6 @@ proxy_jobs(proxy_info_t *info)		// I - Printer and device info
   if (password)
     cupsSetPasswordCB(password_cb, password);
 
-  cupsMutexLock(&info->jobs_mutex);
-
   while (!info->done)
   {
     // Look for a fetchable job...
@@ -992,16 +1341,37 @@ proxy_jobs(proxy_info_t *info)		// I - Printer and device info
       if (verbosity)
         plogf(NULL, "Waiting for jobs.");
 
-      cupsCondWait(&info->jobs_cond, &info->jobs_mutex, 15.0);
+      // Only hold the mutex while waiting so that the event loop never blocks
+      // on a job that is printing...
+      cupsMutexLock(&info->jobs_mutex);
+      if (!info->jobs_changed && !info->done)
+        cupsCondWait(&info->jobs_cond, &info->jobs_mutex, 15.0);
+      info->jobs_changed = false;
+      cupsMutexUnlock(&info->jobs_mutex);
     }
   }
 
-  cupsMutexUnlock(&info->jobs_mutex);
-
   return (NULL);
 }
 
 
+//
+// 'read_document()' - Read document data from a spool file or HTTP connection.
+//
+
+static ssize_t				// O - Number of bytes read or `-1` on error
+read_document(http_t      *http,	// I - HTTP connection
+              cups_file_t *doc_file,	// I - Spool file or `NULL`
+              char        *buffer,	// I - Buffer
+              size_t      bufsize)	// I - Size of buffer
+{
+  if (doc_file)
+    return (cupsFileRead(doc_file, buffer, bufsize));
+  else
+    return (cupsReadResponseData(http, buffer, bufsize));
+}
+
+
 //
 // 'register_printer()' - Register the printer (output device) with the Infrastructure Printer.
 //
@@ -1109,7 +1479,9 @@ register_printer(
 
   if ((attr = ippFindAttribute(response, "notify-subscription-id", IPP_TAG_INTEGER)) != NULL)
   {
-    subscription_id = ippGetInteger(attr, 0);
+    subscription_id       = ippGetInteger(attr, 0);
+    info->subscription_id = subscription_id;
+    info->seq_number      = 1;
 
     if (verbosity)
       plogf(NULL, "Monitoring events with subscription #%d.", subscription_id);
@@ -1134,7 +1506,8 @@ run_job(proxy_info_t *info,		// I - Proxy information
         proxy_job_t  *pjob)		// I - Proxy job to fetch and print
 {
   http_t	*http;			// HTTP connection
-  bool		first_time = true;	// First time connecting?
+  unsigned	interval = 1;		// Current retry interval
+  double	delay;			// Current retry delay
   ipp_t		*request,		// IPP request
 		*job_attrs,		// Job attributes
 		*doc_attrs;		// Document attributes
@@ -1142,6 +1515,10 @@ run_job(proxy_info_t *info,		// I - Proxy information
 		doc_number;		// Current document number
   ipp_attribute_t *doc_formats;		// Supported document formats
   const char	*doc_format = NULL;	// Document format we want...
+  double	start,			// Start time
+		elapsed,		// Elapsed time
+		complete;		// Completion time
+  char		filename[1024];		// Spool filename
 
 
   // Figure out the output format we want to use...
@@ -1174,15 +1551,16 @@ run_job(proxy_info_t *info,		// I - Proxy information
   while ((http = httpConnectURI(info->printer_uri, /*host*/NULL, /*hsize*/0, /*port*/NULL, /*resource*/NULL, /*rsize*/0, /*blocking*/true, /*msec*/30000, /*cancel*/NULL, /*require_ca*/false)) == NULL)
   {
     if (info->done)
+    {
+      ippDelete(request);
       return;
+    }
 
-    if (first_time)
-      plogf(NULL, "'%s' is not responding, retrying in 15 seconds.", info->printer_uri);
+    delay = backoff(&interval);
 
-    first_time = false;
+    plogf(NULL, "'%s' is not responding, retrying in %.1f seconds.", info->printer_uri, delay);
 
-    for (int i = 0; i < 15 && !info->done; i ++)
-      sleep(1);
+    wait_seconds(info, delay);
   }
 
   if (verbosity)
@@ -1206,6 +1584,9 @@ run_job(proxy_info_t *info,		// I - Proxy information
     goto update_job;
   }
 
+  pjob->fetch_time      = time_seconds();
+  pjob->first_byte_time = 0.0;
+
   request = ippNewRequest(IPP_OP_ACKNOWLEDGE_JOB);
   ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, info->printer_uri);
   ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", pjob->remote_job_id);
@@ -1228,60 +1609,112 @@ run_job(proxy_info_t *info,		// I - Proxy information
 
   // Then get the document data for each document in the job...
   pjob->local_job_state = IPP_JSTATE_PROCESSING;
+  pjob->local_bytes     = 0;
+  start                 = time_seconds();
 
   update_job_status(http, info, pjob);
 
-  for (doc_number = 1; doc_number <= num_docs; doc_number ++)
+  if (info->spool_dir)
   {
-    if (pjob->remote_job_state >= IPP_JSTATE_ABORTED)
-      break;
+    // Spool and acknowledge all of the documents before sending them to the
+    // local printer, so that device problems don't hold up the Infrastructure
+    // Printer...
+    ipp_t	**docs;			// Document attributes for spooled documents
+    int		num_spooled = 0;	// Number of spooled documents
 
-    update_document_status(http, info, pjob, doc_number, IPP_DSTATE_PROCESSING);
+    if ((docs = calloc((size_t)num_docs, sizeof(ipp_t *))) == NULL)
+    {
+      plogf(pjob, "Unable to allocate memory for %d documents.", num_docs);
+      pjob->local_job_state = IPP_JSTATE_ABORTED;
+      goto update_job;
+    }
 
-    request = ippNewRequest(IPP_OP_FETCH_DOCUMENT);
-    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, info->printer_uri);
-    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", pjob->remote_job_id);
-    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "document-number", doc_number);
-    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "output-device-uuid", NULL, info->device_uuid);
-    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
-    if (doc_format)
-      ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_MIMETYPE, "document-format-accepted", NULL, doc_format);
-//    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "compression-accepted", NULL, "gzip");
+    for (doc_number = 1; doc_number <= num_docs; doc_number ++)
+    {
+      if (pjob->remote_job_state >= IPP_JSTATE_ABORTED)
+	break;
 
-    cupsSendRequest(http, request, info->resource, ippGetLength(request));
-    doc_attrs = cupsGetResponse(http, info->resource);
-    ippDelete(request);
+      update_document_status(http, info, pjob, doc_number, IPP_DSTATE_PROCESSING);
 
-    if (!doc_attrs || cupsGetError() >= IPP_STATUS_REDIRECTION_OTHER_SITE)
-    {
-      plogf(pjob, "Unable to fetch document #%d: %s", doc_number, cupsGetErrorString());
+      if ((doc_attrs = fetch_document(http, info, pjob, doc_format, doc_number)) == NULL)
+      {
+	pjob->local_job_state = IPP_JSTATE_ABORTED;
+	break;
+      }
 
-      pjob->local_job_state = IPP_JSTATE_ABORTED;
-      ippDelete(doc_attrs);
-      break;
+      if (!spool_document(http, info, pjob, doc_attrs, doc_number))
+      {
+	pjob->local_job_state = IPP_JSTATE_ABORTED;
+	ippDelete(doc_attrs);
+	break;
+      }
+
+      acknowledge_document(http, info, pjob, doc_number);
+
+      docs[num_spooled ++] = doc_attrs;
     }
 
-    if (pjob->remote_job_state < IPP_JSTATE_ABORTED)
+    for (doc_number = 1; doc_number <= num_spooled; doc_number ++)
     {
-      // Send document to local printer...
-      send_document(http, info, pjob, job_attrs, doc_attrs, doc_number);
+      if (pjob->local_job_state != IPP_JSTATE_ABORTED && pjob->remote_job_state < IPP_JSTATE_ABORTED)
+	print_spooled_document(http, info, pjob, job_attrs, docs[doc_number - 1], doc_number);
+
+      ippDelete(docs[doc_number - 1]);
+
+      spool_filename(info, pjob, doc_number, filename, sizeof(filename));
+      unlink(filename);
     }
 
-    // Acknowledge receipt of the document data...
-    ippDelete(doc_attrs);
+    free(docs);
+  }
+  else
+  {
+    // Send each document to the local printer as it is fetched...
+    for (doc_number = 1; doc_number <= num_docs; doc_number ++)
+    {
+      if (pjob->remote_job_state >= IPP_JSTATE_ABORTED)
+	break;
 
-    request = ippNewRequest(IPP_OP_ACKNOWLEDGE_DOCUMENT);
-    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, info->printer_uri);
-    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", pjob->remote_job_id);
-    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "document-number", doc_number);
-    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "output-device-uuid", NULL, info->device_uuid);
-    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+      update_document_status(http, info, pjob, doc_number, IPP_DSTATE_PROCESSING);
+
+      if ((doc_attrs = fetch_document(http, info, pjob, doc_format, doc_number)) == NULL)
+      {
+	pjob->local_job_state = IPP_JSTATE_ABORTED;
+	break;
+      }
+
+      if (pjob->remote_job_state < IPP_JSTATE_ABORTED)
+      {
+	// Send document to local printer...
+	send_document(http, info, pjob, job_attrs, doc_attrs, /*doc_file*/NULL, doc_number);
+      }
+
+      // Acknowledge receipt of the document data...
+      ippDelete(doc_attrs);
 
-    ippDelete(cupsDoRequest(http, request, info->resource));
+      acknowledge_document(http, info, pjob, doc_number);
+    }
   }
 
+  if (pjob->local_job_state == IPP_JSTATE_ABORTED)
+    goto update_job;
+
   pjob->local_job_state = IPP_JSTATE_COMPLETED;
 
+  // Report the throughput for the job...
+  if ((elapsed = time_seconds() - start) < 0.001)
+    elapsed = 0.001;
+
+  plogf(pjob, "Sent %ld bytes to the local printer in %.3f seconds (%.1f KiB/second).", (long)pjob->local_bytes, elapsed, pjob->local_bytes / elapsed / 1024.0);
+
+  // Report the latency of each stage (notify, fetch, first byte, complete)...
+  if (!pjob->first_byte_time)
+    pjob->first_byte_time = pjob->fetch_time;
+
+  complete = time_seconds();
+
+  plogf(pjob, "Stage latency: notify-to-fetch=%.3f fetch-to-first-byte=%.3f first-byte-to-complete=%.3f total=%.3f seconds.", pjob->fetch_time - pjob->queue_time, pjob->first_byte_time - pjob->fetch_time, complete - pjob->first_byte_time, complete - pjob->queue_time);
+
   // Update the job state and return...
   update_job:
 
@@ -1294,58 +1727,57 @@ run_job(proxy_info_t *info,		// I - Proxy information
 
 
 //
-// 'run_printer()' - Run the printer until no work remains.
+// 'run_printers()' - Run the printers until no work remains.
+//
+// Events for all of the printers are collected using a single Get-Notifications
+// request listing every subscription.
 //
 
 static void
-run_printer(
-    http_t       *http,			// I - Connection to printer
-    proxy_info_t *info,			// I - Proxy information
-    int          subscription_id)	// I - Subscription ID
+run_printers(
+    http_t       *http,			// I - Connection to Infrastructure System
+    proxy_info_t *infos,		// I - Proxy information for each printer
+    int          num_infos)		// I - Number of printers
 {
-  ipp_t		*device_attrs,		// Device attributes
-		*request,		// IPP request
+  int		i;			// Looping var
+  proxy_info_t	*info;			// Current printer
+  ipp_t		*request,		// IPP request
 		*response;		// IPP response
   http_status_t	status;			// HTTP status
-  ipp_attribute_t *attr;		// IPP attribute
+  ipp_attribute_t *attr,		// IPP attribute
+		*sub_ids,		// notify-subscription-ids
+		*seq_numbers,		// notify-sequence-numbers
+		*seq_attr;		// notify-sequence-number for event
   const char	*name,			// Attribute name
 		*event;			// Current event
-  int		job_id;			// Job ID, if any
+  int		sub_id,			// Subscription ID, if any
+		job_id;			// Job ID, if any
   ipp_jstate_t	job_state;		// Job state, if any
-  int		seq_number = 1;		// Current event sequence number
+  bool		identify;		// Identify-Printer requested?
   int		get_interval;		// How long to sleep
-  cups_thread_t	jobs_thread;		// Job proxy processing thread
+  unsigned	interval = 1;		// Current retry interval
+  double	delay;			// Current retry delay
 
 
-  plogf(NULL, "run_printer: info              = %p", (void *)info);
-  plogf(NULL, "run_printer: info->done        = %s", info->done ? "true" : "false");
-  plogf(NULL, "run_printer: info->printer_uri = \"%s\"", info->printer_uri);
-  plogf(NULL, "run_printer: info->resource    = \"%s\"", info->resource);
-  plogf(NULL, "run_printer: info->device_uri  = \"%s\"", info->device_uri);
-  plogf(NULL, "run_printer: info->device_uuid = \"%s\"", info->device_uuid);
-  plogf(NULL, "run_printer: info->outformat   = \"%s\"", info->outformat);
+  // Start the job processing threads and register the output devices...
+  for (i = 0, info = infos; i < num_infos; i ++, info ++)
+  {
+    if (!start_printer(http, info))
+      goto done;
+  }
 
-  // Query the printer...
-  device_attrs = get_device_attrs(info->device_uri);
-
-  // Setup job processing...
-  info->jobs  = cupsArrayNew((cups_array_cb_t)compare_jobs, NULL, NULL, 0, NULL, (cups_afree_cb_t)free);
-  jobs_thread = cupsThreadCreate((cups_thread_func_t)proxy_jobs, info);
-
-  // Register the output device...
-  if (!update_device_attrs(http, info, device_attrs))
-    return;
-
-  if (!update_remote_jobs(http, info))
-    return;
-
-  while (!stop_running && !info->done)
+  while (!stop_running)
   {
     // See if we have any work to do...
     request = ippNewRequest(IPP_OP_GET_NOTIFICATIONS);
-    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, info->printer_uri);
-    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-ids", subscription_id);
-    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-sequence-numbers", seq_number);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, infos[0].printer_uri);
+    sub_ids     = ippAddIntegers(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-ids", (size_t)num_infos, NULL);
+    seq_numbers = ippAddIntegers(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-sequence-numbers", (size_t)num_infos, NULL);
+    for (i = 0, info = infos; i < num_infos; i ++, info ++)
+    {
+      ippSetInteger(request, &sub_ids, (size_t)i, info->subscription_id);
+      ippSetInteger(request, &seq_numbers, (size_t)i, info->seq_number);
+    }
     ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
     ippAddBoolean(request, IPP_TAG_OPERATION, "notify-wait", true);
 
@@ -1354,24 +1786,24 @@ run_printer(
 
     response = NULL;
 
-    while (response == NULL && !stop_running && !info->done)
+    while (response == NULL && !stop_running)
     {
       // Send the request...
-      status = cupsSendRequest(http, request, info->resource, ippGetLength(request));
+      status = cupsSendRequest(http, request, infos[0].resource, ippGetLength(request));
 
       // Wait for a response...
-      while (status == HTTP_STATUS_CONTINUE && !stop_running && !info->done)
+      while (status == HTTP_STATUS_CONTINUE && !stop_running)
       {
 	if (httpWait(http, 1000))
 	  break;
       }
 
-      if (stop_running || info->done)
+      if (stop_running)
         break;
 
       // Get the server's response...
       if (status <= HTTP_STATUS_CONTINUE || status == HTTP_STATUS_OK)
-	response = cupsGetResponse(http, info->resource);
+	response = cupsGetResponse(http, infos[0].resource);
 
       if (httpGetState(http) != HTTP_STATE_WAITING)
       {
@@ -1385,13 +1817,42 @@ run_printer(
 
     ippDelete(request);
 
-    if (!response)
+    if (stop_running)
+    {
+      ippDelete(response);
+      break;
+    }
+
+    if (!response || cupsGetError() >= IPP_STATUS_REDIRECTION_OTHER_SITE)
     {
-      plogf(/*pjob*/NULL, "Unable to get notifications: %s", cupsGetErrorString());
-      sleep(30);
+      // Back off and retry, spreading out reconnects from many proxies...
+      ipp_status_t error = cupsGetError();
+					// Error from request
+
+      ippDelete(response);
+
+      delay = backoff(&interval);
+
+      plogf(/*pjob*/NULL, "Unable to get notifications: %s, retrying in %.1f seconds.", cupsGetErrorString(), delay);
+      wait_seconds(NULL, delay);
+
+      if (error == IPP_STATUS_ERROR_NOT_FOUND)
+      {
+        // The server has forgotten our subscriptions (restarted?), so create
+        // new ones...
+	for (i = 0, info = infos; i < num_infos && !stop_running; i ++, info ++)
+	{
+	  if (!register_printer(&http, info))
+	    break;
+
+	  update_remote_jobs(http, info);
+	}
+      }
       continue;
     }
 
+    interval = 1;
+
     if (verbosity)
       plogipp(/*pjob*/NULL, /*is_request*/false, response);
 
@@ -1406,8 +1867,11 @@ run_printer(
         continue;
 
       event     = NULL;
+      sub_id    = 0;
       job_id    = 0;
       job_state = IPP_JSTATE_PENDING;
+      identify  = false;
+      seq_attr  = NULL;
 
       while (ippGetGroupTag(attr) == IPP_TAG_EVENT_NOTIFICATION && (name = ippGetName(attr)) != NULL)
       {
@@ -1415,6 +1879,10 @@ run_printer(
 	{
 	  event = ippGetString(attr, 0, NULL);
 	}
+	else if (!strcmp(name, "notify-subscription-id") && ippGetValueTag(attr) == IPP_TAG_INTEGER)
+	{
+	  sub_id = ippGetInteger(attr, 0);
+	}
 	else if ((!strcmp(name, "job-id") || !strcmp(name, "notify-job-id")) && ippGetValueTag(attr) == IPP_TAG_INTEGER)
 	{
 	  job_id = ippGetInteger(attr, 0);
@@ -1425,19 +1893,47 @@ run_printer(
 	}
 	else if (!strcmp(name, "notify-sequence-number") && ippGetValueTag(attr) == IPP_TAG_INTEGER)
 	{
-	  int new_seq = ippGetInteger(attr, 0);
-
-	  if (new_seq >= seq_number)
-	    seq_number = new_seq + 1;
+	  // Sequence numbers are per-subscription, so save this for below...
+	  seq_attr = attr;
 	}
 	else if (!strcmp(name, "printer-state-reasons") && ippContainsString(attr, "identify-printer-requested"))
 	{
-	  acknowledge_identify_printer(http, info);
+	  identify = true;
         }
 
         attr = ippGetNextAttribute(response);
       }
 
+      // Find the printer for this event...
+      for (i = 0, info = infos; i < num_infos; i ++, info ++)
+      {
+        if (info->subscription_id == sub_id)
+          break;
+      }
+
+      if (i >= num_infos)
+      {
+        if (num_infos > 1)
+        {
+          plogf(NULL, "Ignoring event for unknown subscription #%d.", sub_id);
+          continue;
+        }
+
+        info = infos;
+      }
+
+      if (seq_attr)
+      {
+        int new_seq = ippGetInteger(seq_attr, 0);
+					// New sequence number
+
+	if (new_seq >= info->seq_number)
+	  info->seq_number = new_seq + 1;
+      }
+
+      if (identify)
+        acknowledge_identify_printer(http, info);
+
       if (event && job_id)
       {
         get_interval = 0;
@@ -1457,13 +1953,15 @@ run_printer(
               pjob->remote_job_state = (int)job_state;
               pjob->local_job_state  = IPP_JSTATE_PENDING;
 
+	      pjob->queue_time       = time_seconds();
+
 	      plogf(pjob, "Job is now fetchable, queuing up.", pjob);
 
               cupsRWLockWrite(&info->jobs_rwlock);
               cupsArrayAdd(info->jobs, pjob);
               cupsRWUnlock(&info->jobs_rwlock);
 
-	      cupsCondBroadcast(&info->jobs_cond);
+	      wake_jobs(info);
 	    }
 	    else
 	    {
@@ -1484,12 +1982,14 @@ run_printer(
 
 	    plogf(pjob, "Updated remote job-state to '%s'.", ippEnumString("job-state", (int)job_state));
 
-	    cupsCondBroadcast(&info->jobs_cond);
+	    wake_jobs(info);
 	  }
 	}
       }
     }
 
+    ippDelete(response);
+
     // Pause before our next poll of the Infrastructure Printer...
     if (get_interval < 0 || get_interval > 30)
       get_interval = 30;
@@ -1497,21 +1997,22 @@ run_printer(
     if (verbosity)
       plogf(NULL, "Using notify-get-interval=%d", get_interval);
 
-    while (get_interval > 0 && !stop_running)
-    {
-      sleep(1);
-      get_interval --;
-    }
-
-//    httpConnectAgain(http, /*msec*/30000, /*cancel*/NULL);
+    wait_seconds(NULL, get_interval);
   }
 
-  // Stop the job proxy thread...
-  info->done = true;
+  // Stop the job proxy threads...
+  done:
 
-  cupsCondBroadcast(&info->jobs_cond);
-//  cupsThreadCancel(jobs_thread);
-  cupsThreadWait(jobs_thread);
+  for (i = 0, info = infos; i < num_infos; i ++, info ++)
+  {
+    if (!info->jobs)
+      continue;
+
+    info->done = true;
+
+    wake_jobs(info);
+    cupsThreadWait(info->jobs_thread);
+  }
 }
 
 
@@ -1525,6 +2026,7 @@ send_document(http_t       *http,	// I - HTTP connection
               proxy_job_t  *pjob,	// I - Proxy job
               ipp_t        *job_attrs,	// I - Job attributes
               ipp_t        *doc_attrs,	// I - Document attributes
+              cups_file_t  *doc_file,	// I - Spool file or `NULL` to read from the HTTP connection
               int          doc_number)	// I - Document number
 {
   char		scheme[32],		// URI scheme
@@ -1537,10 +2039,14 @@ send_document(http_t       *http,	// I - HTTP connection
   const char	*doc_compression;	// Document compression, if any
   size_t	doc_total = 0;		// Total bytes read
   ssize_t	doc_bytes;		// Bytes read/written
-  char		doc_buffer[16384];	// Copy buffer
+  char		*doc_buffer;		// Copy buffer
+  double	start,			// Start time
+		elapsed;		// Elapsed time
 
 
-  if ((doc_compression = ippGetString(ippFindAttribute(doc_attrs, "compression", IPP_TAG_KEYWORD), 0, NULL)) != NULL && !strcmp(doc_compression, "none"))
+  if (doc_file)
+    doc_compression = NULL;		// Spool files are already decompressed
+  else if ((doc_compression = ippGetString(ippFindAttribute(doc_attrs, "compression", IPP_TAG_KEYWORD), 0, NULL)) != NULL && !strcmp(doc_compression, "none"))
     doc_compression = NULL;
 
   if (httpSeparateURI(HTTP_URI_CODING_ALL, info->device_uri, scheme, sizeof(scheme), userpass, sizeof(userpass), host, sizeof(host), &port, resource, sizeof(resource)) < HTTP_URI_STATUS_OK)
@@ -1558,10 +2064,19 @@ send_document(http_t       *http,	// I - HTTP connection
     return;
   }
 
+  if ((doc_buffer = malloc(DOC_BUFFER_SIZE)) == NULL)
+  {
+    plogf(pjob, "Unable to allocate copy buffer: %s", strerror(errno));
+    pjob->local_job_state = IPP_JSTATE_ABORTED;
+    httpAddrFreeList(list);
+    return;
+  }
+
   if (!strcmp(scheme, "socket"))
   {
     // AppSocket connection...
     int		sock;			// Output socket
+    bool	spliced = false;	// Was the document spliced?
 
     if (verbosity)
       plogf(pjob, "Connecting to '%s'.", info->device_uri);
@@ -1571,33 +2086,52 @@ send_document(http_t       *http,	// I - HTTP connection
       plogf(pjob, "Unable to connect to '%s': %s", info->device_uri, cupsGetErrorString());
       pjob->local_job_state = IPP_JSTATE_ABORTED;
       httpAddrFreeList(list);
+      free(doc_buffer);
       return;
     }
 
     if (verbosity)
       plogf(pjob, "Connected to '%s'.", info->device_uri);
 
+#ifndef _WIN32
+    // Use non-blocking writes so we can wait on the device with poll()...
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+#endif // !_WIN32
+
+    start = time_seconds();
+
     if (doc_compression)
       httpSetField(http, HTTP_FIELD_CONTENT_ENCODING, doc_compression);
+#ifdef __linux
+    else if (!doc_file && !httpIsEncrypted(http) && !httpIsChunked(http) && httpGetRemaining(http) >= SPLICE_MIN_SIZE)
+      spliced = splice_document(http, info, pjob, sock, doc_buffer, &doc_total);
+#endif // __linux
 
-    while ((doc_bytes = cupsReadResponseData(http, doc_buffer, sizeof(doc_buffer))) > 0)
+    if (!spliced)
     {
-      char	*doc_ptr = doc_buffer,	// Pointer into buffer
-		*doc_end = doc_buffer + doc_bytes;
-					// End of buffer
+      while ((doc_bytes = read_document(http, doc_file, doc_buffer, DOC_BUFFER_SIZE)) > 0)
+      {
+	doc_total += (size_t)doc_bytes;
 
-      doc_total += (size_t)doc_bytes;
+	if (!write_device(info, pjob, sock, doc_buffer, (size_t)doc_bytes))
+	{
+	  pjob->local_job_state = IPP_JSTATE_ABORTED;
+	  break;
+	}
 
-      while (doc_ptr < doc_end)
-      {
-        if ((doc_bytes = write(sock, doc_ptr, (size_t)(doc_end - doc_ptr))) > 0)
-          doc_ptr += doc_bytes;
+        if (doc_file)
+          flush_status(http, info, pjob, /*force*/false);
       }
     }
 
     close(sock);
 
-    plogf(pjob, "Local job created, %ld bytes.", (long)doc_total);
+    if ((elapsed = time_seconds() - start) < 0.001)
+      elapsed = 0.001;
+
+    pjob->local_bytes += doc_total;
+
+    plogf(pjob, "Local job created, %ld bytes in %.3f seconds (%.1f KiB/second).", (long)doc_total, elapsed, doc_total / elapsed / 1024.0);
   }
   else
   {
@@ -1656,6 +2190,7 @@ send_document(http_t       *http,	// I - HTTP connection
     {
       plogf(pjob, "Unable to connect to '%s': %s\n", info->device_uri, cupsGetErrorString());
       httpAddrFreeList(list);
+      free(doc_buffer);
       pjob->local_job_state = IPP_JSTATE_ABORTED;
       return;
     }
@@ -1676,6 +2211,7 @@ send_document(http_t       *http,	// I - HTTP connection
       plogf(pjob, "Unable to get list of supported operations from printer.");
       pjob->local_job_state = IPP_JSTATE_ABORTED;
       httpAddrFreeList(list);
+      free(doc_buffer);
       ippDelete(response);
       httpClose(dev_http);
       return;
@@ -1733,6 +2269,7 @@ send_document(http_t       *http,	// I - HTTP connection
 	plogf(pjob, "Unable to create local job: %s", cupsGetErrorString());
 	pjob->local_job_state = IPP_JSTATE_ABORTED;
 	httpAddrFreeList(list);
+	free(doc_buffer);
 	httpClose(dev_http);
 	return;
       }
@@ -1750,14 +2287,19 @@ send_document(http_t       *http,	// I - HTTP connection
         plogipp(pjob, /*is_request*/true, request);
     }
 
+    start = time_seconds();
+
     if (cupsSendRequest(dev_http, request, resource, 0) == HTTP_STATUS_CONTINUE)
     {
-      while ((doc_bytes = cupsReadResponseData(http, doc_buffer, sizeof(doc_buffer))) > 0)
+      while ((doc_bytes = read_document(http, doc_file, doc_buffer, DOC_BUFFER_SIZE)) > 0)
       {
 	doc_total += (size_t)doc_bytes;
 
         if (cupsWriteRequestData(dev_http, doc_buffer, (size_t)doc_bytes) != HTTP_STATUS_CONTINUE)
           break;
+
+        if (!pjob->first_byte_time)
+          pjob->first_byte_time = time_seconds();
       }
     }
 
@@ -1778,11 +2320,17 @@ send_document(http_t       *http,	// I - HTTP connection
       plogf(pjob, "Unable to create local job: %s", cupsGetErrorString());
       pjob->local_job_state = IPP_JSTATE_ABORTED;
       httpAddrFreeList(list);
+      free(doc_buffer);
       httpClose(dev_http);
       return;
     }
 
-    plogf(pjob, "Local job %d created, %ld bytes.", pjob->local_job_id, (long)doc_total);
+    if ((elapsed = time_seconds() - start) < 0.001)
+      elapsed = 0.001;
+
+    pjob->local_bytes += doc_total;
+
+    plogf(pjob, "Local job %d created, %ld bytes in %.3f seconds (%.1f KiB/second).", pjob->local_job_id, (long)doc_total, elapsed, doc_total / elapsed / 1024.0);
 
     // Monitor job state...
     while (pjob->remote_job_state < IPP_JSTATE_CANCELED && job_state < IPP_JSTATE_CANCELED)
@@ -1810,6 +2358,8 @@ send_document(http_t       *http,	// I - HTTP connection
 
       if (job_state < IPP_JSTATE_CANCELED)
       {
+        flush_status(http, info, pjob, /*force*/false);
+
         sleep(FIB_VALUE(interval));
         interval = FIB_NEXT(interval);
       }
@@ -1845,8 +2395,88 @@ send_document(http_t       *http,	// I - HTTP connection
   }
 
   httpAddrFreeList(list);
+  free(doc_buffer);
+
+  if (pjob->local_job_state != IPP_JSTATE_ABORTED)
+    update_document_status(http, info, pjob, doc_number, IPP_DSTATE_COMPLETED);
+}
+
+
+//
+// 'send_document_status()' - Send an Update-Document-Status request.
+//
+
+static void
+send_document_status(
+    http_t       *http,			// I - HTTP connection
+    proxy_info_t *info,			// I - Proxy info
+    proxy_job_t  *pjob,			// I - Proxy job
+    int          doc_number,		// I - Document number
+    ipp_dstate_t doc_state)		// I - New document-state value
+{
+  ipp_t	*request,			// IPP request
+	*response;			// IPP response
+
+
+  request = ippNewRequest(IPP_OP_UPDATE_DOCUMENT_STATUS);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, info->printer_uri);
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", pjob->remote_job_id);
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "document-number", doc_number);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "output-device-uuid", NULL, info->device_uuid);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+
+  ippAddInteger(request, IPP_TAG_DOCUMENT, IPP_TAG_ENUM, "output-device-document-state", (int)doc_state);
+
+  if (verbosity)
+    plogipp(pjob, /*is_request*/true, request);
 
-  update_document_status(http, info, pjob, doc_number, IPP_DSTATE_COMPLETED);
+  response = cupsDoRequest(http, request, info->resource);
+
+  if (verbosity)
+    plogipp(pjob, /*is_request*/false, response);
+
+  ippDelete(response);
+
+  if (cupsGetError() >= IPP_STATUS_REDIRECTION_OTHER_SITE)
+    plogf(pjob, "Unable to update the state for document #%d: %s", doc_number, cupsGetErrorString());
+}
+
+
+//
+// 'send_job_status()' - Send an Update-Job-Status request.
+//
+
+static void
+send_job_status(http_t       *http,	// I - HTTP connection
+                proxy_info_t *info,	// I - Proxy info
+                proxy_job_t  *pjob)	// I - Proxy job
+{
+  ipp_t	*request,			// IPP request
+	*response;			// IPP response
+
+
+  request = ippNewRequest(IPP_OP_UPDATE_JOB_STATUS);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, info->printer_uri);
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", pjob->remote_job_id);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "output-device-uuid", NULL, info->device_uuid);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+
+  ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_ENUM, "output-device-job-state", (int)pjob->local_job_state);
+
+  pjob->sent_job_state = pjob->local_job_state;
+
+  if (verbosity)
+    plogipp(pjob, /*is_request*/true, request);
+
+  response = cupsDoRequest(http, request, info->resource);
+
+  if (verbosity)
+    plogipp(pjob, /*is_request*/false, response);
+
+  ippDelete(response);
+
+  if (cupsGetError() >= IPP_STATUS_REDIRECTION_OTHER_SITE)
+    plogf(pjob, "Unable to update the job state: %s", cupsGetErrorString());
 }
 
 
@@ -1863,6 +2493,363 @@ sighandler(int sig)			// I - Signal
 }
 
 
+#ifdef __linux
+//
+// 'splice_document()' - Copy document data to a socket without copying through userspace.
+//
+// The HTTP connection must not be encrypted or chunked.  Any data already
+// buffered by the HTTP connection is written first, and then the remaining
+// data is moved from the HTTP socket to the device socket through a pipe.
+// Since the HTTP connection does not know about the data we have consumed,
+// it is reconnected afterwards.  The copy fails if no document data arrives
+// for SPLICE_TIMEOUT seconds.
+//
+// `true` is returned once any data has been handled, even if copying failed
+// (the local job is then aborted).  `false` is only returned if the pipe could
+// not be created, in which case nothing was copied and the caller should fall
+// back to the normal copy loop.
+//
+
+static bool				// O - `true` if the document was handled, `false` to use the copy loop
+splice_document(
+    http_t       *http,			// I - HTTP connection
+    proxy_info_t *info,			// I - Proxy information
+    proxy_job_t  *pjob,			// I - Proxy job
+    int          sock,			// I - Output socket
+    char         *doc_buffer,		// I - Copy buffer
+    size_t       *doc_total)		// IO - Total bytes copied
+{
+  int		pipefds[2];		// Pipe between the sockets
+  int		pipesize;		// Size of pipe
+  int		http_fd = httpGetFd(http);
+					// HTTP socket
+  off_t		remaining;		// Remaining bytes to read
+  size_t	inpipe = 0,		// Bytes in the pipe
+		ready;			// Bytes buffered by the HTTP connection
+  ssize_t	bytes;			// Bytes moved
+  bool		ret = true;		// Return value
+  struct pollfd	pfd;			// poll() data for HTTP socket
+  int		pcount;			// Number of ready descriptors
+  double	data_time;		// Time of last document data
+
+
+  if (pipe(pipefds))
+    return (false);
+
+  // Try to make the pipe as large as our copy buffer...
+  if ((pipesize = fcntl(pipefds[1], F_SETPIPE_SZ, DOC_BUFFER_SIZE)) < 0 && (pipesize = fcntl(pipefds[1], F_GETPIPE_SZ)) < 0)
+    pipesize = 65536;
+
+  if (verbosity)
+    plogf(pjob, "Splicing %ld bytes to the local printer.", (long)httpGetRemaining(http));
+
+  // Write any data that has already been buffered...
+  while ((ready = httpGetReady(http)) > 0)
+  {
+    if (ready > DOC_BUFFER_SIZE)
+      ready = DOC_BUFFER_SIZE;
+
+    if ((bytes = cupsReadResponseData(http, doc_buffer, ready)) <= 0)
+      break;
+
+    *doc_total += (size_t)bytes;
+
+    if (!write_device(info, pjob, sock, doc_buffer, (size_t)bytes))
+    {
+      ret = false;
+      goto done;
+    }
+  }
+
+  // Then move the rest directly between the sockets...
+  remaining = httpGetRemaining(http);
+  data_time = time_seconds();
+
+  pfd.fd     = http_fd;
+  pfd.events = POLLIN;
+
+  while (remaining > 0 || inpipe > 0)
+  {
+    if (remaining > 0 && inpipe < (size_t)pipesize)
+    {
+      size_t	count = (size_t)pipesize - inpipe;
+					// Bytes to read
+
+      if ((off_t)count > remaining)
+        count = (size_t)remaining;
+
+      // Don't block on the HTTP socket while there is data to write, and
+      // otherwise wait a second at a time so a stalled server or a canceled
+      // job is noticed...
+      if ((pcount = poll(&pfd, 1, inpipe > 0 ? 0 : 1000)) < 0)
+      {
+        if (errno == EINTR || errno == EAGAIN)
+          continue;
+
+        plogf(pjob, "Unable to wait for document data: %s", strerror(errno));
+        ret = false;
+        break;
+      }
+      else if (pcount == 0)
+      {
+        if (inpipe == 0)
+        {
+          if (stop_running || info->done || pjob->remote_job_state >= IPP_JSTATE_CANCELED)
+          {
+            plogf(pjob, "Stopped receiving document data.");
+            ret = false;
+            break;
+          }
+          else if ((time_seconds() - data_time) >= SPLICE_TIMEOUT)
+          {
+            plogf(pjob, "Timed out waiting for document data with %ld bytes remaining.", (long)remaining);
+            ret = false;
+            break;
+          }
+
+          continue;
+        }
+      }
+      else if ((bytes = splice(http_fd, NULL, pipefds[1], NULL, count, SPLICE_F_MOVE | SPLICE_F_MORE | SPLICE_F_NONBLOCK)) == 0)
+      {
+        plogf(pjob, "Unexpected end of document data with %ld bytes remaining.", (long)remaining);
+        ret = false;
+        break;
+      }
+      else if (bytes < 0)
+      {
+        // EAGAIN just means the data is not here yet; still try to write...
+        if (errno == EINTR)
+          continue;
+
+        if (errno != EAGAIN)
+        {
+          plogf(pjob, "Unable to read document data: %s", strerror(errno));
+          ret = false;
+          break;
+        }
+      }
+      else
+      {
+        remaining -= bytes;
+        inpipe    += (size_t)bytes;
+        data_time = time_seconds();
+      }
+    }
+
+    if ((bytes = splice(pipefds[0], NULL, sock, NULL, inpipe, SPLICE_F_MOVE | SPLICE_F_MORE | SPLICE_F_NONBLOCK)) > 0)
+    {
+      inpipe     -= (size_t)bytes;
+      *doc_total += (size_t)bytes;
+
+      if (!pjob->first_byte_time)
+        pjob->first_byte_time = time_seconds();
+    }
+    else if (bytes < 0 && errno != EAGAIN && errno != EINTR)
+    {
+      plogf(pjob, "Unable to write to '%s': %s", info->device_uri, strerror(errno));
+      ret = false;
+      break;
+    }
+    else if (bytes < 0 && errno == EAGAIN && (remaining == 0 || inpipe >= (size_t)pipesize))
+    {
+      // Only wait on the device when we can't read any more...
+      if (!wait_device(info, pjob, sock))
+      {
+        ret = false;
+        break;
+      }
+    }
+  }
+
+  done:
+
+  close(pipefds[0]);
+  close(pipefds[1]);
+
+  if (!ret)
+    pjob->local_job_state = IPP_JSTATE_ABORTED;
+
+  // Reset the HTTP connection since libcups didn't see the data we consumed...
+  if (!httpConnectAgain(http, /*msec*/30000, /*cancel*/NULL))
+  {
+    plogf(pjob, "Unable to reconnect to the Infrastructure Printer: %s", cupsGetErrorString());
+    pjob->local_job_state = IPP_JSTATE_ABORTED;
+  }
+
+  return (true);
+}
+#endif // __linux
+
+
+//
+// 'spool_document()' - Copy document data to the spool directory.
+//
+// Compressed document data is decompressed as it is spooled.  The spool file
+// is synced to disk before returning so the document can safely be
+// acknowledged.
+//
+
+static bool				// O - `true` on success, `false` on error
+spool_document(
+    http_t       *http,			// I - HTTP connection
+    proxy_info_t *info,			// I - Proxy information
+    proxy_job_t  *pjob,			// I - Proxy job
+    ipp_t        *doc_attrs,		// I - Document attributes
+    int          doc_number)		// I - Document number
+{
+  char		filename[1024];		// Spool filename
+  cups_file_t	*doc_file;		// Spool file
+  const char	*doc_compression;	// Document compression, if any
+  char		*doc_buffer;		// Copy buffer
+  ssize_t	doc_bytes;		// Bytes read
+  size_t	doc_total = 0;		// Total bytes
+  bool		ret = true;		// Return value
+
+
+  spool_filename(info, pjob, doc_number, filename, sizeof(filename));
+
+  if ((doc_buffer = malloc(DOC_BUFFER_SIZE)) == NULL)
+  {
+    plogf(pjob, "Unable to allocate copy buffer: %s", strerror(errno));
+    return (false);
+  }
+
+  if ((doc_file = cupsFileOpen(filename, "w")) == NULL)
+  {
+    plogf(pjob, "Unable to create spool file '%s': %s", filename, strerror(errno));
+    free(doc_buffer);
+    return (false);
+  }
+
+  if ((doc_compression = ippGetString(ippFindAttribute(doc_attrs, "compression", IPP_TAG_KEYWORD), 0, NULL)) != NULL && strcmp(doc_compression, "none"))
+    httpSetField(http, HTTP_FIELD_CONTENT_ENCODING, doc_compression);
+
+  while ((doc_bytes = cupsReadResponseData(http, doc_buffer, DOC_BUFFER_SIZE)) > 0)
+  {
+    if (!cupsFileWrite(doc_file, doc_buffer, (size_t)doc_bytes))
+    {
+      plogf(pjob, "Unable to write spool file '%s': %s", filename, strerror(errno));
+      ret = false;
+      break;
+    }
+
+    doc_total += (size_t)doc_bytes;
+  }
+
+  if (doc_bytes < 0)
+  {
+    plogf(pjob, "Unable to read document #%d: %s", doc_number, cupsGetErrorString());
+    ret = false;
+  }
+
+  if (ret && (!cupsFileFlush(doc_file) || fsync(cupsFileNumber(doc_file))))
+  {
+    plogf(pjob, "Unable to sync spool file '%s': %s", filename, strerror(errno));
+    ret = false;
+  }
+
+  if (!cupsFileClose(doc_file) && ret)
+  {
+    plogf(pjob, "Unable to close spool file '%s': %s", filename, strerror(errno));
+    ret = false;
+  }
+
+  free(doc_buffer);
+
+  if (ret)
+  {
+    plogf(pjob, "Spooled document #%d, %ld bytes.", doc_number, (long)doc_total);
+  }
+  else
+  {
+    unlink(filename);
+    httpFlush(http);
+  }
+
+  return (ret);
+}
+
+
+//
+// 'spool_filename()' - Make the spool filename for a document.
+//
+
+static char *				// O - Filename
+spool_filename(proxy_info_t *info,	// I - Proxy information
+               proxy_job_t  *pjob,	// I - Proxy job
+               int          doc_number,	// I - Document number
+               char         *filename,	// I - Filename buffer
+               size_t       filesize)	// I - Size of filename buffer
+{
+  // Use the device UUID (minus "urn:uuid:") so several proxies can share a spool directory...
+  snprintf(filename, filesize, "%s/%s-%d-%d.prn", info->spool_dir, info->device_uuid + 9, pjob->remote_job_id, doc_number);
+
+  return (filename);
+}
+
+
+//
+// 'start_printer()' - Register the output device and start processing jobs.
+//
+
+static bool				// O - `true` on success, `false` on failure
+start_printer(
+    http_t       *http,			// I - Connection to Infrastructure System
+    proxy_info_t *info)			// I - Proxy information
+{
+  ipp_t		*device_attrs;		// Device attributes
+
+
+  plogf(NULL, "start_printer: info              = %p", (void *)info);
+  plogf(NULL, "start_printer: info->printer_uri = \"%s\"", info->printer_uri);
+  plogf(NULL, "start_printer: info->resource    = \"%s\"", info->resource);
+  plogf(NULL, "start_printer: info->device_uri  = \"%s\"", info->device_uri);
+  plogf(NULL, "start_printer: info->device_uuid = \"%s\"", info->device_uuid);
+  plogf(NULL, "start_printer: info->outformat   = \"%s\"", info->outformat);
+
+  // Query the printer...
+  if ((device_attrs = get_device_attrs(info->device_uri)) == NULL && stop_running)
+    return (false);
+
+  // Setup job processing...
+  info->jobs        = cupsArrayNew((cups_array_cb_t)compare_jobs, NULL, NULL, 0, NULL, (cups_afree_cb_t)free);
+  info->jobs_thread = cupsThreadCreate((cups_thread_func_t)proxy_jobs, info);
+
+  // Register the output device...
+  if (!update_device_attrs(http, info, device_attrs))
+    return (false);
+
+  return (update_remote_jobs(http, info));
+}
+
+
+//
+// 'time_seconds()' - Get the current time in seconds.
+//
+
+static double				// O - Time in seconds
+time_seconds(void)
+{
+#ifdef _WIN32
+  struct _timeb curtime;		// Current time
+
+
+  _ftime(&curtime);
+
+  return ((double)curtime.time + 0.001 * curtime.millitm);
+
+#else
+  struct timeval curtime;		// Current time
+
+
+  gettimeofday(&curtime, NULL);
+
+  return ((double)curtime.tv_sec + 0.000001 * curtime.tv_usec);
+#endif // _WIN32
+}
+
+
 //
 // 'update_device_attrs()' - Update device attributes on the server.
 //
@@ -1878,6 +2865,7 @@ update_device_attrs(
   ipp_t			*request;	// IPP request
   ipp_attribute_t	*attr;		// New attribute
   const char		*name;		// New attribute name
+  int			changes = 0;	// Number of changed attributes
 
 
   // Update the configuration of the output device...
@@ -1897,12 +2885,42 @@ update_device_attrs(
       if ((result = strcmp(name, printer_attrs[i])) == 0)
       {
         // This is an attribute we care about...
-        if (!attrs_are_equal(ippFindAttribute(info->device_attrs, name, ippGetValueTag(attr)), attr))
+        if (!attrs_are_equal(ippFindAttribute(info->device_attrs, name, IPP_TAG_ZERO), attr))
+        {
 	  ippCopyAttribute(request, attr, 1);
+	  changes ++;
+	}
       }
     }
   }
 
+  if (info->device_attrs)
+  {
+    // Delete any attributes that are no longer reported...
+    for (i = 0; i < (int)(sizeof(printer_attrs) / sizeof(printer_attrs[0])); i ++)
+    {
+      if (ippFindAttribute(info->device_attrs, printer_attrs[i], IPP_TAG_ZERO) && !ippFindAttribute(new_attrs, printer_attrs[i], IPP_TAG_ZERO))
+      {
+        ippAddOutOfBand(request, IPP_TAG_PRINTER, IPP_TAG_DELETEATTR, printer_attrs[i]);
+        changes ++;
+      }
+    }
+
+    if (!changes)
+    {
+      // Nothing to send...
+      if (verbosity)
+        plogf(NULL, "Output device attributes are unchanged.");
+
+      ippDelete(request);
+      ippDelete(new_attrs);
+      return (true);
+    }
+  }
+
+  if (verbosity)
+    plogf(NULL, "Sending %d changed output device attributes.", changes);
+
   ippDelete(cupsDoRequest(http, request, info->resource));
 
   if (cupsGetError() != IPP_STATUS_OK)
@@ -1923,6 +2941,9 @@ update_device_attrs(
 //
 // 'update_document_status()' - Update the document status.
 //
+// Terminal states are sent immediately, other states are coalesced and sent
+// at most once every status interval.
+//
 
 static void
 update_document_status(
@@ -1932,67 +2953,33 @@ update_document_status(
     int          doc_number,		// I - Document number
     ipp_dstate_t doc_state)		// I - New document-state value
 {
-  ipp_t	*request,			// IPP request
-	*response;			// IPP response
-
-
-  request = ippNewRequest(IPP_OP_UPDATE_DOCUMENT_STATUS);
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, info->printer_uri);
-  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", pjob->remote_job_id);
-  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "document-number", doc_number);
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "output-device-uuid", NULL, info->device_uuid);
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
-
-  ippAddInteger(request, IPP_TAG_DOCUMENT, IPP_TAG_ENUM, "output-device-document-state", (int)doc_state);
-
-  if (verbosity)
-    plogipp(pjob, /*is_request*/true, request);
-
-  response = cupsDoRequest(http, request, info->resource);
+  // Send any pending update for a different document first...
+  if (pjob->doc_number && pjob->doc_number != doc_number)
+  {
+    send_document_status(http, info, pjob, pjob->doc_number, pjob->doc_state);
+    pjob->doc_number = 0;
+  }
 
-  if (verbosity)
-    plogipp(pjob, /*is_request*/false, response);
+  pjob->doc_number = doc_number;
+  pjob->doc_state  = doc_state;
 
-  ippDelete(response);
-
-  if (cupsGetError() >= IPP_STATUS_REDIRECTION_OTHER_SITE)
-    plogf(pjob, "Unable to update the state for document #%d: %s", doc_number, cupsGetErrorString());
+  flush_status(http, info, pjob, doc_state >= IPP_DSTATE_CANCELED);
 }
 
 
 //
 // 'update_job_status()' - Update the job status.
 //
+// Terminal states are sent immediately, other states are coalesced and sent
+// at most once every status interval.
+//
 
 static void
 update_job_status(http_t       *http,	// I - HTTP connection
                   proxy_info_t *info,	// I - Proxy info
                   proxy_job_t  *pjob)	// I - Proxy job
 {
-  ipp_t	*request,			// IPP request
-	*response;			// IPP response
-
-
-  request = ippNewRequest(IPP_OP_UPDATE_JOB_STATUS);
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, info->printer_uri);
-  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", pjob->remote_job_id);
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "output-device-uuid", NULL, info->device_uuid);
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
-
-  ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_ENUM, "output-device-job-state", (int)pjob->local_job_state);
-
-  if (verbosity)
-    plogipp(pjob, /*is_request*/true, request);
-
-  response = cupsDoRequest(http, request, info->resource);
-
-  if (verbosity)
-    plogipp(pjob, /*is_request*/false, response);
-
-  ippDelete(response);
-
-  if (cupsGetError() >= IPP_STATUS_REDIRECTION_OTHER_SITE)
-    plogf(pjob, "Unable to update the job state: %s", cupsGetErrorString());
+  flush_status(http, info, pjob, pjob->local_job_state >= IPP_JSTATE_CANCELED);
 }
 
 
@@ -2072,13 +3059,15 @@ update_remote_jobs(
 	  pjob->remote_job_state = (int)job_state;
 	  pjob->local_job_state  = IPP_JSTATE_PENDING;
 
+	  pjob->queue_time       = time_seconds();
+
 	  plogf(pjob, "Job is now fetchable, queuing up.", pjob);
 
 	  cupsRWLockWrite(&info->jobs_rwlock);
 	  cupsArrayAdd(info->jobs, pjob);
 	  cupsRWUnlock(&info->jobs_rwlock);
 
-	  cupsCondBroadcast(&info->jobs_cond);
+	  wake_jobs(info);
 	}
 	else
 	{
@@ -2101,12 +3090,14 @@ update_remote_jobs(
 static int				// O - Exit status
 usage(FILE *out)			// I - Output file
 {
-  fputs("Usage: ippproxy [OPTIONS] PRINTER-URI\n", out);
+  fputs("Usage: ippproxy [OPTIONS] PRINTER-URI [... -d DEVICE-URI PRINTER-URI]\n", out);
   fputs("Options:\n", out);
-  fputs("  -d DEVICE-URI   Specify local printer device URI.\n", out);
+  fputs("  -d DEVICE-URI   Specify local printer device URI (one per PRINTER-URI).\n", out);
+  fputs("  -i MSEC         Minimum time between job status updates (default 1000).\n", out);
   fputs("  -m MIME/TYPE    Specify the desired print format.\n", out);
   fputs("  -p PASSWORD     Password for authentication.\n", out);
   fputs("                  (Also IPPPROXY_PASSWORD environment variable)\n", out);
+  fputs("  -s SPOOL-DIR    Spool documents locally before printing.\n", out);
   fputs("  -u USERNAME     Username for authentication.\n", out);
   fputs("  -v              Be verbose.\n", out);
   fputs("  --help          Show this help.\n", out);
@@ -2114,3 +3105,151 @@ usage(FILE *out)			// I - Output file
 
   return (out == stderr ? 1 : 0);
 }
+
+
+#ifndef _WIN32
+//
+// 'wait_device()' - Wait for the device socket to accept more data.
+//
+
+static bool				// O - `true` if the device is ready, `false` on error or cancel
+wait_device(proxy_info_t *info,		// I - Proxy information
+            proxy_job_t  *pjob,		// I - Proxy job
+            int          sock)		// I - Output socket
+{
+  struct pollfd	pfd;			// poll() data
+  int		pcount;			// Number of ready descriptors
+  bool		logged = false;		// Did we log a message?
+
+
+  pfd.fd     = sock;
+  pfd.events = POLLOUT;
+
+  // Poll once a second so we notice when the job is canceled...
+  while ((pcount = poll(&pfd, 1, 1000)) <= 0)
+  {
+    if (pcount < 0 && errno != EINTR && errno != EAGAIN)
+    {
+      plogf(pjob, "Unable to wait for '%s': %s", info->device_uri, strerror(errno));
+      return (false);
+    }
+
+    if (stop_running || info->done || pjob->remote_job_state >= IPP_JSTATE_CANCELED)
+    {
+      plogf(pjob, "Stopped sending to '%s'.", info->device_uri);
+      return (false);
+    }
+
+    if (verbosity && !logged)
+    {
+      plogf(pjob, "Waiting for '%s' to accept more data.", info->device_uri);
+      logged = true;
+    }
+  }
+
+  if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+  {
+    plogf(pjob, "Connection to '%s' was closed.", info->device_uri);
+    return (false);
+  }
+
+  return (true);
+}
+#endif // !_WIN32
+
+
+//
+// 'wait_seconds()' - Wait for the specified number of seconds.
+//
+// The wait ends early if the program is stopping or the printer is done.
+// With proxy information the wait uses the jobs condition variable, which is
+// signaled when the printer is done, and otherwise polls for termination.
+// The signal handler cannot signal the condition, so condition waits are
+// limited to one second at a time.
+//
+
+static void
+wait_seconds(proxy_info_t *info,	// I - Proxy information or `NULL`
+             double       secs)		// I - Number of seconds
+{
+  double	end = time_seconds() + secs,
+					// End time
+		remaining;		// Remaining time
+
+
+  if (!info)
+  {
+    while (!stop_running && time_seconds() < end)
+      usleep(100000);
+    return;
+  }
+
+  cupsMutexLock(&info->jobs_mutex);
+  while (!stop_running && !info->done && (remaining = end - time_seconds()) > 0.0)
+    cupsCondWait(&info->jobs_cond, &info->jobs_mutex, remaining < 1.0 ? remaining : 1.0);
+  cupsMutexUnlock(&info->jobs_mutex);
+}
+
+
+//
+// 'wake_jobs()' - Tell the job processing thread that the jobs have changed.
+//
+
+static void
+wake_jobs(proxy_info_t *info)		// I - Proxy information
+{
+  cupsMutexLock(&info->jobs_mutex);
+  info->jobs_changed = true;
+  cupsCondBroadcast(&info->jobs_cond);
+  cupsMutexUnlock(&info->jobs_mutex);
+}
+
+
+//
+// 'write_device()' - Write data to the device socket.
+//
+
+static bool				// O - `true` on success, `false` on error
+write_device(proxy_info_t *info,	// I - Proxy information
+             proxy_job_t  *pjob,	// I - Proxy job
+             int          sock,		// I - Output socket
+             const char   *buffer,	// I - Buffer
+             size_t       bytes)	// I - Number of bytes to write
+{
+  const char	*ptr = buffer,		// Pointer into buffer
+		*end = buffer + bytes;	// End of buffer
+  ssize_t	written;		// Bytes written
+
+
+  while (ptr < end)
+  {
+    if ((written = write(sock, ptr, (size_t)(end - ptr))) > 0)
+    {
+      ptr += written;
+
+      if (!pjob->first_byte_time)
+        pjob->first_byte_time = time_seconds();
+    }
+#ifdef _WIN32
+    else
+    {
+      // The socket is blocking on Windows, so any failure is an error...
+      plogf(pjob, "Unable to write to '%s': %s", info->device_uri, strerror(errno));
+      return (false);
+    }
+#else
+    else if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+      plogf(pjob, "Unable to write to '%s': %s", info->device_uri, strerror(errno));
+      return (false);
+    }
+    else if (!wait_device(info, pjob, sock))
+    {
+      // Device isn't accepting data...
+      return (false);
+    }
+#endif // _WIN32
+  }
+
+  return (true);
+}
@@ -15,11 +15,14 @@
 #include <ctype.h>
 #include <errno.h>
 #include <cups/cups.h>
+#include <cups/dir.h>
 #include <cups/thread.h>
 #include <fcntl.h>
 #include <termios.h>
 #include <sys/select.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 
 #ifdef __APPLE__
 #  include <IOKit/serial/ioss.h>
@@ -45,19 +48,55 @@ struct termios2 {
 #ifndef _WIN32
 #  include <spawn.h>
 #  include <poll.h>
+#  include <signal.h>
 #  include <sys/wait.h>
 #endif /* !_WIN32 */
 
 
+/*
+ * Constants...
+ */
+
+#define GCODE_CACHE_SIZE	256	/* Default size of G-code cache in megabytes */
+#define GCODE_MAX_PENDING	256	/* Maximum number of unacknowledged lines */
+#define GCODE_WINDOW		127	/* Default receive buffer size (Marlin RX_BUFFER_SIZE - 1) */
+
+
 /*
  * Local types...
  */
 
+typedef struct cache_entry_s		/**** G-code cache entry ****/
+{
+  char		filename[256];		/* Filename in cache directory */
+  time_t	mtime;			/* Last use */
+  off_t		size;			/* Size of file */
+} cache_entry_t;
+
+typedef struct gcode_line_s		/**** Unacknowledged G-code line ****/
+{
+  int		linenum;		/* Line number */
+  char		*line;			/* Formatted line with number and checksum */
+  size_t	length;			/* Length of line */
+} gcode_line_t;
+
 typedef struct gcode_buffer_s		/**** Buffer for G-code status lines ****/
 {
-  char	buffer[8192],			/* Buffer */
-	*bufptr;			/* Pointer info buffer */
-  size_t bytes;				/* Bytes in buffer */
+  char		buffer[8192],		/* Buffer */
+		*bufptr;		/* Pointer info buffer */
+  size_t	bytes;			/* Bytes in buffer */
+  size_t	window,			/* Size of printer's receive buffer, 0 for none */
+		pending_bytes;		/* Bytes sent but not acknowledged */
+  gcode_line_t	pending[GCODE_MAX_PENDING];
+					/* Lines sent but not acknowledged */
+  size_t	first_pending,		/* First pending line */
+		num_pending;		/* Number of pending lines */
+  int		skip_oks,		/* Number of "ok" responses to ignore */
+		skip_resends;		/* Number of duplicate "Resend:" responses to ignore */
+  size_t	num_lines,		/* Number of lines sent */
+		num_sent,		/* Number of bytes sent */
+		num_resends;		/* Number of resend requests */
+  double	start;			/* Time of first line */
 } gcode_buffer_t;
 
 
@@ -65,6 +104,9 @@ typedef struct gcode_buffer_s		/**** Buffer for G-code status lines ****/
  * Local globals...
  */
 
+static char	CacheDir[1024] = "";	/* G-code cache directory, if any */
+static off_t	CacheSize = 0;		/* Maximum size of G-code cache in bytes */
+static char	CacheTemp[1024] = "";	/* Temporary G-code file being written, if any */
 static int	Verbosity = 0;		/* Log level */
 
 
@@ -72,13 +114,25 @@ static int	Verbosity = 0;		/* Log level */
  * Local functions...
  */
 
+static int	cache_compare(cache_entry_t *a, cache_entry_t *b);
+static int	cache_name(const char *filename, const char *json, int num_args, const char **args, char *cachefile, size_t cachesize);
+static void	cache_prune(void);
+#ifndef _WIN32
+static void	cache_signal(int sig);
+#endif /* !_WIN32 */
+static int	gcode_ack(gcode_buffer_t *buf, int device_fd, int wait_secs);
 static int	gcode_fill(gcode_buffer_t *buf, int device_fd, int wait_secs);
+static int	gcode_flush(gcode_buffer_t *buf, int device_fd);
 static char	*gcode_gets(gcode_buffer_t *buf);
+static void	gcode_pop(gcode_buffer_t *buf);
 static int	gcode_puts(gcode_buffer_t *buf, int device_fd, char *line, int linenum);
+static int	gcode_resend(gcode_buffer_t *buf, int device_fd, int linenum);
+static int	gcode_write(int device_fd, const char *data, size_t length);
 static size_t	load_env_options(cups_option_t **options);
 static int	open_device(const char *device_uri);
+static double	time_seconds(void);
 static void	usage(int status) _CUPS_NORETURN;
-static int	xform_document(const char *filename, const char *outformat, size_t num_options, cups_option_t *options, gcode_buffer_t *buf, int device_fd);
+static int	xform_document(const char *filename, const char *informat, const char *outformat, size_t num_options, cups_option_t *options, gcode_buffer_t *buf, int device_fd);
 
 
 /*
@@ -99,6 +153,7 @@ main(int  argc,				/* I - Number of command-line args */
   cups_option_t	*options;		/* Options */
   int		fd = 1;			/* Output file/socket */
   int		status = 0;		/* Exit status */
+  size_t	window = GCODE_WINDOW;	/* Printer's receive buffer size */
   gcode_buffer_t buffer;		/* G-code response buffer */
 
 
@@ -111,6 +166,9 @@ main(int  argc,				/* I - Number of command-line args */
   device_uri   = getenv("DEVICE_URI");
   output_type  = getenv("OUTPUT_TYPE");
 
+  if ((opt = getenv("GCODE_BUFFER_SIZE")) != NULL && atoi(opt) > 0)
+    window = (size_t)atoi(opt);
+
   if ((opt = getenv("SERVER_LOGLEVEL")) != NULL)
   {
     if (!strcmp(opt, "debug"))
@@ -119,6 +177,57 @@ main(int  argc,				/* I - Number of command-line args */
       Verbosity = 1;
   }
 
+  if ((opt = getenv("GCODE_CACHE_SIZE")) != NULL)
+    CacheSize = (off_t)atoi(opt) * 1048576;
+  else
+    CacheSize = (off_t)GCODE_CACHE_SIZE * 1048576;
+
+  if (CacheSize > 0)
+  {
+   /*
+    * Use a per-user G-code cache directory under TMPDIR by default...
+    */
+
+    if ((opt = getenv("GCODE_CACHE_DIR")) != NULL)
+    {
+      cupsCopyString(CacheDir, opt, sizeof(CacheDir));
+    }
+    else
+    {
+      if ((opt = getenv("TMPDIR")) == NULL)
+        opt = "/tmp";
+
+      snprintf(CacheDir, sizeof(CacheDir), "%s/ipptransform3d-%d", opt, (int)getuid());
+    }
+
+    if (mkdir(CacheDir, 0700) && errno != EEXIST)
+    {
+      fprintf(stderr, "DEBUG: Unable to create G-code cache directory \"%s\": %s\n", CacheDir, strerror(errno));
+      CacheDir[0] = '\0';
+    }
+    else
+    {
+     /*
+      * Only use a cache directory that we own and that nobody else can
+      * access, otherwise another user could read our G-code or plant G-code
+      * for the printer to run...
+      */
+
+      struct stat cacheinfo;		/* Cache directory information */
+
+      if (lstat(CacheDir, &cacheinfo))
+      {
+        fprintf(stderr, "DEBUG: Unable to access G-code cache directory \"%s\": %s\n", CacheDir, strerror(errno));
+        CacheDir[0] = '\0';
+      }
+      else if (!S_ISDIR(cacheinfo.st_mode) || cacheinfo.st_uid != getuid() || (cacheinfo.st_mode & 077))
+      {
+        fprintf(stderr, "DEBUG: Not using insecure G-code cache directory \"%s\".\n", CacheDir);
+        CacheDir[0] = '\0';
+      }
+    }
+  }
+
   for (i = 1; i < argc; i ++)
   {
     if (argv[i][0] == '-' && argv[i][1] != '-')
@@ -127,6 +236,14 @@ main(int  argc,				/* I - Number of command-line args */
       {
         switch (*opt)
 	{
+	  case 'b' :
+	      i ++;
+	      if (i >= argc || atoi(argv[i]) <= 0)
+	        usage(1);
+
+	      window = (size_t)atoi(argv[i]);
+	      break;
+
 	  case 'd' :
 	      i ++;
 	      if (i >= argc)
@@ -198,6 +315,8 @@ main(int  argc,				/* I - Number of command-line args */
         content_type = "model/3mf";
       else if (!strcmp(opt, ".stl"))
         content_type = "application/sla";
+      else if (!strcmp(opt, ".gcode") || !strcmp(opt, ".gco"))
+        content_type = "application/g-code";
     }
   }
 
@@ -206,7 +325,7 @@ main(int  argc,				/* I - Number of command-line args */
     fprintf(stderr, "ERROR: Unknown format for \"%s\", please specify with '-i' option.\n", filename);
     usage(1);
   }
-  else if (strcmp(content_type, "application/sla") && strcmp(content_type, "model/3mf"))
+  else if (strcmp(content_type, "application/sla") && strcmp(content_type, "model/3mf") && strcmp(content_type, "application/g-code"))
   {
     fprintf(stderr, "ERROR: Unsupported format \"%s\" for \"%s\".\n", content_type, filename);
     usage(1);
@@ -227,6 +346,9 @@ main(int  argc,				/* I - Number of command-line args */
   * If the device URI is specified, open the connection...
   */
 
+  memset(&buffer, 0, sizeof(buffer));
+  buffer.bufptr = buffer.buffer;
+
   if (device_uri)
   {
     if (strncmp(device_uri, "usbserial:///dev/", 17))
@@ -238,12 +360,11 @@ main(int  argc,				/* I - Number of command-line args */
     fd = open_device(device_uri);
 
    /*
-    * Initialize the G-code response buffer and wait for the printer to send
-    * us its firmware information, etc.
+    * Enable flow control for the printer's receive buffer and wait for the
+    * printer to send us its firmware information, etc.
     */
 
-    memset(&buffer, 0, sizeof(buffer));
-    buffer.bufptr = buffer.buffer;
+    buffer.window = window;
 
     while (gcode_fill(&buffer, fd, 15))
     {
@@ -258,9 +379,10 @@ main(int  argc,				/* I - Number of command-line args */
   * Do transform...
   */
 
-  status = xform_document(filename, output_type, num_options, options, &buffer, fd);
+  status = xform_document(filename, content_type, output_type, num_options, options, &buffer, fd);
 
-  gcode_puts(&buffer, fd, "", 1);
+  if (!gcode_flush(&buffer, fd) && !status)
+    status = 1;
 
   if (fd != 1)
     close(fd);
@@ -269,6 +391,310 @@ main(int  argc,				/* I - Number of command-line args */
 }
 
 
+/*
+ * 'cache_compare()' - Compare two cache entries by last use.
+ */
+
+static int				/* O - Result of comparison */
+cache_compare(cache_entry_t *a,		/* I - First entry */
+              cache_entry_t *b)		/* I - Second entry */
+{
+  if (a->mtime < b->mtime)
+    return (-1);
+  else if (a->mtime > b->mtime)
+    return (1);
+  else
+    return (strcmp(a->filename, b->filename));
+}
+
+
+/*
+ * 'cache_name()' - Get the G-code cache filename for a model and settings.
+ *
+ * The name is a SHA2-256 hash of the CuraEngine arguments, the machine
+ * definition file, and the model file, so that a reprint of the same model
+ * with the same settings finds the G-code from the previous job.
+ *
+ * The key also covers the CuraEngine executable (path, size, and modification
+ * time) so that an upgrade doesn't reuse G-code from the old version.  A
+ * definition file that is not a path is looked up in CURA_ENGINE_SEARCH_PATH
+ * the same way CuraEngine does, and the G-code is not cached if it cannot be
+ * found.
+ */
+
+static int				/* O - 1 on success, 0 if not cached */
+cache_name(const char *filename,	/* I - Model file */
+           const char *json,		/* I - Machine definition file */
+           int        num_args,		/* I - Number of CuraEngine arguments */
+           const char **args,		/* I - CuraEngine arguments */
+	   char       *cachefile,	/* I - Cache filename buffer */
+	   size_t     cachesize)	/* I - Size of cache filename buffer */
+{
+  int		i,			/* Looping var */
+		fd;			/* Model/definition file */
+  unsigned char	hash[32],		/* Current SHA2-256 hash */
+		data[65536 + 32];	/* Previous hash + data */
+  size_t	len;			/* Length of data */
+  ssize_t	bytes;			/* Bytes read */
+  const char	*files[2];		/* Files to hash */
+  char		hashstr[65],		/* Hash as a hex string */
+		engine[1280],		/* CuraEngine identity */
+		jsonpath[1024];		/* Path to definition file */
+  struct stat	fileinfo;		/* File information */
+
+
+  *cachefile = '\0';
+
+  if (!CacheDir[0])
+    return (0);
+
+ /*
+  * Chain the hash through each argument and each block of the definition and
+  * model files so we don't need to load the whole model into memory...
+  */
+
+  if (stat(CURAENGINE, &fileinfo))
+    return (0);
+
+  snprintf(engine, sizeof(engine), "%s;size=%lld;mtime=%lld", CURAENGINE, (long long)fileinfo.st_size, (long long)fileinfo.st_mtime);
+
+  if (!strchr(json, '/'))
+  {
+   /*
+    * Find the definition file in CURA_ENGINE_SEARCH_PATH...
+    */
+
+    const char	*search,		/* Search path */
+		*sep;			/* Separator */
+    size_t	dirlen;			/* Length of directory */
+
+    if ((search = getenv("CURA_ENGINE_SEARCH_PATH")) == NULL)
+      return (0);
+
+    for (jsonpath[0] = '\0'; *search; search = sep + 1)
+    {
+      if ((sep = strchr(search, ':')) == NULL)
+        sep = search + strlen(search);
+
+      dirlen = (size_t)(sep - search);
+
+      snprintf(jsonpath, sizeof(jsonpath), "%.*s/%s", (int)dirlen, search, json);
+      if (!access(jsonpath, R_OK))
+        break;
+
+      snprintf(jsonpath, sizeof(jsonpath), "%.*s/definitions/%s", (int)dirlen, search, json);
+      if (!access(jsonpath, R_OK))
+        break;
+
+      jsonpath[0] = '\0';
+
+      if (!*sep)
+        break;
+    }
+
+    if (!jsonpath[0])
+      return (0);
+
+    json = jsonpath;
+  }
+
+  memset(hash, 0, sizeof(hash));
+
+  for (i = 0; i <= num_args; i ++)
+  {
+    const char *arg = i < num_args ? args[i] : engine;
+					/* Argument or CuraEngine identity */
+
+    if ((len = strlen(arg)) > (sizeof(data) - sizeof(hash)))
+      len = sizeof(data) - sizeof(hash);
+
+    memcpy(data, hash, sizeof(hash));
+    memcpy(data + sizeof(hash), arg, len);
+
+    if (cupsHashData("sha2-256", data, sizeof(hash) + len, hash, sizeof(hash)) < 0)
+      return (0);
+  }
+
+  files[0] = json;
+  files[1] = filename;
+
+  for (i = 0; i < 2; i ++)
+  {
+    if ((fd = open(files[i], O_RDONLY)) < 0)
+      return (0);
+
+    while ((bytes = read(fd, data + sizeof(hash), sizeof(data) - sizeof(hash))) > 0)
+    {
+      memcpy(data, hash, sizeof(hash));
+
+      if (cupsHashData("sha2-256", data, sizeof(hash) + (size_t)bytes, hash, sizeof(hash)) < 0)
+        break;
+    }
+
+    close(fd);
+
+    if (bytes != 0)
+      return (0);
+  }
+
+  snprintf(cachefile, cachesize, "%s/%s.gcode", CacheDir, cupsHashString(hash, sizeof(hash), hashstr, sizeof(hashstr)));
+
+  return (1);
+}
+
+
+/*
+ * 'cache_prune()' - Remove the least recently used G-code files until the
+ *                   cache fits in its size budget.
+ *
+ * Temporary files ("<hash>.<pid>.tmp") whose process no longer exists are
+ * left over from slices that were killed, so they are removed as well.
+ */
+
+static void
+cache_prune(void)
+{
+  cups_dir_t	*dir;			/* Cache directory */
+  cups_dentry_t	*dent;			/* Directory entry */
+  cache_entry_t	*entries = NULL,	/* Cache entries */
+		*entry;			/* Current entry */
+  size_t	i,			/* Looping var */
+		num_entries = 0,	/* Number of entries */
+		alloc_entries = 0;	/* Allocated entries */
+  off_t		total = 0;		/* Total size of cache */
+  const char	*ext;			/* Extension */
+  char		path[1024];		/* Path to cache file */
+
+
+  if ((dir = cupsDirOpen(CacheDir)) == NULL)
+    return;
+
+  while ((dent = cupsDirRead(dir)) != NULL)
+  {
+    if ((ext = strrchr(dent->filename, '.')) == NULL || strlen(dent->filename) >= sizeof(entries->filename))
+      continue;
+
+#ifndef _WIN32
+    if (!strcmp(ext, ".tmp"))
+    {
+      const char *pidptr;		/* Pointer to process ID */
+      int	pid;			/* Process ID */
+
+      for (pidptr = ext; pidptr > dent->filename && pidptr[-1] != '.'; pidptr --);
+
+      if ((pid = atoi(pidptr)) > 0 && pid != (int)getpid() && kill(pid, 0) && errno == ESRCH)
+      {
+        snprintf(path, sizeof(path), "%s/%s", CacheDir, dent->filename);
+
+        if (!unlink(path))
+          fprintf(stderr, "DEBUG: Removed stale \"%s\" from G-code cache.\n", dent->filename);
+      }
+      continue;
+    }
+#endif /* !_WIN32 */
+
+    if (strcmp(ext, ".gcode"))
+      continue;
+
+    if (num_entries >= alloc_entries)
+    {
+      if ((entry = realloc(entries, (alloc_entries + 32) * sizeof(cache_entry_t))) == NULL)
+        break;
+
+      entries       = entry;
+      alloc_entries += 32;
+    }
+
+    entry = entries + num_entries;
+    num_entries ++;
+
+    cupsCopyString(entry->filename, dent->filename, sizeof(entry->filename));
+    entry->mtime = dent->fileinfo.st_mtime;
+    entry->size  = dent->fileinfo.st_size;
+
+    total += entry->size;
+  }
+
+  cupsDirClose(dir);
+
+  if (total > CacheSize)
+  {
+    qsort(entries, num_entries, sizeof(cache_entry_t), (int (*)(const void *, const void *))cache_compare);
+
+    for (i = 0, entry = entries; i < num_entries && total > CacheSize; i ++, entry ++)
+    {
+      snprintf(path, sizeof(path), "%s/%s", CacheDir, entry->filename);
+
+      if (!unlink(path))
+      {
+        fprintf(stderr, "DEBUG: Removed \"%s\" from G-code cache.\n", entry->filename);
+        total -= entry->size;
+      }
+    }
+  }
+
+  free(entries);
+}
+
+
+#ifndef _WIN32
+/*
+ * 'cache_signal()' - Remove the temporary G-code file when terminated.
+ */
+
+static void
+cache_signal(int sig)			/* I - Signal number */
+{
+  if (CacheTemp[0])
+    unlink(CacheTemp);
+
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+#endif /* !_WIN32 */
+
+
+/*
+ * 'gcode_ack()' - Read and process responses from the printer.
+ *
+ * Each "ok" acknowledges the oldest pending line, "Resend:" retransmits the
+ * pending lines starting at the requested line number, and anything else is
+ * just logged.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+gcode_ack(gcode_buffer_t *buf,		/* I - G-code buffer */
+          int            device_fd,	/* I - Device file */
+	  int            wait_secs)	/* I - Timeout in seconds */
+{
+  char	*resp;				/* Response from printer */
+
+
+  if (!gcode_fill(buf, device_fd, wait_secs))
+    return (0);
+
+  while ((resp = gcode_gets(buf)) != NULL)
+  {
+    fprintf(stderr, "DEBUG: %s\n", resp);
+
+    if (!strncmp(resp, "ok", 2) && (!resp[2] || isspace(resp[2] & 255)))
+    {
+      if (buf->skip_oks > 0)
+        buf->skip_oks --;
+      else
+        gcode_pop(buf);
+    }
+    else if (!strncmp(resp, "Resend:", 7))
+    {
+      if (!gcode_resend(buf, device_fd, atoi(resp + 7)))
+        return (0);
+    }
+  }
+
+  return (1);
+}
+
+
 /*
  * 'gcode_fill()' - Fill the G-code buffer with more data...
  */
@@ -329,6 +755,9 @@ gcode_fill(gcode_buffer_t *buf,		/* I - Buffer */
       return (0);
   }
 
+  if (bytes == 0)
+    return (0);				/* Device hung up */
+
   buf->bytes += (size_t)bytes;
   buf->buffer[buf->bytes] = '\0';
 
@@ -336,6 +765,38 @@ gcode_fill(gcode_buffer_t *buf,		/* I - Buffer */
 }
 
 
+/*
+ * 'gcode_flush()' - Wait for all pending lines to be acknowledged.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+gcode_flush(gcode_buffer_t *buf,	/* I - G-code buffer */
+            int            device_fd)	/* I - Device file */
+{
+  double	elapsed;		/* Elapsed time */
+
+
+  while (buf->num_pending > 0)
+  {
+    if (!gcode_ack(buf, device_fd, 30))
+    {
+      fputs("DEBUG: No response from printer.\n", stderr);
+      return (0);
+    }
+  }
+
+  if (buf->num_lines > 0)
+  {
+    if ((elapsed = time_seconds() - buf->start) < 0.001)
+      elapsed = 0.001;
+
+    fprintf(stderr, "INFO: Sent %lu lines (%lu bytes, %lu resend requests) in %.3f seconds, %.1f lines/second.\n", (unsigned long)buf->num_lines, (unsigned long)buf->num_sent, (unsigned long)buf->num_resends, elapsed, buf->num_lines / elapsed);
+  }
+
+  return (1);
+}
+
+
 /*
  * 'gcode_gets()' - Get a line from the G-code buffer.
  */
@@ -364,8 +825,38 @@ gcode_gets(gcode_buffer_t *buf)		/* I - Buffer */
 }
 
 
+/*
+ * 'gcode_pop()' - Remove the oldest pending line after an "ok".
+ */
+
+static void
+gcode_pop(gcode_buffer_t *buf)		/* I - G-code buffer */
+{
+  gcode_line_t	*pending;		/* Oldest pending line */
+
+
+  if (buf->num_pending == 0)
+    return;
+
+  pending = buf->pending + buf->first_pending;
+
+  buf->pending_bytes -= pending->length;
+  buf->first_pending = (buf->first_pending + 1) % GCODE_MAX_PENDING;
+  buf->num_pending --;
+
+  free(pending->line);
+  pending->line = NULL;
+}
+
+
 /*
  * 'gcode_puts()' - Write a line of G-code, complete with line number and checksum.
+ *
+ * Lines are sent without waiting for an "ok" as long as the unacknowledged
+ * lines fit in the printer's receive buffer ("character counting"), so the
+ * printer always has the next moves queued up.  Any line number and checksum
+ * already in the line are replaced, and lines written without a printer (to a
+ * G-code file) are written without them.
  */
 
 static int				/* O - Next line number */
@@ -377,9 +868,8 @@ gcode_puts(gcode_buffer_t *buf,		/* I - G-code buffer */
   char		buffer[8192],		/* Output buffer */
         	*ptr;			/* Pointer into line/buffer */
   unsigned char	checksum;		/* XOR checksum */
-  size_t	len;			/* Length of output buffer remaining */
-  ssize_t	bytes;			/* Bytes written */
-  int		ok = 0;			/* Line written OK? */
+  size_t	len;			/* Length of output line */
+  gcode_line_t	*pending;		/* Pending line */
 
 
  /*
@@ -396,6 +886,51 @@ gcode_puts(gcode_buffer_t *buf,		/* I - G-code buffer */
   if (!line[0])
     return (linenum);			/* Nothing left... */
 
+ /*
+  * Remove any existing "*checksum" suffix and "Nlinenum " prefix...
+  */
+
+  if ((ptr = strrchr(line, '*')) != NULL && isdigit(ptr[1] & 255) && strspn(ptr + 1, "0123456789") == strlen(ptr + 1))
+  {
+    *ptr-- = '\0';
+
+    while (ptr >= line && isspace(*ptr & 255))
+      *ptr-- = '\0';
+  }
+
+  if (line[0] == 'N' && isdigit(line[1] & 255))
+  {
+    for (ptr = line + 1; isdigit(*ptr & 255); ptr ++);
+
+    if (!*ptr || isspace(*ptr & 255))
+    {
+      while (isspace(*ptr & 255))
+        ptr ++;
+
+      line = ptr;
+    }
+  }
+
+  if (!line[0])
+    return (linenum);			/* Nothing left... */
+
+  if (!buf->window)
+  {
+   /*
+    * No printer, just write the line without a line number or checksum...
+    */
+
+    snprintf(buffer, sizeof(buffer), "%s\n", line);
+    len = strlen(buffer);
+
+    fprintf(stderr, "DEBUG: >%s", buffer);
+
+    if (!gcode_write(device_fd, buffer, len))
+      return (-1);
+
+    return (linenum);
+  }
+
  /*
   * Then compute a simple XOR checksum and format the output line...
   */
@@ -405,70 +940,142 @@ gcode_puts(gcode_buffer_t *buf,		/* I - G-code buffer */
   for (ptr = buffer, checksum = 0; *ptr; ptr ++)
     checksum ^= (unsigned char)*ptr;
 
-  snprintf(buffer, sizeof(buffer), "N%d %s*%d\n", linenum ++, line, checksum);
+  snprintf(buffer, sizeof(buffer), "N%d %s*%d\n", linenum, line, checksum);
+  len = strlen(buffer);
+
   fprintf(stderr, "DEBUG: >%s", buffer);
 
  /*
-  * Finally, write the line to the output device and wait for an OK...
+  * Wait until the line fits in the printer's receive buffer...
   */
 
-  do
+  while (buf->num_pending > 0 && (buf->num_pending >= GCODE_MAX_PENDING || (buf->pending_bytes + len) > buf->window))
   {
-    char *resp;				/* Response from printer */
-
-    for (ptr = buffer, len = strlen(buffer); len > 0;)
+    if (!gcode_ack(buf, device_fd, 30))
     {
-      if ((bytes = write(device_fd, ptr, len)) < 0)
-      {
-	if (errno != EAGAIN && errno != EINTR && errno != ENOTTY)
-	  return (-1);
-      }
-      else
-      {
-	len -= (size_t)bytes;
-	ptr += bytes;
-      }
+      fputs("DEBUG: No response from printer.\n", stderr);
+      return (-1);
     }
+  }
 
-    tcdrain(device_fd);
+ /*
+  * Then write the line and remember it in case the printer asks for it
+  * again...
+  */
 
-    do
-    {
-      while ((resp = gcode_gets(buf)) == NULL)
-      {
-        if (!gcode_fill(buf, device_fd, 30))
-	{
-	  fputs("DEBUG: No response from printer.\n", stderr);
-	  return (-1);
-	}
-      }
+  if (!gcode_write(device_fd, buffer, len))
+    return (-1);
 
-      fprintf(stderr, "DEBUG: %s\n", resp);
+  pending = buf->pending + (buf->first_pending + buf->num_pending) % GCODE_MAX_PENDING;
 
-      if (!resp)
-      {
-	fputs("DEBUG: Unable to read response from printer.\n", stderr);
-	return (-1);
-      }
-    }
-    while (strcmp(resp, "ok") && strncmp(resp, "Resend:", 7));
+  if ((pending->line = strdup(buffer)) == NULL)
+    return (-1);
 
-    if (!strncmp(resp, "Resend:", 7))
-    {
-      if (atoi(resp + 7) != (linenum - 1))
-      {
-        fprintf(stderr, "DEBUG: Printer asked us to resend a previous line (%s, on line %d)\n", resp + 7, linenum);
-	return (-1);
-      }
+  pending->linenum = linenum;
+  pending->length  = len;
+
+  buf->num_pending ++;
+  buf->pending_bytes += len;
+
+  if (buf->num_lines == 0)
+    buf->start = time_seconds();
+
+  buf->num_lines ++;
+  buf->num_sent += len;
+
+  return (linenum + 1);
+}
+
+
+/*
+ * 'gcode_resend()' - Resend pending lines starting at the requested line.
+ *
+ * Marlin answers every rejected line with "Resend: N" followed by "ok", so
+ * the "ok" is ignored and so are the duplicate requests for the lines that
+ * were already in flight behind the bad one.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+gcode_resend(gcode_buffer_t *buf,	/* I - G-code buffer */
+             int            device_fd,	/* I - Device file */
+	     int            linenum)	/* I - Line number to resend from */
+{
+  size_t	i,			/* Looping var */
+		count;			/* Number of lines to resend */
+  gcode_line_t	*pending;		/* Current pending line */
+
+
+  buf->skip_oks ++;
+
+  if (buf->skip_resends > 0)
+  {
+    buf->skip_resends --;
+    return (1);
+  }
+
+ /*
+  * Find the requested line, earlier lines are still waiting for their "ok"...
+  */
+
+  for (i = 0; i < buf->num_pending; i ++)
+  {
+    if (buf->pending[(buf->first_pending + i) % GCODE_MAX_PENDING].linenum == linenum)
+      break;
+  }
 
-      ok = 0;
+  if (i >= buf->num_pending)
+  {
+    fprintf(stderr, "DEBUG: Printer asked us to resend line %d which is not pending.\n", linenum);
+    return (0);
+  }
+
+  count             = buf->num_pending - i;
+  buf->skip_resends = (int)count - 1;
+  buf->num_resends ++;
+
+  fprintf(stderr, "DEBUG: Resending %lu line(s) starting at line %d.\n", (unsigned long)count, linenum);
+
+  for (; i < buf->num_pending; i ++)
+  {
+    pending = buf->pending + (buf->first_pending + i) % GCODE_MAX_PENDING;
+
+    if (!gcode_write(device_fd, pending->line, pending->length))
+      return (0);
+
+    buf->num_sent += pending->length;
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'gcode_write()' - Write data to the printer.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+gcode_write(int        device_fd,	/* I - Device file */
+            const char *data,		/* I - Data to write */
+	    size_t     length)		/* I - Number of bytes */
+{
+  ssize_t	bytes;			/* Bytes written */
+
+
+  while (length > 0)
+  {
+    if ((bytes = write(device_fd, data, length)) < 0)
+    {
+      if (errno != EAGAIN && errno != EINTR && errno != ENOTTY)
+	return (0);
     }
     else
-      ok = 1;
+    {
+      length -= (size_t)bytes;
+      data   += bytes;
+    }
   }
-  while (!ok);
 
-  return (linenum);
+  return (1);
 }
 
 
@@ -639,6 +1246,22 @@ open_device(const char *device_uri)	/* I - Device URI */
 }
 
 
+/*
+ * 'time_seconds()' - Get the current time in seconds.
+ */
+
+static double				/* O - Time in seconds */
+time_seconds(void)
+{
+  struct timeval	curtime;	/* Current time */
+
+
+  gettimeofday(&curtime, NULL);
+
+  return (curtime.tv_sec + 0.000001 * curtime.tv_usec);
+}
+
+
 /*
  * 'usage()' - Show program usage.
  */
@@ -649,13 +1272,14 @@ usage(int status)			/* I - Exit status */
   puts("Usage: ipptransform [options] filename\n");
   puts("Options:");
   puts("  --help");
+  puts("  -b bytes");
   puts("  -d device-uri");
   puts("  -i input/format");
   puts("  -m output/format");
   puts("  -o \"name=value [... name=value]\"");
   puts("  -v\n");
   puts("Device URIs: usbserial:///dev/...");
-  puts("Input Formats: application/sla, model/3mf");
+  puts("Input Formats: application/g-code, application/sla, model/3mf");
   puts("Output Formats: application/g-code;machine=FOO");
   puts("Options: materials-col, platform-temperature, print-accuracy, print-base, print-quality, print-supports");
 
@@ -670,6 +1294,7 @@ usage(int status)			/* I - Exit status */
 static int				/* O - 0 on success, 1 on failure */
 xform_document(
     const char     *filename,		/* I - Input file */
+    const char     *informat,		/* I - Input format */
     const char     *outformat,		/* I - Output format */
     size_t         num_options,		/* I - Number of options */
     cups_option_t  *options,		/* I - Options */
@@ -693,6 +1318,9 @@ xform_document(
 		platform_temp[1024];	/* Platform temperature setting */
   posix_spawn_file_actions_t actions;	/* Spawn file actions */
   int		mystdout[2] = {-1, -1};	/* Pipe for stdout */
+  char		cachefile[1024];	/* Cached G-code file */
+  int		cache_fd = -1;		/* Temporary G-code file */
+  bool		complete = false;	/* Read all of the G-code? */
   struct pollfd	polldata[2];		/* Poll data */
   int		pollcount;		/* Number of pipes to poll */
   char		data[32768],		/* Data from stdout */
@@ -708,6 +1336,22 @@ xform_document(
 		*supports;		/* print-supports value */
 
 
+ /*
+  * Send G-code that has already been sliced as-is...
+  */
+
+  if (!strcmp(informat, "application/g-code"))
+  {
+    if ((mystdout[0] = open(filename, O_RDONLY)) < 0)
+    {
+      fprintf(stderr, "ERROR: Unable to open \"%s\": %s\n", filename, strerror(errno));
+      return (1);
+    }
+
+    pid = 0;
+    goto send_gcode;
+  }
+
  /*
   * Look for the machine name in the output format...
   */
@@ -995,6 +1639,20 @@ xform_document(
     myargv[myargc++] = "supportType=0";
   }
 
+ /*
+  * See if we have already sliced this model with the same settings...
+  */
+
+  if (cache_name(filename, json, myargc, myargv, cachefile, sizeof(cachefile)) && (mystdout[0] = open(cachefile, O_RDONLY)) >= 0)
+  {
+    fprintf(stderr, "DEBUG: Using cached G-code \"%s\".\n", cachefile);
+
+    utimes(cachefile, NULL);		/* Mark as recently used */
+
+    pid = 0;
+    goto send_gcode;
+  }
+
   myargv[myargc++] = "-l";
   myargv[myargc++] = (char *)filename;
   myargv[myargc  ] = NULL;
@@ -1010,6 +1668,32 @@ xform_document(
     return (1);
   }
 
+  if (cachefile[0])
+  {
+   /*
+    * Save a copy of the G-code for the cache...
+    */
+
+    size_t	cachelen = strlen(cachefile) - 6;
+					/* Length of cache filename without ".gcode" */
+
+    snprintf(CacheTemp, sizeof(CacheTemp), "%.*s.%d.tmp", (int)cachelen, cachefile, (int)getpid());
+
+    if ((cache_fd = open(CacheTemp, O_WRONLY | O_CREAT | O_TRUNC | O_EXCL, 0600)) < 0)
+    {
+      fprintf(stderr, "DEBUG: Unable to create \"%s\": %s\n", CacheTemp, strerror(errno));
+      CacheTemp[0] = '\0';
+    }
+    else
+    {
+     /*
+      * Don't leave the temporary file behind if the job is canceled...
+      */
+
+      signal(SIGTERM, cache_signal);
+    }
+  }
+
   posix_spawn_file_actions_init(&actions);
   posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
   if (mystdout[1] < 0)
@@ -1023,6 +1707,13 @@ xform_document(
 
     posix_spawn_file_actions_destroy(&actions);
 
+    if (cache_fd >= 0)
+    {
+      close(cache_fd);
+      unlink(CacheTemp);
+      CacheTemp[0] = '\0';
+    }
+
     return (1);
   }
 
@@ -1034,39 +1725,41 @@ xform_document(
 
   posix_spawn_file_actions_destroy(&actions);
 
+  close(mystdout[1]);
+
  /*
-  * Read from the stdout and stderr pipes until EOF...
+  * Read G-code from the stdout pipe or cache file until EOF...
   */
 
-  close(mystdout[1]);
+  send_gcode:
 
   pollcount = 0;
   polldata[pollcount].fd     = mystdout[0];
   polldata[pollcount].events = POLLIN;
   pollcount ++;
 
-  polldata[pollcount].fd     = device_fd;
-  polldata[pollcount].events = POLLIN;
-  pollcount ++;
+  if (buf->window)
+  {
+    polldata[pollcount].fd     = device_fd;
+    polldata[pollcount].events = POLLIN;
+    pollcount ++;
+  }
 
   dataptr = data;
 
-  while (poll(polldata, (nfds_t)pollcount, -1))
+  while (poll(polldata, (nfds_t)pollcount, -1) > 0)
   {
-    if (polldata[1].revents & POLLIN)
+    if (pollcount > 1 && (polldata[1].revents & (POLLIN | POLLHUP | POLLERR)))
     {
      /*
-      * Read status info back (eventually do something with it...)
+      * Read acknowledgements and status info back...
       */
 
-      if (gcode_fill(buf, device_fd, 0))
-      {
-	while ((ptr = gcode_gets(buf)) != NULL)
-	  fprintf(stderr, "DEBUG: %s\n", ptr);
-      }
+      if (!gcode_ack(buf, device_fd, 0))
+        break;
     }
 
-    if (polldata[0].revents & POLLIN)
+    if (polldata[0].revents & (POLLIN | POLLHUP))
     {
      /*
       * Read G-code...
@@ -1074,6 +1767,15 @@ xform_document(
 
       if ((bytes = read(mystdout[0], dataptr, sizeof(data) - (size_t)(dataptr - data + 1))) > 0)
       {
+        if (cache_fd >= 0 && write(cache_fd, dataptr, (size_t)bytes) != bytes)
+        {
+          fprintf(stderr, "DEBUG: Unable to write \"%s\": %s\n", CacheTemp, strerror(errno));
+          close(cache_fd);
+          unlink(CacheTemp);
+          CacheTemp[0] = '\0';
+          cache_fd = -1;
+        }
+
         dataptr += bytes;
 	*dataptr = '\0';
 
@@ -1102,12 +1804,27 @@ xform_document(
 	  if (dataptr > data)
 	    memmove(data, end, (size_t)(dataptr - data));
 	}
+
+        if (linenum < 0)
+          break;
+      }
+      else if (bytes == 0)
+      {
+        complete = true;
+        break;
       }
+      else if (errno != EINTR && errno != EAGAIN)
+        break;
     }
   }
 
   close(mystdout[0]);
 
+  if (!pid)
+    return (complete ? 0 : 1);
+  else if (!complete)
+    kill(pid, SIGTERM);			/* Stop slicing if the printer failed */
+
  /*
   * Wait for child to complete...
   */
@@ -1118,6 +1835,28 @@ xform_document(
   while (wait(&status) < 0);
 #  endif /* HAVE_WAITPID */
 
-  return (status);
+  if (cache_fd >= 0)
+  {
+   /*
+    * Add the G-code to the cache if CuraEngine was successful...
+    */
+
+    close(cache_fd);
+
+    if (!status && complete && !rename(CacheTemp, cachefile))
+    {
+      CacheTemp[0] = '\0';
+
+      fprintf(stderr, "DEBUG: Added \"%s\" to G-code cache.\n", cachefile);
+      cache_prune();
+    }
+    else
+    {
+      unlink(CacheTemp);
+      CacheTemp[0] = '\0';
+    }
+  }
+
+  return (complete ? status : 1);
 #endif /* _WIN32 */
 }
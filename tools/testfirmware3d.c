@@ -0,0 +1,605 @@
+/*
+ * Marlin-style 3D printer firmware emulator for testing ipptransform3d.
+ *
+ * Copyright 2023 by the Printer Working Group.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more
+ * information.
+ *
+ * Usage:
+ *
+ *   ./testfirmware3d [options]
+ *
+ * Creates a pseudo-terminal, prints its "usbserial:" device URI, and then
+ * emulates the serial protocol of Marlin firmware: line numbers, checksums,
+ * "ok" and "Resend:" responses, a fixed-size receive buffer, a small command
+ * queue, a per-command execution time, and the link delay of a USB serial
+ * adapter.  When the host closes the device
+ * the line, byte, error, and throughput statistics are shown, for example:
+ *
+ *   ./testfirmware3d -d 4 -l 2 -e 1 &
+ *   ./ipptransform3d -d usbserial:///dev/pts/N -m application/g-code file.stl
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <cups/cups.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+
+/*
+ * Constants...
+ */
+
+#define FW_MAX_LINE	96		/* Maximum command length (MAX_CMD_SIZE) */
+#define FW_MAX_QUEUE	64		/* Maximum command queue size */
+#define FW_MAX_RESPONSES 1024		/* Maximum number of delayed responses */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct fw_response_s		/**** Delayed response ****/
+{
+  double	when;			/* Time to send response */
+  char		text[256];		/* Response text */
+} fw_response_t;
+
+typedef struct fw_s			/**** Firmware state ****/
+{
+  int		master_fd;		/* PTY master */
+  double	delay;			/* Link delay for responses */
+  fw_response_t	responses[FW_MAX_RESPONSES];
+					/* Delayed responses */
+  size_t	first_response,		/* First delayed response */
+		num_responses;		/* Number of delayed responses */
+  size_t	rx_size;		/* Size of receive buffer */
+  char		rx[65536];		/* Receive buffer */
+  size_t	rx_bytes;		/* Bytes in receive buffer */
+  int		queue_size,		/* Size of command queue */
+		queue_count;		/* Number of queued commands */
+  double	latency,		/* Time to execute each command */
+		busy_until;		/* Time current command completes */
+  int		error_rate;		/* Percentage of lines to corrupt */
+  int		last_line;		/* Last good line number */
+  int		verbose;		/* Log each line? */
+
+  size_t	num_lines,		/* Lines received */
+		num_commands,		/* Commands executed */
+		num_bytes,		/* Bytes received */
+		num_dropped,		/* Bytes dropped due to overflow */
+		num_errors,		/* Line number/checksum errors */
+		num_injected,		/* Injected errors */
+		max_rx;			/* Maximum receive buffer use */
+  double	start,			/* Time of first byte */
+		end;			/* Time of last "ok" */
+} fw_t;
+
+
+/*
+ * Local functions...
+ */
+
+static void	fw_error(fw_t *fw, const char *message);
+static void	fw_flush(fw_t *fw, double curtime);
+static void	fw_line(fw_t *fw, char *line);
+static void	fw_printf(fw_t *fw, const char *format, ...) _CUPS_FORMAT(2,3);
+static double	time_seconds(void);
+static void	usage(int status) _CUPS_NORETURN;
+
+
+/*
+ * 'main()' - Main entry for the firmware emulator.
+ */
+
+int					/* O - Exit status */
+main(int  argc,				/* I - Number of command-line args */
+     char *argv[])			/* I - Command-line arguments */
+{
+  int		i;			/* Looping var */
+  const char	*opt;			/* Current option */
+  fw_t		fw;			/* Firmware state */
+  const char	*slave;			/* PTY slave name */
+  int		slave_fd;		/* PTY slave */
+  struct termios opts;			/* PTY options */
+  struct pollfd	pfd;			/* Poll data */
+  bool		connected = false;	/* Host has the device open? */
+  char		buffer[4096],		/* Read buffer */
+		*ptr,			/* Pointer into receive buffer */
+		*eol;			/* End of line */
+  ssize_t	bytes;			/* Bytes read */
+  size_t	len;			/* Length of data */
+  int		timeout;		/* Poll timeout */
+  double	curtime,		/* Current time */
+		wait,			/* Time until next response */
+		elapsed;		/* Elapsed time */
+
+
+ /*
+  * Parse the command-line...
+  */
+
+  memset(&fw, 0, sizeof(fw));
+  fw.rx_size    = 128;			/* Marlin RX_BUFFER_SIZE */
+  fw.queue_size = 4;			/* Marlin BUFSIZE */
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "--help"))
+    {
+      usage(0);
+    }
+    else if (argv[i][0] == '-' && argv[i][1] != '-')
+    {
+      for (opt = argv[i] + 1; *opt; opt ++)
+      {
+        switch (*opt)
+        {
+          case 'b' : /* -b bytes */
+              i ++;
+              if (i >= argc || atoi(argv[i]) < 1 || (size_t)atoi(argv[i]) > sizeof(fw.rx))
+                usage(1);
+
+              fw.rx_size = (size_t)atoi(argv[i]);
+              break;
+
+          case 'd' : /* -d msecs */
+              i ++;
+              if (i >= argc || atof(argv[i]) < 0.0)
+                usage(1);
+
+              fw.delay = 0.001 * atof(argv[i]);
+              break;
+
+          case 'e' : /* -e percent */
+              i ++;
+              if (i >= argc || atoi(argv[i]) < 0 || atoi(argv[i]) > 100)
+                usage(1);
+
+              fw.error_rate = atoi(argv[i]);
+              break;
+
+          case 'l' : /* -l msecs */
+              i ++;
+              if (i >= argc || atof(argv[i]) < 0.0)
+                usage(1);
+
+              fw.latency = 0.001 * atof(argv[i]);
+              break;
+
+          case 'q' : /* -q commands */
+              i ++;
+              if (i >= argc || atoi(argv[i]) < 1 || atoi(argv[i]) > FW_MAX_QUEUE)
+                usage(1);
+
+              fw.queue_size = atoi(argv[i]);
+              break;
+
+          case 's' : /* -s seed */
+              i ++;
+              if (i >= argc)
+                usage(1);
+
+              srand((unsigned)atoi(argv[i]));
+              break;
+
+          case 'v' : /* -v */
+              fw.verbose ++;
+              break;
+
+          default :
+              fprintf(stderr, "testfirmware3d: Unknown option '-%c'.\n", *opt);
+              usage(1);
+        }
+      }
+    }
+    else
+    {
+      fprintf(stderr, "testfirmware3d: Unknown option '%s'.\n", argv[i]);
+      usage(1);
+    }
+  }
+
+ /*
+  * Create the pseudo-terminal and make it raw so the host sees exactly what
+  * a USB serial printer would send...
+  */
+
+  if ((fw.master_fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(fw.master_fd) || unlockpt(fw.master_fd) || (slave = ptsname(fw.master_fd)) == NULL)
+  {
+    perror("testfirmware3d: Unable to create pseudo-terminal");
+    return (1);
+  }
+
+  if ((slave_fd = open(slave, O_RDWR | O_NOCTTY)) < 0)
+  {
+    fprintf(stderr, "testfirmware3d: Unable to open \"%s\": %s\n", slave, strerror(errno));
+    return (1);
+  }
+
+  tcgetattr(slave_fd, &opts);
+  cfmakeraw(&opts);
+  tcsetattr(slave_fd, TCSANOW, &opts);
+  close(slave_fd);
+
+  printf("usbserial://%s\n", slave);
+  fflush(stdout);
+
+ /*
+  * Process commands until the host closes the device...
+  */
+
+  pfd.fd     = fw.master_fd;
+  pfd.events = POLLIN;
+
+  for (;;)
+  {
+    curtime = time_seconds();
+
+    fw_flush(&fw, curtime);
+
+    if (fw.queue_count > 0 && curtime >= fw.busy_until)
+    {
+     /*
+      * Finish the current command...
+      */
+
+      fw_printf(&fw, "ok\n");
+
+      fw.queue_count --;
+      fw.num_commands ++;
+      fw.end        = curtime;
+      fw.busy_until = curtime + fw.latency;
+    }
+
+    if (fw.queue_count < fw.queue_size)
+    {
+     /*
+      * Move complete lines from the receive buffer to the command queue...
+      */
+
+      for (ptr = fw.rx; fw.queue_count < fw.queue_size && (eol = memchr(ptr, '\n', fw.rx_bytes - (size_t)(ptr - fw.rx))) != NULL; ptr = eol + 1)
+      {
+        *eol = '\0';
+
+        if (eol > ptr && eol[-1] == '\r')
+          eol[-1] = '\0';
+
+        if (fw.queue_count == 0)
+          fw.busy_until = curtime + fw.latency;
+
+        fw_line(&fw, ptr);
+      }
+
+      if (ptr > fw.rx)
+      {
+        fw.rx_bytes -= (size_t)(ptr - fw.rx);
+        memmove(fw.rx, ptr, fw.rx_bytes);
+      }
+    }
+
+    if (fw.queue_count > 0)
+    {
+      if ((timeout = (int)(1000.0 * (fw.busy_until - curtime) + 0.999)) < 0)
+        timeout = 0;
+    }
+    else
+      timeout = 100;
+
+    if (fw.num_responses > 0 && (wait = fw.responses[fw.first_response].when - curtime) < 0.001 * timeout)
+      timeout = wait > 0.0 ? (int)(1000.0 * wait + 0.999) : 0;
+
+    if (poll(&pfd, 1, timeout) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      perror("testfirmware3d: Unable to poll pseudo-terminal");
+      break;
+    }
+
+    if (pfd.revents & POLLHUP)
+    {
+     /*
+      * No host, wait for one to connect or report results if it has closed
+      * the device...
+      */
+
+      if (connected)
+        break;
+
+      usleep(100000);
+      continue;
+    }
+    else if (!connected)
+    {
+      connected = true;
+
+      fputs("testfirmware3d: Host connected.\n", stderr);
+      fw_printf(&fw, "start\necho:Marlin testfirmware3d\necho: Last Updated: 2023-01-01 | Author: (ippsample)\n");
+    }
+
+    if (!(pfd.revents & POLLIN))
+      continue;
+
+    if ((bytes = read(fw.master_fd, buffer, sizeof(buffer))) < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      else if (errno == EIO)
+        break;
+
+      perror("testfirmware3d: Unable to read from pseudo-terminal");
+      break;
+    }
+    else if (bytes == 0)
+      break;
+
+    if (fw.num_bytes == 0)
+      fw.start = time_seconds();
+
+    fw.num_bytes += (size_t)bytes;
+
+   /*
+    * Copy what fits in the receive buffer, a real UART drops the rest...
+    */
+
+    if ((len = (size_t)bytes) > (fw.rx_size - fw.rx_bytes))
+    {
+      len = fw.rx_size - fw.rx_bytes;
+
+      if (fw.verbose)
+        fprintf(stderr, "testfirmware3d: Receive buffer overflow, dropped %d bytes.\n", (int)((size_t)bytes - len));
+
+      fw.num_dropped += (size_t)bytes - len;
+    }
+
+    memcpy(fw.rx + fw.rx_bytes, buffer, len);
+    fw.rx_bytes += len;
+
+    if (fw.rx_bytes > fw.max_rx)
+      fw.max_rx = fw.rx_bytes;
+  }
+
+ /*
+  * Show the results...
+  */
+
+  if ((elapsed = fw.end - fw.start) < 0.001)
+    elapsed = 0.001;
+
+  printf("Lines received: %lu\n", (unsigned long)fw.num_lines);
+  printf("Commands executed: %lu\n", (unsigned long)fw.num_commands);
+  printf("Last line number: %d\n", fw.last_line);
+  printf("Bytes received: %lu\n", (unsigned long)fw.num_bytes);
+  printf("Bytes dropped (overflow): %lu\n", (unsigned long)fw.num_dropped);
+  printf("Maximum receive buffer use: %lu of %lu bytes\n", (unsigned long)fw.max_rx, (unsigned long)fw.rx_size);
+  printf("Resend requests: %lu (%lu injected)\n", (unsigned long)fw.num_errors, (unsigned long)fw.num_injected);
+  printf("Elapsed time: %.3f seconds\n", elapsed);
+  printf("Throughput: %.1f commands/second, %.1f bytes/second\n", fw.num_commands / elapsed, fw.num_bytes / elapsed);
+
+  close(fw.master_fd);
+
+  return (fw.num_dropped > 0);
+}
+
+
+/*
+ * 'fw_error()' - Reject a line and ask for it to be sent again.
+ *
+ * Like Marlin, report the error, ask for the next expected line, and then
+ * send "ok".  Lines already in the receive buffer are checked normally, so
+ * each of them gets its own error and resend request.
+ */
+
+static void
+fw_error(fw_t       *fw,		/* I - Firmware state */
+         const char *message)		/* I - Error message */
+{
+  fw->num_errors ++;
+
+  fw_printf(fw, "Error:%s, Last Line: %d\nResend: %d\nok\n", message, fw->last_line, fw->last_line + 1);
+}
+
+
+/*
+ * 'fw_flush()' - Send delayed responses that are due.
+ */
+
+static void
+fw_flush(fw_t   *fw,			/* I - Firmware state */
+         double curtime)		/* I - Current time */
+{
+  fw_response_t	*response;		/* Current response */
+  const char	*ptr;			/* Pointer into response */
+  size_t	len;			/* Length of response */
+  ssize_t	bytes;			/* Bytes written */
+
+
+  while (fw->num_responses > 0)
+  {
+    response = fw->responses + fw->first_response;
+
+    if (response->when > curtime)
+      break;
+
+    for (ptr = response->text, len = strlen(response->text); len > 0; ptr += bytes, len -= (size_t)bytes)
+    {
+      if ((bytes = write(fw->master_fd, ptr, len)) < 0)
+      {
+	if (errno == EINTR || errno == EAGAIN)
+	{
+	  bytes = 0;
+	  continue;
+	}
+
+	break;
+      }
+    }
+
+    fw->first_response = (fw->first_response + 1) % FW_MAX_RESPONSES;
+    fw->num_responses --;
+  }
+}
+
+
+/*
+ * 'fw_line()' - Check a line from the host and queue the command.
+ */
+
+static void
+fw_line(fw_t *fw,			/* I - Firmware state */
+        char *line)			/* I - Line from host */
+{
+  char		*ptr,			/* Pointer into line */
+		*star;			/* Checksum */
+  int		linenum;		/* Line number */
+  unsigned char	checksum;		/* XOR checksum */
+
+
+  fw->num_lines ++;
+
+  if (fw->verbose > 1)
+    fprintf(stderr, "testfirmware3d: <%s\n", line);
+
+  while (isspace(*line & 255))
+    line ++;
+
+  if (!*line)
+    return;
+
+  if (strlen(line) >= FW_MAX_LINE)
+  {
+    fw_error(fw, "Line too long");
+    return;
+  }
+
+  if (*line == 'N')
+  {
+   /*
+    * Validate the line number and checksum...
+    */
+
+    linenum = (int)strtol(line + 1, &ptr, 10);
+
+    if ((star = strchr(line, '*')) == NULL)
+    {
+      fw_error(fw, "No Checksum with line number");
+      return;
+    }
+
+    for (ptr = line, checksum = 0; ptr < star; ptr ++)
+      checksum ^= (unsigned char)*ptr;
+
+    if (atoi(star + 1) != checksum)
+    {
+      fw_error(fw, "checksum mismatch");
+      return;
+    }
+
+    if (strstr(line, "M110"))
+    {
+     /*
+      * M110 sets the current line number...
+      */
+
+      fw->last_line = linenum;
+    }
+    else if (linenum != fw->last_line + 1)
+    {
+      fw_error(fw, "Line Number is not Last Line Number+1");
+      return;
+    }
+    else if (fw->error_rate > 0 && (rand() % 100) < fw->error_rate)
+    {
+      fw->num_injected ++;
+      fw_error(fw, "checksum mismatch");
+      return;
+    }
+    else
+      fw->last_line = linenum;
+  }
+
+  fw->queue_count ++;
+}
+
+
+/*
+ * 'fw_printf()' - Send a response to the host after the link delay.
+ */
+
+static void
+fw_printf(fw_t       *fw,		/* I - Firmware state */
+          const char *format,		/* I - Printf-style format string */
+          ...)				/* I - Additional arguments as needed */
+{
+  fw_response_t	*response;		/* New response */
+  va_list	ap;			/* Pointer to arguments */
+
+
+  if (fw->num_responses >= FW_MAX_RESPONSES)
+    fw_flush(fw, fw->responses[fw->first_response].when);
+
+  response = fw->responses + (fw->first_response + fw->num_responses) % FW_MAX_RESPONSES;
+  fw->num_responses ++;
+
+  va_start(ap, format);
+  vsnprintf(response->text, sizeof(response->text), format, ap);
+  va_end(ap);
+
+  if (fw->verbose > 1)
+    fprintf(stderr, "testfirmware3d: >%s", response->text);
+
+  response->when = time_seconds() + fw->delay;
+
+  fw_flush(fw, time_seconds());
+}
+
+
+/*
+ * 'time_seconds()' - Get the current time in seconds.
+ */
+
+static double				/* O - Time in seconds */
+time_seconds(void)
+{
+  struct timeval	curtime;	/* Current time */
+
+
+  gettimeofday(&curtime, NULL);
+
+  return (curtime.tv_sec + 0.000001 * curtime.tv_usec);
+}
+
+
+/*
+ * 'usage()' - Show program usage.
+ */
+
+static void
+usage(int status)			/* I - Exit status */
+{
+  puts("Usage: testfirmware3d [options]\n");
+  puts("Options:");
+  puts("  --help          Show program help.");
+  puts("  -b bytes        Set receive buffer size (default 128).");
+  puts("  -d msecs        Set link delay for responses (default 0).");
+  puts("  -e percent      Reject percent of good lines with a checksum error (default 0).");
+  puts("  -l msecs        Set time to execute each command (default 0).");
+  puts("  -q commands     Set command queue size (default 4).");
+  puts("  -s seed         Set random seed for injected errors.");
+  puts("  -v              Be verbose (-vv to show each line).");
+
+  exit(status);
+}
@@ -15,6 +15,7 @@
 #include <stdarg.h>
 #include <io.h>
 #include <direct.h>
+#include <process.h>
 
 
 //
@@ -30,6 +31,8 @@
 #define access		_access
 #define close		_close
 #define fileno		_fileno
+#define fsync		_commit
+#define getpid		_getpid
 #define lseek		_lseek
 #define lstat		stat
 #define mkdir(d,p)	_mkdir(d)
@@ -54,6 +57,12 @@
 #define strncasecmp	_strnicmp
 
 
+// Map the POSIX random() and srandom() functions to the standard C rand() and
+// srand() functions - callers only use the low 15 bits (RAND_MAX is 32767)...
+#define random()	rand()
+#define srandom(s)	srand(s)
+
+
 // Map the POSIX sleep() and usleep() functions to the Win32 Sleep() function...
 typedef unsigned long useconds_t;
 #define sleep(X)	Sleep(1000 * (X))